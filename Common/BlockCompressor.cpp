@@ -0,0 +1,1250 @@
+#include "BlockCompressor.h"
+#include "TaskScheduler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if SIMD_X86
+#include <immintrin.h>
+#endif
+
+// The AVX2 partition scores have to round each product the way the scalar code does; see InstanceBuilder.cpp
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+namespace {
+    // Texels of a 4x4 block in row order as pairs of 16-bit channels, the layout pmaddwd
+    // squares and sums two channels of at once
+    struct BlockPixels {
+        int16_t rg[32];
+        int16_t ba[32];
+    };
+
+    // The colors a block's indices select from, packed like BlockPixels
+    struct Palette {
+        uint32_t count;
+        int16_t rg[32];
+        int16_t ba[32];
+
+        void Set(uint32_t index, int r, int g, int b, int a) {
+            rg[index * 2] = static_cast<int16_t>(r);
+            rg[index * 2 + 1] = static_cast<int16_t>(g);
+            ba[index * 2] = static_cast<int16_t>(b);
+            ba[index * 2 + 1] = static_cast<int16_t>(a);
+        }
+    };
+
+    // Sum of squared errors of the texels in `mask` against their nearest palette entry,
+    // the first one on ties; writes the entry of every texel in the mask
+    using EvaluateFunction = uint32_t (*)(const BlockPixels& block, const Palette& palette, uint32_t mask,
+        uint8_t indices[16]);
+
+    uint32_t EvaluateScalar(const BlockPixels& block, const Palette& palette, uint32_t mask, uint8_t indices[16]) {
+        uint32_t total = 0;
+        for (uint32_t t = 0; t < 16; t++) {
+            if (!(mask & (1u << t))) {
+                continue;
+            }
+            int32_t best = 0x7fffffff;
+            uint32_t bestIndex = 0;
+            for (uint32_t p = 0; p < palette.count; p++) {
+                const int32_t dr = block.rg[t * 2] - palette.rg[p * 2];
+                const int32_t dg = block.rg[t * 2 + 1] - palette.rg[p * 2 + 1];
+                const int32_t db = block.ba[t * 2] - palette.ba[p * 2];
+                const int32_t da = block.ba[t * 2 + 1] - palette.ba[p * 2 + 1];
+                const int32_t error = (dr * dr + dg * dg) + (db * db + da * da);
+                if (error < best) {
+                    best = error;
+                    bestIndex = p;
+                }
+            }
+            total += static_cast<uint32_t>(best);
+            indices[t] = static_cast<uint8_t>(bestIndex);
+        }
+        return total;
+    }
+
+#if SIMD_X86
+    // Eight texels per vector: subtracting a broadcast palette entry from the channel pairs
+    // and pmaddwd of the differences with themselves gives r^2 + g^2 and b^2 + a^2 per texel
+    SIMD_TARGET("avx2")
+    uint32_t EvaluateAvx2(const BlockPixels& block, const Palette& palette, uint32_t mask, uint8_t indices[16]) {
+        alignas(32) int32_t errors[16];
+        alignas(32) int32_t chosen[16];
+        for (uint32_t half = 0; half < 2; half++) {
+            const __m256i rg = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block.rg + half * 16));
+            const __m256i ba = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block.ba + half * 16));
+            __m256i best = _mm256_set1_epi32(0x7fffffff);
+            __m256i bestIndex = _mm256_setzero_si256();
+            for (uint32_t p = 0; p < palette.count; p++) {
+                int32_t entryRg, entryBa;
+                std::memcpy(&entryRg, palette.rg + p * 2, 4);
+                std::memcpy(&entryBa, palette.ba + p * 2, 4);
+                const __m256i drg = _mm256_sub_epi16(rg, _mm256_set1_epi32(entryRg));
+                const __m256i dba = _mm256_sub_epi16(ba, _mm256_set1_epi32(entryBa));
+                const __m256i error = _mm256_add_epi32(_mm256_madd_epi16(drg, drg), _mm256_madd_epi16(dba, dba));
+                const __m256i closer = _mm256_cmpgt_epi32(best, error);
+                best = _mm256_min_epi32(best, error);
+                bestIndex = _mm256_blendv_epi8(bestIndex, _mm256_set1_epi32(static_cast<int>(p)), closer);
+            }
+            _mm256_store_si256(reinterpret_cast<__m256i*>(errors + half * 8), best);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(chosen + half * 8), bestIndex);
+        }
+        uint32_t total = 0;
+        for (uint32_t t = 0; t < 16; t++) {
+            if (mask & (1u << t)) {
+                total += static_cast<uint32_t>(errors[t]);
+                indices[t] = static_cast<uint8_t>(chosen[t]);
+            }
+        }
+        return total;
+    }
+#endif
+
+    // BC7 interpolation weights out of 64 for 3- and 4-bit indices
+    const int Weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+    const int Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    // BC7 two-subset partitions: bit t set when texel t is in subset 1
+    const uint16_t Partitions2[64] = {
+        0xcccc, 0x8888, 0xeeee, 0xecc8, 0xc880, 0xfeec, 0xfec8, 0xec80,
+        0xc800, 0xffec, 0xfe80, 0xe800, 0xffe8, 0xff00, 0xfff0, 0xf000,
+        0xf710, 0x008e, 0x7100, 0x08ce, 0x008c, 0x7310, 0x3100, 0x8cce,
+        0x088c, 0x3110, 0x6666, 0x366c, 0x17e8, 0x0ff0, 0x718e, 0x399c,
+        0xaaaa, 0xf0f0, 0x5a5a, 0x33cc, 0x3c3c, 0x55aa, 0x9696, 0xa55a,
+        0x73ce, 0x13c8, 0x324c, 0x3bdc, 0x6996, 0xc33c, 0x9966, 0x0660,
+        0x0272, 0x04e4, 0x4e40, 0x2720, 0xc936, 0x936c, 0x39c6, 0x639c,
+        0x9336, 0x9cc6, 0x817e, 0xe718, 0xccf0, 0x0fcc, 0x7744, 0xee22,
+    };
+
+    // The texel of subset 1 whose index drops its top bit; subset 0's is always texel 0
+    const uint8_t Anchors2[64] = {
+        15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+        15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2,
+        15, 15, 6, 8, 2, 8, 15, 15, 2, 8, 2, 2, 2, 15, 15, 6,
+        6, 2, 6, 8, 15, 15, 2, 2, 15, 15, 15, 15, 15, 2, 2, 15,
+    };
+
+    int Bc7Interpolate(int e0, int e1, int weight) {
+        return ((64 - weight) * e0 + weight * e1 + 32) >> 6;
+    }
+
+    // Endpoint channels are stored with `bits` bits, plus a p-bit as the new lowest bit for
+    // BC7, and widened to 8 bits by repeating their top bits
+    enum class PBits {
+        None,
+        PerEndpoint,
+        Shared,     // One p-bit for both endpoints of a subset
+    };
+
+    struct Endpoints {
+        int q[2][4];
+        int p[2];
+    };
+
+    // What a subset's endpoints and indices encode
+    struct EndpointFormat {
+        int bits[4];                // 0 for channels the format does not store; they decode as 0 here
+        PBits pbits;
+        uint32_t indexCount;
+        float fraction[16];         // Position of each index from endpoint 0 to 1; < 0 for fixed values
+        void (*palette)(const int e0[4], const int e1[4], Palette& out);
+    };
+
+    int Expand(const EndpointFormat& format, const Endpoints& endpoints, int end, int c) {
+        int bits = format.bits[c];
+        if (bits == 0) {
+            return 0;
+        }
+        int value = endpoints.q[end][c];
+        if (format.pbits != PBits::None) {
+            value = (value << 1) | endpoints.p[end];
+            bits++;
+        }
+        return bits >= 8 ? value : (value << (8 - bits)) | (value >> (2 * bits - 8));
+    }
+
+    void BuildPalette(const EndpointFormat& format, const Endpoints& endpoints, Palette& palette) {
+        int e0[4], e1[4];
+        for (int c = 0; c < 4; c++) {
+            e0[c] = Expand(format, endpoints, 0, c);
+            e1[c] = Expand(format, endpoints, 1, c);
+        }
+        format.palette(e0, e1, palette);
+    }
+
+    void PaletteBc1Four(const int e0[4], const int e1[4], Palette& out) {
+        out.count = 4;
+        out.Set(0, e0[0], e0[1], e0[2], 0);
+        out.Set(1, e1[0], e1[1], e1[2], 0);
+        out.Set(2, (2 * e0[0] + e1[0] + 1) / 3, (2 * e0[1] + e1[1] + 1) / 3, (2 * e0[2] + e1[2] + 1) / 3, 0);
+        out.Set(3, (e0[0] + 2 * e1[0] + 1) / 3, (e0[1] + 2 * e1[1] + 1) / 3, (e0[2] + 2 * e1[2] + 1) / 3, 0);
+    }
+
+    // Index 3 is transparent black; the encoder only assigns it to transparent texels
+    void PaletteBc1Three(const int e0[4], const int e1[4], Palette& out) {
+        out.count = 3;
+        out.Set(0, e0[0], e0[1], e0[2], 0);
+        out.Set(1, e1[0], e1[1], e1[2], 0);
+        out.Set(2, (e0[0] + e1[0] + 1) / 2, (e0[1] + e1[1] + 1) / 2, (e0[2] + e1[2] + 1) / 2, 0);
+    }
+
+    int AlphaEight(int a0, int a1, uint32_t index) {
+        if (index < 2) {
+            return index == 0 ? a0 : a1;
+        }
+        const int k = static_cast<int>(index) - 1;
+        return ((7 - k) * a0 + k * a1 + 3) / 7;
+    }
+
+    int AlphaSix(int a0, int a1, uint32_t index) {
+        if (index < 2) {
+            return index == 0 ? a0 : a1;
+        }
+        if (index >= 6) {
+            return index == 6 ? 0 : 255;
+        }
+        const int k = static_cast<int>(index) - 1;
+        return ((5 - k) * a0 + k * a1 + 2) / 5;
+    }
+
+    void PaletteAlphaEight(const int e0[4], const int e1[4], Palette& out) {
+        out.count = 8;
+        for (uint32_t i = 0; i < 8; i++) {
+            out.Set(i, 0, 0, 0, AlphaEight(e0[3], e1[3], i));
+        }
+    }
+
+    void PaletteAlphaSix(const int e0[4], const int e1[4], Palette& out) {
+        out.count = 8;
+        for (uint32_t i = 0; i < 8; i++) {
+            out.Set(i, 0, 0, 0, AlphaSix(e0[3], e1[3], i));
+        }
+    }
+
+    void PaletteBc7Three(const int e0[4], const int e1[4], Palette& out) {
+        out.count = 8;
+        for (uint32_t i = 0; i < 8; i++) {
+            out.Set(i, Bc7Interpolate(e0[0], e1[0], Weights3[i]), Bc7Interpolate(e0[1], e1[1], Weights3[i]),
+                Bc7Interpolate(e0[2], e1[2], Weights3[i]), Bc7Interpolate(e0[3], e1[3], Weights3[i]));
+        }
+    }
+
+    void PaletteBc7Four(const int e0[4], const int e1[4], Palette& out) {
+        out.count = 16;
+        for (uint32_t i = 0; i < 16; i++) {
+            out.Set(i, Bc7Interpolate(e0[0], e1[0], Weights4[i]), Bc7Interpolate(e0[1], e1[1], Weights4[i]),
+                Bc7Interpolate(e0[2], e1[2], Weights4[i]), Bc7Interpolate(e0[3], e1[3], Weights4[i]));
+        }
+    }
+
+    EndpointFormat MakeFormat(int r, int g, int b, int a, PBits pbits, uint32_t indexCount,
+        void (*palette)(const int*, const int*, Palette&)) {
+        EndpointFormat format = { { r, g, b, a }, pbits, indexCount, {}, palette };
+        for (float& f : format.fraction) {
+            f = -1.0f;
+        }
+        return format;
+    }
+
+    struct Formats {
+        EndpointFormat bc1Four, bc1Three, alphaEight, alphaSix, bc7Mode1, bc7Mode6;
+
+        Formats() {
+            bc1Four = MakeFormat(5, 6, 5, 0, PBits::None, 4, PaletteBc1Four);
+            const float four[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+            std::copy(four, four + 4, bc1Four.fraction);
+            bc1Three = MakeFormat(5, 6, 5, 0, PBits::None, 3, PaletteBc1Three);
+            const float three[3] = { 0.0f, 1.0f, 0.5f };
+            std::copy(three, three + 3, bc1Three.fraction);
+            alphaEight = MakeFormat(0, 0, 0, 8, PBits::None, 8, PaletteAlphaEight);
+            alphaSix = MakeFormat(0, 0, 0, 8, PBits::None, 8, PaletteAlphaSix);
+            alphaEight.fraction[0] = alphaSix.fraction[0] = 0.0f;
+            alphaEight.fraction[1] = alphaSix.fraction[1] = 1.0f;
+            for (int i = 2; i < 8; i++) {
+                alphaEight.fraction[i] = (i - 1) / 7.0f;
+            }
+            for (int i = 2; i < 6; i++) {
+                alphaSix.fraction[i] = (i - 1) / 5.0f;
+            }
+            bc7Mode1 = MakeFormat(6, 6, 6, 0, PBits::Shared, 8, PaletteBc7Three);
+            for (int i = 0; i < 8; i++) {
+                bc7Mode1.fraction[i] = Weights3[i] / 64.0f;
+            }
+            bc7Mode6 = MakeFormat(7, 7, 7, 7, PBits::PerEndpoint, 16, PaletteBc7Four);
+            for (int i = 0; i < 16; i++) {
+                bc7Mode6.fraction[i] = Weights4[i] / 64.0f;
+            }
+        }
+    };
+
+    const Formats& GetFormats() {
+        static const Formats formats;
+        return formats;
+    }
+
+    // A block's texels with the channels a format stores; the others are zero so they
+    // neither steer the fit nor count as error
+    struct BlockChannels {
+        float texels[16][4];
+        BlockPixels pixels;
+    };
+
+    BlockChannels SelectChannels(const uint8_t rgba[16][4], uint32_t keep) {
+        BlockChannels block;
+        for (uint32_t t = 0; t < 16; t++) {
+            int value[4];
+            for (uint32_t c = 0; c < 4; c++) {
+                value[c] = (keep & (1u << c)) ? rgba[t][c] : 0;
+                block.texels[t][c] = static_cast<float>(value[c]);
+            }
+            block.pixels.rg[t * 2] = static_cast<int16_t>(value[0]);
+            block.pixels.rg[t * 2 + 1] = static_cast<int16_t>(value[1]);
+            block.pixels.ba[t * 2] = static_cast<int16_t>(value[2]);
+            block.pixels.ba[t * 2 + 1] = static_cast<int16_t>(value[3]);
+        }
+        return block;
+    }
+
+    // The principal axis of the texels in `mask` through their mean; returns false when they
+    // are all the same
+    bool PrincipalAxis(const float texels[16][4], uint32_t mask, float mean[4], float axis[4]) {
+        uint32_t count = 0;
+        float lo[4] = { 255.0f, 255.0f, 255.0f, 255.0f }, hi[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        for (int c = 0; c < 4; c++) {
+            mean[c] = 0.0f;
+        }
+        for (uint32_t t = 0; t < 16; t++) {
+            if (mask & (1u << t)) {
+                count++;
+                for (int c = 0; c < 4; c++) {
+                    mean[c] += texels[t][c];
+                    lo[c] = std::min(lo[c], texels[t][c]);
+                    hi[c] = std::max(hi[c], texels[t][c]);
+                }
+            }
+        }
+        if (count == 0) {
+            return false;
+        }
+        for (int c = 0; c < 4; c++) {
+            mean[c] /= static_cast<float>(count);
+        }
+        float covariance[4][4] = {};
+        float spread = 0.0f;
+        for (uint32_t t = 0; t < 16; t++) {
+            if (mask & (1u << t)) {
+                float d[4];
+                for (int c = 0; c < 4; c++) {
+                    d[c] = texels[t][c] - mean[c];
+                    spread += d[c] * d[c];
+                }
+                for (int i = 0; i < 4; i++) {
+                    for (int j = 0; j < 4; j++) {
+                        covariance[i][j] += d[i] * d[j];
+                    }
+                }
+            }
+        }
+        if (spread == 0.0f) {
+            return false;
+        }
+        // Power iteration from the bounding box diagonal, its signs following the covariance
+        // with the channel that varies most
+        int widest = 0;
+        for (int c = 1; c < 4; c++) {
+            widest = covariance[c][c] > covariance[widest][widest] ? c : widest;
+        }
+        for (int c = 0; c < 4; c++) {
+            axis[c] = covariance[widest][c] < 0.0f ? lo[c] - hi[c] : hi[c] - lo[c];
+        }
+        for (int iteration = 0; iteration < 8; iteration++) {
+            float next[4] = {};
+            for (int i = 0; i < 4; i++) {
+                for (int j = 0; j < 4; j++) {
+                    next[i] += covariance[i][j] * axis[j];
+                }
+            }
+            float length = 0.0f;
+            for (int c = 0; c < 4; c++) {
+                length = std::max(length, std::fabs(next[c]));
+            }
+            if (length == 0.0f) {
+                break;
+            }
+            for (int c = 0; c < 4; c++) {
+                axis[c] = next[c] / length;
+            }
+        }
+        float length = 0.0f;
+        for (int c = 0; c < 4; c++) {
+            length += axis[c] * axis[c];
+        }
+        if (length == 0.0f) {
+            return false;
+        }
+        length = std::sqrt(length);
+        for (int c = 0; c < 4; c++) {
+            axis[c] /= length;
+        }
+        return true;
+    }
+
+    // Integer moments of each texel's RGB and their sum over the block, zero outside the
+    // image: count, r, g, b, rr, rg, rb, gg, gb, bb. Summed over at most 16 texels every
+    // n * rr - r * r term of a scatter matrix stays below 2^24, exact in 32-bit ints and floats.
+    struct BlockMoments {
+        int32_t texel[16][10];
+        int32_t total[10];
+    };
+
+    BlockMoments ComputeMoments(const uint8_t rgba[16][4], uint32_t valid) {
+        BlockMoments moments = {};
+        for (uint32_t t = 0; t < 16; t++) {
+            if (valid & (1u << t)) {
+                const int32_t r = rgba[t][0], g = rgba[t][1], b = rgba[t][2];
+                const int32_t m[10] = { 1, r, g, b, r * r, r * g, r * b, g * g, g * b, b * b };
+                for (int k = 0; k < 10; k++) {
+                    moments.texel[t][k] = m[k];
+                    moments.total[k] += m[k];
+                }
+            }
+        }
+        return moments;
+    }
+
+    // How badly a line fits the texels of each subset of every partition: the RGB variance
+    // off the principal axis, summed over both subsets. The largest eigenvalue of each scatter
+    // matrix is estimated by the Rayleigh quotient of one power iteration from the column of
+    // its widest channel, which is all the ranking needs.
+    using PartitionScoreFunction = void (*)(const BlockMoments& moments, float score[64]);
+
+    float OffAxisScalar(const int32_t m[10]) {
+        // The scatter matrix times the count
+        const int32_t n = m[0];
+        const float c[3][3] = {
+            { float(n * m[4] - m[1] * m[1]), float(n * m[5] - m[1] * m[2]), float(n * m[6] - m[1] * m[3]) },
+            { float(n * m[5] - m[1] * m[2]), float(n * m[7] - m[2] * m[2]), float(n * m[8] - m[2] * m[3]) },
+            { float(n * m[6] - m[1] * m[3]), float(n * m[8] - m[2] * m[3]), float(n * m[9] - m[3] * m[3]) },
+        };
+        const float trace = c[0][0] + c[1][1] + c[2][2];
+        int widest = 0;
+        for (int i = 1; i < 3; i++) {
+            widest = c[i][i] > c[widest][widest] ? i : widest;
+        }
+        const float v[3] = { c[0][widest], c[1][widest], c[2][widest] };
+        const float length = v[0] * v[0] + v[1] * v[1] + v[2] * v[2];
+        // Fewer than two texels leave an all-zero matrix
+        if (length == 0.0f) {
+            return 0.0f;
+        }
+        float along = 0.0f;
+        for (int i = 0; i < 3; i++) {
+            along += v[i] * (c[i][0] * v[0] + c[i][1] * v[1] + c[i][2] * v[2]);
+        }
+        return std::max(0.0f, trace - along / length) / static_cast<float>(n);
+    }
+
+    void PartitionScoresScalar(const BlockMoments& moments, float score[64]) {
+        for (uint32_t p = 0; p < 64; p++) {
+            int32_t subset[10] = {}, rest[10];
+            for (uint32_t t = 0; t < 16; t++) {
+                if (Partitions2[p] & (1u << t)) {
+                    for (int k = 0; k < 10; k++) {
+                        subset[k] += moments.texel[t][k];
+                    }
+                }
+            }
+            for (int k = 0; k < 10; k++) {
+                rest[k] = moments.total[k] - subset[k];
+            }
+            score[p] = OffAxisScalar(subset) + OffAxisScalar(rest);
+        }
+    }
+
+#if SIMD_X86
+    // OffAxisScalar for eight partitions, one per lane, in the same order of operations
+    SIMD_TARGET("avx2")
+    __m256 OffAxisAvx2(const __m256i m[10]) {
+        const __m256i n = m[0];
+        auto scatter = [&](int square, int a, int b) {
+            return _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_mullo_epi32(n, m[square]), _mm256_mullo_epi32(m[a], m[b])));
+        };
+        const __m256 c00 = scatter(4, 1, 1), c01 = scatter(5, 1, 2), c02 = scatter(6, 1, 3);
+        const __m256 c11 = scatter(7, 2, 2), c12 = scatter(8, 2, 3), c22 = scatter(9, 3, 3);
+        const __m256 trace = _mm256_add_ps(_mm256_add_ps(c00, c11), c22);
+        const __m256 widest1 = _mm256_cmp_ps(c11, c00, _CMP_GT_OQ);
+        const __m256 widest2 = _mm256_cmp_ps(c22, _mm256_blendv_ps(c00, c11, widest1), _CMP_GT_OQ);
+        const __m256 v0 = _mm256_blendv_ps(_mm256_blendv_ps(c00, c01, widest1), c02, widest2);
+        const __m256 v1 = _mm256_blendv_ps(_mm256_blendv_ps(c01, c11, widest1), c12, widest2);
+        const __m256 v2 = _mm256_blendv_ps(_mm256_blendv_ps(c02, c12, widest1), c22, widest2);
+        const __m256 length = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(v0, v0), _mm256_mul_ps(v1, v1)),
+            _mm256_mul_ps(v2, v2));
+        auto row = [&](__m256 a, __m256 b, __m256 c) {
+            return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a, v0), _mm256_mul_ps(b, v1)), _mm256_mul_ps(c, v2));
+        };
+        __m256 along = _mm256_setzero_ps();
+        along = _mm256_add_ps(along, _mm256_mul_ps(v0, row(c00, c01, c02)));
+        along = _mm256_add_ps(along, _mm256_mul_ps(v1, row(c01, c11, c12)));
+        along = _mm256_add_ps(along, _mm256_mul_ps(v2, row(c02, c12, c22)));
+        const __m256 off = _mm256_max_ps(_mm256_sub_ps(trace, _mm256_div_ps(along, length)), _mm256_setzero_ps());
+        const __m256 result = _mm256_div_ps(off, _mm256_cvtepi32_ps(n));
+        return _mm256_andnot_ps(_mm256_cmp_ps(length, _mm256_setzero_ps(), _CMP_EQ_OQ), result);
+    }
+
+    SIMD_TARGET("avx2")
+    void PartitionScoresAvx2(const BlockMoments& moments, float score[64]) {
+        for (uint32_t group = 0; group < 8; group++) {
+            const __m256i partitions =
+                _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(Partitions2 + group * 8)));
+            __m256i subset[10], rest[10];
+            for (int k = 0; k < 10; k++) {
+                subset[k] = _mm256_setzero_si256();
+            }
+            for (uint32_t t = 0; t < 16; t++) {
+                const __m256i bit = _mm256_set1_epi32(1 << t);
+                const __m256i inSubset = _mm256_cmpeq_epi32(_mm256_and_si256(partitions, bit), bit);
+                for (int k = 0; k < 10; k++) {
+                    subset[k] = _mm256_add_epi32(subset[k],
+                        _mm256_and_si256(inSubset, _mm256_set1_epi32(moments.texel[t][k])));
+                }
+            }
+            for (int k = 0; k < 10; k++) {
+                rest[k] = _mm256_sub_epi32(_mm256_set1_epi32(moments.total[k]), subset[k]);
+            }
+            _mm256_storeu_ps(score + group * 8, _mm256_add_ps(OffAxisAvx2(subset), OffAxisAvx2(rest)));
+        }
+    }
+#endif
+
+    // The extreme points of the texels projected on their principal axis
+    void FitLine(const float texels[16][4], uint32_t mask, float e0[4], float e1[4]) {
+        float mean[4], axis[4];
+        if (!PrincipalAxis(texels, mask, mean, axis)) {
+            for (int c = 0; c < 4; c++) {
+                e0[c] = e1[c] = mean[c];
+            }
+            return;
+        }
+        float lo = 1e30f, hi = -1e30f;
+        for (uint32_t t = 0; t < 16; t++) {
+            if (mask & (1u << t)) {
+                float dot = 0.0f;
+                for (int c = 0; c < 4; c++) {
+                    dot += (texels[t][c] - mean[c]) * axis[c];
+                }
+                lo = std::min(lo, dot);
+                hi = std::max(hi, dot);
+            }
+        }
+        for (int c = 0; c < 4; c++) {
+            e0[c] = std::min(255.0f, std::max(0.0f, mean[c] + lo * axis[c]));
+            e1[c] = std::min(255.0f, std::max(0.0f, mean[c] + hi * axis[c]));
+        }
+    }
+
+    // Endpoints that minimize the squared error of the texels at their current indices;
+    // false when the indices do not pin both endpoints down
+    bool LeastSquares(const float texels[16][4], uint32_t mask, const uint8_t indices[16], const EndpointFormat& format,
+        float e0[4], float e1[4]) {
+        float a = 0.0f, b = 0.0f, c = 0.0f, x0[4] = {}, x1[4] = {};
+        for (uint32_t t = 0; t < 16; t++) {
+            if (!(mask & (1u << t)) || format.fraction[indices[t]] < 0.0f) {
+                continue;
+            }
+            const float f = format.fraction[indices[t]];
+            a += (1.0f - f) * (1.0f - f);
+            b += (1.0f - f) * f;
+            c += f * f;
+            for (int k = 0; k < 4; k++) {
+                x0[k] += (1.0f - f) * texels[t][k];
+                x1[k] += f * texels[t][k];
+            }
+        }
+        const float determinant = a * c - b * b;
+        if (std::fabs(determinant) < 1e-6f) {
+            return false;
+        }
+        for (int k = 0; k < 4; k++) {
+            e0[k] = std::min(255.0f, std::max(0.0f, (c * x0[k] - b * x1[k]) / determinant));
+            e1[k] = std::min(255.0f, std::max(0.0f, (a * x1[k] - b * x0[k]) / determinant));
+        }
+        return true;
+    }
+
+    // The stored value of a channel nearest to `value` with a given p-bit
+    int QuantizeChannel(const EndpointFormat& format, float value, int c, int pbit) {
+        const int bits = format.bits[c];
+        if (bits == 0) {
+            return 0;
+        }
+        const int top = (1 << bits) - 1;
+        const int total = format.pbits == PBits::None ? bits : bits + 1;
+        float scaled = value * static_cast<float>((1 << total) - 1) / 255.0f;
+        if (format.pbits != PBits::None) {
+            scaled = (scaled - static_cast<float>(pbit)) * 0.5f;
+        }
+        const int guess = std::min(top, std::max(0, static_cast<int>(scaled + 0.5f)));
+        // Widening to 8 bits is not linear, so check the neighbours too
+        Endpoints probe = {};
+        probe.p[0] = pbit;
+        int best = guess;
+        float bestError = 1e30f;
+        for (int q = std::max(0, guess - 1); q <= std::min(top, guess + 1); q++) {
+            probe.q[0][c] = q;
+            const float error = std::fabs(static_cast<float>(Expand(format, probe, 0, c)) - value);
+            if (error < bestError) {
+                bestError = error;
+                best = q;
+            }
+        }
+        return best;
+    }
+
+    // How far an endpoint lands from `value` with a p-bit, summed over channels
+    float QuantizationError(const EndpointFormat& format, const float value[4], int pbit, int q[4]) {
+        Endpoints probe = {};
+        probe.p[0] = pbit;
+        float error = 0.0f;
+        for (int c = 0; c < 4; c++) {
+            q[c] = QuantizeChannel(format, value[c], c, pbit);
+            probe.q[0][c] = q[c];
+            const float d = static_cast<float>(Expand(format, probe, 0, c)) - value[c];
+            error += d * d;
+        }
+        return error;
+    }
+
+    struct LineResult {
+        Endpoints endpoints;
+        uint8_t indices[16];
+        uint32_t error;
+    };
+
+    // Endpoints and indices for the texels in `mask` of one subset
+    class LineEncoder {
+    public:
+        LineEncoder(const BlockChannels& block, uint32_t mask, const EndpointFormat& format, EvaluateFunction evaluate)
+            : block(block), mask(mask), format(format), evaluate(evaluate) {
+            best.endpoints = {};
+            std::memset(best.indices, 0, sizeof(best.indices));
+            best.error = 0xffffffffu;
+        }
+
+        LineResult Encode(BcQuality quality, uint32_t fitMask) {
+            float e0[4], e1[4];
+            FitLine(block.texels, fitMask, e0, e1);
+            TryQuantized(e0, e1, quality != BcQuality::Fast);
+            if (quality == BcQuality::Fast) {
+                return best;
+            }
+            for (int iteration = 0; iteration < 2; iteration++) {
+                if (!LeastSquares(block.texels, mask, best.indices, format, e0, e1) || !TryQuantized(e0, e1, true)) {
+                    break;
+                }
+            }
+            if (quality == BcQuality::Best) {
+                Search();
+            }
+            return best;
+        }
+
+    private:
+        bool Try(const Endpoints& endpoints) {
+            Palette palette;
+            BuildPalette(format, endpoints, palette);
+            uint8_t indices[16] = {};
+            const uint32_t error = evaluate(block.pixels, palette, mask, indices);
+            if (error >= best.error) {
+                return false;
+            }
+            best.endpoints = endpoints;
+            std::memcpy(best.indices, indices, sizeof(indices));
+            best.error = error;
+            return true;
+        }
+
+        // Quantizes both endpoints, with the p-bits that land closest to them or with every choice
+        bool TryQuantized(const float e0[4], const float e1[4], bool everyPBit) {
+            Endpoints endpoints = {};
+            if (format.pbits == PBits::None) {
+                QuantizationError(format, e0, 0, endpoints.q[0]);
+                QuantizationError(format, e1, 0, endpoints.q[1]);
+                return Try(endpoints);
+            }
+            bool improved = false;
+            float closest = 1e30f;
+            Endpoints nearest = {};
+            for (int p0 = 0; p0 < 2; p0++) {
+                for (int p1 = 0; p1 < 2; p1++) {
+                    if (format.pbits == PBits::Shared && p0 != p1) {
+                        continue;
+                    }
+                    endpoints.p[0] = p0;
+                    endpoints.p[1] = p1;
+                    const float error = QuantizationError(format, e0, p0, endpoints.q[0]) +
+                        QuantizationError(format, e1, p1, endpoints.q[1]);
+                    if (everyPBit) {
+                        improved |= Try(endpoints);
+                    }
+                    else if (error < closest) {
+                        closest = error;
+                        nearest = endpoints;
+                    }
+                }
+            }
+            return everyPBit ? improved : Try(nearest);
+        }
+
+        // Greedy descent over single steps of one stored channel or p-bit
+        void Search() {
+            for (int pass = 0; pass < 8; pass++) {
+                bool improved = false;
+                for (int end = 0; end < 2; end++) {
+                    for (int c = 0; c < 4; c++) {
+                        const int top = (1 << format.bits[c]) - 1;
+                        for (int step : { -1, 1 }) {
+                            Endpoints endpoints = best.endpoints;
+                            endpoints.q[end][c] += step;
+                            if (format.bits[c] > 0 && endpoints.q[end][c] >= 0 && endpoints.q[end][c] <= top) {
+                                improved |= Try(endpoints);
+                            }
+                        }
+                    }
+                    if (format.pbits == PBits::PerEndpoint) {
+                        Endpoints endpoints = best.endpoints;
+                        endpoints.p[end] ^= 1;
+                        improved |= Try(endpoints);
+                    }
+                }
+                if (format.pbits == PBits::Shared) {
+                    Endpoints endpoints = best.endpoints;
+                    endpoints.p[0] ^= 1;
+                    endpoints.p[1] ^= 1;
+                    improved |= Try(endpoints);
+                }
+                if (!improved) {
+                    break;
+                }
+            }
+        }
+
+        const BlockChannels& block;
+        uint32_t mask;
+        const EndpointFormat& format;
+        EvaluateFunction evaluate;
+        LineResult best;
+    };
+
+    // 128-bit little-endian bit stream, BC7's layout
+    class BitWriter {
+    public:
+        explicit BitWriter(uint8_t* out) : out(out) { std::memset(out, 0, 16); }
+
+        void Write(uint32_t value, uint32_t bits) {
+            for (uint32_t i = 0; i < bits; i++, position++) {
+                out[position >> 3] |= static_cast<uint8_t>(((value >> i) & 1) << (position & 7));
+            }
+        }
+
+    private:
+        uint8_t* out;
+        uint32_t position = 0;
+    };
+
+    class BitReader {
+    public:
+        explicit BitReader(const uint8_t* in) : in(in) {}
+
+        uint32_t Read(uint32_t bits) {
+            uint32_t value = 0;
+            for (uint32_t i = 0; i < bits; i++, position++) {
+                value |= ((in[position >> 3] >> (position & 7)) & 1u) << i;
+            }
+            return value;
+        }
+
+    private:
+        const uint8_t* in;
+        uint32_t position = 0;
+    };
+
+    struct BlockTexels {
+        uint8_t rgba[16][4];
+        uint32_t valid;         // Texels inside the image; the rest are zero and ignored
+    };
+
+    BlockTexels LoadBlock(const CpuImage& image, uint32_t blockX, uint32_t blockY) {
+        BlockTexels block = {};
+        for (uint32_t y = 0; y < 4; y++) {
+            const uint32_t py = blockY * 4 + y;
+            for (uint32_t x = 0; x < 4; x++) {
+                const uint32_t px = blockX * 4 + x;
+                if (px < image.width && py < image.height) {
+                    std::memcpy(block.rgba[y * 4 + x], image.Row(py) + px * 4, 4);
+                    block.valid |= 1u << (y * 4 + x);
+                }
+            }
+        }
+        return block;
+    }
+
+    uint16_t Pack565(const int q[4]) {
+        return static_cast<uint16_t>((q[0] << 11) | (q[1] << 5) | q[2]);
+    }
+
+    // BC1 colors; in BC3 the four-color mode applies whatever the endpoint order
+    void EncodeColorBlock(const BlockTexels& texels, bool punchThrough, BcQuality quality, EvaluateFunction evaluate,
+        uint8_t* out) {
+        const Formats& formats = GetFormats();
+        uint32_t transparent = 0;
+        if (punchThrough) {
+            for (uint32_t t = 0; t < 16; t++) {
+                transparent |= ((texels.valid >> t) & 1u) && texels.rgba[t][3] < 128 ? 1u << t : 0u;
+            }
+        }
+        const uint32_t opaque = texels.valid & ~transparent;
+        const BlockChannels color = SelectChannels(texels.rgba, 0x7);
+        const EndpointFormat& format = transparent ? formats.bc1Three : formats.bc1Four;
+        LineResult result = LineEncoder(color, opaque, format, evaluate).Encode(quality, opaque);
+
+        uint16_t c0 = Pack565(result.endpoints.q[0]);
+        uint16_t c1 = Pack565(result.endpoints.q[1]);
+        uint8_t* indices = result.indices;
+        for (uint32_t t = 0; t < 16; t++) {
+            if (!(opaque & (1u << t))) {
+                indices[t] = (transparent & (1u << t)) ? 3 : 0;
+            }
+        }
+        // c0 > c1 selects four colors, c0 <= c1 three and transparent black
+        if (transparent ? c0 > c1 : c0 < c1) {
+            std::swap(c0, c1);
+            for (uint32_t t = 0; t < 16; t++) {
+                if (indices[t] < 2 || !transparent) {
+                    indices[t] ^= 1;
+                }
+            }
+        }
+        else if (!transparent && c0 == c1) {
+            std::memset(indices, 0, 16);
+        }
+        uint32_t bits = 0;
+        for (uint32_t t = 0; t < 16; t++) {
+            bits |= static_cast<uint32_t>(indices[t]) << (t * 2);
+        }
+        std::memcpy(out, &c0, 2);
+        std::memcpy(out + 2, &c1, 2);
+        std::memcpy(out + 4, &bits, 4);
+    }
+
+    // BC3's alpha: a0 > a1 interpolates eight values, otherwise six plus 0 and 255
+    void EncodeAlphaBlock(const BlockTexels& texels, BcQuality quality, EvaluateFunction evaluate, uint8_t* out) {
+        const Formats& formats = GetFormats();
+        const BlockChannels alpha = SelectChannels(texels.rgba, 0x8);
+        LineResult result = LineEncoder(alpha, texels.valid, formats.alphaEight, evaluate).Encode(quality, texels.valid);
+        bool six = false;
+        if (quality != BcQuality::Fast) {
+            uint32_t between = 0;
+            for (uint32_t t = 0; t < 16; t++) {
+                between |= texels.rgba[t][3] != 0 && texels.rgba[t][3] != 255 ? 1u << t : 0u;
+            }
+            const LineResult sixResult =
+                LineEncoder(alpha, texels.valid, formats.alphaSix, evaluate).Encode(quality, texels.valid & between);
+            if (sixResult.error < result.error) {
+                result = sixResult;
+                six = true;
+            }
+        }
+
+        int a0 = result.endpoints.q[0][3];
+        int a1 = result.endpoints.q[1][3];
+        uint8_t* indices = result.indices;
+        if (six ? a0 > a1 : a0 < a1) {
+            std::swap(a0, a1);
+            for (uint32_t t = 0; t < 16; t++) {
+                if (indices[t] < 2) {
+                    indices[t] ^= 1;
+                }
+                else if (!six) {
+                    indices[t] = static_cast<uint8_t>(9 - indices[t]);
+                }
+                else if (indices[t] < 6) {
+                    indices[t] = static_cast<uint8_t>(7 - indices[t]);
+                }
+            }
+        }
+        else if (!six && a0 == a1) {
+            std::memset(indices, 0, 16);
+        }
+        out[0] = static_cast<uint8_t>(a0);
+        out[1] = static_cast<uint8_t>(a1);
+        uint64_t bits = 0;
+        for (uint32_t t = 0; t < 16; t++) {
+            bits |= static_cast<uint64_t>(indices[t] & 7) << (t * 3);
+        }
+        for (int i = 0; i < 6; i++) {
+            out[2 + i] = static_cast<uint8_t>(bits >> (i * 8));
+        }
+    }
+
+    void WriteMode6(const LineResult& result, uint8_t* out) {
+        Endpoints endpoints = result.endpoints;
+        uint8_t indices[16];
+        std::memcpy(indices, result.indices, 16);
+        // Texel 0's index is stored without its top bit
+        if (indices[0] & 8) {
+            std::swap(endpoints.q[0], endpoints.q[1]);
+            std::swap(endpoints.p[0], endpoints.p[1]);
+            for (uint8_t& index : indices) {
+                index = static_cast<uint8_t>(15 - index);
+            }
+        }
+        BitWriter writer(out);
+        writer.Write(1u << 6, 7);
+        for (int c = 0; c < 4; c++) {
+            writer.Write(endpoints.q[0][c], 7);
+            writer.Write(endpoints.q[1][c], 7);
+        }
+        writer.Write(endpoints.p[0], 1);
+        writer.Write(endpoints.p[1], 1);
+        for (uint32_t t = 0; t < 16; t++) {
+            writer.Write(indices[t], t == 0 ? 3 : 4);
+        }
+    }
+
+    void WriteMode1(uint32_t partition, const LineResult subsets[2], uint8_t* out) {
+        const uint16_t mask = Partitions2[partition];
+        Endpoints endpoints[2] = { subsets[0].endpoints, subsets[1].endpoints };
+        uint8_t indices[16];
+        for (uint32_t t = 0; t < 16; t++) {
+            indices[t] = subsets[(mask >> t) & 1].indices[t];
+        }
+        const uint32_t anchors[2] = { 0, Anchors2[partition] };
+        for (uint32_t s = 0; s < 2; s++) {
+            if (indices[anchors[s]] & 4) {
+                std::swap(endpoints[s].q[0], endpoints[s].q[1]);
+                for (uint32_t t = 0; t < 16; t++) {
+                    if (((mask >> t) & 1) == s) {
+                        indices[t] = static_cast<uint8_t>(7 - indices[t]);
+                    }
+                }
+            }
+        }
+        BitWriter writer(out);
+        writer.Write(1u << 1, 2);
+        writer.Write(partition, 6);
+        for (int c = 0; c < 3; c++) {
+            for (uint32_t s = 0; s < 2; s++) {
+                writer.Write(endpoints[s].q[0][c], 6);
+                writer.Write(endpoints[s].q[1][c], 6);
+            }
+        }
+        writer.Write(endpoints[0].p[0], 1);
+        writer.Write(endpoints[1].p[0], 1);
+        for (uint32_t t = 0; t < 16; t++) {
+            writer.Write(indices[t], t == anchors[0] || t == anchors[1] ? 2 : 3);
+        }
+    }
+
+    // Partitions tried with mode 1 at each preset, best first by how well a line fits each subset
+    uint32_t PartitionCandidates(BcQuality quality) {
+        return quality == BcQuality::Best ? 4 : quality == BcQuality::Normal ? 1 : 0;
+    }
+
+    void EncodeBc7Block(const BlockTexels& texels, BcQuality quality, EvaluateFunction evaluate,
+        PartitionScoreFunction partitionScores, uint8_t* out) {
+        const Formats& formats = GetFormats();
+        const BlockChannels rgba = SelectChannels(texels.rgba, 0xf);
+        const LineResult single = LineEncoder(rgba, texels.valid, formats.bc7Mode6, evaluate).Encode(quality, texels.valid);
+
+        bool opaque = true;
+        for (uint32_t t = 0; t < 16; t++) {
+            opaque &= !((texels.valid >> t) & 1) || texels.rgba[t][3] == 255;
+        }
+        const uint32_t candidates = opaque && single.error > 0 ? PartitionCandidates(quality) : 0;
+        if (candidates == 0) {
+            WriteMode6(single, out);
+            return;
+        }
+
+        // Mode 1 decodes alpha as 255, so without alpha its error compares with mode 6's
+        const BlockChannels rgb = SelectChannels(texels.rgba, 0x7);
+        float score[64];
+        uint32_t order[64];
+        partitionScores(ComputeMoments(texels.rgba, texels.valid), score);
+        for (uint32_t p = 0; p < 64; p++) {
+            order[p] = p;
+        }
+        std::partial_sort(order, order + candidates, order + 64, [&](uint32_t a, uint32_t b) {
+            return score[a] < score[b] || (score[a] == score[b] && a < b);
+        });
+
+        uint32_t bestPartition = 64, bestError = single.error;
+        LineResult bestSubsets[2];
+        for (uint32_t i = 0; i < candidates; i++) {
+            const uint32_t p = order[i];
+            LineResult subsets[2];
+            uint32_t error = 0;
+            for (uint32_t s = 0; s < 2; s++) {
+                const uint32_t mask = texels.valid & (s ? Partitions2[p] : ~Partitions2[p] & 0xffffu);
+                subsets[s] = LineEncoder(rgb, mask, formats.bc7Mode1, evaluate).Encode(quality, mask);
+                error += mask ? subsets[s].error : 0;
+            }
+            if (error < bestError) {
+                bestError = error;
+                bestPartition = p;
+                bestSubsets[0] = subsets[0];
+                bestSubsets[1] = subsets[1];
+            }
+        }
+        if (bestPartition < 64) {
+            WriteMode1(bestPartition, bestSubsets, out);
+        }
+        else {
+            WriteMode6(single, out);
+        }
+    }
+
+    void DecodeColorBlock(const uint8_t* in, bool alwaysFourColors, uint8_t rgba[16][4]) {
+        uint16_t c[2];
+        uint32_t bits;
+        std::memcpy(c, in, 4);
+        std::memcpy(&bits, in + 4, 4);
+        int e[2][3];
+        for (int i = 0; i < 2; i++) {
+            const int r = c[i] >> 11, g = (c[i] >> 5) & 63, b = c[i] & 31;
+            e[i][0] = (r << 3) | (r >> 2);
+            e[i][1] = (g << 2) | (g >> 4);
+            e[i][2] = (b << 3) | (b >> 2);
+        }
+        const int e0[4] = { e[0][0], e[0][1], e[0][2], 0 }, e1[4] = { e[1][0], e[1][1], e[1][2], 0 };
+        Palette palette;
+        const bool four = alwaysFourColors || c[0] > c[1];
+        if (four) {
+            PaletteBc1Four(e0, e1, palette);
+        }
+        else {
+            PaletteBc1Three(e0, e1, palette);
+        }
+        for (uint32_t t = 0; t < 16; t++) {
+            const uint32_t index = (bits >> (t * 2)) & 3;
+            if (!four && index == 3) {
+                rgba[t][0] = rgba[t][1] = rgba[t][2] = rgba[t][3] = 0;
+                continue;
+            }
+            rgba[t][0] = static_cast<uint8_t>(palette.rg[index * 2]);
+            rgba[t][1] = static_cast<uint8_t>(palette.rg[index * 2 + 1]);
+            rgba[t][2] = static_cast<uint8_t>(palette.ba[index * 2]);
+            rgba[t][3] = 255;
+        }
+    }
+
+    void DecodeAlphaBlock(const uint8_t* in, uint8_t rgba[16][4]) {
+        const int a0 = in[0], a1 = in[1];
+        uint64_t bits = 0;
+        for (int i = 0; i < 6; i++) {
+            bits |= static_cast<uint64_t>(in[2 + i]) << (i * 8);
+        }
+        for (uint32_t t = 0; t < 16; t++) {
+            const uint32_t index = static_cast<uint32_t>((bits >> (t * 3)) & 7);
+            rgba[t][3] = static_cast<uint8_t>(a0 > a1 ? AlphaEight(a0, a1, index) : AlphaSix(a0, a1, index));
+        }
+    }
+
+    void DecodeBc7Block(const uint8_t* in, uint8_t rgba[16][4]) {
+        BitReader reader(in);
+        uint32_t mode = 0;
+        while (mode < 8 && reader.Read(1) == 0) {
+            mode++;
+        }
+        if (mode == 6) {
+            int e[2][4];
+            for (int c = 0; c < 4; c++) {
+                e[0][c] = static_cast<int>(reader.Read(7)) << 1;
+                e[1][c] = static_cast<int>(reader.Read(7)) << 1;
+            }
+            const int p0 = static_cast<int>(reader.Read(1)), p1 = static_cast<int>(reader.Read(1));
+            for (int c = 0; c < 4; c++) {
+                e[0][c] |= p0;
+                e[1][c] |= p1;
+            }
+            for (uint32_t t = 0; t < 16; t++) {
+                const int weight = Weights4[reader.Read(t == 0 ? 3 : 4)];
+                for (int c = 0; c < 4; c++) {
+                    rgba[t][c] = static_cast<uint8_t>(Bc7Interpolate(e[0][c], e[1][c], weight));
+                }
+            }
+            return;
+        }
+        if (mode == 1) {
+            const uint32_t partition = reader.Read(6);
+            int e[2][2][3];
+            for (int c = 0; c < 3; c++) {
+                for (int s = 0; s < 2; s++) {
+                    e[s][0][c] = static_cast<int>(reader.Read(6));
+                    e[s][1][c] = static_cast<int>(reader.Read(6));
+                }
+            }
+            for (int s = 0; s < 2; s++) {
+                const int p = static_cast<int>(reader.Read(1));
+                for (int end = 0; end < 2; end++) {
+                    for (int c = 0; c < 3; c++) {
+                        const int value = (e[s][end][c] << 1) | p;
+                        e[s][end][c] = (value << 1) | (value >> 6);
+                    }
+                }
+            }
+            const uint32_t anchor = Anchors2[partition];
+            for (uint32_t t = 0; t < 16; t++) {
+                const uint32_t s = (Partitions2[partition] >> t) & 1;
+                const int weight = Weights3[reader.Read(t == 0 || t == anchor ? 2 : 3)];
+                for (int c = 0; c < 3; c++) {
+                    rgba[t][c] = static_cast<uint8_t>(Bc7Interpolate(e[s][0][c], e[s][1][c], weight));
+                }
+                rgba[t][3] = 255;
+            }
+            return;
+        }
+        throw std::runtime_error("BC7 mode " + std::to_string(mode) + " blocks are not decoded");
+    }
+}
+
+struct BlockCompressor::Kernels {
+    EvaluateFunction evaluate;
+    PartitionScoreFunction partitionScores;
+};
+
+const char* BcFormatName(BcFormat format) {
+    switch (format) {
+    case BcFormat::BC1: return "bc1";
+    case BcFormat::BC3: return "bc3";
+    case BcFormat::BC7: return "bc7";
+    }
+    return "unknown";
+}
+
+bool ParseBcFormat(const char* name, BcFormat& format) {
+    for (BcFormat candidate : { BcFormat::BC1, BcFormat::BC3, BcFormat::BC7 }) {
+        if (std::strcmp(name, BcFormatName(candidate)) == 0) {
+            format = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t BcBlockBytes(BcFormat format) {
+    return format == BcFormat::BC1 ? 8 : 16;
+}
+
+const char* BcQualityName(BcQuality quality) {
+    switch (quality) {
+    case BcQuality::Fast: return "fast";
+    case BcQuality::Normal: return "normal";
+    case BcQuality::Best: return "best";
+    }
+    return "unknown";
+}
+
+bool ParseBcQuality(const char* name, BcQuality& quality) {
+    for (BcQuality candidate : { BcQuality::Fast, BcQuality::Normal, BcQuality::Best }) {
+        if (std::strcmp(name, BcQualityName(candidate)) == 0) {
+            quality = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+CpuImage DecompressImage(const CompressedImage& image) {
+    CpuImage result(image.width, image.height);
+    const uint32_t blockBytes = BcBlockBytes(image.format);
+    if (image.blocks.size() < static_cast<size_t>(image.RowPitch()) * image.BlocksY()) {
+        throw std::runtime_error("Compressed image is missing blocks");
+    }
+    for (uint32_t by = 0; by < image.BlocksY(); by++) {
+        for (uint32_t bx = 0; bx < image.BlocksX(); bx++) {
+            const uint8_t* in = image.blocks.data() + static_cast<size_t>(by) * image.RowPitch() + bx * blockBytes;
+            uint8_t rgba[16][4];
+            switch (image.format) {
+            case BcFormat::BC1:
+                DecodeColorBlock(in, false, rgba);
+                break;
+            case BcFormat::BC3:
+                DecodeColorBlock(in + 8, true, rgba);
+                DecodeAlphaBlock(in, rgba);
+                break;
+            case BcFormat::BC7:
+                DecodeBc7Block(in, rgba);
+                break;
+            }
+            for (uint32_t y = 0; y < 4 && by * 4 + y < image.height; y++) {
+                for (uint32_t x = 0; x < 4 && bx * 4 + x < image.width; x++) {
+                    std::memcpy(result.Row(by * 4 + y) + (bx * 4 + x) * 4, rgba[y * 4 + x], 4);
+                }
+            }
+        }
+    }
+    return result;
+}
+
+BlockCompressor::BlockCompressor(SimdIsa selected) : isa(selected), kernels(nullptr) {
+    static const Kernels scalar = { EvaluateScalar, PartitionScoresScalar };
+    kernels = &scalar;
+#if SIMD_X86
+    static const Kernels avx2 = { EvaluateAvx2, PartitionScoresAvx2 };
+    if (isa == SimdIsa::AVX2 || isa == SimdIsa::AVX512) {
+        kernels = &avx2;
+    }
+#endif
+}
+
+uint64_t BlockCompressor::LevelBytes(BcFormat format, uint32_t width, uint32_t height) {
+    return static_cast<uint64_t>((width + 3) / 4) * ((height + 3) / 4) * BcBlockBytes(format);
+}
+
+CompressedImage BlockCompressor::Compress(const CpuImage& image, BcFormat format, BcQuality quality,
+    TaskScheduler* scheduler) const {
+    if (image.width == 0 || image.height == 0) {
+        throw std::runtime_error("Cannot compress an empty image");
+    }
+    CompressedImage result;
+    result.format = format;
+    result.width = image.width;
+    result.height = image.height;
+    result.blocks.assign(static_cast<size_t>(result.RowPitch()) * result.BlocksY(), 0);
+    const uint32_t blockBytes = BcBlockBytes(format);
+    const EvaluateFunction evaluate = kernels->evaluate;
+    const PartitionScoreFunction partitionScores = kernels->partitionScores;
+
+    auto encodeRows = [&](uint32_t begin, uint32_t end) {
+        for (uint32_t by = begin; by < end; by++) {
+            for (uint32_t bx = 0; bx < result.BlocksX(); bx++) {
+                const BlockTexels texels = LoadBlock(image, bx, by);
+                uint8_t* out = result.blocks.data() + static_cast<size_t>(by) * result.RowPitch() + bx * blockBytes;
+                switch (format) {
+                case BcFormat::BC1:
+                    EncodeColorBlock(texels, true, quality, evaluate, out);
+                    break;
+                case BcFormat::BC3:
+                    EncodeAlphaBlock(texels, quality, evaluate, out);
+                    EncodeColorBlock(texels, false, quality, evaluate, out + 8);
+                    break;
+                case BcFormat::BC7:
+                    EncodeBc7Block(texels, quality, evaluate, partitionScores, out);
+                    break;
+                }
+            }
+        }
+    };
+    if (scheduler) {
+        scheduler->ParallelFor(result.BlocksY(), encodeRows);
+    }
+    else {
+        encodeRows(0, result.BlocksY());
+    }
+    return result;
+}
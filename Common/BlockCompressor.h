@@ -0,0 +1,82 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "CpuImage.h"
+#include "SimdIsa.h"
+
+class TaskScheduler;
+
+// Block-compressed formats of 4x4 texel blocks
+enum class BcFormat {
+    BC1,    // DXGI_FORMAT_BC1_UNORM, 8 bytes a block: two RGB565 endpoints, 2-bit indices, 1-bit alpha
+    BC3,    // DXGI_FORMAT_BC3_UNORM, 16 bytes: BC1 colors and interpolated 8-bit alpha
+    BC7,    // DXGI_FORMAT_BC7_UNORM, 16 bytes: RGBA endpoints up to 8 bits, up to 4-bit indices
+};
+
+const char* BcFormatName(BcFormat format);
+bool ParseBcFormat(const char* name, BcFormat& format);
+uint32_t BcBlockBytes(BcFormat format);
+
+// How hard the encoder searches for endpoints
+enum class BcQuality {
+    Fast,       // Principal axis endpoints, one pass over the indices
+    Normal,     // Plus least-squares refits of the endpoints to their indices and every p-bit choice
+    Best,       // Plus a greedy search of neighbouring endpoint values and more BC7 partitions
+};
+
+const char* BcQualityName(BcQuality quality);
+bool ParseBcQuality(const char* name, BcQuality& quality);
+
+// A block-compressed image as D3D12_SUBRESOURCE_DATA takes it: BlocksY() rows of
+// RowPitch() bytes, blocks left to right. A texture with this format needs a top level
+// whose width and height are multiples of 4; smaller levels still take whole blocks.
+struct CompressedImage {
+    BcFormat format = BcFormat::BC1;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint8_t> blocks;
+
+    uint32_t BlocksX() const { return (width + 3) / 4; }
+    uint32_t BlocksY() const { return (height + 3) / 4; }
+    uint32_t RowPitch() const { return BlocksX() * BcBlockBytes(format); }
+};
+
+// Decodes to R8G8B8A8. BC1 and BC3 interpolate with integer rounding, which hardware may
+// differ from by one step. For BC7 only modes 1 and 6, the ones BlockCompressor writes,
+// are decoded; other modes throw std::runtime_error.
+CpuImage DecompressImage(const CompressedImage& image);
+
+// Encodes R8G8B8A8 images block by block. Endpoints start from the principal axis of the
+// block's texels; every candidate endpoint pair is scored by mapping each texel to its
+// nearest palette entry by squared RGBA error, in integers. That search is the inner loop
+// of every preset and has an AVX2 kernel taking eight texels per vector. BC7 ranks its 64
+// partitions by how well a line fits each subset, eight partitions per vector with AVX2 in
+// the scalar code's order of operations, so every ISA writes the same blocks.
+//
+// BC1 blocks with texels below alpha 128 use the three-color mode with transparent black.
+// BC7 uses mode 6 (one subset, RGBA) and, for opaque blocks at Normal and Best, mode 1
+// (two subsets out of 64 partitions, RGB) when its error is lower.
+class BlockCompressor {
+public:
+    // SimdIsa::AVX512 runs the AVX2 kernel and SSE42 the scalar one
+    explicit BlockCompressor(SimdIsa isa = DetectSimdIsa());
+
+    SimdIsa Isa() const { return isa; }
+
+    // Rows of blocks are spread over the scheduler's threads; scheduler may be null to
+    // encode on the calling thread. Throws std::runtime_error for an empty image.
+    CompressedImage Compress(const CpuImage& image, BcFormat format, BcQuality quality,
+        TaskScheduler* scheduler) const;
+
+    // Bytes of a format's level or of an R8G8B8A8 one, for reporting what compression saves
+    static uint64_t LevelBytes(BcFormat format, uint32_t width, uint32_t height);
+    static uint64_t UncompressedLevelBytes(uint32_t width, uint32_t height) {
+        return static_cast<uint64_t>(width) * height * 4;
+    }
+
+private:
+    struct Kernels;
+
+    SimdIsa isa;
+    const Kernels* kernels;
+};
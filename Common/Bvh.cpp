@@ -0,0 +1,919 @@
+#include "Bvh.h"
+#include "TaskScheduler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <limits>
+
+#if SIMD_X86
+#include <immintrin.h>
+#endif
+
+// The wide-node kernels have to round each box test the way TestBox and IntersectBox do
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+namespace {
+    // Primitives per ParallelFor item for centroids, root bounds, binning and leaf refits
+    const uint32_t ChunkSize = 16384;
+
+    // Nodes with fewer primitives than this are binned on one thread even during a parallel build
+    const uint32_t ParallelBinThreshold = 65536;
+
+    // The semantics of minps and maxps, NaNs included, so the scalar and SIMD slab tests agree
+    inline float MinF(float a, float b) { return a < b ? a : b; }
+    inline float MaxF(float a, float b) { return a > b ? a : b; }
+
+    inline float Component(const Float3& v, int axis) { return axis == 0 ? v.x : axis == 1 ? v.y : v.z; }
+
+    Aabb EmptyBox() {
+        const float inf = std::numeric_limits<float>::infinity();
+        return { { inf, inf, inf }, { -inf, -inf, -inf } };
+    }
+
+    // MinF and MaxF rather than std::min and std::max, which take references and come out as
+    // branches that the random order of a build mispredicts
+    inline void Grow(Aabb& box, const Aabb& other) {
+        box.min = { MinF(other.min.x, box.min.x), MinF(other.min.y, box.min.y), MinF(other.min.z, box.min.z) };
+        box.max = { MaxF(other.max.x, box.max.x), MaxF(other.max.y, box.max.y), MaxF(other.max.z, box.max.z) };
+    }
+
+    inline void Grow(Aabb& box, const Float3& point) {
+        Grow(box, Aabb{ point, point });
+    }
+
+    // Half the surface area; 0 for an empty box
+    inline float HalfArea(const Aabb& box) {
+        const float dx = box.max.x - box.min.x, dy = box.max.y - box.min.y, dz = box.max.z - box.min.z;
+        return dx < 0.0f ? 0.0f : dx * dy + dy * dz + dz * dx;
+    }
+
+    inline Aabb NodeBox(const BvhNode& node) {
+        return { node.min, node.max };
+    }
+
+    inline void SetBox(BvhNode& node, const Aabb& box) {
+        node.min = box.min;
+        node.max = box.max;
+    }
+
+    // fn(begin, end, chunk) over [0, count) in ChunkSize pieces, on the scheduler if there is one
+    template <typename Function>
+    void ForChunks(TaskScheduler* scheduler, uint32_t count, const Function& fn) {
+        const uint32_t chunks = (count + ChunkSize - 1) / ChunkSize;
+        auto run = [&](uint32_t begin, uint32_t end) {
+            for (uint32_t chunk = begin; chunk < end; chunk++) {
+                fn(chunk * ChunkSize, std::min((chunk + 1) * ChunkSize, count), chunk);
+            }
+        };
+        if (scheduler && chunks > 1) {
+            scheduler->ParallelFor(chunks, run);
+        }
+        else {
+            run(0, chunks);
+        }
+    }
+
+    struct Bin {
+        Aabb bounds;
+        Aabb centroids;
+        uint32_t count;
+    };
+
+    struct BinSet {
+        Bin bins[3][Bvh::BinCount];
+
+        void Clear() {
+            for (auto& axis : bins) {
+                for (Bin& bin : axis) {
+                    bin = { EmptyBox(), EmptyBox(), 0 };
+                }
+            }
+        }
+
+        void Merge(const BinSet& other) {
+            for (int axis = 0; axis < 3; axis++) {
+                for (uint32_t b = 0; b < Bvh::BinCount; b++) {
+                    Grow(bins[axis][b].bounds, other.bins[axis][b].bounds);
+                    Grow(bins[axis][b].centroids, other.bins[axis][b].centroids);
+                    bins[axis][b].count += other.bins[axis][b].count;
+                }
+            }
+        }
+    };
+
+    // What binning and partitioning read of a primitive, kept in build order alongside its
+    // index so both stream through memory instead of gathering from the caller's boxes
+    struct BuildPrimitive {
+        Aabb box;
+        Float3 centroid;
+        uint32_t primitive;
+    };
+
+    // A node whose primitives are Primitives()[first, last), with the bounds of their boxes
+    // and of their centroids
+    struct BuildTask {
+        uint32_t node;
+        uint32_t first, last;
+        Aabb bounds;
+        Aabb centroids;
+    };
+
+    class Builder {
+    public:
+        explicit Builder(std::vector<BuildPrimitive>& primitives) : primitives(primitives) {}
+
+        // Fills node and returns true with left and right set up if the task is worth
+        // splitting; the children will be nodes firstChild and firstChild + 1
+        bool Split(const BuildTask& task, uint32_t firstChild, BvhNode& node, BuildTask& left, BuildTask& right,
+            TaskScheduler* scheduler) const {
+            const uint32_t count = task.last - task.first;
+            SetBox(node, task.bounds);
+            node.first = task.first;
+            node.count = count;
+            if (count <= 1) {
+                return false;
+            }
+
+            float origin[3], scale[3];
+            bool any = false;
+            for (int axis = 0; axis < 3; axis++) {
+                origin[axis] = Component(task.centroids.min, axis);
+                const float extent = Component(task.centroids.max, axis) - origin[axis];
+                const float binScale = extent > 0.0f ? Bvh::BinCount / extent : 0.0f;
+                scale[axis] = std::isfinite(binScale) ? binScale : 0.0f;
+                any |= scale[axis] > 0.0f;
+            }
+            if (!any) {
+                // Every centroid in one place: no plane separates them, so halve the range
+                if (count <= Bvh::MaxLeafSize) {
+                    return false;
+                }
+                const uint32_t middle = task.first + count / 2;
+                left = { 0, task.first, middle, RangeBounds(task.first, middle), task.centroids };
+                right = { 0, middle, task.last, RangeBounds(middle, task.last), task.centroids };
+                node.first = firstChild;
+                node.count = 0;
+                return true;
+            }
+
+            BinSet bins;
+            if (scheduler && count >= ParallelBinThreshold) {
+                std::vector<BinSet> partial((count + ChunkSize - 1) / ChunkSize);
+                ForChunks(scheduler, count, [&](uint32_t begin, uint32_t end, uint32_t chunk) {
+                    BinRange(task.first + begin, task.first + end, origin, scale, partial[chunk]);
+                });
+                bins = partial[0];
+                for (size_t k = 1; k < partial.size(); k++) {
+                    bins.Merge(partial[k]);
+                }
+            }
+            else {
+                BinRange(task.first, task.last, origin, scale, bins);
+            }
+
+            // Sweep each axis for the split with the least area-weighted primitive count
+            float bestCost = std::numeric_limits<float>::max();
+            int bestAxis = -1;
+            uint32_t bestSplit = 0;
+            for (int axis = 0; axis < 3; axis++) {
+                if (scale[axis] == 0.0f) {
+                    continue;
+                }
+                float rightCost[Bvh::BinCount];
+                Aabb box = EmptyBox();
+                uint32_t rightCount = 0;
+                for (uint32_t b = Bvh::BinCount - 1; b > 0; b--) {
+                    Grow(box, bins.bins[axis][b].bounds);
+                    rightCount += bins.bins[axis][b].count;
+                    rightCost[b] = HalfArea(box) * rightCount;
+                }
+                box = EmptyBox();
+                uint32_t leftCount = 0;
+                for (uint32_t split = 1; split < Bvh::BinCount; split++) {
+                    Grow(box, bins.bins[axis][split - 1].bounds);
+                    leftCount += bins.bins[axis][split - 1].count;
+                    const float cost = HalfArea(box) * leftCount + rightCost[split];
+                    if (leftCount > 0 && leftCount < count && cost < bestCost) {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestSplit = split;
+                    }
+                }
+            }
+
+            // One traversal step against testing every primitive, each relative to one box test
+            const float area = HalfArea(task.bounds);
+            const float splitCost = area > 0.0f ? 1.0f + bestCost / area : static_cast<float>(count);
+            if (bestAxis < 0 || (count <= Bvh::MaxLeafSize && splitCost >= static_cast<float>(count))) {
+                return false;
+            }
+
+            const float axisOrigin = origin[bestAxis], axisScale = scale[bestAxis];
+            BuildPrimitive* middle = std::partition(primitives.data() + task.first, primitives.data() + task.last,
+                [&](const BuildPrimitive& primitive) {
+                    return BinIndex(Component(primitive.centroid, bestAxis), axisOrigin, axisScale) < bestSplit;
+                });
+            const uint32_t split = static_cast<uint32_t>(middle - primitives.data());
+            left = { 0, task.first, split, EmptyBox(), EmptyBox() };
+            right = { 0, split, task.last, EmptyBox(), EmptyBox() };
+            for (uint32_t b = 0; b < Bvh::BinCount; b++) {
+                BuildTask& side = b < bestSplit ? left : right;
+                Grow(side.bounds, bins.bins[bestAxis][b].bounds);
+                Grow(side.centroids, bins.bins[bestAxis][b].centroids);
+            }
+            node.first = firstChild;
+            node.count = 0;
+            return true;
+        }
+
+        // The whole subtree of a task on this thread, into nodes
+        void BuildRecursive(const BuildTask& task, std::vector<BvhNode>& nodes) const {
+            BuildTask left, right;
+            BvhNode node;
+            const uint32_t firstChild = static_cast<uint32_t>(nodes.size());
+            if (Split(task, firstChild, node, left, right, nullptr)) {
+                nodes[task.node] = node;
+                nodes.resize(nodes.size() + 2);
+                left.node = firstChild;
+                right.node = firstChild + 1;
+                BuildRecursive(left, nodes);
+                BuildRecursive(right, nodes);
+            }
+            else {
+                nodes[task.node] = node;
+            }
+        }
+
+        Aabb RangeBounds(uint32_t first, uint32_t last) const {
+            Aabb box = EmptyBox();
+            for (uint32_t i = first; i < last; i++) {
+                Grow(box, primitives[i].box);
+            }
+            return box;
+        }
+
+    private:
+        static uint32_t BinIndex(float centroid, float origin, float scale) {
+            const int bin = static_cast<int>((centroid - origin) * scale);
+            return bin < 0 ? 0 : bin >= static_cast<int>(Bvh::BinCount) ? Bvh::BinCount - 1 : static_cast<uint32_t>(bin);
+        }
+
+        void BinRange(uint32_t first, uint32_t last, const float origin[3], const float scale[3], BinSet& bins) const {
+            bins.Clear();
+            for (uint32_t i = first; i < last; i++) {
+                const BuildPrimitive& primitive = primitives[i];
+                for (int axis = 0; axis < 3; axis++) {
+                    Bin& bin = bins.bins[axis][BinIndex(Component(primitive.centroid, axis), origin[axis], scale[axis])];
+                    Grow(bin.bounds, primitive.box);
+                    Grow(bin.centroids, primitive.centroid);
+                    bin.count++;
+                }
+            }
+        }
+
+        std::vector<BuildPrimitive>& primitives;
+    };
+
+    // Primitives of a subtree known to be inside the frustum: the range from its leftmost
+    // leaf to its rightmost, found down the two edges instead of visiting every node
+    void AppendSubtree(const std::vector<BvhNode>& nodes, const std::vector<uint32_t>& primitives, uint32_t root,
+        uint32_t* out, uint32_t& visible) {
+        uint32_t left = root, right = root;
+        while (nodes[left].count == 0) {
+            left = nodes[left].first;
+        }
+        while (nodes[right].count == 0) {
+            right = nodes[right].first + 1;
+        }
+        const uint32_t first = nodes[left].first, last = nodes[right].first + nodes[right].count;
+        std::memcpy(out + visible, primitives.data() + first, (last - first) * sizeof(uint32_t));
+        visible += last - first;
+    }
+
+    // The same for a wide node's interior slot, whose slots keep the binary tree's order
+    template <int Width>
+    void AppendWideSubtree(const std::vector<WideBvhNode<Width>>& nodes, const uint32_t* primitives, uint32_t root,
+        uint32_t* out, uint32_t& visible) {
+        const WideBvhNode<Width>* left = &nodes[root];
+        while (left->count[0] == 0) {
+            left = &nodes[left->child[0]];
+        }
+        const WideBvhNode<Width>* right = &nodes[root];
+        for (;;) {
+            int last = Width - 1;
+            while (right->child[last] == WideBvh<Width>::EmptyChild) {
+                last--;
+            }
+            if (right->count[last] > 0) {
+                const uint32_t first = left->child[0], end = right->child[last] + right->count[last];
+                std::memcpy(out + visible, primitives + first, (end - first) * sizeof(uint32_t));
+                visible += end - first;
+                return;
+            }
+            right = &nodes[right->child[last]];
+        }
+    }
+
+    // Per-slot tests of a wide node. Each returns a bit mask of used slots: those not outside
+    // the frustum (and in `inside` those entirely inside), or those the ray enters before tMax
+    // with the entry distances in t.
+    template <int Width>
+    using FrustumSlotFunction = uint32_t (*)(const WideBvhNode<Width>& node, const Frustum& frustum, uint32_t& inside);
+
+    template <int Width>
+    using RaySlotFunction = uint32_t (*)(const WideBvhNode<Width>& node, const Ray& ray, const Float3& inverse,
+        float tMax, float* t);
+
+    template <int Width>
+    inline Aabb SlotBox(const WideBvhNode<Width>& node, int k) {
+        return { { node.minX[k], node.minY[k], node.minZ[k] }, { node.maxX[k], node.maxY[k], node.maxZ[k] } };
+    }
+
+    template <int Width>
+    uint32_t FrustumSlotsScalar(const WideBvhNode<Width>& node, const Frustum& frustum, uint32_t& inside) {
+        uint32_t keep = 0;
+        inside = 0;
+        for (int k = 0; k < Width && node.child[k] != WideBvh<Width>::EmptyChild; k++) {
+            const FrustumTest test = TestBox(frustum, SlotBox(node, k));
+            keep |= (test != FrustumTest::Outside ? 1u : 0u) << k;
+            inside |= (test == FrustumTest::Inside ? 1u : 0u) << k;
+        }
+        return keep;
+    }
+
+    template <int Width>
+    uint32_t RaySlotsScalar(const WideBvhNode<Width>& node, const Ray& ray, const Float3& inverse, float tMax, float* t) {
+        uint32_t hits = 0;
+        for (int k = 0; k < Width && node.child[k] != WideBvh<Width>::EmptyChild; k++) {
+            hits |= (IntersectBox(ray, inverse, SlotBox(node, k), tMax, t[k]) ? 1u : 0u) << k;
+        }
+        return hits;
+    }
+
+#if SIMD_X86
+    SIMD_TARGET("sse4.2")
+    uint32_t FrustumSlotsSse(const WideBvhNode<4>& node, const Frustum& frustum, uint32_t& inside) {
+        const __m128 low[3] = { _mm_loadu_ps(node.minX), _mm_loadu_ps(node.minY), _mm_loadu_ps(node.minZ) };
+        const __m128 high[3] = { _mm_loadu_ps(node.maxX), _mm_loadu_ps(node.maxY), _mm_loadu_ps(node.maxZ) };
+        const __m128 zero = _mm_setzero_ps();
+        __m128 outside = zero, crossing = zero;
+        for (const Float4& plane : frustum.planes) {
+            const float n[3] = { plane.x, plane.y, plane.z };
+            __m128 farthest = _mm_mul_ps(_mm_set1_ps(n[0]), n[0] >= 0.0f ? high[0] : low[0]);
+            __m128 nearest = _mm_mul_ps(_mm_set1_ps(n[0]), n[0] >= 0.0f ? low[0] : high[0]);
+            for (int axis = 1; axis < 3; axis++) {
+                farthest = _mm_add_ps(farthest, _mm_mul_ps(_mm_set1_ps(n[axis]), n[axis] >= 0.0f ? high[axis] : low[axis]));
+                nearest = _mm_add_ps(nearest, _mm_mul_ps(_mm_set1_ps(n[axis]), n[axis] >= 0.0f ? low[axis] : high[axis]));
+            }
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(farthest, _mm_set1_ps(plane.w)), zero));
+            crossing = _mm_or_ps(crossing, _mm_cmplt_ps(_mm_add_ps(nearest, _mm_set1_ps(plane.w)), zero));
+        }
+        const __m128i empty = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(node.child)),
+            _mm_set1_epi32(-1));
+        const uint32_t used = ~static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(empty))) & 0xf;
+        const uint32_t keep = ~static_cast<uint32_t>(_mm_movemask_ps(outside)) & used;
+        inside = ~static_cast<uint32_t>(_mm_movemask_ps(crossing)) & keep;
+        return keep;
+    }
+
+    SIMD_TARGET("sse4.2")
+    uint32_t RaySlotsSse(const WideBvhNode<4>& node, const Ray& ray, const Float3& inverse, float tMax, float* t) {
+        const __m128 tx1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minX), _mm_set1_ps(ray.origin.x)), _mm_set1_ps(inverse.x));
+        const __m128 tx2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxX), _mm_set1_ps(ray.origin.x)), _mm_set1_ps(inverse.x));
+        const __m128 ty1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minY), _mm_set1_ps(ray.origin.y)), _mm_set1_ps(inverse.y));
+        const __m128 ty2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxY), _mm_set1_ps(ray.origin.y)), _mm_set1_ps(inverse.y));
+        const __m128 tz1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minZ), _mm_set1_ps(ray.origin.z)), _mm_set1_ps(inverse.z));
+        const __m128 tz2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxZ), _mm_set1_ps(ray.origin.z)), _mm_set1_ps(inverse.z));
+        __m128 entry = _mm_max_ps(_mm_max_ps(_mm_min_ps(tx1, tx2), _mm_min_ps(ty1, ty2)), _mm_min_ps(tz1, tz2));
+        entry = _mm_max_ps(entry, _mm_setzero_ps());
+        __m128 exit = _mm_min_ps(_mm_min_ps(_mm_max_ps(tx1, tx2), _mm_max_ps(ty1, ty2)), _mm_max_ps(tz1, tz2));
+        exit = _mm_min_ps(exit, _mm_set1_ps(tMax));
+        const __m128 hit = _mm_and_ps(_mm_cmple_ps(entry, exit), _mm_cmplt_ps(entry, _mm_set1_ps(tMax)));
+        _mm_storeu_ps(t, entry);
+        const __m128i empty = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(node.child)),
+            _mm_set1_epi32(-1));
+        return static_cast<uint32_t>(_mm_movemask_ps(_mm_andnot_ps(_mm_castsi128_ps(empty), hit)));
+    }
+
+    SIMD_TARGET("avx2")
+    uint32_t FrustumSlotsAvx2(const WideBvhNode<8>& node, const Frustum& frustum, uint32_t& inside) {
+        const __m256 low[3] = { _mm256_loadu_ps(node.minX), _mm256_loadu_ps(node.minY), _mm256_loadu_ps(node.minZ) };
+        const __m256 high[3] = { _mm256_loadu_ps(node.maxX), _mm256_loadu_ps(node.maxY), _mm256_loadu_ps(node.maxZ) };
+        const __m256 zero = _mm256_setzero_ps();
+        __m256 outside = zero, crossing = zero;
+        for (const Float4& plane : frustum.planes) {
+            const float n[3] = { plane.x, plane.y, plane.z };
+            __m256 farthest = _mm256_mul_ps(_mm256_set1_ps(n[0]), n[0] >= 0.0f ? high[0] : low[0]);
+            __m256 nearest = _mm256_mul_ps(_mm256_set1_ps(n[0]), n[0] >= 0.0f ? low[0] : high[0]);
+            for (int axis = 1; axis < 3; axis++) {
+                farthest = _mm256_add_ps(farthest, _mm256_mul_ps(_mm256_set1_ps(n[axis]), n[axis] >= 0.0f ? high[axis] : low[axis]));
+                nearest = _mm256_add_ps(nearest, _mm256_mul_ps(_mm256_set1_ps(n[axis]), n[axis] >= 0.0f ? low[axis] : high[axis]));
+            }
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(farthest, _mm256_set1_ps(plane.w)), zero, _CMP_LT_OQ));
+            crossing = _mm256_or_ps(crossing, _mm256_cmp_ps(_mm256_add_ps(nearest, _mm256_set1_ps(plane.w)), zero, _CMP_LT_OQ));
+        }
+        const __m256i empty = _mm256_cmpeq_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(node.child)),
+            _mm256_set1_epi32(-1));
+        const uint32_t used = ~static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(empty))) & 0xff;
+        const uint32_t keep = ~static_cast<uint32_t>(_mm256_movemask_ps(outside)) & used;
+        inside = ~static_cast<uint32_t>(_mm256_movemask_ps(crossing)) & keep;
+        return keep;
+    }
+
+    SIMD_TARGET("avx2")
+    uint32_t RaySlotsAvx2(const WideBvhNode<8>& node, const Ray& ray, const Float3& inverse, float tMax, float* t) {
+        const __m256 ox = _mm256_set1_ps(ray.origin.x), oy = _mm256_set1_ps(ray.origin.y), oz = _mm256_set1_ps(ray.origin.z);
+        const __m256 ix = _mm256_set1_ps(inverse.x), iy = _mm256_set1_ps(inverse.y), iz = _mm256_set1_ps(inverse.z);
+        const __m256 tx1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(node.minX), ox), ix);
+        const __m256 tx2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(node.maxX), ox), ix);
+        const __m256 ty1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(node.minY), oy), iy);
+        const __m256 ty2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(node.maxY), oy), iy);
+        const __m256 tz1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(node.minZ), oz), iz);
+        const __m256 tz2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(node.maxZ), oz), iz);
+        __m256 entry = _mm256_max_ps(_mm256_max_ps(_mm256_min_ps(tx1, tx2), _mm256_min_ps(ty1, ty2)), _mm256_min_ps(tz1, tz2));
+        entry = _mm256_max_ps(entry, _mm256_setzero_ps());
+        __m256 exit = _mm256_min_ps(_mm256_min_ps(_mm256_max_ps(tx1, tx2), _mm256_max_ps(ty1, ty2)), _mm256_max_ps(tz1, tz2));
+        exit = _mm256_min_ps(exit, _mm256_set1_ps(tMax));
+        const __m256 hit = _mm256_and_ps(_mm256_cmp_ps(entry, exit, _CMP_LE_OQ),
+            _mm256_cmp_ps(entry, _mm256_set1_ps(tMax), _CMP_LT_OQ));
+        _mm256_storeu_ps(t, entry);
+        const __m256i empty = _mm256_cmpeq_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(node.child)),
+            _mm256_set1_epi32(-1));
+        return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_andnot_ps(_mm256_castsi256_ps(empty), hit)));
+    }
+#endif
+
+    void SelectSlotTests(SimdIsa isa, FrustumSlotFunction<4>& frustum, RaySlotFunction<4>& ray) {
+        frustum = FrustumSlotsScalar<4>;
+        ray = RaySlotsScalar<4>;
+#if SIMD_X86
+        if (isa != SimdIsa::Scalar) {
+            frustum = FrustumSlotsSse;
+            ray = RaySlotsSse;
+        }
+#else
+        (void)isa;
+#endif
+    }
+
+    void SelectSlotTests(SimdIsa isa, FrustumSlotFunction<8>& frustum, RaySlotFunction<8>& ray) {
+        frustum = FrustumSlotsScalar<8>;
+        ray = RaySlotsScalar<8>;
+#if SIMD_X86
+        if (isa == SimdIsa::AVX2 || isa == SimdIsa::AVX512) {
+            frustum = FrustumSlotsAvx2;
+            ray = RaySlotsAvx2;
+        }
+#else
+        (void)isa;
+#endif
+    }
+
+    inline Float3 InverseDirection(const Ray& ray) {
+        return { 1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z };
+    }
+
+    inline void TestPrimitives(const Ray& ray, const Float3& inverse, const std::vector<Aabb>& boxes,
+        const uint32_t* primitives, uint32_t count, RayHit& hit) {
+        for (uint32_t i = 0; i < count; i++) {
+            float t;
+            if (IntersectBox(ray, inverse, boxes[primitives[i]], hit.t, t)) {
+                hit.primitive = primitives[i];
+                hit.t = t;
+            }
+        }
+    }
+}
+
+Ray MakePickRay(const Float3& eye, const Float3& focus, const Float3& up, float fovAngleY, float aspectRatio,
+    float ndcX, float ndcY) {
+    const Float3 forward = Vector3Normalize({ focus.x - eye.x, focus.y - eye.y, focus.z - eye.z });
+    const Float3 right = Vector3Normalize(Vector3Cross(up, forward));
+    const Float3 cameraUp = Vector3Cross(forward, right);
+    const float y = ndcY * std::tan(0.5f * fovAngleY), x = ndcX * std::tan(0.5f * fovAngleY) * aspectRatio;
+    const Float3 direction = Vector3Normalize({ forward.x + right.x * x + cameraUp.x * y,
+        forward.y + right.y * x + cameraUp.y * y, forward.z + right.z * x + cameraUp.z * y });
+    return { eye, direction, std::numeric_limits<float>::infinity() };
+}
+
+FrustumTest TestBox(const Frustum& frustum, const Aabb& box) {
+    bool inside = true;
+    for (const Float4& plane : frustum.planes) {
+        // The corners furthest along and against the plane normal
+        const float farthest = (plane.x * (plane.x >= 0.0f ? box.max.x : box.min.x)
+            + plane.y * (plane.y >= 0.0f ? box.max.y : box.min.y)) + plane.z * (plane.z >= 0.0f ? box.max.z : box.min.z);
+        if (farthest + plane.w < 0.0f) {
+            return FrustumTest::Outside;
+        }
+        const float nearest = (plane.x * (plane.x >= 0.0f ? box.min.x : box.max.x)
+            + plane.y * (plane.y >= 0.0f ? box.min.y : box.max.y)) + plane.z * (plane.z >= 0.0f ? box.min.z : box.max.z);
+        inside &= !(nearest + plane.w < 0.0f);
+    }
+    return inside ? FrustumTest::Inside : FrustumTest::Intersecting;
+}
+
+bool IntersectBox(const Ray& ray, const Float3& inverseDirection, const Aabb& box, float tMax, float& t) {
+    const float tx1 = (box.min.x - ray.origin.x) * inverseDirection.x, tx2 = (box.max.x - ray.origin.x) * inverseDirection.x;
+    const float ty1 = (box.min.y - ray.origin.y) * inverseDirection.y, ty2 = (box.max.y - ray.origin.y) * inverseDirection.y;
+    const float tz1 = (box.min.z - ray.origin.z) * inverseDirection.z, tz2 = (box.max.z - ray.origin.z) * inverseDirection.z;
+    const float entry = MaxF(MaxF(MaxF(MinF(tx1, tx2), MinF(ty1, ty2)), MinF(tz1, tz2)), 0.0f);
+    const float exit = MinF(MinF(MinF(MaxF(tx1, tx2), MaxF(ty1, ty2)), MaxF(tz1, tz2)), tMax);
+    if (entry <= exit && entry < tMax) {
+        t = entry;
+        return true;
+    }
+    return false;
+}
+
+void Bvh::Build(const std::vector<Aabb>& boxes, TaskScheduler* scheduler) {
+    const uint32_t count = static_cast<uint32_t>(boxes.size());
+    nodes.clear();
+    primitives.resize(count);
+    if (count == 0) {
+        return;
+    }
+
+    std::vector<BuildPrimitive> records(count);
+    std::vector<Aabb> chunkBounds((count + ChunkSize - 1) / ChunkSize), chunkCentroids(chunkBounds.size());
+    ForChunks(scheduler, count, [&](uint32_t begin, uint32_t end, uint32_t chunk) {
+        Aabb bounds = EmptyBox(), centroidBounds = EmptyBox();
+        for (uint32_t i = begin; i < end; i++) {
+            const Aabb& box = boxes[i];
+            records[i] = { box, { (box.min.x + box.max.x) * 0.5f, (box.min.y + box.max.y) * 0.5f,
+                (box.min.z + box.max.z) * 0.5f }, i };
+            Grow(bounds, box);
+            Grow(centroidBounds, records[i].centroid);
+        }
+        chunkBounds[chunk] = bounds;
+        chunkCentroids[chunk] = centroidBounds;
+    });
+    BuildTask root = { 0, 0, count, EmptyBox(), EmptyBox() };
+    for (size_t chunk = 0; chunk < chunkBounds.size(); chunk++) {
+        Grow(root.bounds, chunkBounds[chunk]);
+        Grow(root.centroids, chunkCentroids[chunk]);
+    }
+
+    const Builder builder(records);
+    nodes.reserve(count);
+    nodes.resize(1);
+    // The build order is the leaves' primitive order
+    auto takePrimitives = [&]() {
+        ForChunks(scheduler, count, [&](uint32_t begin, uint32_t end, uint32_t) {
+            for (uint32_t i = begin; i < end; i++) {
+                primitives[i] = records[i].primitive;
+            }
+        });
+    };
+    if (!scheduler) {
+        builder.BuildRecursive(root, nodes);
+        takePrimitives();
+        return;
+    }
+
+    // Split breadth-first until every open node is small enough to be one thread's subtree
+    const uint32_t subtreeSize = std::max(count / (scheduler->ThreadCount() * 8), 4096u);
+    std::deque<BuildTask> open = { root };
+    std::vector<BuildTask> subtrees;
+    while (!open.empty()) {
+        const BuildTask task = open.front();
+        open.pop_front();
+        if (task.last - task.first <= subtreeSize) {
+            subtrees.push_back(task);
+            continue;
+        }
+        BuildTask left, right;
+        const uint32_t firstChild = static_cast<uint32_t>(nodes.size());
+        if (builder.Split(task, firstChild, nodes[task.node], left, right, scheduler)) {
+            nodes.resize(nodes.size() + 2);
+            left.node = firstChild;
+            right.node = firstChild + 1;
+            open.push_back(left);
+            open.push_back(right);
+        }
+    }
+
+    // Each subtree into nodes of its own, rooted at index 0, then appended with its child
+    // indices moved past the nodes already placed
+    std::vector<std::vector<BvhNode>> subtreeNodes(subtrees.size());
+    scheduler->ParallelFor(static_cast<uint32_t>(subtrees.size()), [&](uint32_t begin, uint32_t end) {
+        for (uint32_t k = begin; k < end; k++) {
+            BuildTask task = subtrees[k];
+            task.node = 0;
+            subtreeNodes[k].reserve(task.last - task.first);
+            subtreeNodes[k].resize(1);
+            builder.BuildRecursive(task, subtreeNodes[k]);
+        }
+    });
+    for (size_t k = 0; k < subtrees.size(); k++) {
+        std::vector<BvhNode>& local = subtreeNodes[k];
+        const uint32_t base = static_cast<uint32_t>(nodes.size()) - 1;
+        for (BvhNode& node : local) {
+            if (node.count == 0) {
+                node.first += base;
+            }
+        }
+        nodes[subtrees[k].node] = local[0];
+        nodes.insert(nodes.end(), local.begin() + 1, local.end());
+        std::vector<BvhNode>().swap(local);
+    }
+    takePrimitives();
+}
+
+void Bvh::Refit(const std::vector<Aabb>& boxes, TaskScheduler* scheduler) {
+    const uint32_t count = static_cast<uint32_t>(nodes.size());
+    ForChunks(scheduler, count, [&](uint32_t begin, uint32_t end, uint32_t) {
+        for (uint32_t i = begin; i < end; i++) {
+            BvhNode& node = nodes[i];
+            if (node.count > 0) {
+                Aabb box = EmptyBox();
+                for (uint32_t k = 0; k < node.count; k++) {
+                    Grow(box, boxes[primitives[node.first + k]]);
+                }
+                SetBox(node, box);
+            }
+        }
+    });
+    // Children follow their parents, so walking backwards sees every child first
+    for (uint32_t i = count; i-- > 0;) {
+        BvhNode& node = nodes[i];
+        if (node.count == 0) {
+            Aabb box = NodeBox(nodes[node.first]);
+            Grow(box, NodeBox(nodes[node.first + 1]));
+            SetBox(node, box);
+        }
+    }
+}
+
+uint32_t Bvh::CullFrustum(const Frustum& frustum, const std::vector<Aabb>& boxes, uint32_t* out) const {
+    uint32_t visible = 0;
+    if (nodes.empty()) {
+        return 0;
+    }
+    std::vector<uint32_t> stack;
+    stack.reserve(64);
+    stack.push_back(0);
+    while (!stack.empty()) {
+        const uint32_t index = stack.back();
+        stack.pop_back();
+        const BvhNode& node = nodes[index];
+        const FrustumTest test = TestBox(frustum, NodeBox(node));
+        if (test == FrustumTest::Outside) {
+            continue;
+        }
+        if (test == FrustumTest::Inside) {
+            AppendSubtree(nodes, primitives, index, out, visible);
+        }
+        else if (node.count > 0) {
+            for (uint32_t k = 0; k < node.count; k++) {
+                const uint32_t primitive = primitives[node.first + k];
+                if (TestBox(frustum, boxes[primitive]) != FrustumTest::Outside) {
+                    out[visible++] = primitive;
+                }
+            }
+        }
+        else {
+            stack.push_back(node.first + 1);
+            stack.push_back(node.first);
+        }
+    }
+    return visible;
+}
+
+bool Bvh::IntersectRay(const Ray& ray, const std::vector<Aabb>& boxes, RayHit& hit) const {
+    hit = RayHit();
+    hit.t = ray.tMax;
+    float t;
+    const Float3 inverse = InverseDirection(ray);
+    if (nodes.empty() || !IntersectBox(ray, inverse, NodeBox(nodes[0]), hit.t, t)) {
+        return false;
+    }
+    struct Entry {
+        uint32_t node;
+        float t;
+    };
+    std::vector<Entry> stack;
+    stack.reserve(64);
+    stack.push_back({ 0, t });
+    while (!stack.empty()) {
+        const Entry entry = stack.back();
+        stack.pop_back();
+        if (entry.t >= hit.t) {
+            continue;
+        }
+        const BvhNode& node = nodes[entry.node];
+        if (node.count > 0) {
+            TestPrimitives(ray, inverse, boxes, &primitives[node.first], node.count, hit);
+            continue;
+        }
+        float t0, t1;
+        const bool hit0 = IntersectBox(ray, inverse, NodeBox(nodes[node.first]), hit.t, t0);
+        const bool hit1 = IntersectBox(ray, inverse, NodeBox(nodes[node.first + 1]), hit.t, t1);
+        // The nearer child on top
+        if (hit0 && hit1) {
+            const bool firstNearer = t0 <= t1;
+            stack.push_back(firstNearer ? Entry{ node.first + 1, t1 } : Entry{ node.first, t0 });
+            stack.push_back(firstNearer ? Entry{ node.first, t0 } : Entry{ node.first + 1, t1 });
+        }
+        else if (hit0) {
+            stack.push_back({ node.first, t0 });
+        }
+        else if (hit1) {
+            stack.push_back({ node.first + 1, t1 });
+        }
+    }
+    return hit.primitive != RayHit().primitive;
+}
+
+float Bvh::SahCost() const {
+    if (nodes.empty()) {
+        return 0.0f;
+    }
+    const float rootArea = HalfArea(NodeBox(nodes[0]));
+    double cost = 0.0;
+    for (const BvhNode& node : nodes) {
+        cost += HalfArea(NodeBox(node)) * (node.count > 0 ? static_cast<double>(node.count) : 1.0);
+    }
+    return rootArea > 0.0f ? static_cast<float>(cost / rootArea) : 0.0f;
+}
+
+template <int Width>
+void WideBvh<Width>::Collapse(const Bvh& bvh) {
+    nodes.clear();
+    primitives = bvh.Primitives().data();
+    if (!bvh.Nodes().empty()) {
+        CollapseNode(bvh, 0);
+    }
+}
+
+template <int Width>
+uint32_t WideBvh<Width>::CollapseNode(const Bvh& bvh, uint32_t index) {
+    const std::vector<BvhNode>& binary = bvh.Nodes();
+    uint32_t slots[Width];
+    int used = 0;
+    if (binary[index].count > 0) {
+        slots[used++] = index;
+    }
+    else {
+        slots[used++] = binary[index].first;
+        slots[used++] = binary[index].first + 1;
+        // Open the interior child with the largest surface area until the slots run out
+        while (used < Width) {
+            int widest = -1;
+            float widestArea = -1.0f;
+            for (int k = 0; k < used; k++) {
+                const float area = HalfArea(NodeBox(binary[slots[k]]));
+                if (binary[slots[k]].count == 0 && area > widestArea) {
+                    widest = k;
+                    widestArea = area;
+                }
+            }
+            if (widest < 0) {
+                break;
+            }
+            // Its children take its place, in order, so slots stay left to right
+            const uint32_t opened = slots[widest];
+            for (int k = used; k > widest + 1; k--) {
+                slots[k] = slots[k - 1];
+            }
+            slots[widest] = binary[opened].first;
+            slots[widest + 1] = binary[opened].first + 1;
+            used++;
+        }
+    }
+
+    const uint32_t wide = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back();
+    for (int k = 0; k < Width; k++) {
+        WideBvhNode<Width>& node = nodes[wide];
+        if (k >= used) {
+            node.minX[k] = node.minY[k] = node.minZ[k] = 0.0f;
+            node.maxX[k] = node.maxY[k] = node.maxZ[k] = 0.0f;
+            node.child[k] = EmptyChild;
+            node.count[k] = 0;
+            continue;
+        }
+        const BvhNode& child = binary[slots[k]];
+        node.minX[k] = child.min.x;
+        node.minY[k] = child.min.y;
+        node.minZ[k] = child.min.z;
+        node.maxX[k] = child.max.x;
+        node.maxY[k] = child.max.y;
+        node.maxZ[k] = child.max.z;
+        node.count[k] = child.count;
+        node.child[k] = child.first;
+        if (child.count == 0) {
+            // Recursing may move nodes
+            const uint32_t collapsed = CollapseNode(bvh, slots[k]);
+            nodes[wide].child[k] = collapsed;
+        }
+    }
+    return wide;
+}
+
+template <int Width>
+uint32_t WideBvh<Width>::CullFrustum(const Frustum& frustum, const std::vector<Aabb>& boxes, uint32_t* out) const {
+    FrustumSlotFunction<Width> frustumSlots;
+    RaySlotFunction<Width> raySlots;
+    SelectSlotTests(isa, frustumSlots, raySlots);
+
+    uint32_t visible = 0;
+    if (nodes.empty()) {
+        return 0;
+    }
+    std::vector<uint32_t> stack;
+    stack.reserve(64);
+    stack.push_back(0);
+    while (!stack.empty()) {
+        const WideBvhNode<Width>& node = nodes[stack.back()];
+        stack.pop_back();
+        uint32_t inside = 0;
+        const uint32_t keep = frustumSlots(node, frustum, inside);
+        for (int k = 0; k < Width; k++) {
+            if (!(keep & (1u << k))) {
+                continue;
+            }
+            const bool slotInside = (inside & (1u << k)) != 0;
+            if (node.count[k] == 0) {
+                if (slotInside) {
+                    AppendWideSubtree(nodes, primitives, node.child[k], out, visible);
+                }
+                else {
+                    stack.push_back(node.child[k]);
+                }
+                continue;
+            }
+            const uint32_t* leaf = primitives + node.child[k];
+            for (uint32_t i = 0; i < node.count[k]; i++) {
+                if (slotInside || TestBox(frustum, boxes[leaf[i]]) != FrustumTest::Outside) {
+                    out[visible++] = leaf[i];
+                }
+            }
+        }
+    }
+    return visible;
+}
+
+template <int Width>
+bool WideBvh<Width>::IntersectRay(const Ray& ray, const std::vector<Aabb>& boxes, RayHit& hit) const {
+    FrustumSlotFunction<Width> frustumSlots;
+    RaySlotFunction<Width> raySlots;
+    SelectSlotTests(isa, frustumSlots, raySlots);
+
+    hit = RayHit();
+    hit.t = ray.tMax;
+    if (nodes.empty()) {
+        return false;
+    }
+    const Float3 inverse = InverseDirection(ray);
+    struct Entry {
+        uint32_t node;
+        float t;
+    };
+    std::vector<Entry> stack;
+    stack.reserve(64);
+    stack.push_back({ 0, 0.0f });
+    while (!stack.empty()) {
+        const Entry entry = stack.back();
+        stack.pop_back();
+        if (entry.t >= hit.t) {
+            continue;
+        }
+        const WideBvhNode<Width>& node = nodes[entry.node];
+        float t[Width];
+        const uint32_t hits = raySlots(node, ray, inverse, hit.t, t);
+
+        // Slots nearest first: leaves are tested right away, nodes pushed so the nearest is on top
+        int order[Width];
+        int count = 0;
+        for (int k = 0; k < Width; k++) {
+            if (hits & (1u << k)) {
+                int position = count++;
+                while (position > 0 && t[order[position - 1]] > t[k]) {
+                    order[position] = order[position - 1];
+                    position--;
+                }
+                order[position] = k;
+            }
+        }
+        const size_t base = stack.size();
+        for (int i = 0; i < count; i++) {
+            const int k = order[i];
+            if (t[k] >= hit.t) {
+                break;
+            }
+            if (node.count[k] > 0) {
+                TestPrimitives(ray, inverse, boxes, primitives + node.child[k], node.count[k], hit);
+            }
+            else {
+                stack.insert(stack.begin() + base, { node.child[k], t[k] });
+            }
+        }
+    }
+    return hit.primitive != RayHit().primitive;
+}
+
+template class WideBvh<4>;
+template class WideBvh<8>;
@@ -0,0 +1,135 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "FrustumCuller.h"
+#include "SceneMath.h"
+#include "SimdIsa.h"
+
+class TaskScheduler;
+
+struct Aabb {
+    Float3 min;
+    Float3 max;
+};
+
+// A ray for picking; hits count for 0 <= t < tMax, t in units of the direction's length
+struct Ray {
+    Float3 origin;
+    Float3 direction;
+    float tMax;
+};
+
+struct RayHit {
+    uint32_t primitive = 0xffffffffu;
+    float t = 0.0f;
+};
+
+// The world-space ray through a point of the viewport, ndcX and ndcY in [-1, 1] with y up,
+// for a camera as MatrixLookAtLH and MatrixPerspectiveFovLH build it
+Ray MakePickRay(const Float3& eye, const Float3& focus, const Float3& up, float fovAngleY, float aspectRatio,
+    float ndcX, float ndcY);
+
+// The box tests every traversal and the brute-force checks share, so their answers agree bit
+// for bit. A box is outside when it lies entirely on the outside of one plane and inside
+// when it lies on the inside of all of them.
+enum class FrustumTest {
+    Outside,
+    Intersecting,
+    Inside,
+};
+
+FrustumTest TestBox(const Frustum& frustum, const Aabb& box);
+
+// Slab test; on a hit within [0, tMax) sets t to the entry distance, 0 from inside the box
+bool IntersectBox(const Ray& ray, const Float3& inverseDirection, const Aabb& box, float tMax, float& t);
+
+// 32 bytes, two to a cache line. An interior node's children are nodes first and first + 1;
+// a leaf holds primitives Primitives()[first, first + count).
+struct BvhNode {
+    Float3 min;
+    uint32_t first;
+    Float3 max;
+    uint32_t count;     // 0 for interior nodes
+};
+
+// Binary BVH over boxes, built top-down with binned SAH: 16 bins per axis on the
+// primitives' centroids, a leaf once splitting costs more than testing every primitive
+// and at most MaxLeafSize primitives a leaf. With a scheduler, the upper levels are split
+// one at a time with binning spread over the threads until there is a subtree per
+// thread several times over; the subtrees are then built in parallel and stitched in.
+// Children always follow their parent in Nodes(), and a subtree's leaves hold one
+// contiguous range of Primitives(), left to right.
+class Bvh {
+public:
+    static const uint32_t BinCount = 16;
+    static const uint32_t MaxLeafSize = 8;
+
+    // scheduler may be null to build on the calling thread
+    void Build(const std::vector<Aabb>& boxes, TaskScheduler* scheduler);
+
+    // New bounds for the same primitives after they moved, keeping the tree's topology.
+    // Cheaper than a rebuild but the tree degrades as primitives drift from their neighbours.
+    void Refit(const std::vector<Aabb>& boxes, TaskScheduler* scheduler);
+
+    // Primitives whose boxes are not outside the frustum, in no particular order; out has
+    // room for every primitive. Subtrees entirely inside are copied out as one range.
+    uint32_t CullFrustum(const Frustum& frustum, const std::vector<Aabb>& boxes, uint32_t* out) const;
+
+    // Nearest primitive box the ray hits; false if none
+    bool IntersectRay(const Ray& ray, const std::vector<Aabb>& boxes, RayHit& hit) const;
+
+    // Expected cost of a random ray relative to testing one box, from node surface areas
+    float SahCost() const;
+
+    const std::vector<BvhNode>& Nodes() const { return nodes; }
+    const std::vector<uint32_t>& Primitives() const { return primitives; }
+    size_t MemoryBytes() const { return nodes.size() * sizeof(BvhNode) + primitives.size() * sizeof(uint32_t); }
+
+private:
+    std::vector<BvhNode> nodes;
+    std::vector<uint32_t> primitives;
+};
+
+// A Width-wide node: the children's boxes in structure-of-arrays form so one query tests
+// them all at once, 128 bytes for BVH4 and 256 for BVH8. Slots hold a node index (count 0),
+// a leaf's primitive range, or nothing (EmptyChild); used slots come first, left to right
+// as in the binary tree.
+template <int Width>
+struct WideBvhNode {
+    float minX[Width], minY[Width], minZ[Width];
+    float maxX[Width], maxY[Width], maxZ[Width];
+    uint32_t child[Width];
+    uint32_t count[Width];
+};
+
+// A binary BVH collapsed into a BVH4 or BVH8: every node pulls up the grandchildren of its
+// largest interior children until it has Width slots. Queries give the same answers as
+// the binary BVH. The BVH4 tests its slots with SSE on x86; the BVH8 with AVX2 when the
+// selected ISA has it, else with scalar code.
+template <int Width>
+class WideBvh {
+public:
+    static const uint32_t EmptyChild = 0xffffffffu;
+
+    explicit WideBvh(SimdIsa isa = DetectSimdIsa()) : isa(isa) {}
+
+    // Primitive ranges keep pointing into bvh.Primitives(), which must outlive this tree
+    void Collapse(const Bvh& bvh);
+
+    uint32_t CullFrustum(const Frustum& frustum, const std::vector<Aabb>& boxes, uint32_t* out) const;
+    bool IntersectRay(const Ray& ray, const std::vector<Aabb>& boxes, RayHit& hit) const;
+
+    SimdIsa Isa() const { return isa; }
+    const std::vector<WideBvhNode<Width>>& Nodes() const { return nodes; }
+    size_t MemoryBytes() const { return nodes.size() * sizeof(WideBvhNode<Width>); }
+
+private:
+    uint32_t CollapseNode(const Bvh& bvh, uint32_t index);
+
+    SimdIsa isa;
+    std::vector<WideBvhNode<Width>> nodes;
+    const uint32_t* primitives = nullptr;
+};
+
+using Bvh4 = WideBvh<4>;
+using Bvh8 = WideBvh<8>;
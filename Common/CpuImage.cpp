@@ -0,0 +1,42 @@
+#include "CpuImage.h"
+#include <algorithm>
+#include <cstring>
+
+uint8_t FloatToUnorm8(float value) {
+    // NaN fails the comparison and maps to 0 along with negatives
+    value = (value > 0.0f) ? std::min(value, 1.0f) : 0.0f;
+    return static_cast<uint8_t>(value * 255.0f + 0.5f);
+}
+
+uint32_t PackUnorm8(const float rgba[4]) {
+    uint32_t packed = 0;
+    for (int c = 0; c < 4; c++) {
+        packed |= static_cast<uint32_t>(FloatToUnorm8(rgba[c])) << (c * 8);
+    }
+    return packed;
+}
+
+void ClearImage(CpuImage& image, const float rgba[4]) {
+    const uint32_t packed = PackUnorm8(rgba);
+    uint8_t* pixel = image.pixels.data();
+    for (size_t i = 0; i < image.pixels.size(); i += 4) {
+        std::memcpy(pixel + i, &packed, sizeof(packed));
+    }
+}
+
+CpuImage DownsampleImage(const CpuImage& source) {
+    CpuImage result(std::max(1u, source.width / 2), std::max(1u, source.height / 2));
+    for (uint32_t y = 0; y < result.height; y++) {
+        const uint8_t* row0 = source.Row(std::min(y * 2, source.height - 1));
+        const uint8_t* row1 = source.Row(std::min(y * 2 + 1, source.height - 1));
+        uint8_t* out = result.Row(y);
+        for (uint32_t x = 0; x < result.width; x++) {
+            uint32_t x0 = std::min(x * 2, source.width - 1) * 4;
+            uint32_t x1 = std::min(x * 2 + 1, source.width - 1) * 4;
+            for (uint32_t c = 0; c < 4; c++) {
+                out[x * 4 + c] = static_cast<uint8_t>((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+            }
+        }
+    }
+    return result;
+}
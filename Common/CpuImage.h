@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Plain R8G8B8A8_UNORM image with tightly packed rows, used by the CPU backends
+// wherever a sample would otherwise write to a render target or UAV texture.
+struct CpuImage {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint8_t> pixels;
+
+    CpuImage() = default;
+    CpuImage(uint32_t w, uint32_t h) { Resize(w, h); }
+
+    void Resize(uint32_t w, uint32_t h) {
+        width = w;
+        height = h;
+        pixels.assign(static_cast<size_t>(w) * h * 4, 0);
+    }
+
+    uint32_t RowPitch() const { return width * 4; }
+    uint8_t* Row(uint32_t y) { return pixels.data() + static_cast<size_t>(y) * RowPitch(); }
+    const uint8_t* Row(uint32_t y) const { return pixels.data() + static_cast<size_t>(y) * RowPitch(); }
+};
+
+// FLOAT -> 8-bit UNORM following the D3D conversion rules: NaN becomes 0, the value is
+// saturated, scaled by 255, offset by 0.5 and truncated.
+uint8_t FloatToUnorm8(float value);
+
+// float4 -> R8G8B8A8_UNORM as a render target or typed UAV store would write it.
+uint32_t PackUnorm8(const float rgba[4]);
+
+// Fills every pixel with one color, like ClearRenderTargetView.
+void ClearImage(CpuImage& image, const float rgba[4]);
+
+// The next mip level: a 2x2 box filter with rounding, odd sizes repeating the last row or column
+CpuImage DownsampleImage(const CpuImage& source);
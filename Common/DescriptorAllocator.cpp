@@ -0,0 +1,89 @@
+#include "DescriptorAllocator.h"
+#include <stdexcept>
+
+DescriptorFreeList::DescriptorFreeList(uint32_t firstIndex, uint32_t count)
+    : first(firstIndex), next(count) {
+    if (count >= AllocatedMark || static_cast<uint64_t>(firstIndex) + count > AllocatedMark) {
+        throw std::runtime_error("Descriptor free list region is too large");
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        next[i] = i + 1 < count ? i + 1 : EndOfList;
+    }
+    head = count > 0 ? 0 : EndOfList;
+}
+
+uint32_t DescriptorFreeList::Allocate() {
+    if (head == EndOfList) {
+        throw std::runtime_error("Descriptor free list exhausted");
+    }
+    const uint32_t slot = head;
+    head = next[slot];
+    next[slot] = AllocatedMark;
+    allocated++;
+    return first + slot;
+}
+
+void DescriptorFreeList::Free(uint32_t index) {
+    const uint32_t slot = index - first;
+    if (slot >= next.size() || next[slot] != AllocatedMark) {
+        throw std::runtime_error("Freeing a descriptor index that is not allocated");
+    }
+    next[slot] = head;
+    head = slot;
+    allocated--;
+}
+
+DescriptorRing::DescriptorRing(TimelineFence& frameFence, uint32_t firstIndex, uint32_t count)
+    : fence(frameFence), first(firstIndex), capacity(count) {
+    if (count == 0) {
+        throw std::runtime_error("A descriptor ring needs at least one descriptor");
+    }
+}
+
+uint32_t DescriptorRing::Allocate(uint32_t count) {
+    if (count == 0 || count > capacity) {
+        throw std::runtime_error("Descriptor ring allocation must be between 1 and the ring size");
+    }
+
+    // Ranges are contiguous in the heap; skip the end of the region if this one would wrap
+    const uint64_t offset = head % capacity;
+    const uint64_t skip = offset + count > capacity ? capacity - offset : 0;
+    const uint64_t needed = skip + count;
+
+    if (head + needed - tail > capacity) {
+        RetireCompleted();
+        while (head + needed - tail > capacity) {
+            // Ranges of the frame still being recorded are not in `pending`
+            if (pending.empty()) {
+                throw std::runtime_error("Descriptor ring too small for one frame's tables");
+            }
+            stats.waits++;
+            fence.WaitForValue(pending.front().fenceValue);
+            RetireCompleted();
+        }
+    }
+
+    head += skip;
+    const uint32_t index = first + static_cast<uint32_t>(head % capacity);
+    head += count;
+    stats.allocations++;
+    stats.descriptors += count;
+    stats.skipped += skip;
+    return index;
+}
+
+void DescriptorRing::EndFrame(uint64_t fenceValue) {
+    // A frame without tables has nothing to retire
+    const uint64_t frameStart = pending.empty() ? tail : pending.back().end;
+    if (head != frameStart) {
+        pending.push_back({ fenceValue, head });
+    }
+}
+
+void DescriptorRing::RetireCompleted() {
+    const uint64_t completed = fence.CompletedValue();
+    while (!pending.empty() && pending.front().fenceValue <= completed) {
+        tail = pending.front().end;
+        pending.pop_front();
+    }
+}
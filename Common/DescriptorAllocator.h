@@ -0,0 +1,136 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include "TimelineFence.h"
+
+// Descriptor heap bookkeeping in descriptor indices, so it runs without a device. A
+// shader-visible CBV_SRV_UAV heap (up to D3D12's 1,000,000 descriptors) is split into a
+// persistent region of stable indices and a ring region for per-frame tables:
+//
+//   [0, persistent)                        DescriptorFreeList: long-lived SRVs, UAVs, ...
+//   [persistent, persistent + transient)   DescriptorRing: tables rebuilt every frame
+//
+// Index i of a heap is the handle at GetCPU/GPUDescriptorHandleForHeapStart() + i * increment.
+// None of the classes are thread-safe.
+
+// Stable indices in [first, first + count), handed out and returned in O(1). Freed indices
+// are reused first, so the live set stays dense near the start of the region.
+class DescriptorFreeList {
+public:
+    DescriptorFreeList(uint32_t first, uint32_t count);
+
+    // Throws std::runtime_error when the region is full
+    uint32_t Allocate();
+
+    // Throws std::runtime_error for an index outside the region or one that is not allocated
+    void Free(uint32_t index);
+
+    bool IsAllocated(uint32_t index) const {
+        return index - first < next.size() && next[index - first] == AllocatedMark;
+    }
+
+    uint32_t First() const { return first; }
+    uint32_t Capacity() const { return static_cast<uint32_t>(next.size()); }
+    uint32_t AllocatedCount() const { return allocated; }
+
+private:
+    static const uint32_t EndOfList = 0xffffffffu;
+    static const uint32_t AllocatedMark = 0xfffffffeu;
+
+    uint32_t first;
+    uint32_t head = EndOfList;
+    uint32_t allocated = 0;
+    std::vector<uint32_t> next;     // Next free slot, or AllocatedMark while in use
+};
+
+// Contiguous descriptor ranges in [first, first + count) for tables that live for one frame.
+// A range never wraps: one that does not fit before the end of the region starts over at
+// `first`. EndFrame tags everything allocated since the previous EndFrame with the fence
+// value signaled after the frame, and Allocate reclaims frames as the fence passes them,
+// waiting for the oldest only when the ring is full.
+class DescriptorRing {
+public:
+    struct Stats {
+        uint64_t allocations = 0;
+        uint64_t descriptors = 0;
+        uint64_t waits = 0;         // Allocate calls that had to wait for the GPU
+        uint64_t skipped = 0;       // Descriptors left unused at the end of the region by wrapping
+    };
+
+    DescriptorRing(TimelineFence& fence, uint32_t first, uint32_t count);
+
+    // Index of the first of `count` contiguous descriptors. Throws std::runtime_error if the
+    // request cannot fit even with every previous frame retired.
+    uint32_t Allocate(uint32_t count);
+
+    // `fenceValue` is signaled after every command list using this frame's tables
+    void EndFrame(uint64_t fenceValue);
+
+    uint32_t First() const { return first; }
+    uint32_t Capacity() const { return capacity; }
+    uint64_t InUse() const { return head - tail; }   // Including frames the GPU may have finished
+    const Stats& GetStats() const { return stats; }
+
+private:
+    struct PendingFrame {
+        uint64_t fenceValue;
+        uint64_t end;               // Ring position after the frame's last range
+    };
+
+    void RetireCompleted();
+
+    TimelineFence& fence;
+    uint32_t first;
+    uint32_t capacity;
+    uint64_t head = 0;              // Positions grow forever; the index is position % capacity
+    uint64_t tail = 0;              // Start of the oldest range the GPU may still read
+    std::deque<PendingFrame> pending;
+    Stats stats;
+};
+
+// One descriptor copy: `count` descriptors from index `source` of the staging heap to index
+// `destination` of the shader-visible heap
+struct DescriptorCopy {
+    uint32_t source;
+    uint32_t destination;
+    uint32_t count;
+};
+
+// Descriptors are written into a non-shader-visible staging heap, where creating views is
+// cheap and shader-visible heaps (write-combined memory on many GPUs) are never read back,
+// then copied over with one ID3D12Device::CopyDescriptors per flush. Add merges a copy
+// into the previous one when both its source and destination continue it, so a table
+// staged in order costs a single range.
+class DescriptorCopyBatch {
+public:
+    void Add(uint32_t source, uint32_t destination, uint32_t count = 1) {
+        if (count == 0) {
+            return;
+        }
+        if (!copies.empty()) {
+            DescriptorCopy& last = copies.back();
+            if (last.source + last.count == source && last.destination + last.count == destination) {
+                last.count += count;
+                descriptors += count;
+                return;
+            }
+        }
+        copies.push_back({ source, destination, count });
+        descriptors += count;
+    }
+
+    // Ranges for CopyDescriptors: the destination and source range lists are the same ranges
+    const std::vector<DescriptorCopy>& Copies() const { return copies; }
+    uint64_t DescriptorCount() const { return descriptors; }
+    bool Empty() const { return copies.empty(); }
+
+    void Clear() {
+        copies.clear();
+        descriptors = 0;
+    }
+
+private:
+    std::vector<DescriptorCopy> copies;
+    uint64_t descriptors = 0;
+};
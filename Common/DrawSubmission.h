@@ -0,0 +1,128 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include "DescriptorAllocator.h"
+#include "SceneMath.h"
+#include "UploadRing.h"
+
+// One textured cube to draw: its MVP and where its material and texture live
+struct DrawItem {
+    Float4x4 transform;
+    uint32_t materialIndex;     // Into the materials buffer
+    uint32_t textureIndex;      // Stable SRV index in the persistent region of the heap
+};
+
+// Root signature of the bindless pipeline (shader_bindless.hlsl)
+enum BindlessRootParameter : uint32_t {
+    BindlessDrawConstants,      // b0, space1: DrawConstants
+    BindlessTransforms,         // t0, space1: StructuredBuffer<float4x4>, root SRV
+    BindlessMaterials,          // t1, space1: StructuredBuffer<Material>, root SRV
+    BindlessTextures,           // t0, space2: Texture2D[], unbounded table at the start of the heap
+    BindlessRootParameterCount
+};
+
+// The root constants of a bindless draw, all three indices
+struct DrawConstants {
+    uint32_t transformIndex;
+    uint32_t materialIndex;
+    uint32_t textureIndex;
+};
+
+// How MVPmatrix feeds the MVP to VSMain: root parameter 0, 1 or 2 of its root signature
+enum class MvpBinding : uint32_t {
+    RootConstants,      // b0: 16 root constants, the matrix itself in the root arguments
+    RootCbv,            // b1: root CBV pointing at the matrix in the upload ring
+    DescriptorTable,    // b2: table holding one CBV written into the descriptor ring
+};
+
+const uint32_t MvpBindingCount = 3;
+
+inline const char* MvpBindingName(MvpBinding binding) {
+    switch (binding) {
+    case MvpBinding::RootConstants: return "constants";
+    case MvpBinding::RootCbv: return "cbv";
+    case MvpBinding::DescriptorTable: return "table";
+    }
+    return "unknown";
+}
+
+inline bool ParseMvpBinding(const char* name, MvpBinding& binding) {
+    for (uint32_t i = 0; i < MvpBindingCount; i++) {
+        if (std::string(name) == MvpBindingName(static_cast<MvpBinding>(i))) {
+            binding = static_cast<MvpBinding>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+// The ways of submitting draws, templated over the command list so the same code
+// records into ID3D12GraphicsCommandList (through a thin adapter) and into
+// RecordingCommandList for benchmarks. `Commands` provides the calls of RecordingCommandList.
+
+// One draw per MVP, each bound with `binding`. Root constants upload nothing; the root CBV
+// takes a 256-byte constant buffer per draw; the table additionally writes a CBV per draw
+// into the descriptor ring.
+template <typename Commands>
+void SubmitMvpDraws(Commands& commands, MvpBinding binding, UploadCursor& upload, DescriptorRing& ring,
+    const Float4x4* mvps, uint32_t count, uint32_t indexCount) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (binding == MvpBinding::RootConstants) {
+            commands.SetGraphicsRoot32BitConstants(0, 16, &mvps[i], 0);
+        }
+        else {
+            const UploadRing::Allocation constants = upload.AllocateConstants(mvps[i]);
+            if (binding == MvpBinding::RootCbv) {
+                commands.SetGraphicsRootConstantBufferView(1, constants.gpuAddress);
+            }
+            else {
+                const uint32_t table = ring.Allocate(1);
+                commands.CreateConstantBufferView(table, constants.gpuAddress, static_cast<uint32_t>(constants.size));
+                commands.SetGraphicsRootDescriptorTable(2, table);
+            }
+        }
+        commands.DrawIndexedInstanced(indexCount, 1, 0, 0, 0);
+    }
+}
+
+// Table per draw, the way the DescritorTable root signature binds: every draw gets its own
+// { CBV, SRV } table from the per-frame ring, with the MVP in its own 256-byte constant buffer
+// and the SRV copied from the staging heap. `stagingSrv[textureIndex]` is the texture's view
+// in the staging heap. One CopyDescriptors call covers the frame's tables.
+template <typename Commands>
+void SubmitTablePerDraw(Commands& commands, UploadCursor& upload, DescriptorRing& ring, DescriptorCopyBatch& copies,
+    const uint32_t* stagingSrv, const DrawItem* draws, uint32_t count, uint32_t indexCount) {
+    for (uint32_t i = 0; i < count; i++) {
+        const DrawItem& draw = draws[i];
+        const UploadRing::Allocation constants = upload.AllocateConstants(draw.transform);
+        const uint32_t table = ring.Allocate(2);
+        commands.CreateConstantBufferView(table, constants.gpuAddress, static_cast<uint32_t>(constants.size));
+        copies.Add(stagingSrv[draw.textureIndex], table + 1);
+        commands.SetGraphicsRootDescriptorTable(0, table);
+        commands.DrawIndexedInstanced(indexCount, 1, 0, 0, 0);
+    }
+    commands.CopyDescriptors(copies);
+    copies.Clear();
+}
+
+// Bindless: the texture table and the materials are bound once, every MVP goes into one
+// packed array bound as a root SRV, and a draw only changes three root constants.
+// `textureTable` is the heap index the unbounded SRV range starts at.
+template <typename Commands>
+void SubmitBindless(Commands& commands, UploadRing& upload, uint64_t materials, uint32_t textureTable,
+    const DrawItem* draws, uint32_t count, uint32_t indexCount) {
+    const UploadRing::Allocation transforms = upload.Allocate(static_cast<uint64_t>(count) * sizeof(Float4x4));
+    commands.SetGraphicsRootShaderResourceView(BindlessTransforms, transforms.gpuAddress);
+    commands.SetGraphicsRootShaderResourceView(BindlessMaterials, materials);
+    commands.SetGraphicsRootDescriptorTable(BindlessTextures, textureTable);
+
+    Float4x4* out = reinterpret_cast<Float4x4*>(transforms.cpuAddress);
+    for (uint32_t i = 0; i < count; i++) {
+        const DrawItem& draw = draws[i];
+        std::memcpy(&out[i], &draw.transform, sizeof(Float4x4));
+        const DrawConstants constants = { i, draw.materialIndex, draw.textureIndex };
+        commands.SetGraphicsRoot32BitConstants(BindlessDrawConstants, 3, &constants, 0);
+        commands.DrawIndexedInstanced(indexCount, 1, 0, 0, 0);
+    }
+}
@@ -0,0 +1,41 @@
+#include "FramePacer.h"
+#include <stdexcept>
+
+FramePacer::FramePacer(TimelineFence& frameFence, uint32_t framesInFlight, uint64_t lastSignaledValue)
+    : fence(frameFence), contextFence(framesInFlight, 0), lastSignaled(lastSignaledValue) {
+    if (framesInFlight == 0) {
+        throw std::runtime_error("A frame pacer needs at least one frame in flight");
+    }
+    // The first BeginFrame moves to context 0
+    frameIndex = framesInFlight - 1;
+}
+
+void FramePacer::BeginFrame() {
+    if (frameOpen) {
+        throw std::runtime_error("FramePacer::BeginFrame called twice without EndFrame");
+    }
+    frameIndex = (frameIndex + 1) % FramesInFlight();
+
+    const uint64_t pending = contextFence[frameIndex];
+    if (fence.CompletedValue() < pending) {
+        stats.waits++;
+        fence.WaitForValue(pending);
+    }
+    frameOpen = true;
+}
+
+uint64_t FramePacer::EndFrame() {
+    if (!frameOpen) {
+        throw std::runtime_error("FramePacer::EndFrame called without BeginFrame");
+    }
+    contextFence[frameIndex] = ++lastSignaled;
+    stats.frames++;
+    frameOpen = false;
+    return lastSignaled;
+}
+
+void FramePacer::WaitForIdle() {
+    if (fence.CompletedValue() < lastSignaled) {
+        fence.WaitForValue(lastSignaled);
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "TimelineFence.h"
+
+// Frame contexts for N frames in flight. The CPU records frame k into context k % N while
+// the GPU still runs the frames before it; BeginFrame only waits when the context about to
+// be reused still belongs to a frame the GPU has not finished, i.e. when the CPU is N frames
+// ahead. Everything a frame writes from the CPU (command allocators, upload space, per-frame
+// descriptors) lives in arrays indexed by FrameIndex().
+//
+//   pacer.BeginFrame();
+//   commandAllocator[pacer.FrameIndex()]->Reset(); ...record, ExecuteCommandLists, Present...
+//   commandQueue->Signal(fence, pacer.EndFrame());
+class FramePacer {
+public:
+    struct Stats {
+        uint64_t frames = 0;
+        uint64_t waits = 0;     // BeginFrame calls that found their context still in flight
+    };
+
+    // `lastSignaledValue` is the fence's initial value; EndFrame hands out the ones after it
+    FramePacer(TimelineFence& fence, uint32_t framesInFlight, uint64_t lastSignaledValue = 0);
+
+    // Moves to the next context, waiting for the GPU to retire it if needed
+    void BeginFrame();
+
+    // The fence value to signal on the queue after the frame's last command list
+    uint64_t EndFrame();
+
+    // Waits for every submitted frame, e.g. before releasing resources or resizing
+    void WaitForIdle();
+
+    uint32_t FramesInFlight() const { return static_cast<uint32_t>(contextFence.size()); }
+    uint32_t FrameIndex() const { return frameIndex; }
+    uint64_t LastSignaledValue() const { return lastSignaled; }
+    // Fence value of the last frame recorded into a context, 0 before its first use
+    uint64_t ContextFenceValue(uint32_t index) const { return contextFence[index]; }
+    const Stats& GetStats() const { return stats; }
+
+private:
+    TimelineFence& fence;
+    std::vector<uint64_t> contextFence;
+    uint32_t frameIndex;
+    uint64_t lastSignaled;
+    bool frameOpen = false;
+    Stats stats;
+};
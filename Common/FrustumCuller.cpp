@@ -0,0 +1,250 @@
+#include "FrustumCuller.h"
+#include "TaskScheduler.h"
+#include <algorithm>
+#include <cstring>
+
+#if SIMD_X86
+#include <immintrin.h>
+#endif
+
+// Every kernel has to round the plane distances the way the scalar code does; see
+// InstanceBuilder.cpp
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+namespace {
+    inline uint32_t PopCount(uint32_t bits) {
+        bits = bits - ((bits >> 1) & 0x55555555u);
+        bits = (bits & 0x33333333u) + ((bits >> 2) & 0x33333333u);
+        bits = (bits + (bits >> 4)) & 0x0f0f0f0fu;
+        return (bits * 0x01010101u) >> 24;
+    }
+
+    inline float PlaneDistance(const Float4& plane, float x, float y, float z) {
+        return ((plane.x * x + plane.y * y) + plane.z * z) + plane.w;
+    }
+
+    uint32_t CullScalar(const Frustum& frustum, const SphereArrays& spheres, uint32_t first, uint32_t last,
+        uint32_t* out, CullStats& stats) {
+        uint32_t visible = 0;
+        uint32_t intersecting = 0;
+        uint32_t outside[6] = {};
+        for (uint32_t i = first; i < last; i++) {
+            const float x = spheres.x[i], y = spheres.y[i], z = spheres.z[i], r = spheres.radius[i];
+            bool culled = false, crossing = false;
+            for (int p = 0; p < 6; p++) {
+                const float d = PlaneDistance(frustum.planes[p], x, y, z);
+                if (d < -r) {
+                    outside[p]++;
+                    culled = true;
+                }
+                else if (d < r) {
+                    crossing = true;
+                }
+            }
+            if (!culled) {
+                out[visible++] = i;
+                intersecting += crossing;
+            }
+        }
+        stats.tested += last - first;
+        stats.visible += visible;
+        stats.intersecting += intersecting;
+        for (int p = 0; p < 6; p++) {
+            stats.outside[p] += outside[p];
+        }
+        return visible;
+    }
+
+#if SIMD_X86
+    // The lanes of every 8-bit visibility mask moved to the front, for _mm256_permutevar8x32_epi32
+    struct CompactTable {
+        alignas(32) int32_t lanes[256][8];
+
+        CompactTable() {
+            for (uint32_t mask = 0; mask < 256; mask++) {
+                int count = 0;
+                for (int lane = 0; lane < 8; lane++) {
+                    if (mask & (1u << lane)) {
+                        lanes[mask][count++] = lane;
+                    }
+                }
+                while (count < 8) {
+                    lanes[mask][count++] = 0;
+                }
+            }
+        }
+    };
+
+    const CompactTable compactTable;
+
+    SIMD_TARGET("avx2")
+    uint32_t CullAvx2(const Frustum& frustum, const SphereArrays& spheres, uint32_t first, uint32_t last,
+        uint32_t* out, CullStats& stats) {
+        __m256 plane[6][4];
+        for (int p = 0; p < 6; p++) {
+            plane[p][0] = _mm256_set1_ps(frustum.planes[p].x);
+            plane[p][1] = _mm256_set1_ps(frustum.planes[p].y);
+            plane[p][2] = _mm256_set1_ps(frustum.planes[p].z);
+            plane[p][3] = _mm256_set1_ps(frustum.planes[p].w);
+        }
+        const __m256 sign = _mm256_set1_ps(-0.0f);
+        const __m256i laneIndex = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        uint32_t visible = 0;
+        uint32_t intersecting = 0;
+        uint32_t outside[6] = {};
+        uint32_t i = first;
+        for (; i + 8 <= last; i += 8) {
+            const __m256 x = _mm256_loadu_ps(&spheres.x[i]);
+            const __m256 y = _mm256_loadu_ps(&spheres.y[i]);
+            const __m256 z = _mm256_loadu_ps(&spheres.z[i]);
+            const __m256 r = _mm256_loadu_ps(&spheres.radius[i]);
+            const __m256 negativeR = _mm256_xor_ps(r, sign);
+            uint32_t culled = 0, crossing = 0;
+            for (int p = 0; p < 6; p++) {
+                const __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(plane[p][0], x),
+                    _mm256_mul_ps(plane[p][1], y)), _mm256_mul_ps(plane[p][2], z)), plane[p][3]);
+                const uint32_t beyond = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(d, negativeR, _CMP_LT_OQ)));
+                outside[p] += PopCount(beyond);
+                culled |= beyond;
+                crossing |= static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(d, r, _CMP_LT_OQ)));
+            }
+            const uint32_t keep = ~culled & 0xff;
+            intersecting += PopCount(crossing & keep);
+
+            // All eight lanes are stored; the ones past the visible count are overwritten later
+            // or lie inside this range's part of out
+            const __m256i indices = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int32_t>(i)), laneIndex);
+            const __m256i order = _mm256_load_si256(reinterpret_cast<const __m256i*>(compactTable.lanes[keep]));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + visible), _mm256_permutevar8x32_epi32(indices, order));
+            visible += PopCount(keep);
+        }
+        stats.intersecting += intersecting;
+        for (int p = 0; p < 6; p++) {
+            stats.outside[p] += outside[p];
+        }
+        stats.tested += i - first;
+        stats.visible += visible;
+        return visible + CullScalar(frustum, spheres, i, last, out + visible, stats);
+    }
+
+    SIMD_TARGET("avx512f")
+    uint32_t CullAvx512(const Frustum& frustum, const SphereArrays& spheres, uint32_t first, uint32_t last,
+        uint32_t* out, CullStats& stats) {
+        __m512 plane[6][4];
+        for (int p = 0; p < 6; p++) {
+            plane[p][0] = _mm512_set1_ps(frustum.planes[p].x);
+            plane[p][1] = _mm512_set1_ps(frustum.planes[p].y);
+            plane[p][2] = _mm512_set1_ps(frustum.planes[p].z);
+            plane[p][3] = _mm512_set1_ps(frustum.planes[p].w);
+        }
+        const __m512i sign = _mm512_set1_epi32(static_cast<int32_t>(0x80000000u));
+        const __m512i laneIndex = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+        uint32_t visible = 0;
+        uint32_t intersecting = 0;
+        uint32_t outside[6] = {};
+        uint32_t i = first;
+        for (; i + 16 <= last; i += 16) {
+            const __m512 x = _mm512_loadu_ps(&spheres.x[i]);
+            const __m512 y = _mm512_loadu_ps(&spheres.y[i]);
+            const __m512 z = _mm512_loadu_ps(&spheres.z[i]);
+            const __m512 r = _mm512_loadu_ps(&spheres.radius[i]);
+            const __m512 negativeR = _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(r), sign));
+            __mmask16 culled = 0, crossing = 0;
+            for (int p = 0; p < 6; p++) {
+                const __m512 d = _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(plane[p][0], x),
+                    _mm512_mul_ps(plane[p][1], y)), _mm512_mul_ps(plane[p][2], z)), plane[p][3]);
+                const __mmask16 beyond = _mm512_cmp_ps_mask(d, negativeR, _CMP_LT_OQ);
+                outside[p] += PopCount(beyond);
+                culled |= beyond;
+                crossing |= _mm512_cmp_ps_mask(d, r, _CMP_LT_OQ);
+            }
+            const __mmask16 keep = static_cast<__mmask16>(~culled);
+            intersecting += PopCount(crossing & keep);
+            const __m512i indices = _mm512_add_epi32(_mm512_set1_epi32(static_cast<int32_t>(i)), laneIndex);
+            _mm512_mask_compressstoreu_epi32(out + visible, keep, indices);
+            visible += PopCount(keep);
+        }
+        stats.intersecting += intersecting;
+        for (int p = 0; p < 6; p++) {
+            stats.outside[p] += outside[p];
+        }
+        stats.tested += i - first;
+        stats.visible += visible;
+        return visible + CullScalar(frustum, spheres, i, last, out + visible, stats);
+    }
+#endif
+}
+
+Frustum ExtractFrustum(const Float4x4& viewProjection) {
+    // Clip coordinate j of a point is its dot product with column j
+    auto column = [&](int j) {
+        return Float4{ viewProjection.m[0][j], viewProjection.m[1][j], viewProjection.m[2][j], viewProjection.m[3][j] };
+    };
+    auto add = [](const Float4& a, const Float4& b) { return Float4{ a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w }; };
+    auto sub = [](const Float4& a, const Float4& b) { return Float4{ a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w }; };
+    const Float4 x = column(0), y = column(1), z = column(2), w = column(3);
+
+    Frustum frustum = { { add(w, x), sub(w, x), add(w, y), sub(w, y), z, sub(w, z) } };
+    for (Float4& plane : frustum.planes) {
+        const float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+        plane = { plane.x / length, plane.y / length, plane.z / length, plane.w / length };
+    }
+    return frustum;
+}
+
+void SphereArrays::Resize(uint32_t count) {
+    for (std::vector<float>* component : { &x, &y, &z, &radius }) {
+        component->resize(count, 0.0f);
+    }
+}
+
+CullStats& CullStats::operator+=(const CullStats& other) {
+    tested += other.tested;
+    visible += other.visible;
+    intersecting += other.intersecting;
+    for (int p = 0; p < 6; p++) {
+        outside[p] += other.outside[p];
+    }
+    return *this;
+}
+
+FrustumCuller::FrustumCuller(SimdIsa selected) : isa(selected), cull(CullScalar) {
+#if SIMD_X86
+    if (isa == SimdIsa::AVX2) {
+        cull = CullAvx2;
+    }
+    else if (isa == SimdIsa::AVX512) {
+        cull = CullAvx512;
+    }
+#endif
+}
+
+uint32_t FrustumCuller::Cull(const Frustum& frustum, const SphereArrays& spheres, TaskScheduler& scheduler,
+    uint32_t* out, CullStats* stats) const {
+    const uint32_t count = spheres.Count();
+    const uint32_t chunks = (count + ChunkSize - 1) / ChunkSize;
+    std::vector<uint32_t> chunkVisible(chunks);
+    std::vector<CullStats> chunkStats(chunks);
+    scheduler.ParallelFor(chunks, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t chunk = begin; chunk < end; chunk++) {
+            const uint32_t first = chunk * ChunkSize;
+            chunkVisible[chunk] = cull(frustum, spheres, first, std::min(first + ChunkSize, count), out + first,
+                chunkStats[chunk]);
+        }
+    });
+
+    // A chunk's list never starts before the previous chunk's ends, so in order nothing is overwritten
+    uint32_t visible = 0;
+    for (uint32_t chunk = 0; chunk < chunks; chunk++) {
+        if (visible != chunk * ChunkSize) {
+            std::memmove(out + visible, out + chunk * ChunkSize, chunkVisible[chunk] * sizeof(uint32_t));
+        }
+        visible += chunkVisible[chunk];
+        if (stats) {
+            *stats += chunkStats[chunk];
+        }
+    }
+    return visible;
+}
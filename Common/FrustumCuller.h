@@ -0,0 +1,73 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "SceneMath.h"
+#include "SimdIsa.h"
+
+class TaskScheduler;
+
+// The six planes of a view-projection's clip volume in world space, normalized so that
+// x * p.x + y * p.y + z * p.z + p.w is the signed distance of (x, y, z), positive inside.
+// Order: left, right, bottom, top, near, far.
+struct Frustum {
+    Float4 planes[6];
+};
+
+// Gribb-Hartmann extraction for the D3D clip volume -w <= x, y <= w, 0 <= z <= w, from a
+// row-vector matrix as MatrixPerspectiveFovLH builds (clip = float4(p, 1) * viewProjection)
+Frustum ExtractFrustum(const Float4x4& viewProjection);
+
+// Object bounding spheres in structure-of-arrays form, one array per component
+struct SphereArrays {
+    std::vector<float> x, y, z;
+    std::vector<float> radius;
+
+    void Resize(uint32_t count);
+    uint32_t Count() const { return static_cast<uint32_t>(x.size()); }
+};
+
+struct CullStats {
+    uint64_t tested = 0;
+    uint64_t visible = 0;
+    uint64_t intersecting = 0;  // Visible but crossing a plane, so partly outside
+    uint64_t outside[6] = {};   // Spheres entirely outside each plane; one can be outside two
+
+    CullStats& operator+=(const CullStats& other);
+};
+
+// Frustum culling of bounding spheres ahead of draw submission: a sphere is culled when it
+// lies entirely on the outside of any plane, so a few spheres near the frustum's corners
+// are kept although they miss it. The output is the compacted list of visible indices in
+// ascending order. The AVX2 and AVX-512 kernels test 8 or 16 spheres against all planes at
+// once and compact with a permute table or a compress store; they return the same list and
+// stats as the scalar kernel.
+class FrustumCuller {
+public:
+    // Spheres per ParallelFor item in Cull
+    static const uint32_t ChunkSize = 4096;
+
+    // SimdIsa::SSE42 runs the scalar kernel
+    explicit FrustumCuller(SimdIsa isa = DetectSimdIsa());
+
+    SimdIsa Isa() const { return isa; }
+
+    // Visible indices of spheres [first, last) to out, which has room for last - first.
+    // Returns their number and adds to stats.
+    uint32_t CullRange(const Frustum& frustum, const SphereArrays& spheres, uint32_t first, uint32_t last,
+        uint32_t* out, CullStats& stats) const {
+        return cull(frustum, spheres, first, last, out, stats);
+    }
+
+    // Every sphere, in chunks across the scheduler's threads. Each chunk writes its visible
+    // indices at its own offset in out, which has room for spheres.Count(), and one pass
+    // slides them together afterwards. Returns the number of visible spheres.
+    uint32_t Cull(const Frustum& frustum, const SphereArrays& spheres, TaskScheduler& scheduler, uint32_t* out,
+        CullStats* stats = nullptr) const;
+
+private:
+    using CullFunction = uint32_t (*)(const Frustum& frustum, const SphereArrays& spheres, uint32_t first, uint32_t last,
+        uint32_t* out, CullStats& stats);
+
+    SimdIsa isa;
+    CullFunction cull;
+};
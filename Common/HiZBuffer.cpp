@@ -0,0 +1,140 @@
+#include "HiZBuffer.h"
+#include <algorithm>
+#include <cmath>
+
+void HiZBuffer::Resize(uint32_t w, uint32_t h) {
+    width = w;
+    height = h;
+    blocksX = (w + BlockSize - 1) / BlockSize;
+    blocksY = (h + BlockSize - 1) / BlockSize;
+    tilesX = (w + TileSize - 1) / TileSize;
+    tilesY = (h + TileSize - 1) / TileSize;
+    blockMin.assign(static_cast<size_t>(blocksX) * blocksY, 1.0f);
+    blockMax.assign(blockMin.size(), 1.0f);
+    tileMax.assign(static_cast<size_t>(tilesX) * tilesY, 1.0f);
+}
+
+void HiZBuffer::Clear(float value) {
+    std::fill(blockMin.begin(), blockMin.end(), value);
+    std::fill(blockMax.begin(), blockMax.end(), value);
+    std::fill(tileMax.begin(), tileMax.end(), value);
+}
+
+void HiZBuffer::Build(const DepthBuffer& depth) {
+    for (uint32_t blockY = 0; blockY < blocksY; blockY++) {
+        for (uint32_t blockX = 0; blockX < blocksX; blockX++) {
+            UpdateBlock(depth, blockX, blockY);
+        }
+    }
+    for (uint32_t tileY = 0; tileY < tilesY; tileY++) {
+        for (uint32_t tileX = 0; tileX < tilesX; tileX++) {
+            UpdateTile(tileX, tileY);
+        }
+    }
+}
+
+void HiZBuffer::UpdateBlock(const DepthBuffer& depth, uint32_t blockX, uint32_t blockY) {
+    const uint32_t x0 = blockX * BlockSize, y0 = blockY * BlockSize;
+    const uint32_t x1 = std::min(x0 + BlockSize, width), y1 = std::min(y0 + BlockSize, height);
+    float low = depth.depth[static_cast<size_t>(y0) * depth.width + x0];
+    float high = low;
+    for (uint32_t y = y0; y < y1; y++) {
+        const float* row = depth.depth.data() + static_cast<size_t>(y) * depth.width;
+        for (uint32_t x = x0; x < x1; x++) {
+            low = std::min(low, row[x]);
+            high = std::max(high, row[x]);
+        }
+    }
+    blockMin[blockY * blocksX + blockX] = low;
+    blockMax[blockY * blocksX + blockX] = high;
+}
+
+void HiZBuffer::UpdateTile(uint32_t tileX, uint32_t tileY) {
+    const uint32_t bx0 = tileX * TileBlocks, by0 = tileY * TileBlocks;
+    const uint32_t bx1 = std::min(bx0 + TileBlocks, blocksX), by1 = std::min(by0 + TileBlocks, blocksY);
+    float high = blockMax[by0 * blocksX + bx0];
+    for (uint32_t by = by0; by < by1; by++) {
+        for (uint32_t bx = bx0; bx < bx1; bx++) {
+            high = std::max(high, blockMax[by * blocksX + bx]);
+        }
+    }
+    tileMax[tileY * tilesX + tileX] = high;
+}
+
+bool HiZBuffer::IsOccluded(int32_t minX, int32_t minY, int32_t maxX, int32_t maxY, float minDepth) const {
+    const uint32_t tx0 = minX / TileSize, ty0 = minY / TileSize;
+    const uint32_t tx1 = maxX / TileSize, ty1 = maxY / TileSize;
+    for (uint32_t tileY = ty0; tileY <= ty1; tileY++) {
+        for (uint32_t tileX = tx0; tileX <= tx1; tileX++) {
+            // Settled for the whole tile at once, otherwise look at the blocks it shares with the rectangle
+            if (minDepth >= tileMax[tileY * tilesX + tileX]) {
+                continue;
+            }
+            const uint32_t bx0 = std::max<uint32_t>(minX / BlockSize, tileX * TileBlocks);
+            const uint32_t by0 = std::max<uint32_t>(minY / BlockSize, tileY * TileBlocks);
+            const uint32_t bx1 = std::min<uint32_t>(maxX / BlockSize, tileX * TileBlocks + TileBlocks - 1);
+            const uint32_t by1 = std::min<uint32_t>(maxY / BlockSize, tileY * TileBlocks + TileBlocks - 1);
+            for (uint32_t by = by0; by <= by1; by++) {
+                for (uint32_t bx = bx0; bx <= bx1; bx++) {
+                    if (minDepth < blockMax[by * blocksX + bx]) {
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool HiZBuffer::IsUnoccluded(int32_t minX, int32_t minY, int32_t maxX, int32_t maxY, float maxDepth) const {
+    for (uint32_t by = minY / BlockSize; by <= static_cast<uint32_t>(maxY) / BlockSize; by++) {
+        for (uint32_t bx = minX / BlockSize; bx <= static_cast<uint32_t>(maxX) / BlockSize; bx++) {
+            if (!(maxDepth < blockMin[by * blocksX + bx])) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+ScreenBounds ProjectBox(const Float3& boxMin, const Float3& boxMax, const Float4x4& viewProjection,
+    const Viewport& viewport, uint32_t width, uint32_t height) {
+    ScreenBounds bounds;
+    float minX = INFINITY, minY = INFINITY, maxX = -INFINITY, maxY = -INFINITY, minZ = INFINITY;
+    for (int corner = 0; corner < 8; corner++) {
+        Float3 p = { (corner & 1) ? boxMax.x : boxMin.x, (corner & 2) ? boxMax.y : boxMin.y,
+            (corner & 4) ? boxMax.z : boxMin.z };
+        Float4 clip = TransformPoint(p, viewProjection);
+        // Behind or on the near plane the projection folds over; such boxes are always drawn
+        if (clip.z < 0.0f || clip.w <= 0.0f) {
+            return bounds;
+        }
+        float invW = 1.0f / clip.w;
+        float x = (clip.x * invW * 0.5f + 0.5f) * viewport.width + viewport.topLeftX;
+        float y = (0.5f - clip.y * invW * 0.5f) * viewport.height + viewport.topLeftY;
+        float z = viewport.minDepth + clip.z * invW * (viewport.maxDepth - viewport.minDepth);
+        minX = std::min(minX, x);
+        minY = std::min(minY, y);
+        maxX = std::max(maxX, x);
+        maxY = std::max(maxY, y);
+        minZ = std::min(minZ, z);
+    }
+
+    // Pixels whose centers the box could reach, with a pixel of slack for rounding
+    bounds.valid = true;
+    float left = std::max(viewport.topLeftX, 0.0f);
+    float top = std::max(viewport.topLeftY, 0.0f);
+    float right = std::min(viewport.topLeftX + viewport.width, static_cast<float>(width));
+    float bottom = std::min(viewport.topLeftY + viewport.height, static_cast<float>(height));
+    if (maxX < left || maxY < top || minX >= right || minY >= bottom) {
+        bounds.offscreen = true;
+        return bounds;
+    }
+    bounds.minX = static_cast<int32_t>(std::max(left, std::floor(minX) - 1.0f));
+    bounds.minY = static_cast<int32_t>(std::max(top, std::floor(minY) - 1.0f));
+    bounds.maxX = static_cast<int32_t>(std::min(right - 1.0f, std::ceil(maxX) + 1.0f));
+    bounds.maxY = static_cast<int32_t>(std::min(bottom - 1.0f, std::ceil(maxY) + 1.0f));
+    // A few ULPs nearer, since the rasterizer interpolates depth with its own rounding
+    bounds.minDepth = minZ - std::fabs(minZ) * 1e-6f;
+    return bounds;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "SceneMath.h"
+#include "SoftwareRasterizer.h"
+
+// Hierarchical depth for a DepthBuffer: the min and max depth of every 8x8 block, and the
+// max of every 64x64 tile (the TiledRasterizer tile) over its blocks. With the LESS depth
+// test, anything whose nearest depth is >= the max of every block it touches cannot pass
+// anywhere and can be rejected before per-pixel work.
+// The buffer must be kept in step with its DepthBuffer: clear both together, and after
+// writing depth outside a TiledRasterizer draw call Build or UpdateBlock/UpdateTile.
+class HiZBuffer {
+public:
+    static const uint32_t BlockSize = 8;
+    static const uint32_t TileSize = 64;
+    static const uint32_t TileBlocks = TileSize / BlockSize;
+
+    void Resize(uint32_t width, uint32_t height);
+
+    // Matches DepthBuffer::Clear(value)
+    void Clear(float value);
+
+    // Full rebuild from the depth buffer
+    void Build(const DepthBuffer& depth);
+
+    // Incremental updates: recompute one block from the depth buffer, then one tile from its
+    // blocks. Blocks of different tiles may be updated concurrently.
+    void UpdateBlock(const DepthBuffer& depth, uint32_t blockX, uint32_t blockY);
+    void UpdateTile(uint32_t tileX, uint32_t tileY);
+
+    // True if nothing at depth >= minDepth inside the inclusive pixel rectangle can pass the
+    // LESS test. The rectangle must lie inside the buffer.
+    bool IsOccluded(int32_t minX, int32_t minY, int32_t maxX, int32_t maxY, float minDepth) const;
+
+    // True if anything at depth <= maxDepth inside the rectangle passes the LESS test
+    // everywhere, i.e. maxDepth is nearer than every stored depth.
+    bool IsUnoccluded(int32_t minX, int32_t minY, int32_t maxX, int32_t maxY, float maxDepth) const;
+
+    float BlockMin(uint32_t blockX, uint32_t blockY) const { return blockMin[blockY * blocksX + blockX]; }
+    float BlockMax(uint32_t blockX, uint32_t blockY) const { return blockMax[blockY * blocksX + blockX]; }
+    float TileMax(uint32_t tileX, uint32_t tileY) const { return tileMax[tileY * tilesX + tileX]; }
+
+    uint32_t Width() const { return width; }
+    uint32_t Height() const { return height; }
+
+private:
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t blocksX = 0;
+    uint32_t blocksY = 0;
+    uint32_t tilesX = 0;
+    uint32_t tilesY = 0;
+    std::vector<float> blockMin;
+    std::vector<float> blockMax;
+    std::vector<float> tileMax;
+};
+
+// Screen-space bounds of a box for occlusion queries
+struct ScreenBounds {
+    bool valid = false;         // False if the box crosses the near plane and cannot be tested
+    bool offscreen = false;     // Entirely outside the viewport
+    int32_t minX = 0;
+    int32_t minY = 0;
+    int32_t maxX = 0;
+    int32_t maxY = 0;
+    float minDepth = 0.0f;
+};
+
+// Projects the eight corners of an axis-aligned box (row-vector convention, as TransformPoint)
+// and returns the pixel rectangle and nearest depth, rounded outwards
+ScreenBounds ProjectBox(const Float3& boxMin, const Float3& boxMax, const Float4x4& viewProjection,
+    const Viewport& viewport, uint32_t width, uint32_t height);
@@ -0,0 +1,60 @@
+#include "ImageCompare.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+ImageDifference CompareImages(const CpuImage& actual, const CpuImage& expected, uint32_t tolerance, CpuImage* diff) {
+    ImageDifference result;
+    if (actual.width != expected.width || actual.height != expected.height) {
+        result.sizeMatches = false;
+        result.maxChannelDifference = 255;
+        result.pixelsOverTolerance = static_cast<uint64_t>(expected.width) * expected.height;
+        return result;
+    }
+    if (diff) {
+        diff->Resize(expected.width, expected.height);
+    }
+
+    uint64_t squaredError = 0;
+    const size_t pixelCount = static_cast<size_t>(expected.width) * expected.height;
+    for (size_t i = 0; i < pixelCount; i++) {
+        const uint8_t* a = &actual.pixels[i * 4];
+        const uint8_t* e = &expected.pixels[i * 4];
+
+        uint32_t pixelMax = 0;
+        for (int c = 0; c < 4; c++) {
+            uint32_t d = static_cast<uint32_t>(std::abs(a[c] - e[c]));
+            pixelMax = std::max(pixelMax, d);
+            if (c < 3) {
+                squaredError += d * d;
+            }
+        }
+        result.maxChannelDifference = std::max(result.maxChannelDifference, pixelMax);
+        result.pixelsOverTolerance += pixelMax > tolerance;
+
+        if (diff) {
+            uint8_t* out = &diff->pixels[i * 4];
+            uint8_t gray = static_cast<uint8_t>((e[0] * 77 + e[1] * 150 + e[2] * 29) >> 10);
+            out[0] = out[1] = out[2] = gray;
+            out[3] = 255;
+            if (pixelMax > tolerance) {
+                out[0] = 255;
+                out[1] = out[2] = 0;
+            }
+            else if (pixelMax > 0) {
+                out[2] = 255;
+            }
+        }
+    }
+
+    if (squaredError == 0) {
+        result.psnr = std::numeric_limits<double>::infinity();
+    }
+    else {
+        double mse = static_cast<double>(squaredError) / (static_cast<double>(pixelCount) * 3.0);
+        result.rmse = std::sqrt(mse);
+        result.psnr = 10.0 * std::log10(255.0 * 255.0 / mse);
+    }
+    return result;
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <cstdint>
+#include "CpuImage.h"
+
+struct ImageDifference {
+    bool sizeMatches = true;
+    uint32_t maxChannelDifference = 0;      // Largest |actual - expected| over all channels
+    uint64_t pixelsOverTolerance = 0;       // Pixels with any channel differing by more than the tolerance
+    double rmse = 0.0;                      // Root mean squared error over RGB, in 8-bit steps
+    double psnr = 0.0;                      // Over RGB in dB, infinite for identical images
+};
+
+// Compares two RGBA8 images channel by channel. If `diff` is given it receives a
+// visualization: the expected image darkened to a quarter, pixels within tolerance but not
+// identical in blue and pixels over the tolerance in red.
+ImageDifference CompareImages(const CpuImage& actual, const CpuImage& expected, uint32_t tolerance,
+    CpuImage* diff = nullptr);
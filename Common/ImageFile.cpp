@@ -0,0 +1,314 @@
+#include "ImageFile.h"
+#include "stb_image.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+    // Deflate output is a little-endian bit stream; Huffman codes go in most significant bit first
+    class BitWriter {
+    public:
+        explicit BitWriter(std::vector<uint8_t>& out) : out(out) {}
+
+        void Write(uint32_t value, int count) {
+            bits |= static_cast<uint64_t>(value) << bitCount;
+            bitCount += count;
+            while (bitCount >= 8) {
+                out.push_back(static_cast<uint8_t>(bits));
+                bits >>= 8;
+                bitCount -= 8;
+            }
+        }
+
+        void WriteCode(uint32_t code, int length) {
+            uint32_t reversed = 0;
+            for (int i = 0; i < length; i++) {
+                reversed |= ((code >> i) & 1) << (length - 1 - i);
+            }
+            Write(reversed, length);
+        }
+
+        void Flush() {
+            if (bitCount > 0) {
+                out.push_back(static_cast<uint8_t>(bits));
+            }
+            bits = 0;
+            bitCount = 0;
+        }
+
+    private:
+        std::vector<uint8_t>& out;
+        uint64_t bits = 0;
+        int bitCount = 0;
+    };
+
+    const uint16_t lengthBase[] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59,
+        67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    const uint8_t lengthExtra[] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+        4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    const uint16_t distanceBase[] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769,
+        1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    const uint8_t distanceExtra[] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8,
+        9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+    void WriteLiteralOrLength(BitWriter& writer, uint32_t symbol) {
+        if (symbol < 144) writer.WriteCode(0x30 + symbol, 8);
+        else if (symbol < 256) writer.WriteCode(0x190 + symbol - 144, 9);
+        else if (symbol < 280) writer.WriteCode(symbol - 256, 7);
+        else writer.WriteCode(0xc0 + symbol - 280, 8);
+    }
+
+    void WriteMatch(BitWriter& writer, uint32_t length, uint32_t distance) {
+        int code = 28;
+        while (lengthBase[code] > length) {
+            code--;
+        }
+        WriteLiteralOrLength(writer, 257 + code);
+        writer.Write(length - lengthBase[code], lengthExtra[code]);
+
+        code = 29;
+        while (distanceBase[code] > distance) {
+            code--;
+        }
+        writer.WriteCode(code, 5);
+        writer.Write(distance - distanceBase[code], distanceExtra[code]);
+    }
+
+    // One final fixed-Huffman block with greedy hash-chain matching over a 32K window
+    std::vector<uint8_t> Deflate(const std::vector<uint8_t>& data) {
+        const uint32_t windowSize = 32768;
+        const uint32_t hashSize = 1 << 15;
+        const uint32_t maxChain = 64;
+        const uint32_t minMatch = 3;
+        const uint32_t maxMatch = 258;
+
+        std::vector<uint8_t> out;
+        out.reserve(data.size() / 2 + 64);
+        BitWriter writer(out);
+        writer.Write(1, 1);     // BFINAL
+        writer.Write(1, 2);     // BTYPE = fixed Huffman
+
+        std::vector<int32_t> head(hashSize, -1);
+        std::vector<int32_t> prev(windowSize, -1);
+        auto hashAt = [&](uint32_t pos) {
+            uint32_t h = (data[pos] << 16) | (data[pos + 1] << 8) | data[pos + 2];
+            return (h * 2654435761u) >> 17;
+        };
+        auto insert = [&](uint32_t pos) {
+            uint32_t h = hashAt(pos);
+            prev[pos % windowSize] = head[h];
+            head[h] = static_cast<int32_t>(pos);
+        };
+
+        const uint32_t size = static_cast<uint32_t>(data.size());
+        uint32_t pos = 0;
+        while (pos < size) {
+            uint32_t bestLength = 0;
+            uint32_t bestDistance = 0;
+
+            if (pos + minMatch <= size) {
+                uint32_t limit = std::min(maxMatch, size - pos);
+                int32_t candidate = head[hashAt(pos)];
+                for (uint32_t chain = 0; candidate >= 0 && chain < maxChain; chain++) {
+                    uint32_t distance = pos - static_cast<uint32_t>(candidate);
+                    if (distance > windowSize) {
+                        break;
+                    }
+                    uint32_t length = 0;
+                    while (length < limit && data[candidate + length] == data[pos + length]) {
+                        length++;
+                    }
+                    if (length > bestLength) {
+                        bestLength = length;
+                        bestDistance = distance;
+                        if (length == limit) {
+                            break;
+                        }
+                    }
+                    int32_t next = prev[candidate % windowSize];
+                    if (next >= candidate) {
+                        break;
+                    }
+                    candidate = next;
+                }
+            }
+
+            if (bestLength >= minMatch) {
+                WriteMatch(writer, bestLength, bestDistance);
+                for (uint32_t i = 0; i < bestLength; i++, pos++) {
+                    if (pos + minMatch <= size) {
+                        insert(pos);
+                    }
+                }
+            }
+            else {
+                WriteLiteralOrLength(writer, data[pos]);
+                if (pos + minMatch <= size) {
+                    insert(pos);
+                }
+                pos++;
+            }
+        }
+
+        WriteLiteralOrLength(writer, 256);
+        writer.Flush();
+        return out;
+    }
+
+    uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc = 0) {
+        static uint32_t table[256];
+        static bool tableReady = [] {
+            for (uint32_t n = 0; n < 256; n++) {
+                uint32_t c = n;
+                for (int k = 0; k < 8; k++) {
+                    c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                }
+                table[n] = c;
+            }
+            return true;
+        }();
+        (void)tableReady;
+
+        crc = ~crc;
+        for (size_t i = 0; i < size; i++) {
+            crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    uint32_t Adler32(const std::vector<uint8_t>& data) {
+        uint32_t a = 1, b = 0;
+        for (uint8_t value : data) {
+            a = (a + value) % 65521;
+            b = (b + a) % 65521;
+        }
+        return (b << 16) | a;
+    }
+
+    void AppendBigEndian(std::vector<uint8_t>& out, uint32_t value) {
+        out.push_back(static_cast<uint8_t>(value >> 24));
+        out.push_back(static_cast<uint8_t>(value >> 16));
+        out.push_back(static_cast<uint8_t>(value >> 8));
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    void AppendChunk(std::vector<uint8_t>& out, const char type[4], const std::vector<uint8_t>& payload) {
+        AppendBigEndian(out, static_cast<uint32_t>(payload.size()));
+        size_t typeOffset = out.size();
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), payload.begin(), payload.end());
+        AppendBigEndian(out, Crc32(out.data() + typeOffset, payload.size() + 4));
+    }
+
+    uint8_t Paeth(int a, int b, int c) {
+        int p = a + b - c;
+        int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+        if (pa <= pb && pa <= pc) return static_cast<uint8_t>(a);
+        if (pb <= pc) return static_cast<uint8_t>(b);
+        return static_cast<uint8_t>(c);
+    }
+
+    // Filter type byte followed by the filtered row, for each row
+    std::vector<uint8_t> FilterRows(const CpuImage& image) {
+        const uint32_t pitch = image.RowPitch();
+        const uint32_t bpp = 4;
+        std::vector<uint8_t> filtered;
+        filtered.reserve((static_cast<size_t>(pitch) + 1) * image.height);
+        std::vector<uint8_t> candidate(pitch);
+        std::vector<uint8_t> best(pitch);
+        const std::vector<uint8_t> zeroRow(pitch, 0);
+
+        for (uint32_t y = 0; y < image.height; y++) {
+            const uint8_t* row = image.Row(y);
+            const uint8_t* up = y > 0 ? image.Row(y - 1) : zeroRow.data();
+            uint64_t bestCost = UINT64_MAX;
+            uint8_t bestType = 0;
+
+            for (uint8_t type = 0; type < 5; type++) {
+                uint64_t cost = 0;
+                for (uint32_t i = 0; i < pitch; i++) {
+                    int a = i >= bpp ? row[i - bpp] : 0;
+                    int b = up[i];
+                    int c = i >= bpp ? up[i - bpp] : 0;
+                    uint8_t predicted = 0;
+                    switch (type) {
+                    case 1: predicted = static_cast<uint8_t>(a); break;
+                    case 2: predicted = static_cast<uint8_t>(b); break;
+                    case 3: predicted = static_cast<uint8_t>((a + b) / 2); break;
+                    case 4: predicted = Paeth(a, b, c); break;
+                    default: break;
+                    }
+                    candidate[i] = static_cast<uint8_t>(row[i] - predicted);
+                    cost += std::abs(static_cast<int8_t>(candidate[i]));
+                }
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestType = type;
+                    best.swap(candidate);
+                }
+            }
+
+            filtered.push_back(bestType);
+            filtered.insert(filtered.end(), best.begin(), best.end());
+        }
+        return filtered;
+    }
+}
+
+CpuImage LoadImageFile(const std::string& path) {
+    int width, height, channels;
+    stbi_uc* data = stbi_load(path.c_str(), &width, &height, &channels, 4);
+    if (!data) {
+        throw std::runtime_error("Failed to load " + path + ": " + stbi_failure_reason());
+    }
+
+    CpuImage image(static_cast<uint32_t>(width), static_cast<uint32_t>(height));
+    std::memcpy(image.pixels.data(), data, image.pixels.size());
+    stbi_image_free(data);
+    return image;
+}
+
+CpuImage DecodeImage(const uint8_t* data, size_t size, const std::string& name) {
+    int width, height, channels;
+    stbi_uc* pixels = stbi_load_from_memory(data, static_cast<int>(size), &width, &height, &channels, 4);
+    if (!pixels) {
+        throw std::runtime_error("Failed to decode " + name + ": " + stbi_failure_reason());
+    }
+
+    CpuImage image(static_cast<uint32_t>(width), static_cast<uint32_t>(height));
+    std::memcpy(image.pixels.data(), pixels, image.pixels.size());
+    stbi_image_free(pixels);
+    return image;
+}
+
+void WritePngFile(const std::string& path, const CpuImage& image) {
+    static const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    std::vector<uint8_t> png(signature, signature + sizeof(signature));
+
+    // 8-bit RGBA, deflate, adaptive filtering, no interlace
+    std::vector<uint8_t> header;
+    AppendBigEndian(header, image.width);
+    AppendBigEndian(header, image.height);
+    header.insert(header.end(), { 8, 6, 0, 0, 0 });
+    AppendChunk(png, "IHDR", header);
+
+    std::vector<uint8_t> filtered = FilterRows(image);
+    std::vector<uint8_t> zlib = { 0x78, 0x01 };
+    std::vector<uint8_t> compressed = Deflate(filtered);
+    zlib.insert(zlib.end(), compressed.begin(), compressed.end());
+    AppendBigEndian(zlib, Adler32(filtered));
+    AppendChunk(png, "IDAT", zlib);
+    AppendChunk(png, "IEND", {});
+
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        throw std::runtime_error("Failed to open " + path);
+    }
+    size_t written = std::fwrite(png.data(), 1, png.size(), file);
+    if (std::fclose(file) != 0 || written != png.size()) {
+        throw std::runtime_error("Failed to write " + path);
+    }
+}
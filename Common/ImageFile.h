@@ -0,0 +1,14 @@
+#pragma once
+#include <string>
+#include "CpuImage.h"
+
+// Decodes any format stb_image understands (PNG, JPEG, ...) into R8G8B8A8.
+// Throws std::runtime_error if the file cannot be read or decoded.
+CpuImage LoadImageFile(const std::string& path);
+
+// The same for a file already in memory; name only goes into the error message
+CpuImage DecodeImage(const uint8_t* data, size_t size, const std::string& name);
+
+// Writes an RGBA8 PNG. Rows are filtered per row with the usual minimum-sum heuristic and
+// compressed with fixed-Huffman deflate, which is plenty for golden and diff images.
+void WritePngFile(const std::string& path, const CpuImage& image);
@@ -0,0 +1,236 @@
+#include "InstanceBuilder.h"
+#include "SimdMath.h"
+#include "TaskScheduler.h"
+#include <algorithm>
+
+// Every kernel has to round each product the way the scalar code does, but the AVX-512
+// target implies FMA and GCC fuses multiplies and adds even in ISO mode
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize("fp-contract=off")
+// GCC 12 reports the deliberately undefined pass-through operands of AVX-512 intrinsics
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+namespace {
+    // Instances per ParallelFor item; a multiple of every kernel's width
+    const uint32_t BlockSize = 256;
+
+    // The grid cell of an instance and its phase offset, advanced one instance at a time so the
+    // SIMD kernels need no vector division
+    struct CellCounter {
+        uint32_t x, y, z, phase;
+
+        CellCounter(const InstanceGrid& grid, uint32_t index)
+            : x(index % grid.side), y((index / grid.side) % grid.side), z(index / (grid.side * grid.side)),
+            phase(index % 97) {}
+
+        void Next(uint32_t side) {
+            phase = phase == 96 ? 0 : phase + 1;
+            if (++x == side) {
+                x = 0;
+                if (++y == side) {
+                    y = 0;
+                    z++;
+                }
+            }
+        }
+    };
+
+    // Ry(phase) * Rx(phase / 2) written out; the kernels evaluate the same products in the
+    // same order
+    void BuildScalar(const InstanceGrid& grid, float time, uint32_t first, uint32_t last, InstanceTransform* out) {
+        CellCounter cell(grid, first);
+        const float s = grid.scale;
+        for (uint32_t i = first; i < last; i++, cell.Next(grid.side)) {
+            const float phase = time + static_cast<float>(cell.phase) * 0.37f;
+            float sy, cy, sx, cx;
+            ScalarSinCos(phase, sy, cy);
+            ScalarSinCos(phase * 0.5f, sx, cx);
+            const float tx = -grid.extent + (static_cast<float>(cell.x) + 0.5f) * grid.cell;
+            const float ty = -grid.extent + (static_cast<float>(cell.y) + 0.5f) * grid.cell;
+            const float tz = -grid.extent + (static_cast<float>(cell.z) + 0.5f) * grid.cell;
+
+            InstanceTransform& t = out[i];
+            t.column[0] = { cy * s, 0.0f, sy * s, tx };
+            t.column[1] = { (sy * sx) * s, cx * s, -((cy * sx) * s), ty };
+            t.column[2] = { -((sy * cx) * s), sx * s, (cy * cx) * s, tz };
+        }
+    }
+
+#if SIMD_X86
+    // Four component vectors to one float4 per lane: lane k of the 128-bit half h ends up in
+    // result[k] at half h
+    SIMD_TARGET("avx2")
+    inline void TransposeAvx2(__m256 x, __m256 y, __m256 z, __m256 w, __m256 result[4]) {
+        const __m256 xy0 = _mm256_unpacklo_ps(x, y), xy1 = _mm256_unpackhi_ps(x, y);
+        const __m256 zw0 = _mm256_unpacklo_ps(z, w), zw1 = _mm256_unpackhi_ps(z, w);
+        result[0] = _mm256_shuffle_ps(xy0, zw0, 0x44);
+        result[1] = _mm256_shuffle_ps(xy0, zw0, 0xee);
+        result[2] = _mm256_shuffle_ps(xy1, zw1, 0x44);
+        result[3] = _mm256_shuffle_ps(xy1, zw1, 0xee);
+    }
+
+    SIMD_TARGET("avx2")
+    void BuildAvx2(const InstanceGrid& grid, float time, uint32_t first, uint32_t last, InstanceTransform* out) {
+        CellCounter cell(grid, first);
+        const __m256 s = _mm256_set1_ps(grid.scale);
+        const __m256 cellSize = _mm256_set1_ps(grid.cell);
+        const __m256 origin = _mm256_set1_ps(-grid.extent);
+        const __m256 half = _mm256_set1_ps(0.5f);
+        const __m256 sign = _mm256_set1_ps(-0.0f);
+        uint32_t i = first;
+        for (; i + 8 <= last; i += 8) {
+            alignas(32) int32_t lanes[4][8];
+            for (int lane = 0; lane < 8; lane++, cell.Next(grid.side)) {
+                lanes[0][lane] = static_cast<int32_t>(cell.x);
+                lanes[1][lane] = static_cast<int32_t>(cell.y);
+                lanes[2][lane] = static_cast<int32_t>(cell.z);
+                lanes[3][lane] = static_cast<int32_t>(cell.phase);
+            }
+            __m256 laneValue[4];
+            for (int k = 0; k < 4; k++) {
+                laneValue[k] = _mm256_cvtepi32_ps(_mm256_load_si256(reinterpret_cast<const __m256i*>(lanes[k])));
+            }
+            const __m256 phase = _mm256_add_ps(_mm256_set1_ps(time), _mm256_mul_ps(laneValue[3], _mm256_set1_ps(0.37f)));
+            __m256 sy, cy, sx, cx;
+            SinCosAvx2(phase, sy, cy);
+            SinCosAvx2(_mm256_mul_ps(phase, half), sx, cx);
+            const __m256 tx = _mm256_add_ps(origin, _mm256_mul_ps(_mm256_add_ps(laneValue[0], half), cellSize));
+            const __m256 ty = _mm256_add_ps(origin, _mm256_mul_ps(_mm256_add_ps(laneValue[1], half), cellSize));
+            const __m256 tz = _mm256_add_ps(origin, _mm256_mul_ps(_mm256_add_ps(laneValue[2], half), cellSize));
+
+            __m256 columns[3][4];
+            TransposeAvx2(_mm256_mul_ps(cy, s), _mm256_setzero_ps(), _mm256_mul_ps(sy, s), tx, columns[0]);
+            TransposeAvx2(_mm256_mul_ps(_mm256_mul_ps(sy, sx), s), _mm256_mul_ps(cx, s),
+                _mm256_xor_ps(_mm256_mul_ps(_mm256_mul_ps(cy, sx), s), sign), ty, columns[1]);
+            TransposeAvx2(_mm256_xor_ps(_mm256_mul_ps(_mm256_mul_ps(sy, cx), s), sign), _mm256_mul_ps(sx, s),
+                _mm256_mul_ps(_mm256_mul_ps(cy, cx), s), tz, columns[2]);
+
+            // Instances in order, so write-combined memory sees whole lines
+            float* target = &out[i].column[0].x;
+            for (int k = 0; k < 8; k++) {
+                for (int c = 0; c < 3; c++) {
+                    const __m256 v = columns[c][k & 3];
+                    _mm_storeu_ps(target + k * 12 + c * 4, k < 4 ? _mm256_castps256_ps128(v) : _mm256_extractf128_ps(v, 1));
+                }
+            }
+        }
+        BuildScalar(grid, time, i, last, out);
+    }
+
+    // AVX-512F has no float xor
+    SIMD_TARGET("avx512f")
+    inline __m512 NegateAvx512(__m512 v) {
+        return _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(v), _mm512_set1_epi32(static_cast<int32_t>(0x80000000u))));
+    }
+
+    // As TransposeAvx2, per 128-bit quarter
+    SIMD_TARGET("avx512f")
+    inline void TransposeAvx512(__m512 x, __m512 y, __m512 z, __m512 w, __m512 result[4]) {
+        const __m512 xy0 = _mm512_unpacklo_ps(x, y), xy1 = _mm512_unpackhi_ps(x, y);
+        const __m512 zw0 = _mm512_unpacklo_ps(z, w), zw1 = _mm512_unpackhi_ps(z, w);
+        result[0] = _mm512_shuffle_ps(xy0, zw0, 0x44);
+        result[1] = _mm512_shuffle_ps(xy0, zw0, 0xee);
+        result[2] = _mm512_shuffle_ps(xy1, zw1, 0x44);
+        result[3] = _mm512_shuffle_ps(xy1, zw1, 0xee);
+    }
+
+    SIMD_TARGET("avx512f")
+    void BuildAvx512(const InstanceGrid& grid, float time, uint32_t first, uint32_t last, InstanceTransform* out) {
+        CellCounter cell(grid, first);
+        const __m512 s = _mm512_set1_ps(grid.scale);
+        const __m512 cellSize = _mm512_set1_ps(grid.cell);
+        const __m512 origin = _mm512_set1_ps(-grid.extent);
+        const __m512 half = _mm512_set1_ps(0.5f);
+        uint32_t i = first;
+        for (; i + 16 <= last; i += 16) {
+            alignas(64) int32_t lanes[4][16];
+            for (int lane = 0; lane < 16; lane++, cell.Next(grid.side)) {
+                lanes[0][lane] = static_cast<int32_t>(cell.x);
+                lanes[1][lane] = static_cast<int32_t>(cell.y);
+                lanes[2][lane] = static_cast<int32_t>(cell.z);
+                lanes[3][lane] = static_cast<int32_t>(cell.phase);
+            }
+            __m512 laneValue[4];
+            for (int k = 0; k < 4; k++) {
+                laneValue[k] = _mm512_cvtepi32_ps(_mm512_load_si512(lanes[k]));
+            }
+            const __m512 phase = _mm512_add_ps(_mm512_set1_ps(time), _mm512_mul_ps(laneValue[3], _mm512_set1_ps(0.37f)));
+            __m512 sy, cy, sx, cx;
+            SinCosAvx512(phase, sy, cy);
+            SinCosAvx512(_mm512_mul_ps(phase, half), sx, cx);
+            const __m512 tx = _mm512_add_ps(origin, _mm512_mul_ps(_mm512_add_ps(laneValue[0], half), cellSize));
+            const __m512 ty = _mm512_add_ps(origin, _mm512_mul_ps(_mm512_add_ps(laneValue[1], half), cellSize));
+            const __m512 tz = _mm512_add_ps(origin, _mm512_mul_ps(_mm512_add_ps(laneValue[2], half), cellSize));
+
+            __m512 columns[3][4];
+            TransposeAvx512(_mm512_mul_ps(cy, s), _mm512_setzero_ps(), _mm512_mul_ps(sy, s), tx, columns[0]);
+            TransposeAvx512(_mm512_mul_ps(_mm512_mul_ps(sy, sx), s), _mm512_mul_ps(cx, s),
+                NegateAvx512(_mm512_mul_ps(_mm512_mul_ps(cy, sx), s)), ty, columns[1]);
+            TransposeAvx512(NegateAvx512(_mm512_mul_ps(_mm512_mul_ps(sy, cx), s)), _mm512_mul_ps(sx, s),
+                _mm512_mul_ps(_mm512_mul_ps(cy, cx), s), tz, columns[2]);
+
+            float* target = &out[i].column[0].x;
+            for (int k = 0; k < 16; k++) {
+                for (int c = 0; c < 3; c++) {
+                    const __m512 v = columns[c][k & 3];
+                    __m128 quarter;
+                    switch (k >> 2) {
+                    case 0: quarter = _mm512_extractf32x4_ps(v, 0); break;
+                    case 1: quarter = _mm512_extractf32x4_ps(v, 1); break;
+                    case 2: quarter = _mm512_extractf32x4_ps(v, 2); break;
+                    default: quarter = _mm512_extractf32x4_ps(v, 3); break;
+                    }
+                    _mm_storeu_ps(target + k * 12 + c * 4, quarter);
+                }
+            }
+        }
+        BuildScalar(grid, time, i, last, out);
+    }
+#endif
+}
+
+InstanceGrid MakeInstanceGrid(uint32_t count, float extent) {
+    InstanceGrid grid;
+    grid.count = count;
+    grid.side = std::max(1u, static_cast<uint32_t>(std::ceil(std::cbrt(static_cast<double>(count)))));
+    while (static_cast<uint64_t>(grid.side) * grid.side * grid.side < count) {
+        grid.side++;
+    }
+    grid.extent = extent;
+    grid.cell = 2.0f * extent / grid.side;
+    grid.scale = grid.cell * 0.25f;
+    return grid;
+}
+
+Float4x4 InstanceWorldMatrix(const InstanceGrid& grid, float time, uint32_t index) {
+    const float phase = time + static_cast<float>(index % 97) * 0.37f;
+    Float4x4 model = MatrixRotationY(phase) * MatrixRotationX(phase * 0.5f);
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 3; c++) {
+            model.m[r][c] *= grid.scale;
+        }
+    }
+    model.m[3][0] = -grid.extent + (index % grid.side + 0.5f) * grid.cell;
+    model.m[3][1] = -grid.extent + ((index / grid.side) % grid.side + 0.5f) * grid.cell;
+    model.m[3][2] = -grid.extent + (index / (grid.side * grid.side) + 0.5f) * grid.cell;
+    return model;
+}
+
+InstanceBuilder::InstanceBuilder(SimdIsa selected) : isa(selected), build(BuildScalar) {
+#if SIMD_X86
+    if (isa == SimdIsa::AVX2) {
+        build = BuildAvx2;
+    }
+    else if (isa == SimdIsa::AVX512) {
+        build = BuildAvx512;
+    }
+#endif
+}
+
+void InstanceBuilder::Build(const InstanceGrid& grid, float time, TaskScheduler& scheduler, InstanceTransform* out) const {
+    const uint32_t blocks = (grid.count + BlockSize - 1) / BlockSize;
+    scheduler.ParallelFor(blocks, [&](uint32_t begin, uint32_t end) {
+        build(grid, time, begin * BlockSize, std::min(end * BlockSize, grid.count), out);
+    }, 16);
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#include "SceneMath.h"
+#include "SimdIsa.h"
+
+class TaskScheduler;
+
+// Per-instance vertex data of an instanced cube: the columns of the world matrix's affine
+// part, so the vertex shader gets the world position from three dot products with
+// float4(position, 1). The instanced pipeline reads an array of these as its second vertex
+// stream, WORLD0..WORLD2 in DXGI_FORMAT_R32G32B32A32_FLOAT with
+// D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA and a step rate of 1. 48 bytes per cube.
+struct InstanceTransform {
+    Float4 column[3];
+};
+
+// side^3 >= count cells spanning [-extent, extent] on each axis, filled layer by layer from
+// the camera outwards. Every cube is scaled to a quarter of its cell and spins about its own
+// center with the phase BuildCubeGrid gives it.
+struct InstanceGrid {
+    uint32_t count;
+    uint32_t side;
+    float extent;
+    float cell;
+    float scale;
+};
+
+InstanceGrid MakeInstanceGrid(uint32_t count, float extent = 2.0f);
+
+// The world matrix of one grid cube, as MatrixRotationY(phase) * MatrixRotationX(phase / 2),
+// scaled, then translated to the center of its cell
+Float4x4 InstanceWorldMatrix(const InstanceGrid& grid, float time, uint32_t index);
+
+// Fills instance streams for a grid at an animation time. The AVX2 and AVX-512 kernels
+// evaluate 8 or 16 cubes at once, sine and cosine included, and transpose the results so
+// each cube is written as three 16-byte stores in order; they return the same bits as the
+// scalar kernel. The output can be mapped upload memory: it is only ever written.
+class InstanceBuilder {
+public:
+    // SimdIsa::SSE42 runs the scalar kernel
+    explicit InstanceBuilder(SimdIsa isa = DetectSimdIsa());
+
+    SimdIsa Isa() const { return isa; }
+
+    // Instances [first, last) of the grid into out[first, last)
+    void BuildRange(const InstanceGrid& grid, float time, uint32_t first, uint32_t last, InstanceTransform* out) const {
+        build(grid, time, first, last, out);
+    }
+
+    // Every instance of the grid, split into blocks across the scheduler's threads
+    void Build(const InstanceGrid& grid, float time, TaskScheduler& scheduler, InstanceTransform* out) const;
+
+private:
+    using BuildFunction = void (*)(const InstanceGrid& grid, float time, uint32_t first, uint32_t last,
+        InstanceTransform* out);
+
+    SimdIsa isa;
+    BuildFunction build;
+};
@@ -0,0 +1,410 @@
+#include "MipGenerator.h"
+#include "TaskScheduler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#if SIMD_X86
+#include <immintrin.h>
+#endif
+
+// The AVX2 kernels have to round each product the way the scalar code does; see InstanceBuilder.cpp
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+namespace {
+    const double Pi = 3.14159265358979323846;
+
+    // Output rows per ParallelFor item at most; each item filters taps - 2 source rows twice
+    const uint32_t MaxBlockRows = 64;
+    // Output columns decoded and filtered at a time, about 4 KB of source floats
+    const uint32_t StripTexels = 128;
+    // Taps of the widest kernel, radius 3 at 2:1
+    const uint32_t MaxTaps = 12;
+    // Levels with fewer output texels are filtered on the calling thread
+    const uint32_t MinParallelTexels = 128 * 128;
+
+    // Channels are filtered as floats on the 0-255 scale so that box filtering linear
+    // values is exact and matches DownsampleImage. With sRGB, the color channels hold
+    // linear light on the same scale; encode is indexed by value * 257, rounded.
+    struct SrgbTables {
+        float decode[256];
+        uint8_t encode[65536 + 3];      // Padded so a 32-bit gather of the last entry stays inside
+
+        SrgbTables() {
+            for (int i = 0; i < 256; i++) {
+                const double c = i / 255.0;
+                const double linear = c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+                decode[i] = static_cast<float>(linear * 255.0);
+            }
+            for (int i = 0; i < 65536; i++) {
+                const double linear = i / 65535.0;
+                const double c = linear <= 0.0031308 ? linear * 12.92 : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+                encode[i] = static_cast<uint8_t>(std::min(255.0, std::max(0.0, c * 255.0 + 0.5)));
+            }
+            encode[65536] = encode[65537] = encode[65538] = 0;
+        }
+    };
+
+    const SrgbTables& Srgb() {
+        static const SrgbTables tables;
+        return tables;
+    }
+
+    double Sinc(double x) {
+        return x == 0.0 ? 1.0 : std::sin(Pi * x) / (Pi * x);
+    }
+
+    // Modified Bessel function of the first kind, order 0
+    double BesselI0(double x) {
+        double sum = 1.0, term = 1.0;
+        for (int k = 1; k < 32; k++) {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+        }
+        return sum;
+    }
+
+    // Radius in destination texels
+    double FilterRadius(MipFilter filter) {
+        return filter == MipFilter::Box ? 0.5 : 3.0;
+    }
+
+    double FilterWeight(MipFilter filter, double t) {
+        const double radius = FilterRadius(filter);
+        if (std::fabs(t) >= radius) {
+            return 0.0;
+        }
+        switch (filter) {
+        case MipFilter::Box:
+            return 1.0;
+        case MipFilter::Kaiser: {
+            const double alpha = 4.0;
+            const double r = t / radius;
+            return Sinc(t) * BesselI0(alpha * std::sqrt(1.0 - r * r)) / BesselI0(alpha);
+        }
+        case MipFilter::Lanczos:
+            return Sinc(t) * Sinc(t / radius);
+        }
+        return 0.0;
+    }
+
+    // The taps of one output texel, the same for every texel of every level: source texels
+    // 2x - half + 1 ... 2x + half, each at distance k - half + 0.5 source texels from the
+    // output texel's center
+    struct Kernel {
+        uint32_t half;
+        std::vector<float> weights;     // 2 * half
+
+        explicit Kernel(MipFilter filter) {
+            half = static_cast<uint32_t>(std::ceil(FilterRadius(filter) * 2.0 - 0.5));
+            std::vector<double> w(half * 2);
+            double sum = 0.0;
+            for (uint32_t k = 0; k < half * 2; k++) {
+                w[k] = FilterWeight(filter, (static_cast<double>(k) - half + 0.5) / 2.0);
+                sum += w[k];
+            }
+            for (double v : w) {
+                weights.push_back(static_cast<float>(v / sum));
+            }
+        }
+    };
+
+    uint32_t AddressTexel(int64_t i, uint32_t size, bool wrap) {
+        const int64_t n = size;
+        if (wrap) {
+            return static_cast<uint32_t>(((i % n) + n) % n);
+        }
+        return static_cast<uint32_t>(std::min(std::max(i, int64_t(0)), n - 1));
+    }
+
+    // FloatToUnorm8 on the 0-255 scale: NaN to 0, saturate, round
+    inline float Saturate255(float v) {
+        return v > 0.0f ? std::min(v, 255.0f) : 0.0f;
+    }
+
+    void DecodeScalar(const uint8_t* source, uint32_t texels, bool srgb, float* out) {
+        const float* decode = Srgb().decode;
+        for (uint32_t i = 0; i < texels * 4; i++) {
+            out[i] = srgb && (i & 3) != 3 ? decode[source[i]] : static_cast<float>(source[i]);
+        }
+    }
+
+    // out[x] = even taps + odd taps of span texels 2x + 1 ..., each sum accumulated in tap order
+    void HorizontalScalar(const float* span, uint32_t outWidth, const float* weights, uint32_t half, float* out) {
+        for (uint32_t x = 0; x < outWidth; x++) {
+            const float* s = span + (x * 2 + 1) * 4;
+            for (uint32_t c = 0; c < 4; c++) {
+                float even = weights[0] * s[c];
+                float odd = weights[1] * s[4 + c];
+                for (uint32_t j = 1; j < half; j++) {
+                    even = even + weights[j * 2] * s[j * 8 + c];
+                    odd = odd + weights[j * 2 + 1] * s[j * 8 + 4 + c];
+                }
+                out[x * 4 + c] = even + odd;
+            }
+        }
+    }
+
+    void VerticalScalar(const float* const* rows, const float* weights, uint32_t taps, uint32_t first, uint32_t count,
+        bool srgb, uint8_t* out) {
+        const uint8_t* encode = Srgb().encode;
+        for (uint32_t i = first; i < first + count; i++) {
+            float sum = weights[0] * rows[0][i];
+            for (uint32_t k = 1; k < taps; k++) {
+                sum = sum + weights[k] * rows[k][i];
+            }
+            const float v = Saturate255(sum);
+            out[i] = srgb && (i & 3) != 3 ? encode[static_cast<int>(v * 257.0f + 0.5f)] : static_cast<uint8_t>(v + 0.5f);
+        }
+    }
+
+#if SIMD_X86
+    SIMD_TARGET("avx2")
+    void DecodeAvx2(const uint8_t* source, uint32_t texels, bool srgb, float* out) {
+        const float* decode = Srgb().decode;
+        uint32_t i = 0;
+        for (; i + 16 <= texels * 4; i += 16) {
+            const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+            const __m256i low = _mm256_cvtepu8_epi32(bytes);
+            const __m256i high = _mm256_cvtepu8_epi32(_mm_srli_si128(bytes, 8));
+            __m256 v0 = _mm256_cvtepi32_ps(low);
+            __m256 v1 = _mm256_cvtepi32_ps(high);
+            if (srgb) {
+                v0 = _mm256_blend_ps(_mm256_i32gather_ps(decode, low, 4), v0, 0x88);
+                v1 = _mm256_blend_ps(_mm256_i32gather_ps(decode, high, 4), v1, 0x88);
+            }
+            _mm256_storeu_ps(out + i, v0);
+            _mm256_storeu_ps(out + i + 8, v1);
+        }
+        DecodeScalar(source + i, texels - i / 4, srgb, out + i);
+    }
+
+    // Four output texels per iteration, two per vector: the low half of a vector sums the
+    // even taps and the high half the odd taps of the same texel
+    SIMD_TARGET("avx2")
+    void HorizontalAvx2(const float* span, uint32_t outWidth, const float* weights, uint32_t half, float* out) {
+        __m256 w[MaxTaps / 2];
+        for (uint32_t j = 0; j < half; j++) {
+            w[j] = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(weights[j * 2])),
+                _mm_set1_ps(weights[j * 2 + 1]), 1);
+        }
+        uint32_t x = 0;
+        for (; x + 4 <= outWidth; x += 4) {
+            const float* s = span + (x * 2 + 1) * 4;
+            __m256 sum0 = _mm256_mul_ps(w[0], _mm256_loadu_ps(s));
+            __m256 sum1 = _mm256_mul_ps(w[0], _mm256_loadu_ps(s + 8));
+            __m256 sum2 = _mm256_mul_ps(w[0], _mm256_loadu_ps(s + 16));
+            __m256 sum3 = _mm256_mul_ps(w[0], _mm256_loadu_ps(s + 24));
+            for (uint32_t j = 1; j < half; j++) {
+                const float* t = s + j * 8;
+                sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(w[j], _mm256_loadu_ps(t)));
+                sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(w[j], _mm256_loadu_ps(t + 8)));
+                sum2 = _mm256_add_ps(sum2, _mm256_mul_ps(w[j], _mm256_loadu_ps(t + 16)));
+                sum3 = _mm256_add_ps(sum3, _mm256_mul_ps(w[j], _mm256_loadu_ps(t + 24)));
+            }
+            _mm256_storeu_ps(out + x * 4, _mm256_add_ps(_mm256_permute2f128_ps(sum0, sum1, 0x20),
+                _mm256_permute2f128_ps(sum0, sum1, 0x31)));
+            _mm256_storeu_ps(out + x * 4 + 8, _mm256_add_ps(_mm256_permute2f128_ps(sum2, sum3, 0x20),
+                _mm256_permute2f128_ps(sum2, sum3, 0x31)));
+        }
+        HorizontalScalar(span + x * 8, outWidth - x, weights, half, out + x * 4);
+    }
+
+    // Saturated, rounded and, with sRGB, encoded color channels of eight lanes, as 32-bit integers
+    SIMD_TARGET("avx2")
+    inline __m256i EncodeAvx2(__m256 sum, bool srgb, const int* encode) {
+        // maxps returns its second operand for NaN, as Saturate255 does
+        const __m256 v = _mm256_min_ps(_mm256_max_ps(sum, _mm256_setzero_ps()), _mm256_set1_ps(255.0f));
+        const __m256 half = _mm256_set1_ps(0.5f);
+        const __m256i bytes = _mm256_cvttps_epi32(_mm256_add_ps(v, half));
+        if (!srgb) {
+            return bytes;
+        }
+        const __m256i index = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(v, _mm256_set1_ps(257.0f)), half));
+        const __m256i color = _mm256_and_si256(_mm256_i32gather_epi32(encode, index, 1), _mm256_set1_epi32(0xff));
+        return _mm256_blend_epi32(color, bytes, 0x88);
+    }
+
+    // Sixteen channels per iteration in two independent sums
+    SIMD_TARGET("avx2")
+    void VerticalAvx2(const float* const* rows, const float* weights, uint32_t taps, uint32_t first, uint32_t count,
+        bool srgb, uint8_t* out) {
+        const int* encode = reinterpret_cast<const int*>(Srgb().encode);
+        __m256 w[MaxTaps];
+        for (uint32_t k = 0; k < taps; k++) {
+            w[k] = _mm256_set1_ps(weights[k]);
+        }
+        // packus interleaves the two vectors' lanes; this puts the dwords back in order
+        const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+        uint32_t i = first;
+        for (; i + 16 <= first + count; i += 16) {
+            __m256 sum0 = _mm256_mul_ps(w[0], _mm256_loadu_ps(rows[0] + i));
+            __m256 sum1 = _mm256_mul_ps(w[0], _mm256_loadu_ps(rows[0] + i + 8));
+            for (uint32_t k = 1; k < taps; k++) {
+                sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(w[k], _mm256_loadu_ps(rows[k] + i)));
+                sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(w[k], _mm256_loadu_ps(rows[k] + i + 8)));
+            }
+            const __m256i words = _mm256_packus_epi32(EncodeAvx2(sum0, srgb, encode), EncodeAvx2(sum1, srgb, encode));
+            const __m256i bytes = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(words, _mm256_setzero_si256()), order);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm256_castsi256_si128(bytes));
+        }
+        VerticalScalar(rows, weights, taps, i, first + count - i, srgb, out);
+    }
+#endif
+
+    using DecodeFunction = void (*)(const uint8_t* source, uint32_t texels, bool srgb, float* out);
+
+    // Source texels [first, first + count) of a row, wrapped or clamped past either edge
+    void DecodeSpan(const uint8_t* row, uint32_t width, int64_t first, uint32_t count, const MipOptions& options,
+        DecodeFunction decode, float* out) {
+        const int64_t inside = std::max(first, int64_t(0));
+        const int64_t insideEnd = std::min(first + count, static_cast<int64_t>(width));
+        for (int64_t i = first; i < first + count; i++) {
+            if (i == inside && inside < insideEnd) {
+                decode(row + inside * 4, static_cast<uint32_t>(insideEnd - inside), options.srgb, out + (i - first) * 4);
+                i = insideEnd - 1;
+            }
+            else {
+                decode(row + AddressTexel(i, width, options.wrap) * 4, 1, options.srgb, out + (i - first) * 4);
+            }
+        }
+    }
+
+    // Filters output rows [firstRow, lastRow) of one level. Source rows are read in order
+    // and decoded StripTexels output columns at a time so the float span stays in the L1
+    // cache; each strip's two new rows are combined vertically while they are still there.
+    void FilterRows(const CpuImage& source, CpuImage& result, const Kernel& kernel, const MipOptions& options,
+        uint32_t firstRow, uint32_t lastRow, DecodeFunction decode,
+        void (*horizontal)(const float*, uint32_t, const float*, uint32_t, float*),
+        void (*vertical)(const float* const*, const float*, uint32_t, uint32_t, uint32_t, bool, uint8_t*)) {
+        const uint32_t half = kernel.half;
+        const uint32_t taps = half * 2;
+        const size_t rowFloats = static_cast<size_t>(result.width) * 4;
+
+        // Source texels 2 * x0 - half ... of a strip starting at output column x0; the
+        // horizontal kernel reads texels 2x + 1 ... of it for strip column x
+        std::vector<float> span(static_cast<size_t>(StripTexels * 2 + taps) * 4);
+        // The last `taps` horizontally filtered rows, row u in slot u mod taps
+        std::vector<float> ring(taps * rowFloats);
+        std::vector<const float*> rows(taps);
+
+        auto slot = [&](int64_t u) {
+            return ring.data() + static_cast<size_t>((u + taps) % taps) * rowFloats;
+        };
+        auto filterStrip = [&](int64_t u, uint32_t x0, uint32_t count) {
+            const uint32_t y = AddressTexel(u, source.height, options.wrap);
+            DecodeSpan(source.Row(y), source.width, static_cast<int64_t>(x0) * 2 - half, count * 2 + taps - 1,
+                options, decode, span.data());
+            horizontal(span.data(), count, kernel.weights.data(), half, slot(u) + x0 * 4);
+        };
+
+        const int64_t start = static_cast<int64_t>(firstRow) * 2 - half + 1;
+        for (int64_t u = start; u < start + taps - 2; u++) {
+            for (uint32_t x0 = 0; x0 < result.width; x0 += StripTexels) {
+                filterStrip(u, x0, std::min(StripTexels, result.width - x0));
+            }
+        }
+        for (uint32_t y = firstRow; y < lastRow; y++) {
+            const int64_t top = static_cast<int64_t>(y) * 2 - half + 1;
+            for (uint32_t k = 0; k < taps; k++) {
+                rows[k] = slot(top + k);
+            }
+            for (uint32_t x0 = 0; x0 < result.width; x0 += StripTexels) {
+                const uint32_t count = std::min(StripTexels, result.width - x0);
+                filterStrip(top + taps - 2, x0, count);
+                filterStrip(top + taps - 1, x0, count);
+                vertical(rows.data(), kernel.weights.data(), taps, x0 * 4, count * 4, options.srgb, result.Row(y));
+            }
+        }
+    }
+}
+
+struct MipGenerator::Kernels {
+    void (*decode)(const uint8_t* source, uint32_t texels, bool srgb, float* out);
+    void (*horizontal)(const float* span, uint32_t outWidth, const float* weights, uint32_t half, float* out);
+    void (*vertical)(const float* const* rows, const float* weights, uint32_t taps, uint32_t first, uint32_t count,
+        bool srgb, uint8_t* out);
+};
+
+const char* MipFilterName(MipFilter filter) {
+    switch (filter) {
+    case MipFilter::Box: return "box";
+    case MipFilter::Kaiser: return "kaiser";
+    case MipFilter::Lanczos: return "lanczos";
+    }
+    return "unknown";
+}
+
+bool ParseMipFilter(const char* name, MipFilter& filter) {
+    for (MipFilter candidate : { MipFilter::Box, MipFilter::Kaiser, MipFilter::Lanczos }) {
+        if (std::strcmp(name, MipFilterName(candidate)) == 0) {
+            filter = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+MipGenerator::MipGenerator(SimdIsa selected) : isa(selected), kernels(nullptr) {
+    static const Kernels scalar = { DecodeScalar, HorizontalScalar, VerticalScalar };
+    kernels = &scalar;
+#if SIMD_X86
+    static const Kernels avx2 = { DecodeAvx2, HorizontalAvx2, VerticalAvx2 };
+    if (isa == SimdIsa::AVX2 || isa == SimdIsa::AVX512) {
+        kernels = &avx2;
+    }
+#endif
+}
+
+uint32_t MipGenerator::FullChainLevels(uint32_t width, uint32_t height) {
+    uint32_t levels = 1;
+    for (uint32_t size = std::max(width, height); size > 1; size /= 2) {
+        levels++;
+    }
+    return levels;
+}
+
+CpuImage MipGenerator::Downsample(const CpuImage& source, const MipOptions& options, TaskScheduler* scheduler) const {
+    if (source.width == 0 || source.height == 0) {
+        throw std::runtime_error("cannot build mips of an empty image");
+    }
+    const Kernel kernel(options.filter);
+    CpuImage result(std::max(1u, source.width / 2), std::max(1u, source.height / 2));
+
+    uint32_t blockRows = result.height;
+    if (scheduler && static_cast<uint64_t>(result.width) * result.height >= MinParallelTexels) {
+        const uint32_t perThread = (result.height + scheduler->ThreadCount() * 4 - 1) / (scheduler->ThreadCount() * 4);
+        blockRows = std::min(MaxBlockRows, std::max(8u, perThread));
+    }
+    const uint32_t blocks = (result.height + blockRows - 1) / blockRows;
+    auto run = [&](uint32_t begin, uint32_t end) {
+        for (uint32_t b = begin; b < end; b++) {
+            FilterRows(source, result, kernel, options, b * blockRows, std::min(result.height, (b + 1) * blockRows),
+                kernels->decode, kernels->horizontal, kernels->vertical);
+        }
+    };
+    if (blocks > 1) {
+        scheduler->ParallelFor(blocks, run);
+    } else {
+        run(0, 1);
+    }
+    return result;
+}
+
+void MipGenerator::Generate(std::vector<CpuImage>& levels, const MipOptions& options, TaskScheduler* scheduler) const {
+    if (levels.empty() || levels[0].width == 0 || levels[0].height == 0) {
+        throw std::runtime_error("cannot build mips of an empty image");
+    }
+    const uint32_t fullChain = FullChainLevels(levels[0].width, levels[0].height);
+    const uint32_t count = options.mipLevels ? options.mipLevels : fullChain;
+    if (count > fullChain) {
+        throw std::runtime_error("more mip levels than the image size allows");
+    }
+    levels.reserve(count);
+    while (levels.size() < count) {
+        levels.push_back(Downsample(levels.back(), options, scheduler));
+    }
+}
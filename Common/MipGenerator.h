@@ -0,0 +1,62 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "CpuImage.h"
+#include "SimdIsa.h"
+
+class TaskScheduler;
+
+enum class MipFilter {
+    Box,        // 2x2 average, what DownsampleImage and GenerateMips-style compute passes do
+    Kaiser,     // Kaiser-windowed sinc, radius 3 and alpha 4: sharper, slight ringing
+    Lanczos,    // Lanczos-3 windowed sinc: sharpest, more ringing
+};
+
+const char* MipFilterName(MipFilter filter);
+bool ParseMipFilter(const char* name, MipFilter& filter);
+
+struct MipOptions {
+    uint32_t mipLevels = 0;         // 0 = full chain down to 1x1, counting the image itself
+    MipFilter filter = MipFilter::Box;
+    bool srgb = false;              // Average red, green and blue in linear light; alpha is always linear
+    bool wrap = true;               // Taps past an edge wrap around, as the WRAP sampler sees the texture; else clamp
+};
+
+// Builds mip chains of R8G8B8A8 images on the CPU. Every level is filtered from the one
+// above it with a separable kernel centered between each pair of source texels, so level
+// n + 1 is max(1, size / 2) of level n like D3D12 and an odd last row or column only feeds
+// the wider kernels. Kernel weights are normalized; results are rounded to nearest and
+// saturated. With sRGB, texels are decoded through a table, filtered in linear light and
+// encoded through a 64K-entry table.
+//
+// A level is split into blocks of output rows spread over the scheduler's threads. A block
+// reads the source rows it needs in order, filters them horizontally into a ring of float
+// rows and combines the ring vertically, two new source rows per output row. Rows are
+// decoded and filtered 128 output columns at a time so the floats in flight stay in the
+// L1 cache. The AVX2 kernels compute
+// two output texels per vector horizontally and eight channels per vector vertically, in
+// the same order as the scalar code, so all ISAs produce identical images. Box with
+// linear averaging reproduces DownsampleImage exactly.
+class MipGenerator {
+public:
+    // SimdIsa::AVX512 runs the AVX2 kernels and SSE42 the scalar ones
+    explicit MipGenerator(SimdIsa isa = DetectSimdIsa());
+
+    SimdIsa Isa() const { return isa; }
+
+    // The level below `source`. scheduler may be null to filter on the calling thread.
+    CpuImage Downsample(const CpuImage& source, const MipOptions& options, TaskScheduler* scheduler) const;
+
+    // levels[0] holds the image; appends the levels below it up to options.mipLevels.
+    // Throws std::runtime_error for an empty image or more levels than its size allows.
+    void Generate(std::vector<CpuImage>& levels, const MipOptions& options, TaskScheduler* scheduler) const;
+
+    // Levels of a full chain for an image of this size
+    static uint32_t FullChainLevels(uint32_t width, uint32_t height);
+
+private:
+    struct Kernels;
+
+    SimdIsa isa;
+    const Kernels* kernels;
+};
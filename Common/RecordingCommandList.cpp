@@ -0,0 +1,7 @@
+#include "RecordingCommandList.h"
+
+RecordingCommandList::RecordingCommandList(uint32_t shaderVisibleDescriptors, uint32_t stagingDescriptors)
+    : shaderVisible(shaderVisibleDescriptors), staging(stagingDescriptors) {
+    // A command allocator keeps its pages across resets; start with a few MB of them
+    stream.reserve(4 << 20);
+}
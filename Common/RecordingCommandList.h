@@ -0,0 +1,162 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "DescriptorAllocator.h"
+
+// Stands in for ID3D12GraphicsCommandList (and the ID3D12Device view and copy calls) in CPU
+// benchmarks of binding paths. Every call is appended to a packed command stream the way a
+// driver writes into command allocator memory; views and descriptor copies are written into
+// host descriptor heaps of 32-byte descriptors. Descriptor tables are given as heap indices.
+class RecordingCommandList {
+public:
+    static const uint32_t MaxRootParameters = 16;
+    static const uint32_t MaxRootConstants = 64;    // 32-bit values, the root signature limit
+
+    // A view as written into a heap: 32 bytes, the CBV_SRV_UAV increment of most GPUs
+    struct Descriptor {
+        enum Type : uint32_t { Empty, ConstantBuffer, ShaderResource };
+        uint32_t type;
+        uint32_t size;          // Bytes of a constant buffer view
+        uint64_t address;       // GPU virtual address or resource id
+        uint64_t reserved[2];
+    };
+
+    // Root arguments bound when a draw was recorded
+    struct RootState {
+        uint64_t argument[MaxRootParameters];   // Heap index of a table, GPU address of a root view
+        uint32_t constants[MaxRootParameters][MaxRootConstants];
+    };
+
+    struct Draw {
+        uint32_t indexCount;
+        uint32_t instanceCount;
+        uint32_t startIndex;
+        int32_t baseVertex;
+        uint32_t startInstance;
+    };
+
+    RecordingCommandList(uint32_t shaderVisibleDescriptors, uint32_t stagingDescriptors);
+
+    // ID3D12CommandAllocator::Reset + ID3D12GraphicsCommandList::Reset; keeps the memory
+    void Reset() {
+        stream.clear();
+        calls = 0;
+    }
+
+    void SetGraphicsRootDescriptorTable(uint32_t parameter, uint32_t descriptorIndex) {
+        const uint32_t payload[2] = { parameter, descriptorIndex };
+        Append(SetRootTable, payload, sizeof(payload));
+    }
+
+    void SetGraphicsRoot32BitConstants(uint32_t parameter, uint32_t count, const void* data, uint32_t offset) {
+        uint8_t* out = Append(SetRootConstants, nullptr, 12 + count * 4);
+        const uint32_t header[3] = { parameter, count, offset };
+        std::memcpy(out, header, sizeof(header));
+        std::memcpy(out + sizeof(header), data, count * 4);
+    }
+
+    void SetGraphicsRootConstantBufferView(uint32_t parameter, uint64_t gpuAddress) {
+        AppendRootView(SetRootCbv, parameter, gpuAddress);
+    }
+
+    void SetGraphicsRootShaderResourceView(uint32_t parameter, uint64_t gpuAddress) {
+        AppendRootView(SetRootSrv, parameter, gpuAddress);
+    }
+
+    void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex,
+        uint32_t startInstance) {
+        const Draw draw = { indexCount, instanceCount, startIndex, baseVertex, startInstance };
+        Append(DrawIndexed, &draw, sizeof(draw));
+    }
+
+    // ID3D12Device::CreateConstantBufferView into the shader-visible heap
+    void CreateConstantBufferView(uint32_t descriptorIndex, uint64_t gpuAddress, uint32_t size) {
+        shaderVisible[descriptorIndex] = { Descriptor::ConstantBuffer, size, gpuAddress, { 0, 0 } };
+        calls++;
+    }
+
+    // ID3D12Device::CreateShaderResourceView into the staging heap; `resource` identifies it
+    void CreateShaderResourceView(uint32_t stagingIndex, uint64_t resource) {
+        staging[stagingIndex] = { Descriptor::ShaderResource, 0, resource, { 0, 0 } };
+        calls++;
+    }
+
+    // ID3D12Device::CopyDescriptors from the staging heap into the shader-visible heap
+    void CopyDescriptors(const DescriptorCopyBatch& batch) {
+        for (const DescriptorCopy& copy : batch.Copies()) {
+            std::memcpy(&shaderVisible[copy.destination], &staging[copy.source], copy.count * sizeof(Descriptor));
+        }
+        calls++;
+    }
+
+    const Descriptor& ShaderVisibleDescriptor(uint32_t index) const { return shaderVisible[index]; }
+    size_t CommandBytes() const { return stream.size(); }
+    uint64_t Calls() const { return calls; }   // Command list and descriptor calls since Reset
+
+    // Walks the stream and calls onDraw(const RootState&, const Draw&) for every draw with
+    // the root arguments bound at that point
+    template <typename F>
+    void Replay(F&& onDraw) const {
+        RootState state = {};
+        size_t position = 0;
+        while (position < stream.size()) {
+            uint32_t header[2];
+            std::memcpy(header, &stream[position], sizeof(header));
+            const uint8_t* payload = &stream[position + sizeof(header)];
+            ApplyCommand(header[0], payload, header[1], state, [&](const Draw& draw) { onDraw(state, draw); });
+            position += sizeof(header) + header[1];
+        }
+    }
+
+private:
+    enum Opcode : uint32_t { SetRootTable, SetRootConstants, SetRootCbv, SetRootSrv, DrawIndexed };
+
+    // Commands are a { opcode, payload size } header followed by the payload
+    uint8_t* Append(Opcode opcode, const void* payload, uint32_t size) {
+        const size_t position = stream.size();
+        stream.resize(position + 8 + size);
+        const uint32_t header[2] = { opcode, size };
+        std::memcpy(&stream[position], header, sizeof(header));
+        if (payload) {
+            std::memcpy(&stream[position + 8], payload, size);
+        }
+        calls++;
+        return &stream[position + 8];
+    }
+
+    void AppendRootView(Opcode opcode, uint32_t parameter, uint64_t gpuAddress) {
+        uint32_t payload[3] = { parameter };
+        std::memcpy(&payload[1], &gpuAddress, sizeof(gpuAddress));
+        Append(opcode, payload, sizeof(payload));
+    }
+
+    template <typename F>
+    static void ApplyCommand(uint32_t opcode, const uint8_t* payload, uint32_t size, RootState& state, F&& onDraw) {
+        uint32_t words[3] = {};
+        std::memcpy(words, payload, size < sizeof(words) ? size : sizeof(words));
+        switch (opcode) {
+        case SetRootTable:
+            state.argument[words[0]] = words[1];
+            break;
+        case SetRootConstants:
+            std::memcpy(&state.constants[words[0]][words[2]], payload + 12, words[1] * 4);
+            break;
+        case SetRootCbv:
+        case SetRootSrv:
+            std::memcpy(&state.argument[words[0]], payload + 4, sizeof(uint64_t));
+            break;
+        case DrawIndexed: {
+            Draw draw;
+            std::memcpy(&draw, payload, sizeof(draw));
+            onDraw(draw);
+            break;
+        }
+        }
+    }
+
+    std::vector<uint8_t> stream;
+    std::vector<Descriptor> shaderVisible;
+    std::vector<Descriptor> staging;
+    uint64_t calls = 0;
+};
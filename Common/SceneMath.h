@@ -0,0 +1,138 @@
+#pragma once
+#include <cmath>
+
+// The handful of DirectXMath operations the cube samples use, written out in plain C++.
+// DirectXMath comes with the Windows SDK and is not vendored in this repo, so the CPU
+// backends and headless builds on other platforms use these. Conventions follow XMMATRIX:
+// row-major storage, row vectors (v * M) and left-handed view space. The formulas are the
+// ones DirectXMath uses, so results agree to within float rounding; on Windows,
+// MVPmatrix --transforms checks that against DirectXMath itself.
+
+struct Float3 {
+    float x, y, z;
+};
+
+struct Float4 {
+    float x, y, z, w;
+};
+
+struct Float4x4 {
+    float m[4][4];
+};
+
+const float ScenePi = 3.141592654f;
+
+inline float ConvertToRadians(float degrees) {
+    return degrees * (ScenePi / 180.0f);
+}
+
+// XMScalarSinCos: range reduction to [-pi/2, pi/2] followed by minimax polynomials.
+// Using it instead of std::sin keeps the rotation matrices identical to the GPU path.
+inline void ScalarSinCos(float value, float& sinValue, float& cosValue) {
+    float quotient = 0.159154943f * value;
+    quotient = static_cast<float>(static_cast<int>(value >= 0.0f ? quotient + 0.5f : quotient - 0.5f));
+    float y = value - 6.283185307f * quotient;
+
+    float sign = 1.0f;
+    if (y > 1.570796327f) {
+        y = ScenePi - y;
+        sign = -1.0f;
+    }
+    else if (y < -1.570796327f) {
+        y = -ScenePi - y;
+        sign = -1.0f;
+    }
+
+    float y2 = y * y;
+    sinValue = (((((-2.3889859e-08f * y2 + 2.7525562e-06f) * y2 - 0.00019840874f) * y2 + 0.0083333310f) * y2
+        - 0.16666667f) * y2 + 1.0f) * y;
+    float p = ((((-2.6051615e-07f * y2 + 2.4760495e-05f) * y2 - 0.0013888378f) * y2 + 0.041666638f) * y2
+        - 0.5f) * y2 + 1.0f;
+    cosValue = sign * p;
+}
+
+inline Float4x4 MatrixIdentity() {
+    return { { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } } };
+}
+
+inline Float4x4 MatrixMultiply(const Float4x4& a, const Float4x4& b) {
+    Float4x4 result;
+    for (int row = 0; row < 4; row++) {
+        for (int col = 0; col < 4; col++) {
+            result.m[row][col] = a.m[row][0] * b.m[0][col] + a.m[row][1] * b.m[1][col]
+                + a.m[row][2] * b.m[2][col] + a.m[row][3] * b.m[3][col];
+        }
+    }
+    return result;
+}
+
+inline Float4x4 operator*(const Float4x4& a, const Float4x4& b) {
+    return MatrixMultiply(a, b);
+}
+
+inline Float4x4 MatrixRotationX(float angle) {
+    float s, c;
+    ScalarSinCos(angle, s, c);
+    return { { { 1, 0, 0, 0 }, { 0, c, s, 0 }, { 0, -s, c, 0 }, { 0, 0, 0, 1 } } };
+}
+
+inline Float4x4 MatrixRotationY(float angle) {
+    float s, c;
+    ScalarSinCos(angle, s, c);
+    return { { { c, 0, -s, 0 }, { 0, 1, 0, 0 }, { s, 0, c, 0 }, { 0, 0, 0, 1 } } };
+}
+
+inline Float3 Vector3Cross(const Float3& a, const Float3& b) {
+    return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+inline float Vector3Dot(const Float3& a, const Float3& b) {
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+inline Float3 Vector3Normalize(const Float3& v) {
+    float length = std::sqrt(Vector3Dot(v, v));
+    if (length > 0.0f) {
+        return { v.x / length, v.y / length, v.z / length };
+    }
+    return v;
+}
+
+inline Float4x4 MatrixLookAtLH(const Float3& eye, const Float3& focus, const Float3& up) {
+    Float3 r2 = Vector3Normalize({ focus.x - eye.x, focus.y - eye.y, focus.z - eye.z });
+    Float3 r0 = Vector3Normalize(Vector3Cross(up, r2));
+    Float3 r1 = Vector3Cross(r2, r0);
+    Float3 negEye = { -eye.x, -eye.y, -eye.z };
+
+    return { {
+        { r0.x, r1.x, r2.x, 0.0f },
+        { r0.y, r1.y, r2.y, 0.0f },
+        { r0.z, r1.z, r2.z, 0.0f },
+        { Vector3Dot(r0, negEye), Vector3Dot(r1, negEye), Vector3Dot(r2, negEye), 1.0f },
+    } };
+}
+
+inline Float4x4 MatrixPerspectiveFovLH(float fovAngleY, float aspectRatio, float nearZ, float farZ) {
+    float s, c;
+    ScalarSinCos(0.5f * fovAngleY, s, c);
+    float height = c / s;
+    float width = height / aspectRatio;
+    float range = farZ / (farZ - nearZ);
+
+    return { {
+        { width, 0.0f, 0.0f, 0.0f },
+        { 0.0f, height, 0.0f, 0.0f },
+        { 0.0f, 0.0f, range, 1.0f },
+        { 0.0f, 0.0f, -range * nearZ, 0.0f },
+    } };
+}
+
+// float4(p, 1) * m, i.e. mul(m, float4(p, 1)) in the shaders, which see the matrix transposed.
+inline Float4 TransformPoint(const Float3& p, const Float4x4& m) {
+    return {
+        p.x * m.m[0][0] + p.y * m.m[1][0] + p.z * m.m[2][0] + m.m[3][0],
+        p.x * m.m[0][1] + p.y * m.m[1][1] + p.z * m.m[2][1] + m.m[3][1],
+        p.x * m.m[0][2] + p.y * m.m[1][2] + p.z * m.m[2][2] + m.m[3][2],
+        p.x * m.m[0][3] + p.y * m.m[1][3] + p.z * m.m[2][3] + m.m[3][3],
+    };
+}
@@ -0,0 +1,99 @@
+#include "SimdIsa.h"
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+
+#if SIMD_X86
+#if defined(_MSC_VER)
+#include <immintrin.h>
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+namespace {
+    void CpuId(unsigned leaf, unsigned subleaf, unsigned regs[4]) {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuidex(info, static_cast<int>(leaf), static_cast<int>(subleaf));
+        for (int i = 0; i < 4; i++) regs[i] = static_cast<unsigned>(info[i]);
+#else
+        if (!__get_cpuid_count(leaf, subleaf, &regs[0], &regs[1], &regs[2], &regs[3])) {
+            regs[0] = regs[1] = regs[2] = regs[3] = 0;
+        }
+#endif
+    }
+
+    uint64_t ReadXCR0() {
+#if defined(_MSC_VER)
+        return _xgetbv(0);
+#else
+        uint32_t eax, edx;
+        __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+    }
+}
+#endif
+
+SimdIsa DetectSimdIsa() {
+    if (IsSimdIsaSupported(SimdIsa::AVX512)) return SimdIsa::AVX512;
+    if (IsSimdIsaSupported(SimdIsa::AVX2)) return SimdIsa::AVX2;
+    if (IsSimdIsaSupported(SimdIsa::SSE42)) return SimdIsa::SSE42;
+    return SimdIsa::Scalar;
+}
+
+bool IsSimdIsaSupported(SimdIsa isa) {
+    if (isa == SimdIsa::Scalar) {
+        return true;
+    }
+#if SIMD_X86
+    unsigned leaf1[4], leaf7[4];
+    CpuId(1, 0, leaf1);
+    CpuId(7, 0, leaf7);
+
+    const bool sse42 = (leaf1[2] >> 20) & 1;
+    const bool osxsave = (leaf1[2] >> 27) & 1;
+    const bool avx = (leaf1[2] >> 28) & 1;
+    const bool fma = (leaf1[2] >> 12) & 1;
+    const bool avx2 = (leaf7[1] >> 5) & 1;
+    const bool avx512f = (leaf7[1] >> 16) & 1;
+
+    // The OS must save YMM (and for AVX-512 also opmask/ZMM) state on context switches
+    const uint64_t xcr0 = osxsave ? ReadXCR0() : 0;
+    const bool osAvx = (xcr0 & 0x6) == 0x6;
+    const bool osAvx512 = (xcr0 & 0xe6) == 0xe6;
+
+    switch (isa) {
+    case SimdIsa::SSE42:
+        return sse42;
+    case SimdIsa::AVX2:
+        return avx && avx2 && fma && osAvx;
+    case SimdIsa::AVX512:
+        return avx512f && osAvx512;
+    default:
+        return false;
+    }
+#else
+    return false;
+#endif
+}
+
+const char* SimdIsaName(SimdIsa isa) {
+    switch (isa) {
+    case SimdIsa::SSE42: return "sse4.2";
+    case SimdIsa::AVX2: return "avx2";
+    case SimdIsa::AVX512: return "avx512";
+    default: return "scalar";
+    }
+}
+
+bool ParseSimdIsa(const char* name, SimdIsa& isa) {
+    for (SimdIsa candidate : { SimdIsa::Scalar, SimdIsa::SSE42, SimdIsa::AVX2, SimdIsa::AVX512 }) {
+        if (std::strcmp(name, SimdIsaName(candidate)) == 0) {
+            isa = candidate;
+            return true;
+        }
+    }
+    return false;
+}
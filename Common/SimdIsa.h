@@ -0,0 +1,28 @@
+#pragma once
+
+// Instruction sets the CPU backends have kernels for.
+enum class SimdIsa {
+    Scalar,
+    SSE42,
+    AVX2,
+    AVX512,
+};
+
+// Widest instruction set supported by both the CPU and the OS.
+SimdIsa DetectSimdIsa();
+bool IsSimdIsaSupported(SimdIsa isa);
+const char* SimdIsaName(SimdIsa isa);
+bool ParseSimdIsa(const char* name, SimdIsa& isa);
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86 1
+#else
+#define SIMD_X86 0
+#endif
+
+// MSVC lets any function use any intrinsic; GCC and Clang need the target spelled out
+#if defined(_MSC_VER) && !defined(__clang__)
+#define SIMD_TARGET(isa)
+#else
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#endif
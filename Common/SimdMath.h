@@ -0,0 +1,89 @@
+#pragma once
+#include "SceneMath.h"
+#include "SimdIsa.h"
+
+#if SIMD_X86
+#include <immintrin.h>
+
+// SceneMath functions on 8 or 16 lanes at once, returning the same bits per lane as the
+// scalar versions as long as the caller's translation unit does not contract multiplies
+// and adds into FMAs.
+
+// ScalarSinCos on eight lanes
+SIMD_TARGET("avx2")
+inline void SinCosAvx2(__m256 value, __m256& sinValue, __m256& cosValue) {
+    const __m256 half = _mm256_blendv_ps(_mm256_set1_ps(-0.5f), _mm256_set1_ps(0.5f),
+        _mm256_cmp_ps(value, _mm256_setzero_ps(), _CMP_GE_OQ));
+    __m256 quotient = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(0.159154943f), value), half);
+    quotient = _mm256_cvtepi32_ps(_mm256_cvttps_epi32(quotient));
+    __m256 y = _mm256_sub_ps(value, _mm256_mul_ps(_mm256_set1_ps(6.283185307f), quotient));
+
+    const __m256 above = _mm256_cmp_ps(y, _mm256_set1_ps(1.570796327f), _CMP_GT_OQ);
+    const __m256 below = _mm256_cmp_ps(y, _mm256_set1_ps(-1.570796327f), _CMP_LT_OQ);
+    y = _mm256_blendv_ps(y, _mm256_sub_ps(_mm256_set1_ps(ScenePi), y), above);
+    y = _mm256_blendv_ps(y, _mm256_sub_ps(_mm256_set1_ps(-ScenePi), y), below);
+    const __m256 sign = _mm256_blendv_ps(_mm256_set1_ps(1.0f), _mm256_set1_ps(-1.0f), _mm256_or_ps(above, below));
+
+    const __m256 y2 = _mm256_mul_ps(y, y);
+    __m256 s = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(-2.3889859e-08f), y2), _mm256_set1_ps(2.7525562e-06f));
+    s = _mm256_sub_ps(_mm256_mul_ps(s, y2), _mm256_set1_ps(0.00019840874f));
+    s = _mm256_add_ps(_mm256_mul_ps(s, y2), _mm256_set1_ps(0.0083333310f));
+    s = _mm256_sub_ps(_mm256_mul_ps(s, y2), _mm256_set1_ps(0.16666667f));
+    sinValue = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(s, y2), _mm256_set1_ps(1.0f)), y);
+
+    __m256 c = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(-2.6051615e-07f), y2), _mm256_set1_ps(2.4760495e-05f));
+    c = _mm256_sub_ps(_mm256_mul_ps(c, y2), _mm256_set1_ps(0.0013888378f));
+    c = _mm256_add_ps(_mm256_mul_ps(c, y2), _mm256_set1_ps(0.041666638f));
+    c = _mm256_sub_ps(_mm256_mul_ps(c, y2), _mm256_set1_ps(0.5f));
+    cosValue = _mm256_mul_ps(sign, _mm256_add_ps(_mm256_mul_ps(c, y2), _mm256_set1_ps(1.0f)));
+}
+
+// rows[e] holds element e of eight objects; afterwards rows[k] holds elements 0..7 of object k
+SIMD_TARGET("avx2")
+inline void Transpose8x8Avx2(__m256 rows[8]) {
+    __m256 t[8], s[8];
+    for (int k = 0; k < 8; k += 2) {
+        t[k] = _mm256_unpacklo_ps(rows[k], rows[k + 1]);
+        t[k + 1] = _mm256_unpackhi_ps(rows[k], rows[k + 1]);
+    }
+    for (int k = 0; k < 8; k += 4) {
+        s[k] = _mm256_shuffle_ps(t[k], t[k + 2], 0x44);
+        s[k + 1] = _mm256_shuffle_ps(t[k], t[k + 2], 0xee);
+        s[k + 2] = _mm256_shuffle_ps(t[k + 1], t[k + 3], 0x44);
+        s[k + 3] = _mm256_shuffle_ps(t[k + 1], t[k + 3], 0xee);
+    }
+    for (int k = 0; k < 4; k++) {
+        rows[k] = _mm256_permute2f128_ps(s[k], s[k + 4], 0x20);
+        rows[k + 4] = _mm256_permute2f128_ps(s[k], s[k + 4], 0x31);
+    }
+}
+
+// ScalarSinCos on sixteen lanes
+SIMD_TARGET("avx512f")
+inline void SinCosAvx512(__m512 value, __m512& sinValue, __m512& cosValue) {
+    const __mmask16 positive = _mm512_cmp_ps_mask(value, _mm512_setzero_ps(), _CMP_GE_OQ);
+    const __m512 half = _mm512_mask_blend_ps(positive, _mm512_set1_ps(-0.5f), _mm512_set1_ps(0.5f));
+    __m512 quotient = _mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(0.159154943f), value), half);
+    quotient = _mm512_cvtepi32_ps(_mm512_cvttps_epi32(quotient));
+    __m512 y = _mm512_sub_ps(value, _mm512_mul_ps(_mm512_set1_ps(6.283185307f), quotient));
+
+    const __mmask16 above = _mm512_cmp_ps_mask(y, _mm512_set1_ps(1.570796327f), _CMP_GT_OQ);
+    const __mmask16 below = _mm512_cmp_ps_mask(y, _mm512_set1_ps(-1.570796327f), _CMP_LT_OQ);
+    y = _mm512_mask_blend_ps(above, y, _mm512_sub_ps(_mm512_set1_ps(ScenePi), y));
+    y = _mm512_mask_blend_ps(below, y, _mm512_sub_ps(_mm512_set1_ps(-ScenePi), y));
+    const __m512 sign = _mm512_mask_blend_ps(above | below, _mm512_set1_ps(1.0f), _mm512_set1_ps(-1.0f));
+
+    const __m512 y2 = _mm512_mul_ps(y, y);
+    __m512 s = _mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(-2.3889859e-08f), y2), _mm512_set1_ps(2.7525562e-06f));
+    s = _mm512_sub_ps(_mm512_mul_ps(s, y2), _mm512_set1_ps(0.00019840874f));
+    s = _mm512_add_ps(_mm512_mul_ps(s, y2), _mm512_set1_ps(0.0083333310f));
+    s = _mm512_sub_ps(_mm512_mul_ps(s, y2), _mm512_set1_ps(0.16666667f));
+    sinValue = _mm512_mul_ps(_mm512_add_ps(_mm512_mul_ps(s, y2), _mm512_set1_ps(1.0f)), y);
+
+    __m512 c = _mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(-2.6051615e-07f), y2), _mm512_set1_ps(2.4760495e-05f));
+    c = _mm512_sub_ps(_mm512_mul_ps(c, y2), _mm512_set1_ps(0.0013888378f));
+    c = _mm512_add_ps(_mm512_mul_ps(c, y2), _mm512_set1_ps(0.041666638f));
+    c = _mm512_sub_ps(_mm512_mul_ps(c, y2), _mm512_set1_ps(0.5f));
+    cosValue = _mm512_mul_ps(sign, _mm512_add_ps(_mm512_mul_ps(c, y2), _mm512_set1_ps(1.0f)));
+}
+#endif
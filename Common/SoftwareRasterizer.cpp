@@ -0,0 +1,727 @@
+#include "SoftwareRasterizer.h"
+#include "HiZBuffer.h"
+#include "TaskScheduler.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#if SIMD_X86
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+    // D3D rasterizes with 8 bits of sub-pixel precision
+    const int SubPixelBits = 8;
+    const int64_t SubPixelScale = 1 << SubPixelBits;
+    const int64_t HalfPixel = SubPixelScale / 2;
+
+    // Clip x and y against a band this many viewports wide so fixed-point coordinates stay small
+    const float GuardBand = 8.0f;
+
+    // Triangle fans can grow by one vertex per clip plane
+    const int MaxClipVertices = 3 + 6;
+
+    // `bits` must not be zero
+    inline int32_t CountTrailingZeros64(uint64_t bits) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+        unsigned long index;
+        _BitScanForward64(&index, bits);
+        return static_cast<int32_t>(index);
+#elif defined(_MSC_VER)
+        unsigned long index;
+        if (_BitScanForward(&index, static_cast<uint32_t>(bits))) {
+            return static_cast<int32_t>(index);
+        }
+        _BitScanForward(&index, static_cast<uint32_t>(bits >> 32));
+        return static_cast<int32_t>(index) + 32;
+#else
+        return __builtin_ctzll(bits);
+#endif
+    }
+
+    inline uint32_t PopCount(uint64_t bits) {
+        bits = bits - ((bits >> 1) & 0x5555555555555555ull);
+        bits = (bits & 0x3333333333333333ull) + ((bits >> 2) & 0x3333333333333333ull);
+        bits = (bits + (bits >> 4)) & 0x0f0f0f0f0f0f0f0full;
+        return static_cast<uint32_t>((bits * 0x0101010101010101ull) >> 56);
+    }
+
+    struct ScreenVertex {
+        int64_t x;
+        int64_t y;
+        float z;
+        float invW;
+        float varyings[MaxVaryings];
+    };
+
+    // Signed distance to each clip plane; inside when >= 0. Depth clipping keeps 0 <= z <= w.
+    float PlaneDistance(const ClipVertex& v, int plane) {
+        const Float4& p = v.position;
+        switch (plane) {
+        case 0: return p.z;
+        case 1: return p.w - p.z;
+        case 2: return GuardBand * p.w + p.x;
+        case 3: return GuardBand * p.w - p.x;
+        case 4: return GuardBand * p.w + p.y;
+        default: return GuardBand * p.w - p.y;
+        }
+    }
+
+    ClipVertex Lerp(const ClipVertex& a, const ClipVertex& b, float t, uint32_t varyingCount) {
+        ClipVertex v;
+        v.position.x = a.position.x + (b.position.x - a.position.x) * t;
+        v.position.y = a.position.y + (b.position.y - a.position.y) * t;
+        v.position.z = a.position.z + (b.position.z - a.position.z) * t;
+        v.position.w = a.position.w + (b.position.w - a.position.w) * t;
+        for (uint32_t i = 0; i < varyingCount; i++) {
+            v.varyings[i] = a.varyings[i] + (b.varyings[i] - a.varyings[i]) * t;
+        }
+        return v;
+    }
+
+    // Sutherland-Hodgman against every plane the polygon crosses. Returns the vertex count.
+    int ClipPolygon(ClipVertex* polygon, uint32_t varyingCount) {
+        ClipVertex scratch[MaxClipVertices];
+        int count = 3;
+
+        for (int plane = 0; plane < 6 && count > 0; plane++) {
+            int inCount = 0;
+            for (int i = 0; i < count; i++) {
+                inCount += PlaneDistance(polygon[i], plane) >= 0.0f;
+            }
+            if (inCount == count) {
+                continue;
+            }
+
+            int outCount = 0;
+            for (int i = 0; i < count; i++) {
+                const ClipVertex& a = polygon[i];
+                const ClipVertex& b = polygon[(i + 1) % count];
+                float da = PlaneDistance(a, plane);
+                float db = PlaneDistance(b, plane);
+                if (da >= 0.0f) {
+                    scratch[outCount++] = a;
+                }
+                if ((da >= 0.0f) != (db >= 0.0f)) {
+                    scratch[outCount++] = Lerp(a, b, da / (da - db), varyingCount);
+                }
+            }
+            std::memcpy(polygon, scratch, sizeof(ClipVertex) * outCount);
+            count = outCount;
+        }
+        return count;
+    }
+
+    ScreenVertex ToScreen(const ClipVertex& v, const Viewport& viewport, uint32_t varyingCount) {
+        ScreenVertex s;
+        s.invW = 1.0f / v.position.w;
+        float x = (v.position.x * s.invW * 0.5f + 0.5f) * viewport.width + viewport.topLeftX;
+        float y = (0.5f - v.position.y * s.invW * 0.5f) * viewport.height + viewport.topLeftY;
+        s.x = static_cast<int64_t>(std::lround(x * SubPixelScale));
+        s.y = static_cast<int64_t>(std::lround(y * SubPixelScale));
+        s.z = viewport.minDepth + v.position.z * s.invW * (viewport.maxDepth - viewport.minDepth);
+        for (uint32_t i = 0; i < varyingCount; i++) {
+            s.varyings[i] = v.varyings[i] * s.invW;
+        }
+        return s;
+    }
+
+    // Edge function of a -> b: positive on the inside of a clockwise (y down) triangle.
+    // Pixels exactly on an edge belong to it only if it is a top or left edge.
+    struct Edge {
+        int64_t stepX;
+        int64_t stepY;
+        int64_t value;      // At the first sample of the rectangle being walked
+        int64_t bias;       // 0 for top-left edges, -1 otherwise
+
+        void Setup(const ScreenVertex& a, const ScreenVertex& b, int64_t sampleX, int64_t sampleY) {
+            int64_t dx = b.x - a.x;
+            int64_t dy = b.y - a.y;
+            stepX = -dy * SubPixelScale;
+            stepY = dx * SubPixelScale;
+            value = dx * (sampleY - a.y) - dy * (sampleX - a.x);
+            bool topLeft = dy < 0 || (dy == 0 && dx > 0);
+            bias = topLeft ? 0 : -1;
+        }
+    };
+
+    // A clockwise screen-space triangle that survived culling, with its pixel bounding box
+    // already clamped to the scissor rectangle
+    struct SetupTriangle {
+        ScreenVertex v[3];
+        float invArea;
+        float minZ;             // Conservative: no covered pixel interpolates a smaller depth
+        int32_t minX, minY, maxX, maxY;
+    };
+
+    struct PixelRect {
+        int32_t minX, minY, maxX, maxY;     // Inclusive
+    };
+
+    // Culls and orients one screen-space triangle. Returns false if it covers no pixel centers' box.
+    bool SetupTriangleBounds(const RasterPipeline& pipeline, const PixelRect& scissor,
+        const ScreenVertex& v0, const ScreenVertex& v1, const ScreenVertex& v2, SetupTriangle& out) {
+        int64_t area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+        if (area == 0) {
+            return false;
+        }
+
+        // With y pointing down a positive area is clockwise on screen
+        bool clockwise = area > 0;
+        bool frontFacing = pipeline.rasterizer.frontCounterClockwise ? !clockwise : clockwise;
+        if ((pipeline.rasterizer.cullMode == CullMode::Back && !frontFacing) ||
+            (pipeline.rasterizer.cullMode == CullMode::Front && frontFacing)) {
+            return false;
+        }
+
+        out.v[0] = v0;
+        out.v[1] = clockwise ? v1 : v2;
+        out.v[2] = clockwise ? v2 : v1;
+        out.invArea = 1.0f / static_cast<float>(clockwise ? area : -area);
+        // The interpolated depth can round a few ULPs below the smallest vertex depth
+        float minZ = std::min({ v0.z, v1.z, v2.z });
+        out.minZ = minZ - std::fabs(minZ) * 1e-6f;
+
+        // Pixel centers are at +0.5
+        int64_t minX = (std::min({ v0.x, v1.x, v2.x }) - HalfPixel + SubPixelScale - 1) >> SubPixelBits;
+        int64_t minY = (std::min({ v0.y, v1.y, v2.y }) - HalfPixel + SubPixelScale - 1) >> SubPixelBits;
+        int64_t maxX = (std::max({ v0.x, v1.x, v2.x }) - HalfPixel) >> SubPixelBits;
+        int64_t maxY = (std::max({ v0.y, v1.y, v2.y }) - HalfPixel) >> SubPixelBits;
+        out.minX = static_cast<int32_t>(std::max<int64_t>(scissor.minX, minX));
+        out.minY = static_cast<int32_t>(std::max<int64_t>(scissor.minY, minY));
+        out.maxX = static_cast<int32_t>(std::min<int64_t>(scissor.maxX, maxX));
+        out.maxY = static_cast<int32_t>(std::min<int64_t>(scissor.maxY, maxY));
+        return out.minX <= out.maxX && out.minY <= out.maxY;
+    }
+
+    // The scissor rectangle is the viewport, clamped to the render target
+    PixelRect ScissorRect(const Viewport& viewport, const CpuImage& target) {
+        PixelRect rect;
+        rect.minX = std::max(0, static_cast<int32_t>(std::ceil(viewport.topLeftX)));
+        rect.minY = std::max(0, static_cast<int32_t>(std::ceil(viewport.topLeftY)));
+        rect.maxX = std::min(static_cast<int32_t>(target.width), static_cast<int32_t>(viewport.topLeftX + viewport.width)) - 1;
+        rect.maxY = std::min(static_cast<int32_t>(target.height), static_cast<int32_t>(viewport.topLeftY + viewport.height)) - 1;
+        return rect;
+    }
+
+    // Vertex fetch, trivial reject, clipping, projection and setup of one input triangle.
+    // Appends up to MaxClipVertices - 2 triangles and returns how many were appended.
+    template <typename Index>
+    int SetupInputTriangle(const RasterPipeline& pipeline, const PixelRect& scissor, const ClipVertex* vertices,
+        const Index* indices, SetupTriangle* out) {
+        const uint32_t varyingCount = pipeline.varyingCount;
+        ClipVertex polygon[MaxClipVertices] = { vertices[indices[0]], vertices[indices[1]], vertices[indices[2]] };
+
+        // Everything outside one plane is dropped here, everything inside all planes skips clipping
+        for (int plane = 0; plane < 6; plane++) {
+            if (PlaneDistance(polygon[0], plane) < 0.0f && PlaneDistance(polygon[1], plane) < 0.0f &&
+                PlaneDistance(polygon[2], plane) < 0.0f) {
+                return 0;
+            }
+        }
+
+        int count = ClipPolygon(polygon, varyingCount);
+        ScreenVertex screen[MaxClipVertices];
+        for (int v = 0; v < count; v++) {
+            screen[v] = ToScreen(polygon[v], pipeline.viewport, varyingCount);
+        }
+
+        int produced = 0;
+        for (int v = 1; v + 1 < count; v++) {
+            produced += SetupTriangleBounds(pipeline, scissor, screen[0], screen[v], screen[v + 1], out[produced]);
+        }
+        return produced;
+    }
+
+    // Perspective-correct varyings at barycentric coordinates b0, b1 and b2
+    inline void InterpolateVaryings(const SetupTriangle& triangle, uint32_t varyingCount, float b0, float b1, float b2,
+        float* varyings) {
+        const ScreenVertex& v0 = triangle.v[0];
+        const ScreenVertex& v1 = triangle.v[1];
+        const ScreenVertex& v2 = triangle.v[2];
+        float q0 = b0 * v0.invW, q1 = b1 * v1.invW, q2 = b2 * v2.invW;
+        float invSum = 1.0f / (q0 + q1 + q2);
+        for (uint32_t i = 0; i < varyingCount; i++) {
+            varyings[i] = (b0 * v0.varyings[i] + b1 * v1.varyings[i] + b2 * v2.varyings[i]) * invSum;
+        }
+    }
+
+    // Coarse ddx and ddy: every pixel of a 2x2 quad gets the differences along the quad's top
+    // row and left column. Like helper pixels, quad pixels outside the triangle are extrapolated.
+    void QuadDerivatives(const SetupTriangle& triangle, uint32_t varyingCount, int32_t x, int32_t y,
+        int64_t w0, int64_t w1, int64_t w2, PixelInput& input) {
+        const ScreenVertex* v = triangle.v;
+        const int64_t stepX[3] = { (v[1].y - v[2].y) * SubPixelScale, (v[2].y - v[0].y) * SubPixelScale,
+            (v[0].y - v[1].y) * SubPixelScale };
+        const int64_t stepY[3] = { (v[2].x - v[1].x) * SubPixelScale, (v[0].x - v[2].x) * SubPixelScale,
+            (v[1].x - v[0].x) * SubPixelScale };
+        const int64_t w[3] = { w0, w1, w2 };
+
+        // Edge functions at the quad's top-left pixel
+        float origin[3], right[3], below[3];
+        for (int e = 0; e < 3; e++) {
+            int64_t value = w[e] - (x & 1) * stepX[e] - (y & 1) * stepY[e];
+            origin[e] = static_cast<float>(value) * triangle.invArea;
+            right[e] = static_cast<float>(value + stepX[e]) * triangle.invArea;
+            below[e] = static_cast<float>(value + stepY[e]) * triangle.invArea;
+        }
+        float atOrigin[MaxVaryings], atRight[MaxVaryings], atBelow[MaxVaryings];
+        InterpolateVaryings(triangle, varyingCount, origin[0], origin[1], origin[2], atOrigin);
+        InterpolateVaryings(triangle, varyingCount, right[0], right[1], right[2], atRight);
+        InterpolateVaryings(triangle, varyingCount, below[0], below[1], below[2], atBelow);
+        for (uint32_t i = 0; i < varyingCount; i++) {
+            input.ddx[i] = atRight[i] - atOrigin[i];
+            input.ddy[i] = atBelow[i] - atOrigin[i];
+        }
+    }
+
+    // Early depth test LESS, perspective-correct interpolation and the pixel shader for one
+    // covered pixel whose edge functions are w0, w1 and w2. Returns whether depth was written.
+    inline bool ShadePixel(const RasterPipeline& pipeline, const SetupTriangle& triangle, int32_t x, int32_t y,
+        int64_t w0, int64_t w1, int64_t w2, float* depthRow, uint8_t* colorRow) {
+        const ScreenVertex& v0 = triangle.v[0];
+        const ScreenVertex& v1 = triangle.v[1];
+        const ScreenVertex& v2 = triangle.v[2];
+        float b0 = static_cast<float>(w0) * triangle.invArea;
+        float b1 = static_cast<float>(w1) * triangle.invArea;
+        float b2 = static_cast<float>(w2) * triangle.invArea;
+
+        // Depth is linear in screen space
+        float z = b0 * v0.z + b1 * v1.z + b2 * v2.z;
+        if (!(z < depthRow[x])) {
+            return false;
+        }
+        depthRow[x] = z;
+
+        PixelInput input;
+        InterpolateVaryings(triangle, pipeline.varyingCount, b0, b1, b2, input.varyings);
+        if (pipeline.quadDerivatives) {
+            QuadDerivatives(triangle, pipeline.varyingCount, x, y, w0, w1, w2, input);
+        }
+        input.x = static_cast<uint32_t>(x);
+        input.y = static_cast<uint32_t>(y);
+        input.depth = z;
+
+        float rgba[4];
+        pipeline.pixelShader(input, rgba);
+        uint32_t packed = PackUnorm8(rgba);
+        std::memcpy(colorRow + x * 4, &packed, sizeof(packed));
+        return true;
+    }
+
+    // Rasterizes the part of a set-up triangle inside `rect`, one pixel at a time
+    void RasterizeTriangle(const RasterPipeline& pipeline, const SetupTriangle& triangle, const PixelRect& rect,
+        CpuImage& target, DepthBuffer& depth) {
+        const int32_t minX = std::max(triangle.minX, rect.minX);
+        const int32_t minY = std::max(triangle.minY, rect.minY);
+        const int32_t maxX = std::min(triangle.maxX, rect.maxX);
+        const int32_t maxY = std::min(triangle.maxY, rect.maxY);
+        if (minX > maxX || minY > maxY) {
+            return;
+        }
+
+        int64_t sampleX = static_cast<int64_t>(minX) * SubPixelScale + HalfPixel;
+        int64_t sampleY = static_cast<int64_t>(minY) * SubPixelScale + HalfPixel;
+        Edge e0, e1, e2;
+        e0.Setup(triangle.v[1], triangle.v[2], sampleX, sampleY);
+        e1.Setup(triangle.v[2], triangle.v[0], sampleX, sampleY);
+        e2.Setup(triangle.v[0], triangle.v[1], sampleX, sampleY);
+
+        for (int32_t y = minY; y <= maxY; y++) {
+            int64_t w0 = e0.value, w1 = e1.value, w2 = e2.value;
+            float* depthRow = depth.Row(static_cast<uint32_t>(y));
+            uint8_t* colorRow = target.Row(static_cast<uint32_t>(y));
+
+            for (int32_t x = minX; x <= maxX; x++) {
+                if ((w0 + e0.bias) >= 0 && (w1 + e1.bias) >= 0 && (w2 + e2.bias) >= 0) {
+                    ShadePixel(pipeline, triangle, x, y, w0, w1, w2, depthRow, colorRow);
+                }
+                w0 += e0.stepX;
+                w1 += e1.stepX;
+                w2 += e2.stepX;
+            }
+            e0.value += e0.stepY;
+            e1.value += e1.stepY;
+            e2.value += e2.stepY;
+        }
+    }
+
+    // Edges that cross one 8x8 block, with the fill-rule bias folded into each value
+    struct BlockEdges {
+        int count;
+        int64_t value[3];       // At the block's first sample
+        int64_t stepX[3];
+        int64_t stepY[3];
+    };
+
+    // Coverage of `candidates` (bit y * 8 + x) by an 8x8 block: a pixel is kept where
+    // value + x * stepX + y * stepY >= 0 for every edge
+    using BlockCoverage = uint64_t (*)(const BlockEdges& edges, uint64_t candidates);
+
+    // Only visits the candidate pixels, which are few for small triangles
+    uint64_t BlockCoverageScalar(const BlockEdges& edges, uint64_t candidates) {
+        uint64_t mask = candidates;
+        for (uint64_t bits = candidates; bits; bits &= bits - 1) {
+            int32_t bit = CountTrailingZeros64(bits);
+            int64_t x = bit & 7, y = bit >> 3;
+            for (int e = 0; e < edges.count; e++) {
+                if (edges.value[e] + x * edges.stepX[e] + y * edges.stepY[e] < 0) {
+                    mask &= ~(1ull << bit);
+                    break;
+                }
+            }
+        }
+        return mask;
+    }
+
+#if SIMD_X86
+    // The vector kernels work in 32 bits. Callers only pass edges whose values over the block
+    // fit, which holds for any edge shorter than about 4000 pixels; blocks crossed by longer
+    // ones (guard-band clipped triangles) use the scalar kernel.
+    SIMD_TARGET("avx2")
+    uint64_t BlockCoverageAvx2(const BlockEdges& edges, uint64_t candidates) {
+        const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        __m256i row[3], stepY[3];
+        for (int e = 0; e < edges.count; e++) {
+            row[e] = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int32_t>(edges.value[e])),
+                _mm256_mullo_epi32(lanes, _mm256_set1_epi32(static_cast<int32_t>(edges.stepX[e]))));
+            stepY[e] = _mm256_set1_epi32(static_cast<int32_t>(edges.stepY[e]));
+        }
+
+        // Sign bits of the OR are set where any edge is negative
+        uint64_t outside = 0;
+        for (int y = 0; y < 8; y++) {
+            __m256i negative = row[0];
+            row[0] = _mm256_add_epi32(row[0], stepY[0]);
+            for (int e = 1; e < edges.count; e++) {
+                negative = _mm256_or_si256(negative, row[e]);
+                row[e] = _mm256_add_epi32(row[e], stepY[e]);
+            }
+            outside |= static_cast<uint64_t>(_mm256_movemask_ps(_mm256_castsi256_ps(negative))) << (y * 8);
+        }
+        return candidates & ~outside;
+    }
+
+    // Two block rows per vector
+    SIMD_TARGET("avx512f")
+    uint64_t BlockCoverageAvx512(const BlockEdges& edges, uint64_t candidates) {
+        const __m512i lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 0, 1, 2, 3, 4, 5, 6, 7);
+        const __m512i rows = _mm512_setr_epi32(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1);
+        __m512i pair[3], stepY[3];
+        for (int e = 0; e < edges.count; e++) {
+            pair[e] = _mm512_add_epi32(_mm512_set1_epi32(static_cast<int32_t>(edges.value[e])),
+                _mm512_add_epi32(_mm512_mullo_epi32(lanes, _mm512_set1_epi32(static_cast<int32_t>(edges.stepX[e]))),
+                    _mm512_mullo_epi32(rows, _mm512_set1_epi32(static_cast<int32_t>(edges.stepY[e])))));
+            stepY[e] = _mm512_set1_epi32(static_cast<int32_t>(edges.stepY[e] * 2));
+        }
+
+        uint64_t outside = 0;
+        for (int y = 0; y < 8; y += 2) {
+            __m512i negative = pair[0];
+            pair[0] = _mm512_add_epi32(pair[0], stepY[0]);
+            for (int e = 1; e < edges.count; e++) {
+                negative = _mm512_or_si512(negative, pair[e]);
+                pair[e] = _mm512_add_epi32(pair[e], stepY[e]);
+            }
+            outside |= static_cast<uint64_t>(_mm512_cmplt_epi32_mask(negative, _mm512_setzero_si512())) << (y * 8);
+        }
+        return candidates & ~outside;
+    }
+#endif
+
+    BlockCoverage GetBlockCoverage(SimdIsa isa) {
+#if SIMD_X86
+        switch (isa) {
+        case SimdIsa::AVX2: return BlockCoverageAvx2;
+        case SimdIsa::AVX512: return BlockCoverageAvx512;
+        default: break;
+        }
+#else
+        (void)isa;
+#endif
+        return BlockCoverageScalar;
+    }
+
+    struct TileCounters {
+        uint64_t pixelsCovered = 0;
+        uint64_t trianglesOccluded = 0;
+        uint64_t blocksOccluded = 0;
+        bool hiZChanged = false;    // Some block of the tile needs its tile level refreshed
+    };
+
+    // Bits of the columns [first, last] in every row of a block
+    uint64_t BlockColumnMask(int32_t first, int32_t last) {
+        uint64_t row = ((1ull << (last - first + 1)) - 1) << first;
+        return row * 0x0101010101010101ull;
+    }
+
+    uint64_t BlockRowMask(int32_t first, int32_t last) {
+        int32_t rows = last - first + 1;
+        return (rows == 8 ? ~0ull : (1ull << (rows * 8)) - 1) << (first * 8);
+    }
+
+    // Rasterizes the part of a set-up triangle inside `rect` in 8x8 blocks. Each edge first
+    // tests the block corner where it is largest (all outside: reject the block) and the one
+    // where it is smallest (all inside: the edge needs no per-pixel test); only edges that
+    // cross the block are evaluated per pixel by `coverage`. Covers exactly the pixels of
+    // RasterizeTriangle. With a Hi-Z buffer, blocks the triangle cannot win the depth test in
+    // are skipped before coverage, and blocks whose depth changed are updated in it.
+    void RasterizeTriangleBlocks(const RasterPipeline& pipeline, const SetupTriangle& triangle,
+        const PixelRect& rect, BlockCoverage coverage, HiZBuffer* hiZ, TileCounters& counters,
+        CpuImage& target, DepthBuffer& depth) {
+        const int32_t minX = std::max(triangle.minX, rect.minX);
+        const int32_t minY = std::max(triangle.minY, rect.minY);
+        const int32_t maxX = std::min(triangle.maxX, rect.maxX);
+        const int32_t maxY = std::min(triangle.maxY, rect.maxY);
+        if (minX > maxX || minY > maxY) {
+            return;
+        }
+
+        const int32_t blockMinX = minX & ~7, blockMinY = minY & ~7;
+        int64_t sampleX = static_cast<int64_t>(blockMinX) * SubPixelScale + HalfPixel;
+        int64_t sampleY = static_cast<int64_t>(blockMinY) * SubPixelScale + HalfPixel;
+        Edge edges[3];
+        edges[0].Setup(triangle.v[1], triangle.v[2], sampleX, sampleY);
+        edges[1].Setup(triangle.v[2], triangle.v[0], sampleX, sampleY);
+        edges[2].Setup(triangle.v[0], triangle.v[1], sampleX, sampleY);
+
+        // Offsets from a block's first sample to its smallest and largest value per edge
+        int64_t lowOffset[3], highOffset[3];
+        bool narrow = true;
+        for (int e = 0; e < 3; e++) {
+            lowOffset[e] = 7 * (std::min<int64_t>(edges[e].stepX, 0) + std::min<int64_t>(edges[e].stepY, 0));
+            highOffset[e] = 7 * (std::max<int64_t>(edges[e].stepX, 0) + std::max<int64_t>(edges[e].stepY, 0));
+            narrow = narrow && highOffset[e] - lowOffset[e] <= INT32_MAX;
+        }
+        // A crossing edge is within its low to high range of zero everywhere in the block
+        const BlockCoverage blockCoverage = narrow ? coverage : BlockCoverageScalar;
+
+        int64_t rowValue[3] = { edges[0].value + edges[0].bias, edges[1].value + edges[1].bias, edges[2].value + edges[2].bias };
+        for (int32_t blockY = blockMinY; blockY <= maxY; blockY += 8) {
+            const uint64_t rowMask = BlockRowMask(std::max(minY, blockY) - blockY, std::min(maxY, blockY + 7) - blockY);
+            int64_t value[3] = { rowValue[0], rowValue[1], rowValue[2] };
+
+            for (int32_t blockX = blockMinX; blockX <= maxX; blockX += 8) {
+                uint64_t mask = rowMask & BlockColumnMask(std::max(minX, blockX) - blockX, std::min(maxX, blockX + 7) - blockX);
+                BlockEdges crossing;
+                crossing.count = 0;
+                for (int e = 0; e < 3; e++) {
+                    if (value[e] + highOffset[e] < 0) {
+                        mask = 0;
+                        break;
+                    }
+                    if (value[e] + lowOffset[e] < 0) {
+                        crossing.value[crossing.count] = value[e];
+                        crossing.stepX[crossing.count] = edges[e].stepX;
+                        crossing.stepY[crossing.count] = edges[e].stepY;
+                        crossing.count++;
+                    }
+                }
+                if (mask && hiZ && triangle.minZ >= hiZ->BlockMax(blockX / 8, blockY / 8)) {
+                    mask = 0;
+                    counters.blocksOccluded++;
+                }
+                if (mask && crossing.count) {
+                    mask = blockCoverage(crossing, mask);
+                }
+
+                // Shading walks the covered pixels; the edge values drop the bias again
+                bool written = false;
+                for (uint64_t bits = mask; bits; ) {
+                    const int32_t y = CountTrailingZeros64(bits) >> 3;
+                    uint32_t rowBits = static_cast<uint32_t>(bits >> (y * 8)) & 0xff;
+                    bits &= ~(0xffull << (y * 8));
+
+                    const int32_t pixelY = blockY + y;
+                    float* depthRow = depth.Row(static_cast<uint32_t>(pixelY));
+                    uint8_t* colorRow = target.Row(static_cast<uint32_t>(pixelY));
+                    int64_t w[3];
+                    for (int e = 0; e < 3; e++) {
+                        w[e] = value[e] - edges[e].bias + y * edges[e].stepY;
+                    }
+                    for (; rowBits; rowBits &= rowBits - 1) {
+                        int32_t x = CountTrailingZeros64(rowBits);
+                        written |= ShadePixel(pipeline, triangle, blockX + x, pixelY, w[0] + x * edges[0].stepX,
+                            w[1] + x * edges[1].stepX, w[2] + x * edges[2].stepX, depthRow, colorRow);
+                    }
+                }
+                counters.pixelsCovered += PopCount(mask);
+                if (written && hiZ) {
+                    hiZ->UpdateBlock(depth, blockX / 8, blockY / 8);
+                    counters.hiZChanged = true;
+                }
+
+                for (int e = 0; e < 3; e++) {
+                    value[e] += 8 * edges[e].stepX;
+                }
+            }
+            for (int e = 0; e < 3; e++) {
+                rowValue[e] += 8 * edges[e].stepY;
+            }
+        }
+    }
+
+    template <typename Index>
+    void DrawSerial(const RasterPipeline& pipeline, const ClipVertex* vertices, const Index* indices,
+        uint32_t indexCount, CpuImage& target, DepthBuffer& depth) {
+        const PixelRect scissor = ScissorRect(pipeline.viewport, target);
+        SetupTriangle triangles[MaxClipVertices - 2];
+        for (uint32_t i = 0; i + 2 < indexCount; i += 3) {
+            int count = SetupInputTriangle(pipeline, scissor, vertices, indices + i, triangles);
+            for (int t = 0; t < count; t++) {
+                RasterizeTriangle(pipeline, triangles[t], scissor, target, depth);
+            }
+        }
+    }
+}
+
+void DrawIndexed(const RasterPipeline& pipeline, const ClipVertex* vertices, const uint16_t* indices,
+    uint32_t indexCount, CpuImage& target, DepthBuffer& depth) {
+    DrawSerial(pipeline, vertices, indices, indexCount, target, depth);
+}
+
+void DrawIndexed(const RasterPipeline& pipeline, const ClipVertex* vertices, const uint32_t* indices,
+    uint32_t indexCount, CpuImage& target, DepthBuffer& depth) {
+    DrawSerial(pipeline, vertices, indices, indexCount, target, depth);
+}
+
+static_assert(HiZBuffer::TileSize == TiledRasterizer::TileSize, "Hi-Z tiles must be rasterizer tiles");
+
+struct TiledRasterizer::Chunk {
+    std::vector<SetupTriangle> triangles;
+    std::vector<std::vector<uint32_t>> bins;    // Per tile: indices into triangles, in submission order
+    uint64_t submitted = 0;
+    uint64_t binEntries = 0;
+};
+
+struct TiledRasterizer::Tile {
+    TileCounters counters;
+};
+
+TiledRasterizer::TiledRasterizer(TaskScheduler& scheduler, SimdIsa isa)
+    : scheduler(scheduler), isa(isa) {
+}
+
+TiledRasterizer::~TiledRasterizer() = default;
+
+void TiledRasterizer::DrawIndexed(const RasterPipeline& pipeline, const ClipVertex* vertices, const uint16_t* indices,
+    uint32_t indexCount, CpuImage& target, DepthBuffer& depth) {
+    Draw(pipeline, vertices, indices, indexCount, target, depth);
+}
+
+void TiledRasterizer::DrawIndexed(const RasterPipeline& pipeline, const ClipVertex* vertices, const uint32_t* indices,
+    uint32_t indexCount, CpuImage& target, DepthBuffer& depth) {
+    Draw(pipeline, vertices, indices, indexCount, target, depth);
+}
+
+template <typename Index>
+void TiledRasterizer::Draw(const RasterPipeline& pipeline, const ClipVertex* vertices, const Index* indices,
+    uint32_t indexCount, CpuImage& target, DepthBuffer& depth) {
+    const PixelRect scissor = ScissorRect(pipeline.viewport, target);
+    const uint32_t tilesX = (target.width + TileSize - 1) / TileSize;
+    const uint32_t tilesY = (target.height + TileSize - 1) / TileSize;
+    const uint32_t tileCount = tilesX * tilesY;
+    const uint32_t triangleCount = indexCount / 3;
+    const uint32_t chunkCount = (triangleCount + ChunkTriangles - 1) / ChunkTriangles;
+    if (chunks.size() < chunkCount) {
+        chunks.resize(chunkCount);
+    }
+    if (hiZ && (hiZ->Width() != target.width || hiZ->Height() != target.height)) {
+        throw std::runtime_error("Hi-Z buffer size does not match the render target");
+    }
+    if (tiles.size() < tileCount) {
+        tiles.resize(tileCount);
+    }
+    for (uint32_t tile = 0; tile < tileCount; tile++) {
+        tiles[tile].counters = TileCounters();
+    }
+    const BlockCoverage coverage = GetBlockCoverage(isa);
+
+    // Front end: setup and binning, one chunk of input triangles per task
+    scheduler.ParallelFor(chunkCount, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t c = begin; c < end; c++) {
+            Chunk& chunk = chunks[c];
+            chunk.bins.resize(tileCount);
+            for (auto& bin : chunk.bins) {
+                bin.clear();
+            }
+
+            const uint32_t first = c * ChunkTriangles;
+            const uint32_t last = std::min(triangleCount, first + ChunkTriangles);
+            chunk.triangles.clear();
+            chunk.submitted = last - first;
+            chunk.binEntries = 0;
+
+            SetupTriangle setup[MaxClipVertices - 2];
+            for (uint32_t t = first; t < last; t++) {
+                int count = SetupInputTriangle(pipeline, scissor, vertices, indices + t * 3, setup);
+                for (int i = 0; i < count; i++) {
+                    const SetupTriangle& triangle = setup[i];
+                    const uint32_t index = static_cast<uint32_t>(chunk.triangles.size());
+                    uint32_t tileMinX = static_cast<uint32_t>(triangle.minX) / TileSize;
+                    uint32_t tileMinY = static_cast<uint32_t>(triangle.minY) / TileSize;
+                    uint32_t tileMaxX = static_cast<uint32_t>(triangle.maxX) / TileSize;
+                    uint32_t tileMaxY = static_cast<uint32_t>(triangle.maxY) / TileSize;
+                    for (uint32_t ty = tileMinY; ty <= tileMaxY; ty++) {
+                        for (uint32_t tx = tileMinX; tx <= tileMaxX; tx++) {
+                            chunk.bins[ty * tilesX + tx].push_back(index);
+                        }
+                    }
+                    chunk.binEntries += (tileMaxX - tileMinX + 1) * (tileMaxY - tileMinY + 1);
+                    chunk.triangles.push_back(triangle);
+                }
+            }
+        }
+    });
+
+    stats = RasterStats();
+    for (uint32_t c = 0; c < chunkCount; c++) {
+        stats.trianglesSubmitted += chunks[c].submitted;
+        stats.trianglesRasterized += chunks[c].triangles.size();
+        stats.binEntries += chunks[c].binEntries;
+    }
+
+    // Back end: each tile owns its pixels, so tiles need no synchronization
+    scheduler.ParallelFor(tileCount, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t tile = begin; tile < end; tile++) {
+            PixelRect rect;
+            rect.minX = static_cast<int32_t>((tile % tilesX) * TileSize);
+            rect.minY = static_cast<int32_t>((tile / tilesX) * TileSize);
+            rect.maxX = std::min(rect.minX + static_cast<int32_t>(TileSize), static_cast<int32_t>(target.width)) - 1;
+            rect.maxY = std::min(rect.minY + static_cast<int32_t>(TileSize), static_cast<int32_t>(target.height)) - 1;
+
+            TileCounters& counters = tiles[tile].counters;
+            for (uint32_t c = 0; c < chunkCount; c++) {
+                const Chunk& chunk = chunks[c];
+                for (uint32_t index : chunk.bins[tile]) {
+                    const SetupTriangle& triangle = chunk.triangles[index];
+                    if (hiZ) {
+                        PixelRect area = { std::max(triangle.minX, rect.minX), std::max(triangle.minY, rect.minY),
+                            std::min(triangle.maxX, rect.maxX), std::min(triangle.maxY, rect.maxY) };
+                        if (hiZ->IsOccluded(area.minX, area.minY, area.maxX, area.maxY, triangle.minZ)) {
+                            counters.trianglesOccluded++;
+                            continue;
+                        }
+                    }
+                    RasterizeTriangleBlocks(pipeline, triangle, rect, coverage, hiZ, counters, target, depth);
+                    if (counters.hiZChanged) {
+                        hiZ->UpdateTile(tile % tilesX, tile / tilesX);
+                        counters.hiZChanged = false;
+                    }
+                }
+            }
+        }
+    });
+
+    for (uint32_t tile = 0; tile < tileCount; tile++) {
+        const TileCounters& counters = tiles[tile].counters;
+        stats.pixelsCovered += counters.pixelsCovered;
+        stats.trianglesOccluded += counters.trianglesOccluded;
+        stats.blocksOccluded += counters.blocksOccluded;
+    }
+}
@@ -0,0 +1,148 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "CpuImage.h"
+#include "SceneMath.h"
+#include "SimdIsa.h"
+
+class HiZBuffer;
+class TaskScheduler;
+
+// CPU stand-in for the fixed-function part of the cube pipelines: clipping, viewport
+// transform, culling, rasterization with the D3D fill rules, D32_FLOAT depth test LESS and
+// an R8G8B8A8_UNORM render target with blending disabled.
+
+// Attributes that follow SV_POSITION out of the vertex shader (COLOR, TEXCOORD, ...)
+const uint32_t MaxVaryings = 4;
+
+struct ClipVertex {
+    Float4 position;                // SV_POSITION before the divide by w
+    float varyings[MaxVaryings];
+};
+
+// DXGI_FORMAT_D32_FLOAT
+struct DepthBuffer {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<float> depth;
+
+    void Resize(uint32_t w, uint32_t h) {
+        width = w;
+        height = h;
+        depth.assign(static_cast<size_t>(w) * h, 1.0f);
+    }
+
+    // ClearDepthStencilView(D3D12_CLEAR_FLAG_DEPTH, value)
+    void Clear(float value) { depth.assign(depth.size(), value); }
+
+    float* Row(uint32_t y) { return depth.data() + static_cast<size_t>(y) * width; }
+};
+
+enum class CullMode {
+    None,
+    Front,
+    Back,
+};
+
+// Defaults match CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT)
+struct RasterizerState {
+    CullMode cullMode = CullMode::Back;
+    bool frontCounterClockwise = false;
+};
+
+struct Viewport {
+    float topLeftX = 0.0f;
+    float topLeftY = 0.0f;
+    float width = 0.0f;
+    float height = 0.0f;
+    float minDepth = 0.0f;
+    float maxDepth = 1.0f;
+};
+
+// What the pixel shader sees for one covered pixel
+struct PixelInput {
+    uint32_t x;
+    uint32_t y;
+    float depth;
+    float varyings[MaxVaryings];    // Perspective-correct
+    float ddx[MaxVaryings];         // Coarse derivatives across the pixel's 2x2 quad, only
+    float ddy[MaxVaryings];         // filled if RasterPipeline::quadDerivatives is set
+};
+
+using PixelShader = std::function<void(const PixelInput& input, float rgba[4])>;
+
+struct RasterPipeline {
+    RasterizerState rasterizer;
+    Viewport viewport;              // The scissor rectangle is the viewport
+    uint32_t varyingCount = 0;
+    bool quadDerivatives = false;   // The pixel shader uses ddx/ddy, e.g. through Texture2D.Sample
+    PixelShader pixelShader;
+};
+
+// DrawIndexedInstanced(indexCount, 1, 0, 0, 0) of a triangle list whose vertices have
+// already been through the vertex shader. Single-threaded reference implementation.
+void DrawIndexed(const RasterPipeline& pipeline, const ClipVertex* vertices, const uint16_t* indices,
+    uint32_t indexCount, CpuImage& target, DepthBuffer& depth);
+void DrawIndexed(const RasterPipeline& pipeline, const ClipVertex* vertices, const uint32_t* indices,
+    uint32_t indexCount, CpuImage& target, DepthBuffer& depth);
+
+struct RasterStats {
+    uint64_t trianglesSubmitted = 0;
+    uint64_t trianglesRasterized = 0;   // After clipping, culling and empty-coverage rejection
+    uint64_t binEntries = 0;            // Triangle-tile pairs
+    uint64_t pixelsCovered = 0;         // Before the depth test
+    uint64_t trianglesOccluded = 0;     // Triangle-tile pairs rejected by the Hi-Z buffer
+    uint64_t blocksOccluded = 0;        // 8x8 blocks rejected by the Hi-Z buffer
+};
+
+// Sort-middle rasterizer producing the same pixels as DrawIndexed.
+// Triangles are set up in parallel in fixed-size chunks, each chunk bins its triangles into
+// TileSize x TileSize screen tiles, and tiles are then rasterized in parallel. A tile walks
+// the chunks in submission order, so depth ties resolve exactly as in the serial path.
+// Bins, setup buffers and per-tile counters are kept between draws; nothing is allocated
+// once they have grown.
+// Within a tile, coverage is computed per 8x8 block with trivial accept/reject and, for
+// blocks an edge crosses, one edge-function vector per block row (AVX2) or two (AVX-512).
+class TiledRasterizer {
+public:
+    static const uint32_t TileSize = 64;
+    static const uint32_t ChunkTriangles = 2048;
+
+    // SimdIsa::Scalar and SSE42 evaluate the block masks with scalar code
+    explicit TiledRasterizer(TaskScheduler& scheduler, SimdIsa isa = DetectSimdIsa());
+    ~TiledRasterizer();
+
+    TiledRasterizer(const TiledRasterizer&) = delete;
+    TiledRasterizer& operator=(const TiledRasterizer&) = delete;
+
+    void DrawIndexed(const RasterPipeline& pipeline, const ClipVertex* vertices, const uint16_t* indices,
+        uint32_t indexCount, CpuImage& target, DepthBuffer& depth);
+    void DrawIndexed(const RasterPipeline& pipeline, const ClipVertex* vertices, const uint32_t* indices,
+        uint32_t indexCount, CpuImage& target, DepthBuffer& depth);
+
+    SimdIsa Isa() const { return isa; }
+
+    // Optional Hi-Z buffer of the depth buffer passed to DrawIndexed, or null. Triangles are
+    // then rejected per tile and per 8x8 block before any per-pixel work, and the buffer is
+    // updated as blocks are written. The caller clears it together with the depth buffer.
+    void SetHiZ(HiZBuffer* buffer) { hiZ = buffer; }
+
+    // Counters of the most recent draw
+    const RasterStats& Stats() const { return stats; }
+
+private:
+    struct Chunk;
+    struct Tile;
+
+    template <typename Index>
+    void Draw(const RasterPipeline& pipeline, const ClipVertex* vertices, const Index* indices,
+        uint32_t indexCount, CpuImage& target, DepthBuffer& depth);
+
+    TaskScheduler& scheduler;
+    SimdIsa isa;
+    std::vector<Chunk> chunks;
+    std::vector<Tile> tiles;
+    HiZBuffer* hiZ = nullptr;
+    RasterStats stats;
+};
@@ -0,0 +1,181 @@
+#include "SubresourceUpload.h"
+#include "MipGenerator.h"
+#include "TaskScheduler.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+    // Rows shorter than this are not worth lining up for streaming stores
+    const uint32_t StreamingRowBytes = 256;
+
+    // Staging bytes per unit of work when a copy is spread over threads
+    const uint64_t RunBytes = 64 << 10;
+
+    uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    void CopyRowsScalar(uint8_t* target, uint64_t targetPitch, const uint8_t* source, uint64_t sourcePitch,
+        uint32_t rowBytes, uint32_t rows) {
+        if (targetPitch == rowBytes && sourcePitch == rowBytes) {
+            std::memcpy(target, source, static_cast<size_t>(rowBytes) * rows);
+            return;
+        }
+        for (uint32_t row = 0; row < rows; row++) {
+            std::memcpy(target + row * targetPitch, source + row * sourcePitch, rowBytes);
+        }
+    }
+
+#if SIMD_X86
+    SIMD_TARGET("avx2")
+    void CopyRowsAvx2(uint8_t* target, uint64_t targetPitch, const uint8_t* source, uint64_t sourcePitch,
+        uint32_t rowBytes, uint32_t rows) {
+        if (rowBytes < StreamingRowBytes) {
+            CopyRowsScalar(target, targetPitch, source, sourcePitch, rowBytes, rows);
+            return;
+        }
+        for (uint32_t row = 0; row < rows; row++) {
+            uint8_t* out = target + row * targetPitch;
+            const uint8_t* in = source + row * sourcePitch;
+            // Up to the first 32-byte boundary, which a staging footprint always starts on
+            const uint32_t head = static_cast<uint32_t>((32 - reinterpret_cast<uintptr_t>(out) % 32) % 32);
+            std::memcpy(out, in, head);
+            uint32_t x = head;
+            for (; x + 128 <= rowBytes; x += 128) {
+                const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + x));
+                const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + x + 32));
+                const __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + x + 64));
+                const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + x + 96));
+                _mm256_stream_si256(reinterpret_cast<__m256i*>(out + x), a);
+                _mm256_stream_si256(reinterpret_cast<__m256i*>(out + x + 32), b);
+                _mm256_stream_si256(reinterpret_cast<__m256i*>(out + x + 64), c);
+                _mm256_stream_si256(reinterpret_cast<__m256i*>(out + x + 96), d);
+            }
+            for (; x + 32 <= rowBytes; x += 32) {
+                _mm256_stream_si256(reinterpret_cast<__m256i*>(out + x),
+                    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + x)));
+            }
+            std::memcpy(out + x, in + x, rowBytes - x);
+        }
+        // Streaming stores are weakly ordered; whoever submits the copy must see them
+        _mm_sfence();
+    }
+#endif
+}
+
+struct SubresourceCopier::Kernels {
+    void (*copyRows)(uint8_t* target, uint64_t targetPitch, const uint8_t* source, uint64_t sourcePitch,
+        uint32_t rowBytes, uint32_t rows);
+};
+
+uint32_t SubresourceMipLevels(const SubresourceLayoutDesc& desc) {
+    return desc.mipLevels ? desc.mipLevels : MipGenerator::FullChainLevels(desc.width, desc.height);
+}
+
+uint32_t SubresourceCount(const SubresourceLayoutDesc& desc) {
+    return SubresourceMipLevels(desc) * desc.arraySize;
+}
+
+uint64_t GetCopyableFootprints(const SubresourceLayoutDesc& desc, uint32_t firstSubresource,
+    uint32_t subresourceCount, uint64_t baseOffset, std::vector<SubresourceFootprint>& footprints) {
+    footprints.clear();
+    if (desc.width == 0 || desc.height == 0 || desc.arraySize == 0) {
+        throw std::runtime_error("footprints of an empty texture");
+    }
+    const uint32_t mipLevels = SubresourceMipLevels(desc);
+    if (mipLevels > MipGenerator::FullChainLevels(desc.width, desc.height)) {
+        throw std::runtime_error(std::to_string(mipLevels) + " mip levels for a " + std::to_string(desc.width) + "x" +
+            std::to_string(desc.height) + " texture");
+    }
+    const uint64_t subresources = static_cast<uint64_t>(mipLevels) * desc.arraySize;
+    if (firstSubresource > subresources || subresourceCount > subresources - firstSubresource) {
+        throw std::runtime_error("subresources " + std::to_string(firstSubresource) + " to " +
+            std::to_string(static_cast<uint64_t>(firstSubresource) + subresourceCount) + " of a texture with " +
+            std::to_string(subresources));
+    }
+
+    const uint32_t blockSize = IsBlockCompressed(desc.format) ? 4 : 1;
+    uint64_t offset = 0, total = 0;
+    for (uint32_t i = 0; i < subresourceCount; i++) {
+        const uint32_t mipLevel = (firstSubresource + i) % mipLevels;
+        const uint32_t width = std::max(1u, desc.width >> mipLevel);
+        const uint32_t height = std::max(1u, desc.height >> mipLevel);
+        SubresourceFootprint footprint;
+        footprint.offset = baseOffset + offset;
+        footprint.format = desc.format;
+        footprint.width = static_cast<uint32_t>(AlignUp(width, blockSize));
+        footprint.height = static_cast<uint32_t>(AlignUp(height, blockSize));
+        footprint.rowBytes = TextureRowBytes(desc.format, width);
+        footprint.rows = TextureRowCount(desc.format, height);
+        footprint.rowPitch = static_cast<uint32_t>(AlignUp(footprint.rowBytes, TextureDataPitchAlignment));
+        footprints.push_back(footprint);
+        total = offset + static_cast<uint64_t>(footprint.rows - 1) * footprint.rowPitch + footprint.rowBytes;
+        offset = AlignUp(offset + static_cast<uint64_t>(footprint.rows) * footprint.rowPitch, TextureDataPlacementAlignment);
+    }
+    return total;
+}
+
+SubresourceCopier::SubresourceCopier(SimdIsa selected) : isa(selected), kernels(nullptr) {
+    static const Kernels scalar = { CopyRowsScalar };
+    kernels = &scalar;
+#if SIMD_X86
+    static const Kernels avx2 = { CopyRowsAvx2 };
+    if (isa == SimdIsa::AVX2 || isa == SimdIsa::AVX512) {
+        kernels = &avx2;
+    }
+#endif
+}
+
+void SubresourceCopier::CopyRows(uint8_t* target, uint64_t targetPitch, const uint8_t* source, uint64_t sourcePitch,
+    uint32_t rowBytes, uint32_t rows) const {
+    kernels->copyRows(target, targetPitch, source, sourcePitch, rowBytes, rows);
+}
+
+void SubresourceCopier::Copy(uint8_t* staging, uint64_t stagingBytes, const std::vector<SubresourceFootprint>& footprints,
+    const SubresourceData* sources, TaskScheduler* scheduler) const {
+    struct Run {
+        uint32_t subresource;
+        uint32_t firstRow;
+        uint32_t rows;
+    };
+    std::vector<Run> runs;
+    for (uint32_t i = 0; i < footprints.size(); i++) {
+        const SubresourceFootprint& footprint = footprints[i];
+        if (footprint.rows == 0) {
+            continue;
+        }
+        if (footprint.rowBytes > footprint.rowPitch || footprint.offset > stagingBytes ||
+            static_cast<uint64_t>(footprint.rows - 1) * footprint.rowPitch + footprint.rowBytes >
+            stagingBytes - footprint.offset) {
+            throw std::runtime_error("subresource " + std::to_string(i) + " ends past the " +
+                std::to_string(stagingBytes) + "-byte staging buffer");
+        }
+        const uint32_t runRows = static_cast<uint32_t>(std::max<uint64_t>(1, RunBytes / footprint.rowPitch));
+        for (uint32_t row = 0; row < footprint.rows; row += runRows) {
+            runs.push_back({ i, row, std::min(runRows, footprint.rows - row) });
+        }
+    }
+
+    auto copy = [&](uint32_t begin, uint32_t end) {
+        for (uint32_t r = begin; r < end; r++) {
+            const Run& run = runs[r];
+            const SubresourceFootprint& footprint = footprints[run.subresource];
+            const SubresourceData& source = sources[run.subresource];
+            kernels->copyRows(staging + footprint.offset + static_cast<uint64_t>(run.firstRow) * footprint.rowPitch,
+                footprint.rowPitch, static_cast<const uint8_t*>(source.data) + run.firstRow * source.rowPitch,
+                source.rowPitch, footprint.rowBytes, run.rows);
+        }
+    };
+    if (scheduler && runs.size() > 1) {
+        scheduler->ParallelFor(static_cast<uint32_t>(runs.size()), copy);
+    }
+    else {
+        copy(0, static_cast<uint32_t>(runs.size()));
+    }
+}
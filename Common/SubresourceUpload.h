@@ -0,0 +1,89 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "SimdIsa.h"
+#include "TextureContainer.h"
+
+class TaskScheduler;
+
+// D3D12_TEXTURE_DATA_PITCH_ALIGNMENT and D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT
+const uint32_t TextureDataPitchAlignment = 256;
+const uint32_t TextureDataPlacementAlignment = 512;
+
+// The parts of a D3D12_RESOURCE_DESC of a Texture2D or Texture2DArray that decide its
+// copyable footprints
+struct SubresourceLayoutDesc {
+    TextureFormat format = TextureFormat::R8G8B8A8;
+    uint32_t width = 1;
+    uint32_t height = 1;
+    uint32_t arraySize = 1;     // DepthOrArraySize
+    uint32_t mipLevels = 1;     // 0 = full chain, as D3D12 reads MipLevels = 0
+};
+
+// D3D12_PLACED_SUBRESOURCE_FOOTPRINT of one subresource, with the row count and row size
+// GetCopyableFootprints returns beside it
+struct SubresourceFootprint {
+    uint64_t offset;        // From the start of the staging buffer, base offset included
+    TextureFormat format;
+    uint32_t width;         // Texels; rounded up to whole 4x4 blocks for BC formats
+    uint32_t height;
+    uint32_t rowPitch;      // Bytes, a multiple of TextureDataPitchAlignment
+    uint32_t rows;          // Rows of texels, or of 4x4 blocks for BC formats
+    uint32_t rowBytes;      // Bytes of each row that hold texels
+};
+
+// D3D12CalcSubresource: mips of slice 0, then mips of slice 1, ...
+inline uint32_t SubresourceIndex(uint32_t mipLevel, uint32_t arraySlice, uint32_t mipLevels) {
+    return mipLevel + arraySlice * mipLevels;
+}
+
+// Mip levels and subresources of desc, a mipLevels of 0 counted as the full chain
+uint32_t SubresourceMipLevels(const SubresourceLayoutDesc& desc);
+uint32_t SubresourceCount(const SubresourceLayoutDesc& desc);
+
+// ID3D12Device::GetCopyableFootprints without a device: footprints of subresources
+// [first, first + count) one after another from baseOffset, each on a placement boundary.
+// Returns TotalBytes, which like D3D12's leaves the last row of the last subresource
+// unpadded; GetRequiredIntermediateSize is this with a base offset of 0. Throws
+// std::runtime_error for an empty texture, more mips than its size has or subresources
+// past the last.
+uint64_t GetCopyableFootprints(const SubresourceLayoutDesc& desc, uint32_t firstSubresource,
+    uint32_t subresourceCount, uint64_t baseOffset, std::vector<SubresourceFootprint>& footprints);
+
+// D3D12_SUBRESOURCE_DATA of a 2D subresource: rows of the footprint's rowBytes, rowPitch apart
+struct SubresourceData {
+    const void* data;
+    uint64_t rowPitch;
+};
+
+// The CPU half of UpdateSubresources: writes each subresource's rows into a staging buffer
+// at its footprint's offset and pitch, leaving the padding between rows as it was. Any
+// memory will do; the D3D12 samples pass a mapped UPLOAD heap buffer, which is
+// write-combined, so the AVX2 kernel writes rows of 256 bytes and more with streaming
+// stores and the CPU never reads those lines back. Shorter rows and unaligned
+// destinations go through memcpy. Rows are the unit of work: every subresource is split
+// into runs of rows spread over the scheduler's threads, so one large mip does not leave
+// the other threads idle.
+class SubresourceCopier {
+public:
+    // SimdIsa::AVX512 runs the AVX2 kernel and SSE42 the scalar one
+    explicit SubresourceCopier(SimdIsa isa = DetectSimdIsa());
+
+    SimdIsa Isa() const { return isa; }
+
+    // sources[i] goes to footprints[i]. Throws std::runtime_error, before writing anything,
+    // if a footprint ends past stagingBytes. scheduler may be null to copy on the calling
+    // thread.
+    void Copy(uint8_t* staging, uint64_t stagingBytes, const std::vector<SubresourceFootprint>& footprints,
+        const SubresourceData* sources, TaskScheduler* scheduler) const;
+
+    // `rows` rows of rowBytes from source to target, each advancing by its own pitch
+    void CopyRows(uint8_t* target, uint64_t targetPitch, const uint8_t* source, uint64_t sourcePitch,
+        uint32_t rowBytes, uint32_t rows) const;
+
+private:
+    struct Kernels;
+
+    SimdIsa isa;
+    const Kernels* kernels;
+};
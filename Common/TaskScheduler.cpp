@@ -0,0 +1,164 @@
+#include "TaskScheduler.h"
+#include <algorithm>
+
+namespace {
+    uint64_t PackRange(uint32_t begin, uint32_t end) {
+        return (static_cast<uint64_t>(end) << 32) | begin;
+    }
+
+    uint32_t RangeBegin(uint64_t range) { return static_cast<uint32_t>(range); }
+    uint32_t RangeEnd(uint64_t range) { return static_cast<uint32_t>(range >> 32); }
+}
+
+TaskScheduler::TaskScheduler(unsigned threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    queues = std::vector<Queue>(threadCount);
+
+    // Slot 0 belongs to the thread calling ParallelFor
+    for (unsigned slot = 1; slot < threadCount; slot++) {
+        workers.emplace_back(&TaskScheduler::WorkerLoop, this, slot);
+    }
+}
+
+TaskScheduler::~TaskScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        shuttingDown = true;
+    }
+    wakeCondition.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void TaskScheduler::ParallelFor(uint32_t count, const RangeFunction& fn, uint32_t grain) {
+    if (count == 0) {
+        return;
+    }
+    grain = std::max(1u, grain);
+
+    const unsigned slots = ThreadCount();
+    if (slots == 1 || count <= grain) {
+        fn(0, count);
+        return;
+    }
+
+    for (unsigned slot = 0; slot < slots; slot++) {
+        uint32_t begin = static_cast<uint32_t>(static_cast<uint64_t>(count) * slot / slots);
+        uint32_t end = static_cast<uint32_t>(static_cast<uint64_t>(count) * (slot + 1) / slots);
+        queues[slot].range.store(PackRange(begin, end), std::memory_order_relaxed);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &fn;
+        jobGrain = grain;
+        activeWorkers = slots - 1;
+        failed.store(false, std::memory_order_relaxed);
+        generation++;
+    }
+    wakeCondition.notify_all();
+
+    RunSlot(0);
+
+    // Workers may still be inside fn even when it threw here, so always wait for them
+    std::exception_ptr thrown;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        doneCondition.wait(lock, [this] { return activeWorkers == 0; });
+        job = nullptr;
+        thrown = error;
+        error = nullptr;
+    }
+    if (thrown) {
+        std::rethrow_exception(thrown);
+    }
+}
+
+void TaskScheduler::WorkerLoop(unsigned slot) {
+    uint64_t seenGeneration = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeCondition.wait(lock, [&] { return shuttingDown || generation != seenGeneration; });
+            if (shuttingDown) {
+                return;
+            }
+            seenGeneration = generation;
+        }
+
+        RunSlot(slot);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--activeWorkers == 0) {
+            doneCondition.notify_one();
+        }
+    }
+}
+
+void TaskScheduler::RunSlot(unsigned slot) {
+    try {
+        for (;;) {
+            uint32_t begin, end;
+            while (!failed.load(std::memory_order_relaxed) && PopLocal(slot, begin, end)) {
+                (*job)(begin, end);
+            }
+            if (failed.load(std::memory_order_relaxed) || !Steal(slot)) {
+                return;
+            }
+        }
+    }
+    catch (...) {
+        // Keep the first exception for ParallelFor to rethrow and drop the items nobody has started
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!error) {
+            error = std::current_exception();
+        }
+        failed.store(true, std::memory_order_relaxed);
+        for (Queue& queue : queues) {
+            queue.range.store(PackRange(0, 0), std::memory_order_release);
+        }
+    }
+}
+
+bool TaskScheduler::PopLocal(unsigned slot, uint32_t& begin, uint32_t& end) {
+    std::atomic<uint64_t>& range = queues[slot].range;
+    uint64_t current = range.load(std::memory_order_acquire);
+    for (;;) {
+        uint32_t b = RangeBegin(current);
+        uint32_t e = RangeEnd(current);
+        if (b >= e) {
+            return false;
+        }
+        uint32_t n = std::min(jobGrain, e - b);
+        if (range.compare_exchange_weak(current, PackRange(b + n, e), std::memory_order_acq_rel)) {
+            begin = b;
+            end = b + n;
+            return true;
+        }
+    }
+}
+
+bool TaskScheduler::Steal(unsigned slot) {
+    const unsigned slots = ThreadCount();
+    for (unsigned i = 1; i < slots; i++) {
+        std::atomic<uint64_t>& victim = queues[(slot + i) % slots].range;
+        uint64_t current = victim.load(std::memory_order_acquire);
+        for (;;) {
+            uint32_t b = RangeBegin(current);
+            uint32_t e = RangeEnd(current);
+            if (b >= e) {
+                break;
+            }
+            // Take the upper half; a single remaining chunk is taken whole
+            uint32_t mid = (e - b <= jobGrain) ? b : b + (e - b) / 2;
+            if (victim.compare_exchange_weak(current, PackRange(b, mid), std::memory_order_acq_rel)) {
+                queues[slot].range.store(PackRange(mid, e), std::memory_order_release);
+                return true;
+            }
+        }
+    }
+    return false;
+}
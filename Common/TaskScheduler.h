@@ -0,0 +1,61 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing scheduler for the CPU backends.
+// ParallelFor splits [0, count) into one contiguous range per thread. Each thread pops
+// `grain` items at a time from the front of its own range and, once that is empty,
+// steals the upper half of another thread's range. The calling thread takes part.
+class TaskScheduler {
+public:
+    using RangeFunction = std::function<void(uint32_t begin, uint32_t end)>;
+
+    // threadCount = 0 uses one thread per hardware core.
+    explicit TaskScheduler(unsigned threadCount = 0);
+    ~TaskScheduler();
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    // Total number of threads including the caller of ParallelFor.
+    unsigned ThreadCount() const { return static_cast<unsigned>(queues.size()); }
+
+    // Runs fn over [0, count) and returns once every item has been processed. If fn throws,
+    // on any thread, items not yet started are skipped and the first exception is rethrown
+    // here once every thread has left fn. fn must not call ParallelFor on this scheduler;
+    // nested parallel work needs a scheduler of its own.
+    void ParallelFor(uint32_t count, const RangeFunction& fn, uint32_t grain = 1);
+
+private:
+    // Packed [begin, end) so owner pops and thief splits are a single CAS.
+    struct alignas(64) Queue {
+        std::atomic<uint64_t> range{ 0 };
+    };
+
+    void WorkerLoop(unsigned slot);
+    void RunSlot(unsigned slot);
+    bool PopLocal(unsigned slot, uint32_t& begin, uint32_t& end);
+    bool Steal(unsigned slot);
+
+    std::vector<Queue> queues;
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable wakeCondition;
+    std::condition_variable doneCondition;
+    uint64_t generation = 0;
+    unsigned activeWorkers = 0;
+    bool shuttingDown = false;
+
+    const RangeFunction* job = nullptr;
+    uint32_t jobGrain = 1;
+    std::atomic<bool> failed{ false };  // Some thread's fn threw; stop taking items
+    std::exception_ptr error;           // The first exception of this ParallelFor, under mutex
+};
@@ -0,0 +1,516 @@
+#include "TextureContainer.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include "MipGenerator.h"
+
+namespace {
+    // DDS_HEADER and DDS_PIXELFORMAT flags
+    const uint32_t DdsMagic = 0x20534444;           // "DDS "
+    const uint32_t DdsHeaderSize = 124;
+    const uint32_t DdsCaps = 0x1, DdsHeight = 0x2, DdsWidth = 0x4, DdsPitch = 0x8, DdsPixelFormat = 0x1000,
+        DdsMipMapCount = 0x20000, DdsLinearSize = 0x80000;
+    const uint32_t DdpfAlphaPixels = 0x1, DdpfFourCC = 0x4, DdpfRgb = 0x40;
+    const uint32_t DdsCapsComplex = 0x8, DdsCapsTexture = 0x1000, DdsCapsMipMap = 0x400000;
+    const uint32_t DdsCaps2Cubemap = 0x200, DdsCaps2Volume = 0x200000;
+    const uint32_t DdsResourceMiscTextureCube = 0x4;
+    const uint32_t DdsDimensionTexture2D = 3;       // D3D10_RESOURCE_DIMENSION_TEXTURE2D
+    // Magic, DDS_HEADER and DDS_HEADER_DXT10
+    const size_t DdsDataOffset = 4 + DdsHeaderSize + 20;
+
+    const uint8_t Ktx2Identifier[12] = { 0xab, 0x4b, 0x54, 0x58, 0x20, 0x32, 0x30, 0xbb, 0x0d, 0x0a, 0x1a, 0x0a };
+    const size_t Ktx2HeaderSize = 80;
+    const size_t Ktx2LevelIndexEntry = 24;
+
+    uint32_t FourCC(char a, char b, char c, char d) {
+        return static_cast<uint32_t>(a) | (static_cast<uint32_t>(b) << 8) | (static_cast<uint32_t>(c) << 16) |
+            (static_cast<uint32_t>(d) << 24);
+    }
+
+    // Both containers are little-endian, like every platform the samples run on
+    uint32_t ReadU32(const uint8_t* data) {
+        uint32_t value;
+        std::memcpy(&value, data, 4);
+        return value;
+    }
+
+    uint64_t ReadU64(const uint8_t* data) {
+        uint64_t value;
+        std::memcpy(&value, data, 8);
+        return value;
+    }
+
+    void WriteU32(std::vector<uint8_t>& out, size_t offset, uint32_t value) {
+        std::memcpy(out.data() + offset, &value, 4);
+    }
+
+    void WriteU64(std::vector<uint8_t>& out, size_t offset, uint64_t value) {
+        std::memcpy(out.data() + offset, &value, 8);
+    }
+
+    uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    uint32_t BlockBytes(TextureFormat format) {
+        switch (format) {
+        case TextureFormat::R8G8B8A8: return 4;
+        case TextureFormat::BC1: return 8;
+        case TextureFormat::BC3:
+        case TextureFormat::BC7: return 16;
+        }
+        return 4;
+    }
+
+    BcFormat BcFormatOf(TextureFormat format) {
+        return format == TextureFormat::BC1 ? BcFormat::BC1 : format == TextureFormat::BC3 ? BcFormat::BC3 : BcFormat::BC7;
+    }
+
+    const TextureFormat AllFormats[] = { TextureFormat::R8G8B8A8, TextureFormat::BC1, TextureFormat::BC3, TextureFormat::BC7 };
+
+    uint32_t VkFormatValue(TextureFormat format) {
+        switch (format) {
+        case TextureFormat::R8G8B8A8: return 37;
+        case TextureFormat::BC1: return 133;
+        case TextureFormat::BC3: return 137;
+        case TextureFormat::BC7: return 145;
+        }
+        return 0;
+    }
+
+    // Levels of `format` from width x height down, `count` of them, tightly packed from offset
+    // `start` with each level's offset a multiple of `alignment`; returns the end
+    uint64_t LayOutLevels(TextureFormat format, uint32_t width, uint32_t height, uint32_t count, uint64_t start,
+        uint64_t alignment, std::vector<TextureLevel>& levels) {
+        levels.clear();
+        uint64_t offset = start;
+        for (uint32_t level = 0; level < count; level++) {
+            TextureLevel entry;
+            entry.width = width;
+            entry.height = height;
+            entry.rowBytes = TextureRowBytes(format, width);
+            entry.rows = TextureRowCount(format, height);
+            entry.offset = AlignUp(offset, alignment);
+            levels.push_back(entry);
+            offset = entry.offset + entry.Size();
+            width = std::max(1u, width / 2);
+            height = std::max(1u, height / 2);
+        }
+        return offset;
+    }
+
+    void CheckLevelCount(TextureFormat format, uint32_t width, uint32_t height, uint32_t levels, const std::string& name) {
+        if (width == 0 || height == 0 || levels == 0 || levels > MipGenerator::FullChainLevels(width, height)) {
+            throw std::runtime_error(name + ": " + std::to_string(width) + "x" + std::to_string(height) + " with " +
+                std::to_string(levels) + " mip levels is not a valid texture");
+        }
+        // The top level of a block-compressed resource must be whole blocks; smaller levels are padded
+        if (IsBlockCompressed(format) && (width % 4 != 0 || height % 4 != 0)) {
+            throw std::runtime_error(name + ": " + TextureFormatName(format) + " textures need a width and height that "
+                "are multiples of 4, not " + std::to_string(width) + "x" + std::to_string(height));
+        }
+    }
+
+    TextureData ReadDds(std::vector<uint8_t> file, const std::string& name) {
+        if (file.size() < 4 + DdsHeaderSize || ReadU32(file.data() + 4) != DdsHeaderSize) {
+            throw std::runtime_error(name + ": truncated DDS header");
+        }
+        const uint8_t* header = file.data() + 4;
+        TextureData texture;
+        texture.height = ReadU32(header + 8);
+        texture.width = ReadU32(header + 12);
+        const uint32_t depth = ReadU32(header + 20);
+        const uint32_t mipLevels = std::max(1u, ReadU32(header + 24));
+        const uint8_t* pixelFormat = header + 72;
+        const uint32_t pixelFlags = ReadU32(pixelFormat + 4);
+        const uint32_t fourCC = ReadU32(pixelFormat + 8);
+        const uint32_t caps2 = ReadU32(header + 108);
+        if ((caps2 & (DdsCaps2Cubemap | DdsCaps2Volume)) || depth > 1) {
+            throw std::runtime_error(name + ": cube maps and volume textures are not supported");
+        }
+
+        size_t dataOffset = 4 + DdsHeaderSize;
+        if ((pixelFlags & DdpfFourCC) && fourCC == FourCC('D', 'X', '1', '0')) {
+            if (file.size() < DdsDataOffset) {
+                throw std::runtime_error(name + ": truncated DDS DX10 header");
+            }
+            const uint8_t* dx10 = header + DdsHeaderSize;
+            const uint32_t dxgiFormat = ReadU32(dx10);
+            bool known = false;
+            for (TextureFormat format : AllFormats) {
+                if (DxgiFormatValue(format) == dxgiFormat) {
+                    texture.format = format;
+                    known = true;
+                }
+            }
+            if (!known) {
+                throw std::runtime_error(name + ": DXGI format " + std::to_string(dxgiFormat) + " is not supported");
+            }
+            if (ReadU32(dx10 + 4) != DdsDimensionTexture2D || (ReadU32(dx10 + 8) & DdsResourceMiscTextureCube) ||
+                ReadU32(dx10 + 12) > 1) {
+                throw std::runtime_error(name + ": only single 2D textures are supported");
+            }
+            dataOffset = DdsDataOffset;
+        }
+        else if ((pixelFlags & DdpfFourCC) && fourCC == FourCC('D', 'X', 'T', '1')) {
+            texture.format = TextureFormat::BC1;
+        }
+        else if ((pixelFlags & DdpfFourCC) && fourCC == FourCC('D', 'X', 'T', '5')) {
+            texture.format = TextureFormat::BC3;
+        }
+        else if ((pixelFlags & DdpfRgb) && (pixelFlags & DdpfAlphaPixels) && ReadU32(pixelFormat + 12) == 32 &&
+            ReadU32(pixelFormat + 16) == 0xff && ReadU32(pixelFormat + 20) == 0xff00 &&
+            ReadU32(pixelFormat + 24) == 0xff0000 && ReadU32(pixelFormat + 28) == 0xff000000u) {
+            texture.format = TextureFormat::R8G8B8A8;
+        }
+        else {
+            throw std::runtime_error(name + ": DDS pixel format is not supported");
+        }
+
+        CheckLevelCount(texture.format, texture.width, texture.height, mipLevels, name);
+        const uint64_t end = LayOutLevels(texture.format, texture.width, texture.height, mipLevels, dataOffset, 1,
+            texture.levels);
+        if (end > file.size()) {
+            throw std::runtime_error(name + ": DDS file is shorter than its levels");
+        }
+        texture.bytes = std::move(file);
+        return texture;
+    }
+
+    TextureData ReadKtx2(std::vector<uint8_t> file, const std::string& name) {
+        if (file.size() < Ktx2HeaderSize) {
+            throw std::runtime_error(name + ": truncated KTX2 header");
+        }
+        const uint8_t* header = file.data();
+        const uint32_t vkFormat = ReadU32(header + 12);
+        TextureData texture;
+        bool known = false;
+        for (TextureFormat format : AllFormats) {
+            if (VkFormatValue(format) == vkFormat) {
+                texture.format = format;
+                known = true;
+            }
+        }
+        if (!known) {
+            throw std::runtime_error(name + ": VkFormat " + std::to_string(vkFormat) + " is not supported");
+        }
+        texture.width = ReadU32(header + 20);
+        texture.height = ReadU32(header + 24);
+        if (ReadU32(header + 28) != 0 || ReadU32(header + 32) > 1 || ReadU32(header + 36) != 1) {
+            throw std::runtime_error(name + ": only single 2D textures are supported");
+        }
+        if (ReadU32(header + 44) != 0) {
+            throw std::runtime_error(name + ": supercompressed KTX2 files are not supported");
+        }
+        const uint32_t mipLevels = std::max(1u, ReadU32(header + 40));
+        CheckLevelCount(texture.format, texture.width, texture.height, mipLevels, name);
+        if (file.size() < Ktx2HeaderSize + Ktx2LevelIndexEntry * mipLevels) {
+            throw std::runtime_error(name + ": truncated KTX2 level index");
+        }
+
+        LayOutLevels(texture.format, texture.width, texture.height, mipLevels, 0, 1, texture.levels);
+        for (uint32_t level = 0; level < mipLevels; level++) {
+            const uint8_t* entry = header + Ktx2HeaderSize + Ktx2LevelIndexEntry * level;
+            const uint64_t offset = ReadU64(entry);
+            const uint64_t length = ReadU64(entry + 8);
+            if (length != texture.levels[level].Size() || offset > file.size() || length > file.size() - offset) {
+                throw std::runtime_error(name + ": KTX2 level " + std::to_string(level) + " does not fit the file");
+            }
+            texture.levels[level].offset = offset;
+        }
+        texture.bytes = std::move(file);
+        return texture;
+    }
+
+    std::vector<uint8_t> WriteDds(const TextureData& texture) {
+        std::vector<uint8_t> file(DdsDataOffset, 0);
+        const bool compressed = IsBlockCompressed(texture.format);
+        WriteU32(file, 0, DdsMagic);
+        WriteU32(file, 4, DdsHeaderSize);
+        WriteU32(file, 8, DdsCaps | DdsHeight | DdsWidth | DdsPixelFormat | DdsMipMapCount |
+            (compressed ? DdsLinearSize : DdsPitch));
+        WriteU32(file, 12, texture.height);
+        WriteU32(file, 16, texture.width);
+        WriteU32(file, 20, static_cast<uint32_t>(compressed ? texture.levels[0].Size() : texture.levels[0].rowBytes));
+        WriteU32(file, 28, texture.MipLevels());
+        WriteU32(file, 76, 32);
+        WriteU32(file, 80, DdpfFourCC);
+        WriteU32(file, 84, FourCC('D', 'X', '1', '0'));
+        WriteU32(file, 108, DdsCapsTexture | (texture.MipLevels() > 1 ? DdsCapsComplex | DdsCapsMipMap : 0));
+        WriteU32(file, 128, DxgiFormatValue(texture.format));
+        WriteU32(file, 132, DdsDimensionTexture2D);
+        WriteU32(file, 140, 1);
+        for (uint32_t level = 0; level < texture.MipLevels(); level++) {
+            const uint8_t* data = texture.LevelData(level);
+            file.insert(file.end(), data, data + texture.levels[level].Size());
+        }
+        return file;
+    }
+
+    // The Khronos basic data format descriptor of a format: its color model, block size and
+    // where each channel sits in a texel or block
+    std::vector<uint32_t> Ktx2FormatDescriptor(TextureFormat format) {
+        struct Sample {
+            uint32_t bitOffset, bitLength, channel, upper;
+        };
+        static const Sample Rgba8[] = { { 0, 8, 0, 255 }, { 8, 8, 1, 255 }, { 16, 8, 2, 255 }, { 24, 8, 15, 255 } };
+        static const Sample Bc1[] = { { 0, 64, 1, 0xffffffffu } };                              // BC1A_ALPHAPRESENT
+        static const Sample Bc3[] = { { 0, 64, 15, 0xffffffffu }, { 64, 64, 0, 0xffffffffu } };  // Alpha, then color
+        static const Sample Bc7[] = { { 0, 128, 0, 0xffffffffu } };
+        const Sample* samples = Rgba8;
+        uint32_t sampleCount = 4;
+        uint32_t model = 1;     // KHR_DF_MODEL_RGBSDA
+        switch (format) {
+        case TextureFormat::R8G8B8A8:
+            break;
+        case TextureFormat::BC1:
+            samples = Bc1;
+            sampleCount = 1;
+            model = 128;        // KHR_DF_MODEL_BC1A
+            break;
+        case TextureFormat::BC3:
+            samples = Bc3;
+            sampleCount = 2;
+            model = 130;        // KHR_DF_MODEL_BC3
+            break;
+        case TextureFormat::BC7:
+            samples = Bc7;
+            sampleCount = 1;
+            model = 134;        // KHR_DF_MODEL_BC7
+            break;
+        }
+        const uint32_t blockSize = 24 + 16 * sampleCount;
+        const uint32_t blockDimension = IsBlockCompressed(format) ? 3 : 0;
+        std::vector<uint32_t> words = {
+            4 + blockSize,                          // dfdTotalSize
+            0,                                      // Khronos vendor, basic descriptor type
+            2 | (blockSize << 16),                  // KHR_DF_VERSIONNUMBER_1_3
+            model | (1 << 8) | (1 << 16),           // BT.709 primaries, linear transfer, straight alpha
+            blockDimension | (blockDimension << 8),
+            BlockBytes(format),
+            0,
+        };
+        for (uint32_t i = 0; i < sampleCount; i++) {
+            const Sample& sample = samples[i];
+            words.push_back(sample.bitOffset | ((sample.bitLength - 1) << 16) | (sample.channel << 24));
+            words.push_back(0);
+            words.push_back(0);
+            words.push_back(sample.upper);
+        }
+        return words;
+    }
+
+    std::vector<uint8_t> WriteKtx2(const TextureData& texture) {
+        const std::vector<uint32_t> descriptor = Ktx2FormatDescriptor(texture.format);
+        const uint32_t levels = texture.MipLevels();
+        const size_t dfdOffset = Ktx2HeaderSize + Ktx2LevelIndexEntry * levels;
+        const size_t dfdLength = descriptor.size() * 4;
+        std::vector<uint8_t> file(dfdOffset + dfdLength, 0);
+        std::memcpy(file.data(), Ktx2Identifier, sizeof(Ktx2Identifier));
+        WriteU32(file, 12, VkFormatValue(texture.format));
+        WriteU32(file, 16, 1);
+        WriteU32(file, 20, texture.width);
+        WriteU32(file, 24, texture.height);
+        WriteU32(file, 36, 1);
+        WriteU32(file, 40, levels);
+        WriteU32(file, 48, static_cast<uint32_t>(dfdOffset));
+        WriteU32(file, 52, static_cast<uint32_t>(dfdLength));
+        std::memcpy(file.data() + dfdOffset, descriptor.data(), dfdLength);
+
+        // Level data runs from the smallest level to the largest, each aligned to the least
+        // common multiple of the block size and 4, which is the block size here
+        const uint64_t alignment = BlockBytes(texture.format);
+        for (uint32_t level = levels; level-- > 0;) {
+            const uint64_t offset = AlignUp(file.size(), alignment);
+            const uint64_t length = texture.levels[level].Size();
+            file.resize(static_cast<size_t>(offset), 0);
+            const uint8_t* data = texture.LevelData(level);
+            file.insert(file.end(), data, data + length);
+            const size_t entry = Ktx2HeaderSize + Ktx2LevelIndexEntry * level;
+            WriteU64(file, entry, offset);
+            WriteU64(file, entry + 8, length);
+            WriteU64(file, entry + 16, length);
+        }
+        return file;
+    }
+}
+
+const char* TextureFormatName(TextureFormat format) {
+    switch (format) {
+    case TextureFormat::R8G8B8A8: return "rgba8";
+    case TextureFormat::BC1: return "bc1";
+    case TextureFormat::BC3: return "bc3";
+    case TextureFormat::BC7: return "bc7";
+    }
+    return "unknown";
+}
+
+bool ParseTextureFormat(const char* name, TextureFormat& format) {
+    for (TextureFormat candidate : AllFormats) {
+        if (std::strcmp(name, TextureFormatName(candidate)) == 0) {
+            format = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+TextureFormat TextureFormatOf(BcFormat format) {
+    switch (format) {
+    case BcFormat::BC1: return TextureFormat::BC1;
+    case BcFormat::BC3: return TextureFormat::BC3;
+    case BcFormat::BC7: return TextureFormat::BC7;
+    }
+    return TextureFormat::BC7;
+}
+
+bool IsBlockCompressed(TextureFormat format) {
+    return format != TextureFormat::R8G8B8A8;
+}
+
+uint32_t DxgiFormatValue(TextureFormat format) {
+    switch (format) {
+    case TextureFormat::R8G8B8A8: return 28;
+    case TextureFormat::BC1: return 71;
+    case TextureFormat::BC3: return 77;
+    case TextureFormat::BC7: return 98;
+    }
+    return 0;
+}
+
+uint32_t TextureRowBytes(TextureFormat format, uint32_t width) {
+    return (IsBlockCompressed(format) ? (width + 3) / 4 : width) * BlockBytes(format);
+}
+
+uint32_t TextureRowCount(TextureFormat format, uint32_t height) {
+    return IsBlockCompressed(format) ? (height + 3) / 4 : height;
+}
+
+TextureData BuildTextureData(const std::vector<CpuImage>& chain, TextureFormat format, BcQuality quality,
+    TaskScheduler* scheduler) {
+    if (chain.empty() || chain[0].width == 0 || chain[0].height == 0) {
+        throw std::runtime_error("Cannot build a texture from an empty image");
+    }
+    if (IsBlockCompressed(format) && (chain[0].width % 4 != 0 || chain[0].height % 4 != 0)) {
+        throw std::runtime_error(std::string(TextureFormatName(format)) + " textures need a width and height that are "
+            "multiples of 4, not " + std::to_string(chain[0].width) + "x" + std::to_string(chain[0].height));
+    }
+    TextureData texture;
+    texture.format = format;
+    texture.width = chain[0].width;
+    texture.height = chain[0].height;
+    const uint64_t size = LayOutLevels(format, texture.width, texture.height, static_cast<uint32_t>(chain.size()), 0, 1,
+        texture.levels);
+    texture.bytes.resize(static_cast<size_t>(size));
+
+    const BlockCompressor compressor;
+    for (uint32_t level = 0; level < texture.MipLevels(); level++) {
+        const CpuImage& image = chain[level];
+        const TextureLevel& entry = texture.levels[level];
+        if (image.width != entry.width || image.height != entry.height) {
+            throw std::runtime_error("Mip level " + std::to_string(level) + " is not half the size of the one above");
+        }
+        uint8_t* out = texture.bytes.data() + entry.offset;
+        if (format == TextureFormat::R8G8B8A8) {
+            std::memcpy(out, image.pixels.data(), image.pixels.size());
+        }
+        else {
+            const CompressedImage blocks = compressor.Compress(image, BcFormatOf(format), quality, scheduler);
+            std::memcpy(out, blocks.blocks.data(), blocks.blocks.size());
+        }
+    }
+    return texture;
+}
+
+CpuImage TextureLevelImage(const TextureData& texture, uint32_t level) {
+    const TextureLevel& entry = texture.levels.at(level);
+    const uint8_t* data = texture.LevelData(level);
+    if (texture.format == TextureFormat::R8G8B8A8) {
+        CpuImage image(entry.width, entry.height);
+        std::memcpy(image.pixels.data(), data, image.pixels.size());
+        return image;
+    }
+    CompressedImage blocks;
+    blocks.format = BcFormatOf(texture.format);
+    blocks.width = entry.width;
+    blocks.height = entry.height;
+    blocks.blocks.assign(data, data + entry.Size());
+    return DecompressImage(blocks);
+}
+
+const char* ContainerTypeName(ContainerType type) {
+    return type == ContainerType::Dds ? "dds" : "ktx2";
+}
+
+bool ContainerTypeOfPath(const std::string& path, ContainerType& type) {
+    std::string extension = std::filesystem::path(path).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) {
+        return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    });
+    if (extension == ".dds") {
+        type = ContainerType::Dds;
+        return true;
+    }
+    if (extension == ".ktx2") {
+        type = ContainerType::Ktx2;
+        return true;
+    }
+    return false;
+}
+
+bool IsTextureContainer(const uint8_t* data, size_t size) {
+    return (size >= 4 && ReadU32(data) == DdsMagic) ||
+        (size >= sizeof(Ktx2Identifier) && std::memcmp(data, Ktx2Identifier, sizeof(Ktx2Identifier)) == 0);
+}
+
+TextureData ReadTextureContainer(std::vector<uint8_t> file, const std::string& name) {
+    if (file.size() >= 4 && ReadU32(file.data()) == DdsMagic) {
+        return ReadDds(std::move(file), name);
+    }
+    if (file.size() >= sizeof(Ktx2Identifier) && std::memcmp(file.data(), Ktx2Identifier, sizeof(Ktx2Identifier)) == 0) {
+        return ReadKtx2(std::move(file), name);
+    }
+    throw std::runtime_error(name + " is neither a DDS nor a KTX2 file");
+}
+
+TextureData LoadTextureContainer(const std::string& path) {
+    std::error_code error;
+    const uintmax_t size = std::filesystem::file_size(path, error);
+    FILE* file = error ? nullptr : std::fopen(path.c_str(), "rb");
+    if (!file) {
+        throw std::runtime_error("Failed to open " + path);
+    }
+    std::vector<uint8_t> bytes(static_cast<size_t>(size));
+    const bool complete = std::fread(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    std::fclose(file);
+    if (!complete) {
+        throw std::runtime_error("Failed to read " + path);
+    }
+    return ReadTextureContainer(std::move(bytes), path);
+}
+
+std::vector<uint8_t> WriteTextureContainer(const TextureData& texture, ContainerType type) {
+    if (texture.levels.empty()) {
+        throw std::runtime_error("Cannot write a texture without levels");
+    }
+    return type == ContainerType::Dds ? WriteDds(texture) : WriteKtx2(texture);
+}
+
+void SaveTextureContainer(const std::string& path, const TextureData& texture) {
+    ContainerType type;
+    if (!ContainerTypeOfPath(path, type)) {
+        throw std::runtime_error(path + " is neither a .dds nor a .ktx2 file");
+    }
+    const std::vector<uint8_t> bytes = WriteTextureContainer(texture, type);
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        throw std::runtime_error("Failed to create " + path);
+    }
+    const bool complete = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    if (std::fclose(file) != 0 || !complete) {
+        throw std::runtime_error("Failed to write " + path);
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "BlockCompressor.h"
+#include "CpuImage.h"
+
+class TaskScheduler;
+
+// Texel formats a texture container may hold
+enum class TextureFormat {
+    R8G8B8A8,   // DXGI_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_R8G8B8A8_UNORM
+    BC1,        // DXGI_FORMAT_BC1_UNORM, VK_FORMAT_BC1_RGBA_UNORM_BLOCK
+    BC3,        // DXGI_FORMAT_BC3_UNORM, VK_FORMAT_BC3_UNORM_BLOCK
+    BC7,        // DXGI_FORMAT_BC7_UNORM, VK_FORMAT_BC7_UNORM_BLOCK
+};
+
+const char* TextureFormatName(TextureFormat format);
+bool ParseTextureFormat(const char* name, TextureFormat& format);
+TextureFormat TextureFormatOf(BcFormat format);
+bool IsBlockCompressed(TextureFormat format);
+
+// The DXGI_FORMAT value, as a number so this header needs no Windows SDK
+uint32_t DxgiFormatValue(TextureFormat format);
+
+// A level of this size as rows of texels, or of 4x4 blocks for BC formats
+uint32_t TextureRowBytes(TextureFormat format, uint32_t width);
+uint32_t TextureRowCount(TextureFormat format, uint32_t height);
+
+// One mip level of a TextureData: rows of rowBytes, tightly packed
+struct TextureLevel {
+    uint32_t width;
+    uint32_t height;
+    uint32_t rowBytes;
+    uint32_t rows;
+    uint64_t offset;        // Into TextureData::bytes
+
+    uint64_t Size() const { return static_cast<uint64_t>(rowBytes) * rows; }
+};
+
+// A 2D texture and its mips the way a copy to the GPU takes them: nothing is left to
+// decode, generate or compress, only rows to copy at the upload buffer's pitch
+struct TextureData {
+    TextureFormat format = TextureFormat::R8G8B8A8;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<TextureLevel> levels;
+    std::vector<uint8_t> bytes;     // For a container read from a file, the whole file
+
+    uint32_t MipLevels() const { return static_cast<uint32_t>(levels.size()); }
+    const uint8_t* LevelData(uint32_t level) const { return bytes.data() + levels[level].offset; }
+};
+
+// Packs a mip chain as chain[0] down, encoding every level for BC formats. Throws
+// std::runtime_error for an empty chain, or a BC format and a top level whose size is not
+// a multiple of 4, which D3D12 cannot create.
+TextureData BuildTextureData(const std::vector<CpuImage>& chain, TextureFormat format, BcQuality quality,
+    TaskScheduler* scheduler);
+
+// A level as R8G8B8A8, BC formats decompressed
+CpuImage TextureLevelImage(const TextureData& texture, uint32_t level);
+
+enum class ContainerType {
+    Dds,        // DDS with a DX10 header; DXT1, DXT5 and 32-bit RGBA legacy headers are read too
+    Ktx2,       // KTX 2.0 without supercompression
+};
+
+const char* ContainerTypeName(ContainerType type);
+
+// By the extension: .dds or .ktx2 in any case
+bool ContainerTypeOfPath(const std::string& path, ContainerType& type);
+
+// By the magic number at the start of a file
+bool IsTextureContainer(const uint8_t* data, size_t size);
+
+// Parses a DDS or KTX2 file holding one 2D texture with its mips. The file moves into the
+// result and the levels point into it, so nothing is copied or decoded. Throws
+// std::runtime_error for other formats, cube maps, arrays, volumes, supercompression and
+// files shorter than their headers say.
+TextureData ReadTextureContainer(std::vector<uint8_t> file, const std::string& name);
+TextureData LoadTextureContainer(const std::string& path);
+
+// The file for a texture, the levels in the order and alignment the container specifies
+std::vector<uint8_t> WriteTextureContainer(const TextureData& texture, ContainerType type);
+
+// The container type comes from the extension; throws std::runtime_error for any other
+void SaveTextureContainer(const std::string& path, const TextureData& texture);
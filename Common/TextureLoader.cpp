@@ -0,0 +1,569 @@
+#include "TextureLoader.h"
+#include "ImageFile.h"
+#include "TexturePack.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+    uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    double SecondsSince(std::chrono::steady_clock::time_point begin) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    }
+
+    std::vector<uint8_t> ReadWholeFile(const std::string& path) {
+        FILE* file = std::fopen(path.c_str(), "rb");
+        if (!file) {
+            throw std::runtime_error("Failed to open " + path);
+        }
+        std::vector<uint8_t> bytes;
+        uint8_t buffer[65536];
+        size_t read;
+        while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            bytes.insert(bytes.end(), buffer, buffer + read);
+        }
+        const bool failed = std::ferror(file) != 0;
+        std::fclose(file);
+        if (failed) {
+            throw std::runtime_error("Failed to read " + path);
+        }
+        return bytes;
+    }
+}
+
+void HostTextureCopyQueue::CreateTexture(uint32_t texture, TextureFormat format, uint32_t width, uint32_t height,
+    uint32_t mipLevels) {
+    if (texture >= textures.size()) {
+        textures.resize(texture + 1);
+    }
+    TextureData& data = textures[texture];
+    data = TextureData();
+    data.format = format;
+    data.width = width;
+    data.height = height;
+    uint64_t size = 0;
+    for (uint32_t level = 0; level < mipLevels; level++) {
+        TextureLevel entry;
+        entry.width = width;
+        entry.height = height;
+        entry.rowBytes = TextureRowBytes(format, width);
+        entry.rows = TextureRowCount(format, height);
+        entry.offset = size;
+        data.levels.push_back(entry);
+        size += entry.Size();
+        width = std::max(1u, width / 2);
+        height = std::max(1u, height / 2);
+    }
+    data.bytes.resize(static_cast<size_t>(size));
+}
+
+void HostTextureCopyQueue::CopyLevel(uint32_t texture, uint32_t level, const UploadMemory& staging,
+    const TextureLevelFootprint& footprint) {
+    TextureData& data = textures.at(texture);
+    const TextureLevel& entry = data.levels.at(level);
+    if (footprint.format != data.format || TextureRowBytes(data.format, footprint.width) != entry.rowBytes ||
+        TextureRowCount(data.format, footprint.height) != entry.rows || footprint.rowPitch < entry.rowBytes) {
+        throw std::runtime_error("Copy footprint does not match the texture level");
+    }
+    for (uint32_t row = 0; row < entry.rows; row++) {
+        std::memcpy(data.bytes.data() + entry.offset + static_cast<uint64_t>(row) * entry.rowBytes,
+            staging.cpuAddress + footprint.offset + static_cast<uint64_t>(row) * footprint.rowPitch, entry.rowBytes);
+    }
+}
+
+void HostTextureCopyQueue::Submit(uint64_t fenceValue) {
+    submissions++;
+    fence.Complete(fenceValue);
+}
+
+CpuImage HostTextureCopyQueue::Level(uint32_t texture, uint32_t level) const {
+    return TextureLevelImage(textures.at(texture), level);
+}
+
+// A file on its way through the stages; once decoded, levels holds the mip chain, or for
+// a DDS or KTX2 file container holds the file and where its levels are. A texture from a
+// pack has nothing to read or decode: only pack and packTexture are set, path is its name.
+struct TextureLoader::Request {
+    uint32_t texture = 0;
+    std::string path;
+    std::vector<uint8_t> file;
+    std::vector<CpuImage> levels;
+    TextureData container;
+    const TexturePack* pack = nullptr;
+    uint32_t packTexture = 0;
+    std::string error;
+
+    bool FromContainer() const { return !container.levels.empty(); }
+};
+
+// Copies submitted under one fence value, and the end of their staging space
+struct TextureLoader::Batch {
+    uint64_t fenceValue;
+    uint64_t stagingEnd;
+    std::vector<Request> requests;
+};
+
+// Multi-producer, multi-consumer queue; Push blocks while `capacity` items wait and Pop
+// blocks until there is an item or the queue is closed and empty
+template <typename T>
+class TextureLoader::WorkQueue {
+public:
+    explicit WorkQueue(size_t capacity) : capacity(capacity) {}
+
+    void Push(T&& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [&] { return items.size() < capacity; });
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+    }
+
+    bool Pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [&] { return !items.empty() || closed; });
+        return TakeFront(item);
+    }
+
+    bool TryPop(T& item) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return TakeFront(item);
+    }
+
+    // Pop returns false once the remaining items are gone
+    void Close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notEmpty.notify_all();
+    }
+
+private:
+    bool TakeFront(T& item) {
+        if (items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    size_t capacity;
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::deque<T> items;
+    bool closed = false;
+};
+
+TextureLoader::TextureLoader(UploadDevice& uploadDevice, TextureCopyQueue& copyQueue, const Options& loaderOptions)
+    : device(uploadDevice), queue(copyQueue), options(loaderOptions) {
+    if (options.stagingBytes < PlacementAlignment) {
+        throw std::runtime_error("The texture loader needs a staging buffer");
+    }
+    options.stagingBytes = AlignUp(options.stagingBytes, PlacementAlignment);
+    decodeThreads = options.decodeThreads;
+    if (decodeThreads == 0) {
+        decodeThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    staging = device.CreateMappedBuffer(options.stagingBytes);
+
+    // Requests are small; files and images are held back to a few per decode thread
+    readQueue = std::make_unique<WorkQueue<Request>>(SIZE_MAX);
+    decodeQueue = std::make_unique<WorkQueue<Request>>(2 * decodeThreads);
+    uploadQueue = std::make_unique<WorkQueue<Request>>(2 * decodeThreads);
+    threads.emplace_back(&TextureLoader::ReadLoop, this);
+    for (unsigned i = 0; i < decodeThreads; i++) {
+        threads.emplace_back(&TextureLoader::DecodeLoop, this);
+    }
+    threads.emplace_back(&TextureLoader::UploadLoop, this);
+}
+
+TextureLoader::~TextureLoader() {
+    // Each stage closes the next once it runs dry, so everything queued still finishes
+    readQueue->Close();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    device.ReleaseMappedBuffer(staging);
+}
+
+uint32_t TextureLoader::Load(const std::string& path) {
+    Request request;
+    request.path = path;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        request.texture = nextTexture++;
+        outstanding++;
+        stats.requested++;
+    }
+    const uint32_t texture = request.texture;
+    readQueue->Push(std::move(request));
+    return texture;
+}
+
+uint32_t TextureLoader::Load(const TexturePack& pack, uint32_t packTexture) {
+    Request request;
+    request.path = pack.Name(packTexture);
+    request.pack = &pack;
+    request.packTexture = packTexture;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        request.texture = nextTexture++;
+        outstanding++;
+        stats.requested++;
+    }
+    const uint32_t texture = request.texture;
+    readQueue->Push(std::move(request));
+    return texture;
+}
+
+std::vector<TextureLoader::Resident> TextureLoader::TakeResident() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<Resident> result;
+    result.swap(finished);
+    return result;
+}
+
+void TextureLoader::WaitForIdle() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idleCondition.wait(lock, [&] { return outstanding == 0; });
+}
+
+TextureLoader::Stats TextureLoader::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+uint64_t TextureLoader::LevelFootprints(TextureFormat format, uint32_t width, uint32_t height, uint32_t mipLevels,
+    std::vector<TextureLevelFootprint>& footprints) {
+    SubresourceLayoutDesc desc;
+    desc.format = format;
+    desc.width = width;
+    desc.height = height;
+    desc.mipLevels = mipLevels;
+    std::vector<SubresourceFootprint> subresources;
+    const uint64_t size = GetCopyableFootprints(desc, 0, mipLevels, 0, subresources);
+    footprints.clear();
+    for (const SubresourceFootprint& subresource : subresources) {
+        footprints.push_back({ subresource.offset, subresource.format, subresource.width, subresource.height,
+            subresource.rowPitch });
+    }
+    return AlignUp(size, PlacementAlignment);
+}
+
+void TextureLoader::ReadLoop() {
+    Request request;
+    while (readQueue->Pop(request)) {
+        if (request.pack) {
+            decodeQueue->Push(std::move(request));
+            request = Request();
+            continue;
+        }
+        const auto begin = std::chrono::steady_clock::now();
+        try {
+            request.file = ReadWholeFile(request.path);
+        }
+        catch (const std::exception& e) {
+            request.error = e.what();
+        }
+        const double seconds = SecondsSince(begin);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stats.readSeconds += seconds;
+            stats.fileBytes += request.file.size();
+        }
+        decodeQueue->Push(std::move(request));
+        request = Request();
+    }
+    decodeQueue->Close();
+}
+
+void TextureLoader::DecodeLoop() {
+    Request request;
+    while (decodeQueue->Pop(request)) {
+        double decodeSeconds = 0.0, mipSeconds = 0.0;
+        if (request.error.empty() && !request.pack) {
+            auto begin = std::chrono::steady_clock::now();
+            try {
+                if (IsTextureContainer(request.file.data(), request.file.size())) {
+                    // Already GPU-ready: only the headers are parsed and the file stays as it is
+                    request.container = ReadTextureContainer(std::move(request.file), request.path);
+                    decodeSeconds = SecondsSince(begin);
+                }
+                else {
+                    request.levels.push_back(DecodeImage(request.file.data(), request.file.size(), request.path));
+                    std::vector<uint8_t>().swap(request.file);
+                    decodeSeconds = SecondsSince(begin);
+
+                    begin = std::chrono::steady_clock::now();
+                    MipOptions mips = options.mips;
+                    mips.mipLevels = std::min(mips.mipLevels, MipGenerator::FullChainLevels(request.levels[0].width,
+                        request.levels[0].height));
+                    mipGenerator.Generate(request.levels, mips, nullptr);
+                    mipSeconds = SecondsSince(begin);
+                }
+            }
+            catch (const std::exception& e) {
+                request.error = e.what();
+                request.levels.clear();
+                request.container = TextureData();
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stats.decodeSeconds += decodeSeconds;
+            stats.mipSeconds += mipSeconds;
+        }
+        uploadQueue->Push(std::move(request));
+        request = Request();
+    }
+
+    // The last decode thread out closes the upload stage
+    std::lock_guard<std::mutex> lock(mutex);
+    if (++exitedDecoders == decodeThreads) {
+        uploadQueue->Close();
+    }
+}
+
+void TextureLoader::UploadLoop() {
+    std::vector<Request> batch;
+    uint64_t batchBytes = 0;
+    Request request;
+    for (;;) {
+        RetireBatches(false);
+        if (uploadQueue->TryPop(request)) {
+            Upload(request, batch, batchBytes);
+            request = Request();
+            continue;
+        }
+        // Nothing decoded yet: submit what there is, then see the copies through
+        if (!batch.empty()) {
+            SubmitBatch(batch);
+            batchBytes = 0;
+            continue;
+        }
+        if (!inFlight.empty()) {
+            RetireBatches(true);
+            continue;
+        }
+        if (!uploadQueue->Pop(request)) {
+            break;
+        }
+        Upload(request, batch, batchBytes);
+        request = Request();
+    }
+}
+
+void TextureLoader::Upload(Request& request, std::vector<Request>& batch, uint64_t& batchBytes) {
+    if (!request.error.empty()) {
+        std::vector<Request> failed(1);
+        failed[0] = std::move(request);
+        Finish(failed);
+        return;
+    }
+    const auto begin = std::chrono::steady_clock::now();
+    const bool fromContainer = request.FromContainer();
+    TextureFormat format = fromContainer ? request.container.format : TextureFormat::R8G8B8A8;
+    uint32_t width, height, mipLevels;
+    PackedTexture packed = {};
+    std::vector<TextureLevel> packedLevels;
+    if (request.pack) {
+        packed = request.pack->Texture(request.packTexture);
+        request.pack->Levels(request.packTexture, packedLevels);
+        format = packed.format;
+        width = packed.width;
+        height = packed.height;
+        mipLevels = packed.mipLevels;
+    }
+    else {
+        width = fromContainer ? request.container.width : request.levels[0].width;
+        height = fromContainer ? request.container.height : request.levels[0].height;
+        mipLevels = fromContainer ? request.container.MipLevels() : static_cast<uint32_t>(request.levels.size());
+    }
+    auto fail = [&](const std::string& error) {
+        request.error = error;
+        request.levels.clear();
+        request.container = TextureData();
+        std::vector<Request> failed(1);
+        failed[0] = std::move(request);
+        Finish(failed);
+    };
+    std::vector<TextureLevelFootprint> footprints;
+    uint64_t size;
+    try {
+        size = LevelFootprints(format, width, height, mipLevels, footprints);
+    }
+    catch (const std::exception& e) {
+        fail(request.path + ": " + e.what());
+        return;
+    }
+    if (size > options.stagingBytes) {
+        fail(request.path + " needs " + std::to_string(size) + " staging bytes, more than the loader has");
+        return;
+    }
+
+    // A contiguous range after the head, starting over at the beginning rather than wrapping
+    uint64_t start;
+    for (;;) {
+        // With nothing in use, the end of the buffer left over from the last wrap is free too
+        if (stagingHead == stagingTail) {
+            stagingHead = stagingTail = 0;
+        }
+        start = stagingHead;
+        if (start % options.stagingBytes + size > options.stagingBytes) {
+            start = (start / options.stagingBytes + 1) * options.stagingBytes;
+        }
+        if (start + size - stagingTail <= options.stagingBytes) {
+            break;
+        }
+        if (!batch.empty()) {
+            SubmitBatch(batch);
+            batchBytes = 0;
+        }
+        else {
+            std::lock_guard<std::mutex> lock(mutex);
+            stats.stagingWaits++;
+        }
+        RetireBatches(true);
+    }
+    const uint64_t previousHead = stagingHead;
+    stagingHead = start + size;
+
+    const uint64_t base = start % options.stagingBytes;
+    try {
+        queue.CreateTexture(request.texture, format, width, height, mipLevels);
+        for (uint32_t level = 0; level < mipLevels; level++) {
+            TextureLevelFootprint footprint = footprints[level];
+            footprint.offset += base;
+            const uint8_t* source;
+            uint32_t rowBytes, rows;
+            if (request.pack) {
+                // Straight from the mapped file, which is also where its pages are read
+                source = packed.data + packedLevels[level].offset;
+                rowBytes = packedLevels[level].rowBytes;
+                rows = packedLevels[level].rows;
+            }
+            else if (fromContainer) {
+                source = request.container.LevelData(level);
+                rowBytes = request.container.levels[level].rowBytes;
+                rows = request.container.levels[level].rows;
+            }
+            else {
+                source = request.levels[level].pixels.data();
+                rowBytes = request.levels[level].RowPitch();
+                rows = request.levels[level].height;
+            }
+            copier.CopyRows(staging.cpuAddress + footprint.offset, footprint.rowPitch, source, rowBytes, rowBytes, rows);
+            queue.CopyLevel(request.texture, level, staging, footprint);
+        }
+    }
+    catch (const std::exception& e) {
+        // Nothing was allocated after this range, and copies already recorded only reach the failed texture
+        stagingHead = previousHead;
+        fail(request.path + ": " + e.what());
+        return;
+    }
+    batchBytes += size;
+
+    // Only the sizes are needed once the texels are in staging memory
+    for (CpuImage& level : request.levels) {
+        std::vector<uint8_t>().swap(level.pixels);
+    }
+    std::vector<uint8_t>().swap(request.container.bytes);
+    batch.push_back(std::move(request));
+    const double seconds = SecondsSince(begin);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.uploadBytes += size;
+        stats.uploadSeconds += seconds;
+    }
+    if (batchBytes >= options.batchBytes) {
+        SubmitBatch(batch);
+        batchBytes = 0;
+    }
+}
+
+void TextureLoader::SubmitBatch(std::vector<Request>& batch) {
+    std::unique_ptr<Batch> submitted(new Batch{ nextFenceValue++, stagingHead, std::move(batch) });
+    batch.clear();
+    queue.Submit(submitted->fenceValue);
+    inFlight.push_back(std::move(submitted));
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.batches++;
+}
+
+void TextureLoader::RetireBatches(bool wait) {
+    TimelineFence& fence = queue.Fence();
+    while (!inFlight.empty()) {
+        Batch& oldest = *inFlight.front();
+        if (fence.CompletedValue() < oldest.fenceValue) {
+            if (!wait) {
+                return;
+            }
+            fence.WaitForValue(oldest.fenceValue);
+            wait = false;
+        }
+        stagingTail = oldest.stagingEnd;
+        Finish(oldest.requests);
+        inFlight.pop_front();
+    }
+}
+
+void TextureLoader::Finish(std::vector<Request>& requests) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (Request& request : requests) {
+        Resident resident;
+        resident.texture = request.texture;
+        if (request.pack && request.error.empty()) {
+            const PackedTexture packed = request.pack->Texture(request.packTexture);
+            resident.width = packed.width;
+            resident.height = packed.height;
+            resident.mipLevels = packed.mipLevels;
+            resident.format = packed.format;
+        }
+        else if (request.FromContainer()) {
+            resident.width = request.container.width;
+            resident.height = request.container.height;
+            resident.mipLevels = request.container.MipLevels();
+            resident.format = request.container.format;
+        }
+        else {
+            resident.width = request.levels.empty() ? 0 : request.levels[0].width;
+            resident.height = request.levels.empty() ? 0 : request.levels[0].height;
+            resident.mipLevels = static_cast<uint32_t>(request.levels.size());
+            resident.format = TextureFormat::R8G8B8A8;
+        }
+        resident.path = std::move(request.path);
+        resident.error = std::move(request.error);
+        if (resident.error.empty()) {
+            stats.resident++;
+            for (const CpuImage& level : request.levels) {
+                stats.texelBytes += static_cast<uint64_t>(level.width) * level.height * 4;
+            }
+            for (const TextureLevel& level : request.container.levels) {
+                stats.texelBytes += level.Size();
+            }
+            if (request.pack) {
+                for (uint32_t level = 0, w = resident.width, h = resident.height; level < resident.mipLevels;
+                    level++, w = std::max(1u, w / 2), h = std::max(1u, h / 2)) {
+                    stats.texelBytes += static_cast<uint64_t>(TextureRowBytes(resident.format, w)) *
+                        TextureRowCount(resident.format, h);
+                }
+            }
+            stats.containers += request.FromContainer();
+            stats.packed += request.pack != nullptr;
+        }
+        else {
+            stats.failed++;
+        }
+        finished.push_back(std::move(resident));
+    }
+    outstanding -= requests.size();
+    if (outstanding == 0) {
+        idleCondition.notify_all();
+    }
+}
@@ -0,0 +1,201 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "CpuImage.h"
+#include "MipGenerator.h"
+#include "SubresourceUpload.h"
+#include "TextureContainer.h"
+#include "TimelineFence.h"
+#include "UploadRing.h"
+
+class TexturePack;
+
+// Where one mip level of a texture sits in a staging buffer, as
+// D3D12_PLACED_SUBRESOURCE_FOOTPRINT describes it for CopyTextureRegion
+struct TextureLevelFootprint {
+    uint64_t offset;        // From the start of the staging buffer, a multiple of PlacementAlignment
+    TextureFormat format;
+    uint32_t width;         // Texels; rounded up to whole 4x4 blocks for BC formats
+    uint32_t height;
+    uint32_t rowPitch;      // Bytes, a multiple of RowPitchAlignment
+};
+
+// The copy queue the loader uploads through. On D3D12: a COPY command queue with its own
+// command list and fence. Every call comes from the loader's upload thread.
+class TextureCopyQueue {
+public:
+    virtual ~TextureCopyQueue() = default;
+
+    // CreateCommittedResource of a Texture2D in the DEFAULT heap, in the COMMON state so the
+    // copy queue and then the direct queue promote it implicitly
+    virtual void CreateTexture(uint32_t texture, TextureFormat format, uint32_t width, uint32_t height,
+        uint32_t mipLevels) = 0;
+
+    // CopyTextureRegion of subresource `level` from the staging buffer
+    virtual void CopyLevel(uint32_t texture, uint32_t level, const UploadMemory& staging,
+        const TextureLevelFootprint& footprint) = 0;
+
+    // Close, ExecuteCommandLists and Signal(fenceValue) for everything recorded since the last call
+    virtual void Submit(uint64_t fenceValue) = 0;
+
+    // The fence Submit signals
+    virtual TimelineFence& Fence() = 0;
+};
+
+// A copy queue without a device: textures are host memory laid out like the staging buffer
+// and every submission completes at once. For checks and benchmarks on any platform.
+class HostTextureCopyQueue : public TextureCopyQueue {
+public:
+    void CreateTexture(uint32_t texture, TextureFormat format, uint32_t width, uint32_t height,
+        uint32_t mipLevels) override;
+    void CopyLevel(uint32_t texture, uint32_t level, const UploadMemory& staging,
+        const TextureLevelFootprint& footprint) override;
+    void Submit(uint64_t fenceValue) override;
+    TimelineFence& Fence() override { return fence; }
+
+    // A level as it was copied, as R8G8B8A8; only after the texture is resident
+    CpuImage Level(uint32_t texture, uint32_t level) const;
+
+    // The texture as it was copied, every level tightly packed in its own format
+    const TextureData& Texture(uint32_t texture) const { return textures.at(texture); }
+
+    uint64_t Submissions() const { return submissions; }
+
+private:
+    std::vector<TextureData> textures;
+    ManualFence fence;
+    uint64_t submissions = 0;
+};
+
+// Loads PNG, JPEG and whatever else stb_image reads into textures on a copy queue without
+// stalling the caller. A texture passes through four stages:
+//
+//   read        one thread reads whole files into memory, in request order
+//   decode      a pool of threads runs stbi_load_from_memory to R8G8B8A8
+//   mips        the same thread adds the mip chain with MipGenerator
+//   upload      one thread copies the levels into a staging ring with D3D12 footprints,
+//               records the copies and submits them in batches
+//
+// DDS and KTX2 files, recognized by their magic numbers, skip decode and mips: the decode
+// thread only parses the headers and the upload thread copies the stored levels, BC blocks
+// included, straight from the file's memory into staging. Their mip count and format are
+// the file's; options.mips does not apply. Textures from a TexturePack skip reading too:
+// the upload thread copies each payload from the mapped pack in one piece.
+//
+// A texture becomes resident once the fence value of its batch completes, and TakeResident
+// hands it over in completion order, typically once per frame. Bounded queues between the
+// stages keep at most a few files and images per decode thread in memory. Staging space is
+// reused as the copy fence passes batches; a texture larger than the whole staging buffer
+// fails to load.
+class TextureLoader {
+public:
+    static const uint32_t RowPitchAlignment = TextureDataPitchAlignment;
+    static const uint32_t PlacementAlignment = TextureDataPlacementAlignment;
+
+    struct Options {
+        MipOptions mips;                        // mips.mipLevels: 0 = full chain, 1 = the image alone
+        unsigned decodeThreads = 0;             // 0 = one per hardware core
+        uint64_t stagingBytes = 64ull << 20;
+        uint64_t batchBytes = 8ull << 20;       // Submit once a batch's copies reach this size
+    };
+
+    // A finished request. Failed textures are reported too, with the reason in error.
+    struct Resident {
+        uint32_t texture;
+        uint32_t width;
+        uint32_t height;
+        uint32_t mipLevels;
+        TextureFormat format;
+        std::string path;
+        std::string error;
+    };
+
+    struct Stats {
+        uint64_t requested = 0;
+        uint64_t resident = 0;
+        uint64_t failed = 0;
+        uint64_t fileBytes = 0;         // Read from disk
+        uint64_t texelBytes = 0;        // Decoded or read from containers, mips included
+        uint64_t containers = 0;        // Resident textures that came from DDS or KTX2 files
+        uint64_t packed = 0;            // Resident textures that came from a TexturePack
+        uint64_t uploadBytes = 0;       // Staging bytes copied, pitch padding included
+        uint64_t batches = 0;
+        uint64_t stagingWaits = 0;      // Times the upload thread waited for the copy fence to free staging space
+        double readSeconds = 0.0;       // Thread time of each stage, summed over its threads
+        double decodeSeconds = 0.0;
+        double mipSeconds = 0.0;
+        double uploadSeconds = 0.0;
+    };
+
+    TextureLoader(UploadDevice& device, TextureCopyQueue& queue, const Options& options);
+    ~TextureLoader();
+
+    TextureLoader(const TextureLoader&) = delete;
+    TextureLoader& operator=(const TextureLoader&) = delete;
+
+    // Queues a file and returns its texture index: 0, 1, 2, ... in call order
+    uint32_t Load(const std::string& path);
+
+    // Queues texture `packTexture` of a pack, which must stay open until it is resident
+    uint32_t Load(const TexturePack& pack, uint32_t packTexture);
+
+    // Everything that finished since the last call
+    std::vector<Resident> TakeResident();
+
+    // Blocks until every request so far is resident or failed
+    void WaitForIdle();
+
+    Stats GetStats() const;
+
+    // The footprints of a texture's levels starting at offset 0, as GetCopyableFootprints
+    // lays them out; returns the staging bytes, rounded up to PlacementAlignment
+    static uint64_t LevelFootprints(TextureFormat format, uint32_t width, uint32_t height, uint32_t mipLevels,
+        std::vector<TextureLevelFootprint>& footprints);
+
+private:
+    struct Request;
+    template <typename T>
+    class WorkQueue;
+    struct Batch;
+
+    void ReadLoop();
+    void DecodeLoop();
+    void UploadLoop();
+    void Upload(Request& request, std::vector<Request>& batch, uint64_t& batchBytes);
+    void SubmitBatch(std::vector<Request>& batch);
+    void RetireBatches(bool wait);
+    void Finish(std::vector<Request>& requests);
+
+    UploadDevice& device;
+    TextureCopyQueue& queue;
+    Options options;
+    MipGenerator mipGenerator;
+    SubresourceCopier copier;
+    UploadMemory staging;
+
+    std::unique_ptr<WorkQueue<Request>> readQueue;
+    std::unique_ptr<WorkQueue<Request>> decodeQueue;
+    std::unique_ptr<WorkQueue<Request>> uploadQueue;
+    std::vector<std::thread> threads;
+    unsigned decodeThreads = 0;
+
+    // Upload thread only: staging ring [stagingTail, stagingHead) in use, modulo its size
+    uint64_t stagingHead = 0;
+    uint64_t stagingTail = 0;
+    uint64_t nextFenceValue = 1;
+    std::deque<std::unique_ptr<Batch>> inFlight;
+
+    mutable std::mutex mutex;
+    std::condition_variable idleCondition;
+    std::vector<Resident> finished;
+    uint32_t nextTexture = 0;
+    uint64_t outstanding = 0;
+    unsigned exitedDecoders = 0;
+    Stats stats;
+};
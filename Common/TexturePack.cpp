@@ -0,0 +1,446 @@
+#include "TexturePack.h"
+#include "MipGenerator.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    const uint32_t PackMagic = 0x4b415054;     // "TPAK"
+    const uint32_t PackVersion = 1;
+    const size_t HeaderSize = 64;
+    const size_t EntrySize = 64;
+    const size_t LevelSize = 48;
+
+    const TextureFormat AllFormats[] = { TextureFormat::R8G8B8A8, TextureFormat::BC1, TextureFormat::BC3, TextureFormat::BC7 };
+
+    uint32_t ReadU32(const uint8_t* data) {
+        uint32_t value;
+        std::memcpy(&value, data, 4);
+        return value;
+    }
+
+    uint64_t ReadU64(const uint8_t* data) {
+        uint64_t value;
+        std::memcpy(&value, data, 8);
+        return value;
+    }
+
+    void PutU32(uint8_t* data, uint32_t value) {
+        std::memcpy(data, &value, 4);
+    }
+
+    void PutU64(uint8_t* data, uint64_t value) {
+        std::memcpy(data, &value, 8);
+    }
+
+    // A table of `count` records of `size` bytes at `offset` lies inside a file of `fileSize` bytes
+    bool FitsInFile(uint64_t offset, uint64_t count, uint64_t size, uint64_t fileSize) {
+        return offset <= fileSize && count <= (fileSize - offset) / size;
+    }
+}
+
+MappedFile::MappedFile(const std::string& path) {
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Failed to open " + path);
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(handle, &fileSize)) {
+        CloseHandle(handle);
+        throw std::runtime_error("Failed to read the size of " + path);
+    }
+    size = static_cast<uint64_t>(fileSize.QuadPart);
+    if (size > 0) {
+        // The view keeps the mapping and the file open once their handles are closed
+        HANDLE mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping) {
+            data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+            CloseHandle(mapping);
+        }
+    }
+    CloseHandle(handle);
+#else
+    const int descriptor = open(path.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        throw std::runtime_error("Failed to open " + path);
+    }
+    struct stat status;
+    if (fstat(descriptor, &status) != 0) {
+        close(descriptor);
+        throw std::runtime_error("Failed to read the size of " + path);
+    }
+    size = static_cast<uint64_t>(status.st_size);
+    if (size > 0) {
+        // The mapping keeps the file open once the descriptor is closed
+        void* mapped = mmap(nullptr, static_cast<size_t>(size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+        data = mapped == MAP_FAILED ? nullptr : static_cast<const uint8_t*>(mapped);
+    }
+    close(descriptor);
+#endif
+    if (size > 0 && !data) {
+        size = 0;
+        throw std::runtime_error("Failed to map " + path);
+    }
+}
+
+MappedFile::~MappedFile() {
+    Close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept : data(other.data), size(other.size) {
+    other.data = nullptr;
+    other.size = 0;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        Close();
+        data = other.data;
+        size = other.size;
+        other.data = nullptr;
+        other.size = 0;
+    }
+    return *this;
+}
+
+void MappedFile::Close() {
+    if (data) {
+#ifdef _WIN32
+        UnmapViewOfFile(data);
+#else
+        munmap(const_cast<uint8_t*>(data), static_cast<size_t>(size));
+#endif
+    }
+    data = nullptr;
+    size = 0;
+}
+
+TexturePack::TexturePack(const std::string& path) : file(path) {
+    const uint8_t* header = file.Data();
+    const uint64_t size = file.Size();
+    if (size < HeaderSize || ReadU32(header) != PackMagic) {
+        throw std::runtime_error(path + " is not a texture pack");
+    }
+    if (ReadU32(header + 4) != PackVersion) {
+        throw std::runtime_error(path + ": texture pack version " + std::to_string(ReadU32(header + 4)) +
+            " is not supported");
+    }
+    textureCount = ReadU32(header + 8);
+    levelCount = ReadU32(header + 12);
+    const uint64_t tocOffset = ReadU64(header + 16);
+    const uint64_t levelsOffset = ReadU64(header + 24);
+    const uint64_t namesOffset = ReadU64(header + 32);
+    const uint64_t namesSize = ReadU64(header + 40);
+    if (ReadU64(header + 48) != size || !FitsInFile(tocOffset, textureCount, EntrySize, size) ||
+        !FitsInFile(levelsOffset, levelCount, LevelSize, size) || !FitsInFile(namesOffset, namesSize, 1, size)) {
+        throw std::runtime_error(path + ": texture pack is truncated or its tables lie outside it");
+    }
+    toc = header + tocOffset;
+    levelTable = header + levelsOffset;
+    names = header + namesOffset;
+
+    // Every entry once, so Find, Texture, Levels and Footprints need no checks of their own
+    std::vector<TextureLevel> levels;
+    std::vector<TextureLevelFootprint> expected, footprints;
+    uint64_t previousHash = 0;
+    for (uint32_t texture = 0; texture < textureCount; texture++) {
+        const uint8_t* entry = Entry(texture);
+        const uint64_t hash = ReadU64(entry);
+        const uint64_t offset = ReadU64(entry + 8);
+        const uint64_t payloadSize = ReadU64(entry + 16);
+        const uint32_t nameOffset = ReadU32(entry + 32);
+        const uint32_t nameLength = ReadU32(entry + 36);
+        const uint32_t width = ReadU32(entry + 44);
+        const uint32_t height = ReadU32(entry + 48);
+        const uint32_t mipLevels = ReadU32(entry + 52);
+        const uint32_t firstLevel = ReadU32(entry + 56);
+        const std::string where = path + ": texture " + std::to_string(texture);
+        if (hash < previousHash) {
+            throw std::runtime_error(where + " is out of order");
+        }
+        previousHash = hash;
+        if (static_cast<uint64_t>(nameOffset) + nameLength > namesSize || NameHash(Name(texture)) != hash) {
+            throw std::runtime_error(where + " has a bad name");
+        }
+        bool known = false, blocks = true;
+        for (TextureFormat format : AllFormats) {
+            if (DxgiFormatValue(format) == ReadU32(entry + 40)) {
+                known = true;
+                blocks = !IsBlockCompressed(format) || (width % 4 == 0 && height % 4 == 0);
+            }
+        }
+        if (!known || !blocks || width == 0 || height == 0 || mipLevels == 0 ||
+            mipLevels > MipGenerator::FullChainLevels(width, height) ||
+            firstLevel > levelCount || mipLevels > levelCount - firstLevel) {
+            throw std::runtime_error(where + " has a bad format, size or mip count");
+        }
+        if (offset % PayloadAlignment != 0 || !FitsInFile(offset, payloadSize, 1, size)) {
+            throw std::runtime_error(where + "'s payload lies outside the file");
+        }
+
+        // Levels tightly packed from the largest, footprints as the loader computes them
+        const PackedTexture packed = Texture(texture);
+        const uint64_t stagingBytes = TextureLoader::LevelFootprints(packed.format, width, height, mipLevels, expected);
+        Levels(texture, levels);
+        Footprints(texture, footprints);
+        bool laidOut = packed.stagingBytes == stagingBytes;
+        uint64_t levelOffset = 0;
+        for (uint32_t level = 0, w = width, h = height; laidOut && level < mipLevels;
+            level++, w = std::max(1u, w / 2), h = std::max(1u, h / 2)) {
+            laidOut = levels[level].offset == levelOffset && levels[level].width == w && levels[level].height == h &&
+                levels[level].rowBytes == TextureRowBytes(packed.format, w) &&
+                levels[level].rows == TextureRowCount(packed.format, h) &&
+                footprints[level].offset == expected[level].offset && footprints[level].width == expected[level].width &&
+                footprints[level].height == expected[level].height && footprints[level].rowPitch == expected[level].rowPitch;
+            levelOffset += levels[level].Size();
+        }
+        if (!laidOut || levelOffset != payloadSize) {
+            throw std::runtime_error(where + " has levels or footprints other than its size and format give");
+        }
+    }
+}
+
+uint32_t TexturePack::Find(const std::string& name) const {
+    const uint64_t hash = NameHash(name);
+    uint32_t first = 0, count = textureCount;
+    while (count > 0) {
+        const uint32_t half = count / 2;
+        if (ReadU64(Entry(first + half)) < hash) {
+            first += half + 1;
+            count -= half + 1;
+        }
+        else {
+            count = half;
+        }
+    }
+    // Names whose hashes collide sit next to each other
+    for (uint32_t texture = first; texture < textureCount && ReadU64(Entry(texture)) == hash; texture++) {
+        if (Name(texture) == name) {
+            return texture;
+        }
+    }
+    return NotFound;
+}
+
+std::string TexturePack::Name(uint32_t texture) const {
+    const uint8_t* entry = Entry(texture);
+    return std::string(reinterpret_cast<const char*>(names + ReadU32(entry + 32)), ReadU32(entry + 36));
+}
+
+PackedTexture TexturePack::Texture(uint32_t texture) const {
+    const uint8_t* entry = Entry(texture);
+    PackedTexture packed;
+    packed.format = TextureFormat::R8G8B8A8;
+    for (TextureFormat format : AllFormats) {
+        if (DxgiFormatValue(format) == ReadU32(entry + 40)) {
+            packed.format = format;
+        }
+    }
+    packed.width = ReadU32(entry + 44);
+    packed.height = ReadU32(entry + 48);
+    packed.mipLevels = ReadU32(entry + 52);
+    packed.data = file.Data() + ReadU64(entry + 8);
+    packed.size = ReadU64(entry + 16);
+    packed.stagingBytes = ReadU64(entry + 24);
+    return packed;
+}
+
+void TexturePack::Levels(uint32_t texture, std::vector<TextureLevel>& levels) const {
+    const uint8_t* entry = Entry(texture);
+    const uint8_t* record = levelTable + static_cast<uint64_t>(ReadU32(entry + 56)) * LevelSize;
+    levels.resize(ReadU32(entry + 52));
+    for (TextureLevel& level : levels) {
+        level.offset = ReadU64(record);
+        level.width = ReadU32(record + 8);
+        level.height = ReadU32(record + 12);
+        level.rowBytes = ReadU32(record + 16);
+        level.rows = ReadU32(record + 20);
+        record += LevelSize;
+    }
+}
+
+void TexturePack::Footprints(uint32_t texture, std::vector<TextureLevelFootprint>& footprints) const {
+    const uint8_t* entry = Entry(texture);
+    const TextureFormat format = Texture(texture).format;
+    const uint8_t* record = levelTable + static_cast<uint64_t>(ReadU32(entry + 56)) * LevelSize;
+    footprints.resize(ReadU32(entry + 52));
+    for (TextureLevelFootprint& footprint : footprints) {
+        footprint.offset = ReadU64(record + 24);
+        footprint.format = format;
+        footprint.width = ReadU32(record + 32);
+        footprint.height = ReadU32(record + 36);
+        footprint.rowPitch = ReadU32(record + 40);
+        record += LevelSize;
+    }
+}
+
+uint64_t TexturePack::NameHash(const std::string& name) {
+    // 64-bit FNV-1a
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (char c : name) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+const uint8_t* TexturePack::Entry(uint32_t texture) const {
+    return toc + static_cast<uint64_t>(texture) * EntrySize;
+}
+
+struct TexturePackWriter::Entry {
+    uint64_t hash;
+    uint64_t offset;
+    uint64_t size;
+    uint64_t stagingBytes;
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    TextureFormat format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipLevels;
+    uint32_t firstLevel;
+};
+
+TexturePackWriter::TexturePackWriter(const std::string& packPath) : path(packPath) {
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        throw std::runtime_error("Failed to create " + path);
+    }
+    // The header is written last; the first payload starts on the next page
+    const std::vector<uint8_t> zeros(TexturePack::PayloadAlignment, 0);
+    Write(zeros.data(), zeros.size());
+}
+
+TexturePackWriter::~TexturePackWriter() {
+    if (file) {
+        std::fclose(file);
+        std::remove(path.c_str());
+    }
+}
+
+void TexturePackWriter::Add(const std::string& name, const TextureData& texture) {
+    if (!file) {
+        throw std::runtime_error(path + " is already finished");
+    }
+    if (texture.levels.empty()) {
+        throw std::runtime_error(name + " has no levels");
+    }
+    if (!added.insert(name).second) {
+        throw std::runtime_error(path + " already has a texture called " + name);
+    }
+
+    Entry entry;
+    entry.hash = TexturePack::NameHash(name);
+    entry.offset = position;
+    entry.size = 0;
+    entry.stagingBytes = TextureLoader::LevelFootprints(texture.format, texture.width, texture.height,
+        texture.MipLevels(), footprintScratch);
+    entry.nameOffset = static_cast<uint32_t>(names.size());
+    entry.nameLength = static_cast<uint32_t>(name.size());
+    entry.format = texture.format;
+    entry.width = texture.width;
+    entry.height = texture.height;
+    entry.mipLevels = texture.MipLevels();
+    entry.firstLevel = static_cast<uint32_t>(levels.size());
+
+    // A container read from a file has its headers between the levels; the pack has none
+    for (uint32_t level = 0; level < texture.MipLevels(); level++) {
+        TextureLevel stored = texture.levels[level];
+        Write(texture.LevelData(level), static_cast<size_t>(stored.Size()));
+        stored.offset = entry.size;
+        entry.size += stored.Size();
+        levels.push_back(stored);
+    }
+    const uint64_t padding = (TexturePack::PayloadAlignment - position % TexturePack::PayloadAlignment) %
+        TexturePack::PayloadAlignment;
+    const std::vector<uint8_t> zeros(static_cast<size_t>(padding), 0);
+    Write(zeros.data(), zeros.size());
+    entries.push_back(entry);
+    footprints.insert(footprints.end(), footprintScratch.begin(), footprintScratch.end());
+    names += name;
+}
+
+uint64_t TexturePackWriter::Finish() {
+    if (!file) {
+        throw std::runtime_error(path + " is already finished");
+    }
+    std::sort(entries.begin(), entries.end(), [&](const Entry& a, const Entry& b) {
+        return a.hash != b.hash ? a.hash < b.hash : names.compare(a.nameOffset, a.nameLength, names, b.nameOffset, b.nameLength) < 0;
+    });
+
+    std::vector<uint8_t> toc(entries.size() * EntrySize, 0);
+    for (size_t i = 0; i < entries.size(); i++) {
+        uint8_t* out = toc.data() + i * EntrySize;
+        const Entry& entry = entries[i];
+        PutU64(out, entry.hash);
+        PutU64(out + 8, entry.offset);
+        PutU64(out + 16, entry.size);
+        PutU64(out + 24, entry.stagingBytes);
+        PutU32(out + 32, entry.nameOffset);
+        PutU32(out + 36, entry.nameLength);
+        PutU32(out + 40, DxgiFormatValue(entry.format));
+        PutU32(out + 44, entry.width);
+        PutU32(out + 48, entry.height);
+        PutU32(out + 52, entry.mipLevels);
+        PutU32(out + 56, entry.firstLevel);
+    }
+    std::vector<uint8_t> levelTable(levels.size() * LevelSize, 0);
+    for (size_t i = 0; i < levels.size(); i++) {
+        uint8_t* out = levelTable.data() + i * LevelSize;
+        PutU64(out, levels[i].offset);
+        PutU32(out + 8, levels[i].width);
+        PutU32(out + 12, levels[i].height);
+        PutU32(out + 16, levels[i].rowBytes);
+        PutU32(out + 20, levels[i].rows);
+        PutU64(out + 24, footprints[i].offset);
+        PutU32(out + 32, footprints[i].width);
+        PutU32(out + 36, footprints[i].height);
+        PutU32(out + 40, footprints[i].rowPitch);
+    }
+
+    const uint64_t tocOffset = position;
+    Write(toc.data(), toc.size());
+    const uint64_t levelsOffset = position;
+    Write(levelTable.data(), levelTable.size());
+    const uint64_t namesOffset = position;
+    Write(names.data(), names.size());
+
+    uint8_t header[HeaderSize] = {};
+    PutU32(header, PackMagic);
+    PutU32(header + 4, PackVersion);
+    PutU32(header + 8, static_cast<uint32_t>(entries.size()));
+    PutU32(header + 12, static_cast<uint32_t>(levels.size()));
+    PutU64(header + 16, tocOffset);
+    PutU64(header + 24, levelsOffset);
+    PutU64(header + 32, namesOffset);
+    PutU64(header + 40, names.size());
+    PutU64(header + 48, position);
+    const bool written = std::fseek(file, 0, SEEK_SET) == 0 && std::fwrite(header, 1, HeaderSize, file) == HeaderSize;
+    const bool closed = std::fclose(file) == 0;
+    file = nullptr;
+    if (!written || !closed) {
+        std::remove(path.c_str());
+        throw std::runtime_error("Failed to write " + path);
+    }
+    return position;
+}
+
+void TexturePackWriter::Write(const void* data, size_t size) {
+    if (size > 0 && std::fwrite(data, 1, size, file) != size) {
+        throw std::runtime_error("Failed to write " + path);
+    }
+    position += size;
+}
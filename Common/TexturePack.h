@@ -0,0 +1,128 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "TextureContainer.h"
+#include "TextureLoader.h"
+
+// A read-only view of a whole file through mmap or MapViewOfFile; pages are read on first touch
+class MappedFile {
+public:
+    MappedFile() = default;
+    // Throws std::runtime_error if the file cannot be opened or mapped
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* Data() const { return data; }
+    uint64_t Size() const { return size; }
+
+private:
+    void Close();
+
+    const uint8_t* data = nullptr;
+    uint64_t size = 0;
+};
+
+// One texture of a pack: its payload holds every level tightly packed, largest first, the
+// way TextureData does
+struct PackedTexture {
+    TextureFormat format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipLevels;
+    const uint8_t* data;    // Into the mapped file, PayloadAlignment aligned
+    uint64_t size;
+    uint64_t stagingBytes;  // What TextureLoader::LevelFootprints returns for it
+};
+
+// Many textures in one file, laid out for startup:
+//
+//   header      magic, version, counts and where the tables are
+//   payloads    one per texture, levels tightly packed, each payload PayloadAlignment aligned
+//   TOC         fixed-size entries sorted by the 64-bit FNV-1a hash of the name: offset,
+//               size, staging size, format, size in texels, mip count and the first level
+//   levels      every level's place in its payload and its D3D12 upload footprint, in
+//               texture order
+//   names       the names the hashes came from, to tell collisions apart
+//
+// Opening maps the file and checks the tables; nothing is read per texture until its
+// payload is touched, by the one copy into staging memory. Payloads stay tightly packed
+// rather than pitched, so small textures do not carry 256-byte rows of padding from disk.
+// Find is a binary search over the hashes.
+class TexturePack {
+public:
+    // A page on every platform the samples run on, so payloads start on their own pages
+    static const uint64_t PayloadAlignment = 4096;
+    static const uint32_t NotFound = UINT32_MAX;
+
+    // Throws std::runtime_error for a file that is not a pack or whose tables point outside it
+    explicit TexturePack(const std::string& path);
+
+    uint32_t TextureCount() const { return textureCount; }
+
+    // The texture called `name`, or NotFound
+    uint32_t Find(const std::string& name) const;
+
+    std::string Name(uint32_t texture) const;
+    PackedTexture Texture(uint32_t texture) const;
+
+    // Where each level sits in the payload, offsets from PackedTexture::data
+    void Levels(uint32_t texture, std::vector<TextureLevel>& levels) const;
+
+    // Where each level goes in staging memory, as TextureLoader::LevelFootprints lays it out
+    void Footprints(uint32_t texture, std::vector<TextureLevelFootprint>& footprints) const;
+
+    uint64_t FileBytes() const { return file.Size(); }
+
+    static uint64_t NameHash(const std::string& name);
+
+private:
+    const uint8_t* Entry(uint32_t texture) const;
+
+    MappedFile file;
+    uint32_t textureCount = 0;
+    uint32_t levelCount = 0;
+    const uint8_t* toc = nullptr;
+    const uint8_t* levelTable = nullptr;
+    const uint8_t* names = nullptr;
+};
+
+// Writes a pack front to back: payloads as textures are added, the tables at the end. A
+// writer destroyed before Finish removes the partial file.
+class TexturePackWriter {
+public:
+    // Throws std::runtime_error if the file cannot be created
+    explicit TexturePackWriter(const std::string& path);
+    ~TexturePackWriter();
+
+    TexturePackWriter(const TexturePackWriter&) = delete;
+    TexturePackWriter& operator=(const TexturePackWriter&) = delete;
+
+    // Throws std::runtime_error for a name already added, or a texture without levels
+    void Add(const std::string& name, const TextureData& texture);
+
+    // Sorts the TOC and writes the tables and header; returns the file size
+    uint64_t Finish();
+
+private:
+    struct Entry;
+
+    void Write(const void* data, size_t size);
+
+    std::string path;
+    FILE* file = nullptr;
+    uint64_t position = 0;
+    std::vector<Entry> entries;
+    std::vector<TextureLevel> levels;
+    std::vector<TextureLevelFootprint> footprints;
+    std::vector<TextureLevelFootprint> footprintScratch;
+    std::string names;
+    std::unordered_set<std::string> added;
+};
@@ -0,0 +1,293 @@
+#include "TextureSampler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#if SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+    // Most and least detailed level of a trilinear sample and the weight of the second
+    struct LevelPair {
+        uint32_t first;
+        uint32_t second;
+        float weight;
+    };
+
+    LevelPair SelectLevels(const SampledTexture& texture, float lod) {
+        LevelPair pair;
+        const uint32_t last = texture.MipLevels() - 1;
+        // Also maps NaN to the most detailed level
+        lod = lod > 0.0f ? std::min(lod, static_cast<float>(last)) : 0.0f;
+        pair.first = static_cast<uint32_t>(lod);
+        pair.second = std::min(pair.first + 1, last);
+        pair.weight = lod - static_cast<float>(pair.first);
+        return pair;
+    }
+
+    // Texel coordinate and weight along one axis for WRAP addressing: [0, 1) covers the level once
+    inline float WrapCoordinate(float coordinate) {
+        float wrapped = coordinate - std::floor(coordinate);
+        // NaN and infinities sample the first texel instead of indexing out of bounds
+        return wrapped >= 0.0f && wrapped <= 1.0f ? wrapped : 0.0f;
+    }
+
+    inline void AxisTexels(float wrapped, uint32_t size, uint32_t& i0, uint32_t& i1, float& fraction) {
+        float position = wrapped * static_cast<float>(size) - 0.5f;
+        float floored = std::floor(position);
+        fraction = position - floored;
+        int32_t index = static_cast<int32_t>(floored);
+        i0 = index < 0 ? size - 1 : static_cast<uint32_t>(index);
+        i1 = i0 + 1 == size ? 0 : i0 + 1;
+    }
+
+    // The kernels weight the eight texels of both levels and sum them pairwise in the same
+    // order, so every ISA returns the same bits as long as multiply-adds are not fused
+    void SampleScalar(const SampledTexture& texture, float u, float v, float lod, float rgba[4]) {
+        const LevelPair pair = SelectLevels(texture, lod);
+        const uint32_t levelIndex[2] = { pair.first, pair.second };
+        const float levelWeight[2] = { 1.0f - pair.weight, pair.weight };
+        u = WrapCoordinate(u);
+        v = WrapCoordinate(v);
+
+        float products[4][8];
+        for (int l = 0; l < 2; l++) {
+            const SampledTexture::Level& level = texture.GetLevel(levelIndex[l]);
+            uint32_t x0, x1, y0, y1;
+            float fx, fy;
+            AxisTexels(u, level.width, x0, x1, fx);
+            AxisTexels(v, level.height, y0, y1, fy);
+
+            const uint32_t texels[4] = {
+                texture.Texels()[texture.TexelIndex(level, x0, y0)],
+                texture.Texels()[texture.TexelIndex(level, x1, y0)],
+                texture.Texels()[texture.TexelIndex(level, x0, y1)],
+                texture.Texels()[texture.TexelIndex(level, x1, y1)],
+            };
+            const float weights[4] = {
+                (1.0f - fx) * (1.0f - fy) * levelWeight[l],
+                fx * (1.0f - fy) * levelWeight[l],
+                (1.0f - fx) * fy * levelWeight[l],
+                fx * fy * levelWeight[l],
+            };
+            for (int t = 0; t < 4; t++) {
+                for (int c = 0; c < 4; c++) {
+                    products[c][l * 4 + t] = static_cast<float>((texels[t] >> (c * 8)) & 0xff) * weights[t];
+                }
+            }
+        }
+        for (int c = 0; c < 4; c++) {
+            const float* p = products[c];
+            float first = (p[0] + p[1]) + (p[2] + p[3]);
+            float second = (p[4] + p[5]) + (p[6] + p[7]);
+            rgba[c] = (first + second) * (1.0f / 255.0f);
+        }
+    }
+
+#if SIMD_X86
+    // Index -1 wraps to size - 1 and size to 0
+    SIMD_TARGET("avx2")
+    inline __m256i WrapIndexAvx2(__m256i index, __m256i size) {
+        index = _mm256_add_epi32(index, _mm256_and_si256(size, _mm256_cmpgt_epi32(_mm256_setzero_si256(), index)));
+        return _mm256_sub_epi32(index, _mm256_andnot_si256(_mm256_cmpgt_epi32(size, index), size));
+    }
+
+    // Lanes 0-3 are the corners of the first level, lanes 4-7 those of the second, in the
+    // order (x0, y0), (x1, y0), (x0, y1), (x1, y1)
+    SIMD_TARGET("avx2")
+    void SampleAvx2(const SampledTexture& texture, float u, float v, float lod, float rgba[4]) {
+        const LevelPair pair = SelectLevels(texture, lod);
+        static_assert(sizeof(SampledTexture::Level) == 16, "Level must load as four 32-bit lanes");
+        const __m256i levels = _mm256_setr_m128i(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(&texture.GetLevel(pair.first))),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(&texture.GetLevel(pair.second))));
+        const __m256i width = _mm256_permutevar8x32_epi32(levels, _mm256_setr_epi32(0, 0, 0, 0, 4, 4, 4, 4));
+        const __m256i height = _mm256_permutevar8x32_epi32(levels, _mm256_setr_epi32(1, 1, 1, 1, 5, 5, 5, 5));
+        const __m256i cornerX = _mm256_setr_epi32(0, 1, 0, 1, 0, 1, 0, 1);
+        const __m256i cornerY = _mm256_setr_epi32(0, 0, 1, 1, 0, 0, 1, 1);
+
+        // Wrap u and v into [0, 1) and find the top-left texel of every tap
+        __m256 uv = _mm256_setr_ps(u, v, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+        uv = _mm256_sub_ps(uv, _mm256_floor_ps(uv));
+        uv = _mm256_and_ps(uv, _mm256_and_ps(_mm256_cmp_ps(uv, _mm256_setzero_ps(), _CMP_GE_OQ),
+            _mm256_cmp_ps(uv, _mm256_set1_ps(1.0f), _CMP_LE_OQ)));
+        const __m256 half = _mm256_set1_ps(0.5f);
+        __m256 positionX = _mm256_sub_ps(_mm256_mul_ps(_mm256_permutevar8x32_ps(uv, _mm256_setzero_si256()), _mm256_cvtepi32_ps(width)), half);
+        __m256 positionY = _mm256_sub_ps(_mm256_mul_ps(_mm256_permutevar8x32_ps(uv, _mm256_set1_epi32(1)), _mm256_cvtepi32_ps(height)), half);
+        __m256 flooredX = _mm256_floor_ps(positionX);
+        __m256 flooredY = _mm256_floor_ps(positionY);
+        __m256 fx = _mm256_sub_ps(positionX, flooredX);
+        __m256 fy = _mm256_sub_ps(positionY, flooredY);
+
+        __m256i x = _mm256_cvttps_epi32(flooredX);
+        __m256i y = _mm256_cvttps_epi32(flooredY);
+        x = WrapIndexAvx2(x, width);
+        y = WrapIndexAvx2(y, height);
+        x = WrapIndexAvx2(_mm256_add_epi32(x, cornerX), width);
+        y = WrapIndexAvx2(_mm256_add_epi32(y, cornerY), height);
+
+        const __m256i offset = _mm256_permutevar8x32_epi32(levels, _mm256_setr_epi32(3, 3, 3, 3, 7, 7, 7, 7));
+        __m256i index;
+        if (texture.Layout() == TexelLayout::Linear) {
+            index = _mm256_add_epi32(offset, _mm256_add_epi32(_mm256_mullo_epi32(y, width), x));
+        }
+        else {
+            const __m256i tilesX = _mm256_permutevar8x32_epi32(levels, _mm256_setr_epi32(2, 2, 2, 2, 6, 6, 6, 6));
+            __m256i tile = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_srli_epi32(y, 3), tilesX), _mm256_srli_epi32(x, 3));
+            const __m256i one = _mm256_set1_epi32(1), two = _mm256_set1_epi32(2), four = _mm256_set1_epi32(4);
+            __m256i morton = _mm256_or_si256(
+                _mm256_or_si256(_mm256_and_si256(x, one), _mm256_slli_epi32(_mm256_and_si256(y, one), 1)),
+                _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(x, two), 1), _mm256_slli_epi32(_mm256_and_si256(y, two), 2)));
+            morton = _mm256_or_si256(morton, _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(x, four), 2),
+                _mm256_slli_epi32(_mm256_and_si256(y, four), 3)));
+            index = _mm256_add_epi32(_mm256_add_epi32(offset, _mm256_slli_epi32(tile, 6)), morton);
+        }
+        __m256i texels = _mm256_i32gather_epi32(reinterpret_cast<const int*>(texture.Texels()), index, 4);
+
+        // Corner weights times the level weight
+        const __m256 oneF = _mm256_set1_ps(1.0f);
+        __m256 wx = _mm256_blend_ps(_mm256_sub_ps(oneF, fx), fx, 0xaa);
+        __m256 wy = _mm256_blend_ps(_mm256_sub_ps(oneF, fy), fy, 0xcc);
+        __m256 levelWeight = _mm256_setr_ps(1.0f - pair.weight, 1.0f - pair.weight, 1.0f - pair.weight, 1.0f - pair.weight,
+            pair.weight, pair.weight, pair.weight, pair.weight);
+        __m256 weight = _mm256_mul_ps(_mm256_mul_ps(wx, wy), levelWeight);
+
+        const __m256i byteMask = _mm256_set1_epi32(0xff);
+        __m256 r = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(texels, byteMask)), weight);
+        __m256 g = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(texels, 8), byteMask)), weight);
+        __m256 b = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(texels, 16), byteMask)), weight);
+        __m256 a = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(texels, 24)), weight);
+
+        // [r g b a] sums of each level, then the two levels
+        __m256 sums = _mm256_hadd_ps(_mm256_hadd_ps(r, g), _mm256_hadd_ps(b, a));
+        __m128 color = _mm_add_ps(_mm256_castps256_ps128(sums), _mm256_extractf128_ps(sums, 1));
+        _mm_storeu_ps(rgba, _mm_mul_ps(color, _mm_set1_ps(1.0f / 255.0f)));
+    }
+#endif
+}
+
+const char* TexelLayoutName(TexelLayout layout) {
+    return layout == TexelLayout::Linear ? "linear" : "tiled";
+}
+
+bool ParseTexelLayout(const char* name, TexelLayout& layout) {
+    if (std::strcmp(name, "linear") == 0) {
+        layout = TexelLayout::Linear;
+        return true;
+    }
+    if (std::strcmp(name, "tiled") == 0) {
+        layout = TexelLayout::Tiled;
+        return true;
+    }
+    return false;
+}
+
+SampledTexture::SampledTexture(const CpuImage& image, uint32_t mipLevels, TexelLayout texelLayout)
+    : layout(texelLayout) {
+    if (image.width == 0 || image.height == 0) {
+        throw std::runtime_error("Cannot sample an empty texture");
+    }
+    uint32_t fullChain = 1;
+    for (uint32_t size = std::max(image.width, image.height); size > 1; size /= 2) {
+        fullChain++;
+    }
+    if (mipLevels == 0) {
+        mipLevels = fullChain;
+    }
+    if (mipLevels > fullChain) {
+        throw std::runtime_error("More mip levels than the texture size allows");
+    }
+
+    std::vector<CpuImage> images;
+    images.push_back(image);
+    for (uint32_t i = 1; i < mipLevels; i++) {
+        images.push_back(DownsampleImage(images.back()));
+    }
+    Store(images);
+}
+
+SampledTexture::SampledTexture(const std::vector<CpuImage>& chain, TexelLayout texelLayout)
+    : layout(texelLayout) {
+    if (chain.empty() || chain[0].width == 0 || chain[0].height == 0) {
+        throw std::runtime_error("Cannot sample an empty texture");
+    }
+    for (size_t i = 1; i < chain.size(); i++) {
+        if (chain[i].width != std::max(1u, chain[i - 1].width / 2) ||
+            chain[i].height != std::max(1u, chain[i - 1].height / 2)) {
+            throw std::runtime_error("Mip level sizes do not halve");
+        }
+    }
+    Store(chain);
+}
+
+void SampledTexture::Store(const std::vector<CpuImage>& images) {
+    size_t total = 0;
+    for (const CpuImage& level : images) {
+        Level info;
+        info.width = level.width;
+        info.height = level.height;
+        info.tilesX = (level.width + TileSize - 1) / TileSize;
+        info.offset = static_cast<uint32_t>(total);
+        levels.push_back(info);
+        total += layout == TexelLayout::Linear ? static_cast<size_t>(level.width) * level.height :
+            static_cast<size_t>(info.tilesX) * ((level.height + TileSize - 1) / TileSize) * TileTexels;
+        // Offsets are 32-bit and the gather kernel indexes texels with signed 32-bit lanes
+        if (total > 0x7fffffffu) {
+            throw std::runtime_error("Texture too large to sample");
+        }
+    }
+
+    texels.assign(total, 0);
+    for (uint32_t i = 0; i < MipLevels(); i++) {
+        for (uint32_t y = 0; y < levels[i].height; y++) {
+            const uint8_t* row = images[i].Row(y);
+            for (uint32_t x = 0; x < levels[i].width; x++) {
+                std::memcpy(&texels[TexelIndex(levels[i], x, y)], row + x * 4, 4);
+            }
+        }
+    }
+}
+
+CpuImage SampledTexture::ExtractLevel(uint32_t level) const {
+    const Level& info = levels[level];
+    CpuImage image(info.width, info.height);
+    for (uint32_t y = 0; y < info.height; y++) {
+        uint8_t* row = image.Row(y);
+        for (uint32_t x = 0; x < info.width; x++) {
+            std::memcpy(row + x * 4, &texels[TexelIndex(info, x, y)], 4);
+        }
+    }
+    return image;
+}
+
+TextureSampler::TextureSampler(SimdIsa selected) : isa(selected), sample(SampleScalar) {
+#if SIMD_X86
+    // One trilinear sample fills eight lanes, so AVX-512 runs the AVX2 kernel
+    if (isa == SimdIsa::AVX2 || isa == SimdIsa::AVX512) {
+        sample = SampleAvx2;
+    }
+#endif
+}
+
+float TextureSampler::ComputeLod(const SampledTexture& texture, float dudx, float dvdx, float dudy, float dvdy) {
+    const SampledTexture::Level& level = texture.GetLevel(0);
+    const float width = static_cast<float>(level.width);
+    const float height = static_cast<float>(level.height);
+    float lengthX = std::sqrt(dudx * width * dudx * width + dvdx * height * dvdx * height);
+    float lengthY = std::sqrt(dudy * width * dudy * width + dvdy * height * dvdy * height);
+    float lod = std::log2(std::max(lengthX, lengthY));
+    // Magnification and NaN derivatives sample the most detailed level
+    if (!(lod > 0.0f)) {
+        return 0.0f;
+    }
+    return std::min(lod, static_cast<float>(texture.MipLevels() - 1));
+}
+
+void TextureSampler::SampleQuad(const SampledTexture& texture, const float u[4], const float v[4], float rgba[4][4]) const {
+    float lod = ComputeLod(texture, u[1] - u[0], v[1] - v[0], u[2] - u[0], v[2] - v[0]);
+    for (int i = 0; i < 4; i++) {
+        sample(texture, u[i], v[i], lod, rgba[i]);
+    }
+}
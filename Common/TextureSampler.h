@@ -0,0 +1,112 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "CpuImage.h"
+#include "SimdIsa.h"
+
+// How the texels of each mip level are ordered in memory
+enum class TexelLayout {
+    Linear,     // Row-major rows, like a CpuImage
+    Tiled,      // 8x8 tiles in row-major order, texels in Morton (Z) order inside a tile
+};
+
+const char* TexelLayoutName(TexelLayout layout);
+bool ParseTexelLayout(const char* name, TexelLayout& layout);
+
+// R8G8B8A8_UNORM Texture2D with a mip chain, as the SRV of a texture created with
+// MipLevels = mipLevels. Unless a chain is passed in, the levels below the source image are
+// box-filtered 2x2 reductions, which is what GenerateMips-style compute passes produce for
+// the common power-of-two case.
+class SampledTexture {
+public:
+    static const uint32_t TileSize = 8;
+    static const uint32_t TileTexels = TileSize * TileSize;    // 256 bytes, four cache lines
+
+    // Four 32-bit fields, so a kernel can load a level as one vector
+    struct Level {
+        uint32_t width;
+        uint32_t height;
+        uint32_t tilesX;        // Tiles per tile row, Tiled layout only
+        uint32_t offset;        // First texel of the level
+    };
+
+    SampledTexture() = default;
+
+    // mipLevels = 0 builds the full chain down to 1x1, like D3D12_RESOURCE_DESC::MipLevels = 0
+    SampledTexture(const CpuImage& image, uint32_t mipLevels, TexelLayout layout);
+
+    // A chain built elsewhere, such as by MipGenerator; each level max(1, size / 2) of the one above
+    SampledTexture(const std::vector<CpuImage>& chain, TexelLayout layout);
+
+    uint32_t MipLevels() const { return static_cast<uint32_t>(levels.size()); }
+    TexelLayout Layout() const { return layout; }
+    const Level& GetLevel(uint32_t level) const { return levels[level]; }
+    const uint32_t* Texels() const { return texels.data(); }
+    size_t SizeInBytes() const { return texels.size() * sizeof(uint32_t); }
+
+    // Position of texel (x, y) of a level in Texels()
+    size_t TexelIndex(const Level& level, uint32_t x, uint32_t y) const {
+        if (layout == TexelLayout::Linear) {
+            return level.offset + static_cast<size_t>(y) * level.width + x;
+        }
+        size_t tile = static_cast<size_t>(y / TileSize) * level.tilesX + x / TileSize;
+        return level.offset + tile * TileTexels + MortonIndex(x % TileSize, y % TileSize);
+    }
+
+    // Packed R8G8B8A8 texel, red in the low byte
+    uint32_t Texel(uint32_t level, uint32_t x, uint32_t y) const { return texels[TexelIndex(levels[level], x, y)]; }
+
+    // Copies one level back into a row-major image
+    CpuImage ExtractLevel(uint32_t level) const;
+
+    // Interleaves the bits of x and y (x in the even bits) for coordinates below TileSize
+    static uint32_t MortonIndex(uint32_t x, uint32_t y) {
+        return (x & 1) | ((y & 1) << 1) | ((x & 2) << 1) | ((y & 2) << 2) | ((x & 4) << 2) | ((y & 4) << 3);
+    }
+
+private:
+    void Store(const std::vector<CpuImage>& images);
+
+    TexelLayout layout = TexelLayout::Linear;
+    std::vector<Level> levels;
+    std::vector<uint32_t> texels;
+};
+
+// D3D12_FILTER_MIN_MAG_MIP_LINEAR with D3D12_TEXTURE_ADDRESS_MODE_WRAP, MipLODBias 0, MinLOD 0
+// and MaxLOD D3D12_FLOAT32_MAX: the static sampler of the DescritorTable root signature.
+// A trilinear sample is two bilinear taps on adjacent levels, eight texels in all; the AVX2
+// and AVX-512 kernels fetch them with one gather and filter all four channels at once.
+class TextureSampler {
+public:
+    // SimdIsa::Scalar and SSE42 fetch and filter with scalar code
+    explicit TextureSampler(SimdIsa isa = DetectSimdIsa());
+
+    SimdIsa Isa() const { return isa; }
+
+    // Level of detail from the UV derivatives, scaled to texels of the most detailed level,
+    // clamped to the levels the texture has
+    static float ComputeLod(const SampledTexture& texture, float dudx, float dvdx, float dudy, float dvdy);
+
+    // Texture2D.SampleLevel
+    void SampleLevel(const SampledTexture& texture, float u, float v, float lod, float rgba[4]) const {
+        sample(texture, u, v, lod, rgba);
+    }
+
+    // Texture2D.SampleGrad
+    void SampleGrad(const SampledTexture& texture, float u, float v, float dudx, float dvdx, float dudy, float dvdy,
+        float rgba[4]) const {
+        sample(texture, u, v, ComputeLod(texture, dudx, dvdx, dudy, dvdy), rgba);
+    }
+
+    // Texture2D.Sample for the four pixels of a 2x2 quad, ordered (x, y), (x + 1, y), (x, y + 1),
+    // (x + 1, y + 1). Like the GPU, the whole quad shares one LOD from coarse derivatives:
+    // the differences along the quad's top row and left column.
+    void SampleQuad(const SampledTexture& texture, const float u[4], const float v[4], float rgba[4][4]) const;
+
+private:
+    using SampleFunction = void (*)(const SampledTexture& texture, float u, float v, float lod, float rgba[4]);
+
+    SimdIsa isa;
+    SampleFunction sample;
+};
@@ -0,0 +1,56 @@
+#include "TimelineFence.h"
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+void SimulatedGpuFence::Submit(uint64_t value, Clock::duration gpuTime) {
+    if (value <= submitted) {
+        throw std::runtime_error("Fence values must grow with every submission");
+    }
+    const Clock::time_point now = Clock::now();
+    // The queue starts the work as soon as both it and the previous work are there
+    Clock::time_point start = gpuFree;
+    if (now > gpuFree) {
+        if (submitted > 0) {
+            stats.idleTime += now - gpuFree;
+        }
+        start = now;
+    }
+    gpuFree = start + gpuTime;
+    stats.busyTime += gpuTime;
+    pending.push_back({ value, gpuFree });
+    submitted = value;
+}
+
+uint64_t SimulatedGpuFence::CompletedValue() {
+    Retire(Clock::now());
+    return completed;
+}
+
+void SimulatedGpuFence::WaitForValue(uint64_t value) {
+    if (CompletedValue() >= value) {
+        return;
+    }
+    if (value > submitted) {
+        throw std::runtime_error("Waiting for a fence value that was never submitted");
+    }
+    Clock::time_point done = pending.front().time;
+    for (const Signal& signal : pending) {
+        if (signal.value >= value) {
+            done = signal.time;
+            break;
+        }
+    }
+    const Clock::time_point before = Clock::now();
+    std::this_thread::sleep_until(done);
+    stats.waits++;
+    stats.waitTime += Clock::now() - before;
+    Retire(std::max(done, Clock::now()));
+}
+
+void SimulatedGpuFence::Retire(Clock::time_point now) {
+    while (!pending.empty() && pending.front().time <= now) {
+        completed = pending.front().value;
+        pending.pop_front();
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <deque>
+
+// The part of ID3D12Fence that CPU-side frame bookkeeping needs. Values only grow; the
+// GPU signals them in submission order.
+class TimelineFence {
+public:
+    virtual ~TimelineFence() = default;
+
+    // ID3D12Fence::GetCompletedValue
+    virtual uint64_t CompletedValue() = 0;
+
+    // SetEventOnCompletion + WaitForSingleObject: returns once CompletedValue() >= value
+    virtual void WaitForValue(uint64_t value) = 0;
+};
+
+// A fence the caller completes by hand, standing in for a GPU in checks and benchmarks.
+// WaitForValue has nothing to wait for, so it completes up to the value at once and counts
+// the wait.
+class ManualFence : public TimelineFence {
+public:
+    uint64_t CompletedValue() override { return completed; }
+
+    void WaitForValue(uint64_t value) override {
+        waits++;
+        Complete(value);
+    }
+
+    void Complete(uint64_t value) {
+        if (value > completed) {
+            completed = value;
+        }
+    }
+
+    uint64_t Waits() const { return waits; }
+
+private:
+    uint64_t completed = 0;
+    uint64_t waits = 0;
+};
+
+// A fence on a simulated GPU queue, for pacing checks and benchmarks without a device.
+// Submit queues work of a given GPU duration behind everything submitted before it, like
+// ExecuteCommandLists + Signal; the value completes once that much wall-clock time of GPU
+// work has elapsed. WaitForValue sleeps until then. Not thread-safe.
+class SimulatedGpuFence : public TimelineFence {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Stats {
+        uint64_t waits = 0;                 // WaitForValue calls that had to sleep
+        Clock::duration waitTime{};         // CPU time spent in those sleeps
+        Clock::duration busyTime{};         // GPU time of all submitted work
+        Clock::duration idleTime{};         // GPU starved between the first and last submission
+    };
+
+    // `value` must be greater than every value submitted before
+    void Submit(uint64_t value, Clock::duration gpuTime);
+
+    uint64_t CompletedValue() override;
+
+    // Throws std::runtime_error for a value nothing submitted will signal
+    void WaitForValue(uint64_t value) override;
+
+    // When the GPU runs out of submitted work
+    Clock::time_point IdleTime() const { return gpuFree; }
+    const Stats& GetStats() const { return stats; }
+
+private:
+    struct Signal {
+        uint64_t value;
+        Clock::time_point time;
+    };
+
+    void Retire(Clock::time_point now);
+
+    std::deque<Signal> pending;
+    uint64_t completed = 0;
+    uint64_t submitted = 0;
+    Clock::time_point gpuFree{};
+    Stats stats;
+};
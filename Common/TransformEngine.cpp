@@ -0,0 +1,147 @@
+#include "TransformEngine.h"
+#include "SimdMath.h"
+#include "TaskScheduler.h"
+#include <algorithm>
+
+// The AVX2 kernel has to round each product the way the scalar code does; see InstanceBuilder.cpp
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+namespace {
+    // Objects per ParallelFor item; a multiple of the AVX2 kernel's width
+    const uint32_t BlockSize = 256;
+
+    // The rotation part of the world matrix with the scale applied, in the order the AVX2
+    // kernel evaluates it. Row 1 starts with a zero and the last column is (0, 0, 0, 1).
+    struct World {
+        float m00, m01, m02;
+        float m11, m12;
+        float m20, m21, m22;
+    };
+
+    inline World ObjectWorld(const TransformArrays& objects, uint32_t i) {
+        float sy, cy, sx, cx;
+        ScalarSinCos(objects.yaw[i], sy, cy);
+        ScalarSinCos(objects.pitch[i], sx, cx);
+        const float s = objects.scale[i];
+        return { cy * s, (sy * sx) * s, -((sy * cx) * s), cx * s, sx * s, sy * s, -((cy * sx) * s), (cy * cx) * s };
+    }
+
+    void ComposeScalar(const TransformArrays& objects, const Float4x4& vp, uint32_t first, uint32_t last,
+        uint8_t* out, uint64_t stride) {
+        for (uint32_t i = first; i < last; i++) {
+            const World w = ObjectWorld(objects, i);
+            const float x = objects.x[i], y = objects.y[i], z = objects.z[i];
+            float* m = reinterpret_cast<float*>(out + i * stride);
+            for (int c = 0; c < 4; c++) {
+                m[c] = (w.m00 * vp.m[0][c] + w.m01 * vp.m[1][c]) + w.m02 * vp.m[2][c];
+                m[4 + c] = w.m11 * vp.m[1][c] + w.m12 * vp.m[2][c];
+                m[8 + c] = (w.m20 * vp.m[0][c] + w.m21 * vp.m[1][c]) + w.m22 * vp.m[2][c];
+                m[12 + c] = ((x * vp.m[0][c] + y * vp.m[1][c]) + z * vp.m[2][c]) + vp.m[3][c];
+            }
+        }
+    }
+
+#if SIMD_X86
+    SIMD_TARGET("avx2")
+    void ComposeAvx2(const TransformArrays& objects, const Float4x4& vp, uint32_t first, uint32_t last,
+        uint8_t* out, uint64_t stride) {
+        __m256 column[4][4];
+        for (int r = 0; r < 4; r++) {
+            for (int c = 0; c < 4; c++) {
+                column[r][c] = _mm256_set1_ps(vp.m[r][c]);
+            }
+        }
+        const __m256 sign = _mm256_set1_ps(-0.0f);
+        uint32_t i = first;
+        for (; i + 8 <= last; i += 8) {
+            __m256 sy, cy, sx, cx;
+            SinCosAvx2(_mm256_loadu_ps(&objects.yaw[i]), sy, cy);
+            SinCosAvx2(_mm256_loadu_ps(&objects.pitch[i]), sx, cx);
+            const __m256 s = _mm256_loadu_ps(&objects.scale[i]);
+            const __m256 x = _mm256_loadu_ps(&objects.x[i]);
+            const __m256 y = _mm256_loadu_ps(&objects.y[i]);
+            const __m256 z = _mm256_loadu_ps(&objects.z[i]);
+            const __m256 m00 = _mm256_mul_ps(cy, s);
+            const __m256 m01 = _mm256_mul_ps(_mm256_mul_ps(sy, sx), s);
+            const __m256 m02 = _mm256_xor_ps(_mm256_mul_ps(_mm256_mul_ps(sy, cx), s), sign);
+            const __m256 m11 = _mm256_mul_ps(cx, s);
+            const __m256 m12 = _mm256_mul_ps(sx, s);
+            const __m256 m20 = _mm256_mul_ps(sy, s);
+            const __m256 m21 = _mm256_xor_ps(_mm256_mul_ps(_mm256_mul_ps(cy, sx), s), sign);
+            const __m256 m22 = _mm256_mul_ps(_mm256_mul_ps(cy, cx), s);
+
+            // Element e of the eight MVPs; rows 0-1 first, then rows 2-3
+            __m256 low[8], high[8];
+            for (int c = 0; c < 4; c++) {
+                low[c] = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m00, column[0][c]), _mm256_mul_ps(m01, column[1][c])),
+                    _mm256_mul_ps(m02, column[2][c]));
+                low[4 + c] = _mm256_add_ps(_mm256_mul_ps(m11, column[1][c]), _mm256_mul_ps(m12, column[2][c]));
+                high[c] = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m20, column[0][c]), _mm256_mul_ps(m21, column[1][c])),
+                    _mm256_mul_ps(m22, column[2][c]));
+                high[4 + c] = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, column[0][c]),
+                    _mm256_mul_ps(y, column[1][c])), _mm256_mul_ps(z, column[2][c])), column[3][c]);
+            }
+            Transpose8x8Avx2(low);
+            Transpose8x8Avx2(high);
+
+            // Objects in order, so write-combined memory sees whole lines
+            uint8_t* target = out + i * stride;
+            for (int k = 0; k < 8; k++, target += stride) {
+                _mm256_storeu_ps(reinterpret_cast<float*>(target), low[k]);
+                _mm256_storeu_ps(reinterpret_cast<float*>(target) + 8, high[k]);
+            }
+        }
+        ComposeScalar(objects, vp, i, last, out, stride);
+    }
+#endif
+}
+
+void TransformArrays::Resize(uint32_t count) {
+    for (std::vector<float>* component : { &x, &y, &z, &yaw, &pitch }) {
+        component->resize(count, 0.0f);
+    }
+    scale.resize(count, 1.0f);
+}
+
+Float4x4 ObjectWorldMatrix(const TransformArrays& objects, uint32_t index) {
+    Float4x4 world = MatrixRotationY(objects.yaw[index]) * MatrixRotationX(objects.pitch[index]);
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 3; c++) {
+            world.m[r][c] *= objects.scale[index];
+        }
+    }
+    world.m[3][0] = objects.x[index];
+    world.m[3][1] = objects.y[index];
+    world.m[3][2] = objects.z[index];
+    return world;
+}
+
+TransformEngine::TransformEngine(SimdIsa selected) : isa(SimdIsa::Scalar), compose(ComposeScalar) {
+#if SIMD_X86
+    if (selected == SimdIsa::AVX2 || selected == SimdIsa::AVX512) {
+        isa = SimdIsa::AVX2;
+        compose = ComposeAvx2;
+    }
+#else
+    (void)selected;
+#endif
+}
+
+void TransformEngine::Compose(const TransformArrays& objects, const Float4x4& viewProjection, TaskScheduler& scheduler,
+    void* out, uint64_t stride) const {
+    const uint32_t count = objects.Count();
+    const uint32_t blocks = (count + BlockSize - 1) / BlockSize;
+    scheduler.ParallelFor(blocks, [&](uint32_t begin, uint32_t end) {
+        compose(objects, viewProjection, begin * BlockSize, std::min(end * BlockSize, count), static_cast<uint8_t*>(out),
+            stride);
+    }, 16);
+}
+
+UploadRing::Allocation TransformEngine::ComposeToUploadRing(const TransformArrays& objects, const Float4x4& viewProjection,
+    TaskScheduler& scheduler, UploadRing& ring, uint64_t stride) const {
+    UploadRing::Allocation allocation = ring.Allocate(std::max<uint64_t>(objects.Count() * stride, 1));
+    Compose(objects, viewProjection, scheduler, allocation.cpuAddress, stride);
+    return allocation;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "SceneMath.h"
+#include "SimdIsa.h"
+#include "UploadRing.h"
+
+class TaskScheduler;
+
+// Object transforms in structure-of-arrays form: one array per component, so a kernel loads
+// the same component of eight objects with one instruction. An object's world matrix is
+// MatrixScaling(scale) * MatrixRotationY(yaw) * MatrixRotationX(pitch) * MatrixTranslation(x, y, z),
+// the sample cube's model matrix placed in the scene.
+struct TransformArrays {
+    std::vector<float> x, y, z;
+    std::vector<float> yaw, pitch;
+    std::vector<float> scale;
+
+    void Resize(uint32_t count);
+    uint32_t Count() const { return static_cast<uint32_t>(x.size()); }
+};
+
+// The world matrix of one object through SceneMath, for checks
+Float4x4 ObjectWorldMatrix(const TransformArrays& objects, uint32_t index);
+
+// Composes world * viewProjection for every object and writes the MVPs wherever the draws
+// read them, typically mapped upload memory. The rotation's zeros and ones are folded away,
+// so a matrix costs two sine/cosine pairs, 56 multiplies and 32 adds instead of three
+// 4x4 products. The AVX2 kernel handles eight objects per iteration and returns the same bits
+// as the scalar kernel; it transposes its results so each matrix is written with two
+// 32-byte stores, objects in order. Matrices are SceneMath's Float4x4, laid out as
+// XMFLOAT4X4, so the engine builds with the headless tools where DirectXMath is not on the
+// include path; the window passes its XMMATRIX view-projection in through XMStoreFloat4x4.
+class TransformEngine {
+public:
+    // SimdIsa::AVX512 runs the AVX2 kernel, SSE42 the scalar one
+    explicit TransformEngine(SimdIsa isa = DetectSimdIsa());
+
+    // Instruction set of the kernel in use
+    SimdIsa Isa() const { return isa; }
+
+    // Objects [first, last) to out + i * stride. `stride` is a multiple of 16 and at least
+    // sizeof(Float4x4): 64 packs the matrices for root constants or a structured buffer,
+    // UploadRing::Alignment gives each one a constant buffer of its own.
+    void ComposeRange(const TransformArrays& objects, const Float4x4& viewProjection, uint32_t first, uint32_t last,
+        void* out, uint64_t stride) const {
+        compose(objects, viewProjection, first, last, static_cast<uint8_t*>(out), stride);
+    }
+
+    // Every object, split into blocks across the scheduler's threads
+    void Compose(const TransformArrays& objects, const Float4x4& viewProjection, TaskScheduler& scheduler,
+        void* out, uint64_t stride) const;
+
+    // Allocates the matrices from the current frame of the ring and composes straight into it
+    UploadRing::Allocation ComposeToUploadRing(const TransformArrays& objects, const Float4x4& viewProjection,
+        TaskScheduler& scheduler, UploadRing& ring, uint64_t stride) const;
+
+private:
+    using ComposeFunction = void (*)(const TransformArrays& objects, const Float4x4& viewProjection, uint32_t first,
+        uint32_t last, uint8_t* out, uint64_t stride);
+
+    SimdIsa isa;
+    ComposeFunction compose;
+};
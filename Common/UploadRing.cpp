@@ -0,0 +1,109 @@
+#include "UploadRing.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+    // D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT
+    const uint64_t PlacementAlignment = 65536;
+
+    uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+}
+
+UploadMemory HostUploadDevice::CreateMappedBuffer(uint64_t size) {
+    // Over-allocate so the mapped pointer can be as aligned as the GPU address
+    std::unique_ptr<uint8_t[]> storage(new uint8_t[size + UploadRing::Alignment]);
+    uintptr_t address = reinterpret_cast<uintptr_t>(storage.get());
+
+    UploadMemory memory;
+    memory.cpuAddress = reinterpret_cast<uint8_t*>(AlignUp(address, UploadRing::Alignment));
+    memory.gpuAddress = nextGpuAddress;
+    memory.size = size;
+    memory.handle = storage.get();
+    nextGpuAddress += AlignUp(size, PlacementAlignment);
+    buffers[memory.handle] = std::move(storage);
+    return memory;
+}
+
+void HostUploadDevice::ReleaseMappedBuffer(const UploadMemory& memory) {
+    buffers.erase(memory.handle);
+}
+
+UploadRing::UploadRing(UploadDevice& uploadDevice, TimelineFence& frameFence, uint32_t frameCount, uint64_t frameBytes)
+    : device(uploadDevice), fence(frameFence), partitionFence(frameCount, 0) {
+    if (frameCount == 0 || frameBytes == 0) {
+        throw std::runtime_error("An upload ring needs at least one frame and one byte per frame");
+    }
+    // Every partition starts on a placement boundary, so any alignment up to 64 KB holds
+    bytesPerFrame = AlignUp(frameBytes, PlacementAlignment);
+    memory = device.CreateMappedBuffer(bytesPerFrame * frameCount);
+    // The first BeginFrame moves to partition 0
+    frameIndex = frameCount - 1;
+}
+
+UploadRing::~UploadRing() {
+    device.ReleaseMappedBuffer(memory);
+}
+
+void UploadRing::BeginFrame() {
+    if (frameOpen) {
+        throw std::runtime_error("UploadRing::BeginFrame called twice without EndFrame");
+    }
+    frameIndex = (frameIndex + 1) % FrameCount();
+
+    // Only blocks when the CPU has lapped the GPU
+    const uint64_t pending = partitionFence[frameIndex];
+    if (fence.CompletedValue() < pending) {
+        stats.waits++;
+        fence.WaitForValue(pending);
+    }
+    offset.store(0, std::memory_order_relaxed);
+    frameOpen = true;
+}
+
+void UploadRing::EndFrame(uint64_t fenceValue) {
+    if (!frameOpen) {
+        throw std::runtime_error("UploadRing::EndFrame called without BeginFrame");
+    }
+    partitionFence[frameIndex] = fenceValue;
+    stats.peakBytesPerFrame = std::max(stats.peakBytesPerFrame, BytesUsed());
+    stats.frames++;
+    frameOpen = false;
+}
+
+UploadRing::Allocation UploadRing::Allocate(uint64_t size, uint64_t alignment) {
+    if (!frameOpen) {
+        throw std::runtime_error("UploadRing::Allocate called outside a frame");
+    }
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0 || alignment > PlacementAlignment) {
+        throw std::runtime_error("Upload alignment must be a power of two up to 64 KB");
+    }
+
+    // Sizes stay multiples of Alignment, so plain adds keep every offset aligned
+    const uint64_t rounded = ElementStride(std::max<uint64_t>(size, 1));
+    uint64_t begin;
+    if (alignment <= Alignment) {
+        begin = offset.fetch_add(rounded, std::memory_order_relaxed);
+    }
+    else {
+        uint64_t current = offset.load(std::memory_order_relaxed);
+        do {
+            begin = AlignUp(current, alignment);
+        } while (!offset.compare_exchange_weak(current, begin + rounded, std::memory_order_relaxed));
+    }
+    if (begin + rounded > bytesPerFrame) {
+        throw std::runtime_error("Upload ring frame partition exhausted");
+    }
+
+    const uint64_t position = static_cast<uint64_t>(frameIndex) * bytesPerFrame + begin;
+    Allocation allocation;
+    allocation.cpuAddress = memory.cpuAddress + position;
+    allocation.gpuAddress = memory.gpuAddress + position;
+    allocation.size = rounded;
+    return allocation;
+}
+
+uint64_t UploadRing::BytesUsed() const {
+    return std::min(offset.load(std::memory_order_relaxed), bytesPerFrame);
+}
@@ -0,0 +1,150 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <vector>
+#include "TimelineFence.h"
+
+// A persistently mapped UPLOAD buffer
+struct UploadMemory {
+    uint8_t* cpuAddress = nullptr;
+    uint64_t gpuAddress = 0;    // D3D12_GPU_VIRTUAL_ADDRESS
+    uint64_t size = 0;
+    void* handle = nullptr;     // Owned by the device that created it
+};
+
+// The device calls the upload ring needs. On D3D12: CreateCommittedResource on an UPLOAD
+// heap in GENERIC_READ, then Map once and keep the pointer until the resource is released.
+class UploadDevice {
+public:
+    virtual ~UploadDevice() = default;
+
+    virtual UploadMemory CreateMappedBuffer(uint64_t size) = 0;
+    virtual void ReleaseMappedBuffer(const UploadMemory& memory) = 0;
+};
+
+// Host memory standing in for upload heaps, with made-up GPU virtual addresses that keep
+// the 64 KB placement alignment of committed resources
+class HostUploadDevice : public UploadDevice {
+public:
+    UploadMemory CreateMappedBuffer(uint64_t size) override;
+    void ReleaseMappedBuffer(const UploadMemory& memory) override;
+
+private:
+    std::map<void*, std::unique_ptr<uint8_t[]>> buffers;
+    uint64_t nextGpuAddress = 0x100000000ull;
+};
+
+// Linear allocator over one persistently mapped upload buffer, split into a partition per
+// frame in flight. A frame bumps a pointer through its partition; EndFrame tags the
+// partition with the fence value signaled after the frame's command lists, and BeginFrame
+// waits for that value only if the GPU has not passed it by the time the partition comes
+// around again. Allocations are 256-byte aligned and sized so each one can back a CBV.
+// Allocate may be called from any number of threads between BeginFrame and EndFrame.
+class UploadRing {
+public:
+    // D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT
+    static const uint64_t Alignment = 256;
+
+    struct Allocation {
+        uint8_t* cpuAddress;
+        uint64_t gpuAddress;
+        uint64_t size;          // Rounded up to a multiple of Alignment
+    };
+
+    struct Stats {
+        uint64_t frames = 0;
+        uint64_t waits = 0;             // BeginFrame calls that found their partition still in use
+        uint64_t peakBytesPerFrame = 0;
+    };
+
+    UploadRing(UploadDevice& device, TimelineFence& fence, uint32_t frameCount, uint64_t bytesPerFrame);
+    ~UploadRing();
+
+    UploadRing(const UploadRing&) = delete;
+    UploadRing& operator=(const UploadRing&) = delete;
+
+    // Moves to the next partition, waiting for the GPU if it still reads it
+    void BeginFrame();
+
+    // `fenceValue` is signaled on the queue after every command list using this frame's memory
+    void EndFrame(uint64_t fenceValue);
+
+    // Throws std::runtime_error if the frame's partition is exhausted. `alignment` is a power
+    // of two; anything up to Alignment costs one atomic add.
+    Allocation Allocate(uint64_t size, uint64_t alignment = Alignment);
+
+    // `count` contiguous constant buffers of `elementSize` bytes each, ElementStride() apart,
+    // for one atomic add instead of `count`
+    Allocation AllocateArray(uint32_t count, uint64_t elementSize) {
+        return Allocate(count * ElementStride(elementSize));
+    }
+
+    // Allocate + memcpy of one constant buffer, e.g. a matrix
+    template <typename T>
+    Allocation AllocateConstants(const T& constants) {
+        Allocation allocation = Allocate(sizeof(T));
+        std::memcpy(allocation.cpuAddress, &constants, sizeof(T));
+        return allocation;
+    }
+
+    static uint64_t ElementStride(uint64_t size) { return (size + Alignment - 1) & ~(Alignment - 1); }
+
+    uint32_t FrameCount() const { return static_cast<uint32_t>(partitionFence.size()); }
+    uint32_t FrameIndex() const { return frameIndex; }     // Partition of the current frame
+    uint64_t BytesPerFrame() const { return bytesPerFrame; }
+    uint64_t BytesUsed() const;                             // In the current frame
+    const Stats& GetStats() const { return stats; }
+
+private:
+    UploadDevice& device;
+    TimelineFence& fence;
+    UploadMemory memory;
+    uint64_t bytesPerFrame;
+    std::vector<uint64_t> partitionFence;   // Last fence value that used each partition
+    uint32_t frameIndex = 0;
+    bool frameOpen = false;
+    std::atomic<uint64_t> offset{ 0 };      // Within the current partition
+    Stats stats;
+};
+
+// One thread's view of an UploadRing for many small allocations: it takes blocks from the
+// ring with one atomic add each and bumps through them without further synchronization.
+// A locked add per constant buffer waits for the previous constants' stores to drain.
+// Call Reset after every BeginFrame; unused space at the end of a block is wasted.
+class UploadCursor {
+public:
+    explicit UploadCursor(UploadRing& uploadRing, uint64_t blockBytes = 16384)
+        : ring(uploadRing), blockSize(UploadRing::ElementStride(blockBytes)) {}
+
+    void Reset() { block.size = used = 0; }
+
+    UploadRing::Allocation Allocate(uint64_t size) {
+        const uint64_t rounded = UploadRing::ElementStride(size > 0 ? size : 1);
+        if (used + rounded > block.size) {
+            if (rounded > blockSize) {
+                return ring.Allocate(size);
+            }
+            block = ring.Allocate(blockSize);
+            used = 0;
+        }
+        UploadRing::Allocation allocation = { block.cpuAddress + used, block.gpuAddress + used, rounded };
+        used += rounded;
+        return allocation;
+    }
+
+    template <typename T>
+    UploadRing::Allocation AllocateConstants(const T& constants) {
+        UploadRing::Allocation allocation = Allocate(sizeof(T));
+        std::memcpy(allocation.cpuAddress, &constants, sizeof(T));
+        return allocation;
+    }
+
+private:
+    UploadRing& ring;
+    uint64_t blockSize;
+    UploadRing::Allocation block = {};
+    uint64_t used = 0;
+};
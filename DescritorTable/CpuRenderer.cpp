@@ -0,0 +1,58 @@
+#include "CpuRenderer.h"
+#include "CubeMesh.h"
+
+MipOptions BlockTextureMips() {
+    MipOptions options;
+    options.filter = MipFilter::Kaiser;
+    options.srgb = true;
+    options.wrap = true;
+    return options;
+}
+
+void RenderTexturedCube(const CpuImage& texture, float time, CpuImage& target, DepthBuffer& depth) {
+    std::vector<CpuImage> chain(1, texture);
+    MipGenerator().Generate(chain, BlockTextureMips(), nullptr);
+    const SampledTexture sampled(chain, TexelLayout::Linear);
+    RenderTexturedCube(sampled, TextureSampler(), time, target, depth);
+}
+
+void RenderTexturedCube(const SampledTexture& texture, const TextureSampler& sampler, float time, CpuImage& target,
+    DepthBuffer& depth) {
+    const float clearColor[] = { 0.1f, 0.1f, 0.1f, 1.0f };
+    ClearImage(target, clearColor);
+    depth.Clear(1.0f);
+
+    const float aspect = static_cast<float>(target.width) / static_cast<float>(target.height);
+    Float4x4 model = MatrixRotationY(time) * MatrixRotationX(time * 0.5f);
+    Float4x4 view = MatrixLookAtLH({ 0.0f, 0.0f, -5.0f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f });
+    Float4x4 proj = MatrixPerspectiveFovLH(ConvertToRadians(90.0f), aspect, 0.1f, 100.0f);
+    Float4x4 mvp = model * view * proj;
+
+    // VSMain: output.pos = mul(mvp.m, float4(input.pos, 1.0)), output.uv = input.uv
+    const uint32_t vertexCount = sizeof(cubeVertices) / sizeof(cubeVertices[0]);
+    ClipVertex clipVertices[vertexCount];
+    for (uint32_t i = 0; i < vertexCount; i++) {
+        const Vertex& v = cubeVertices[i];
+        clipVertices[i].position = TransformPoint({ v.position[0], v.position[1], v.position[2] }, mvp);
+        clipVertices[i].varyings[0] = v.texCoord[0];
+        clipVertices[i].varyings[1] = v.texCoord[1];
+    }
+
+    RasterPipeline pipeline;
+    pipeline.viewport.width = static_cast<float>(target.width);
+    pipeline.viewport.height = static_cast<float>(target.height);
+    pipeline.varyingCount = 2;
+    pipeline.quadDerivatives = texture.MipLevels() > 1;
+    pipeline.pixelShader = [&texture, &sampler](const PixelInput& input, float rgba[4]) {
+        // return g_texture.Sample(samplerState, input.uv)
+        if (texture.MipLevels() == 1) {
+            sampler.SampleLevel(texture, input.varyings[0], input.varyings[1], 0.0f, rgba);
+            return;
+        }
+        sampler.SampleGrad(texture, input.varyings[0], input.varyings[1], input.ddx[0], input.ddx[1],
+            input.ddy[0], input.ddy[1], rgba);
+    };
+
+    const uint32_t indexCount = sizeof(cubeIndices) / sizeof(cubeIndices[0]);
+    DrawIndexed(pipeline, clipVertices, cubeIndices, indexCount, target, depth);
+}
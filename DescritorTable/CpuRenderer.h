@@ -0,0 +1,20 @@
+#pragma once
+#include "../Common/CpuImage.h"
+#include "../Common/MipGenerator.h"
+#include "../Common/SoftwareRasterizer.h"
+#include "../Common/TextureSampler.h"
+
+// How the texture loader builds block.png's mip chain for the window: Kaiser-filtered in
+// linear light, wrapping like the static sampler. The CPU reference builds the same chain.
+MipOptions BlockTextureMips();
+
+// One frame of UpdateAndRender on the CPU at a given animation time: clear, transform the
+// cube with model * view * proj and shade it with PSMain sampling `texture` (block.png)
+// with BlockTextureMips through the static sampler. `target` and `depth` must already
+// have the output size.
+void RenderTexturedCube(const CpuImage& texture, float time, CpuImage& target, DepthBuffer& depth);
+
+// The same frame with the texture already laid out for sampling, e.g. with another mip
+// chain or none. PSMain's Sample gets its LOD from the quad derivatives.
+void RenderTexturedCube(const SampledTexture& texture, const TextureSampler& sampler, float time, CpuImage& target,
+    DepthBuffer& depth);
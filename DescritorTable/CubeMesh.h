@@ -0,0 +1,74 @@
+#pragma once
+#include <cstdint>
+
+// Textured cube geometry shared by the D3D12 path and the CPU renderer.
+// Matches the input layout: POSITION as R32G32B32_FLOAT and TEXCOORD as R32G32_FLOAT.
+struct Vertex {
+    float position[3];
+    float texCoord[2];
+};
+
+// Four vertices per face so every face maps the whole texture
+const Vertex cubeVertices[] = {
+    // +X
+    {{+1, -1, -1}, {0, 1}}, // 0
+    {{+1, +1, -1}, {0, 0}}, // 1
+    {{+1, +1, +1}, {1, 0}}, // 2
+    {{+1, -1, +1}, {1, 1}}, // 3
+
+    // -X
+    {{-1, -1, +1}, {0, 1}}, // 4
+    {{-1, +1, +1}, {0, 0}}, // 5
+    {{-1, +1, -1}, {1, 0}}, // 6
+    {{-1, -1, -1}, {1, 1}}, // 7
+
+    // +Y
+    {{-1, +1, -1}, {0, 1}}, // 8
+    {{-1, +1, +1}, {0, 0}}, // 9
+    {{+1, +1, +1}, {1, 0}}, //10
+    {{+1, +1, -1}, {1, 1}}, //11
+
+    // -Y
+    {{-1, -1, +1}, {0, 1}}, //12
+    {{-1, -1, -1}, {0, 0}}, //13
+    {{+1, -1, -1}, {1, 0}}, //14
+    {{+1, -1, +1}, {1, 1}}, //15
+
+    // +Z
+    {{+1, -1, +1}, {0, 1}}, //16
+    {{+1, +1, +1}, {0, 0}}, //17
+    {{-1, +1, +1}, {1, 0}}, //18
+    {{-1, -1, +1}, {1, 1}}, //19
+
+    // -Z
+    {{-1, -1, -1}, {0, 1}}, //20
+    {{-1, +1, -1}, {0, 0}}, //21
+    {{+1, +1, -1}, {1, 0}}, //22
+    {{+1, -1, -1}, {1, 1}}, //23
+};
+
+const uint16_t cubeIndices[] = {
+    // +X
+    0, 1, 2,
+    0, 2, 3,
+
+    // -X
+    4, 5, 6,
+    4, 6, 7,
+
+    // +Y
+    8, 9,10,
+    8,10,11,
+
+    // -Y
+   12,13,14,
+   12,14,15,
+
+   // +Z
+  16,17,18,
+  16,18,19,
+
+  // -Z
+ 20,21,22,
+ 20,22,23,
+};
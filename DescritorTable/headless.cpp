@@ -0,0 +1,2297 @@
+// Headless mode: draws the textured cube with the CPU rasterizer and texture sampler instead of
+// a D3D12 device. On Windows it is reached through `DescritorTable.exe <options>`; on Linux build it standalone:
+//   g++ -std=c++17 -O2 -pthread headless.cpp CpuRenderer.cpp ../Common/CpuImage.cpp ../Common/DescriptorAllocator.cpp ../Common/BlockCompressor.cpp ../Common/HiZBuffer.cpp ../Common/ImageCompare.cpp ../Common/ImageFile.cpp ../Common/MipGenerator.cpp ../Common/RecordingCommandList.cpp ../Common/SimdIsa.cpp ../Common/SoftwareRasterizer.cpp ../Common/StbImage.cpp ../Common/SubresourceUpload.cpp ../Common/TaskScheduler.cpp ../Common/TextureContainer.cpp ../Common/TextureLoader.cpp ../Common/TexturePack.cpp ../Common/TextureSampler.cpp ../Common/UploadRing.cpp -o descriptor_table_headless
+#include "CpuRenderer.h"
+#include "../Common/BlockCompressor.h"
+#include "../Common/CpuImage.h"
+#include "../Common/DescriptorAllocator.h"
+#include "../Common/DrawSubmission.h"
+#include "../Common/ImageCompare.h"
+#include "../Common/ImageFile.h"
+#include "../Common/MipGenerator.h"
+#include "../Common/RecordingCommandList.h"
+#include "../Common/SimdIsa.h"
+#include "../Common/SoftwareRasterizer.h"
+#include "../Common/SubresourceUpload.h"
+#include "../Common/TaskScheduler.h"
+#include "../Common/TextureContainer.h"
+#include "../Common/TextureLoader.h"
+#include "../Common/TexturePack.h"
+#include "../Common/TextureSampler.h"
+#include "../Common/TimelineFence.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    struct HeadlessOptions {
+        uint32_t width = 800;
+        uint32_t height = 600;
+        uint32_t frames = 100;
+        MipOptions mips = BlockTextureMips();
+        uint32_t heapSize = 1000000;
+        uint32_t draws = 10000;
+        uint32_t textures = 1000;
+        float startTime = 0.0f;
+        float timeStep = 1.0f / 60.0f;
+        SimdIsa isa = DetectSimdIsa();
+        TexelLayout layout = TexelLayout::Tiled;
+        bool benchmark = false;
+        bool verify = false;
+        bool descriptors = false;
+        bool bindless = false;
+        bool loader = false;
+        bool mipgen = false;
+        bool compress = false;
+        bool container = false;
+        bool pack = false;
+        bool footprints = false;
+        std::vector<BcFormat> bcFormats;        // Empty = every format
+        std::vector<BcQuality> bcQualities;     // Empty = every preset
+        uint32_t files = 0;                     // 0 = 300 for --loader and --container, 10000 for --pack
+        std::string loaderDir;
+        std::string texturePath = "block.png";
+        std::string outputPath;
+    };
+
+    void PrintUsage() {
+        std::cout <<
+            "Usage: DescritorTable [options]\n"
+            "  --width W        output width in pixels (default 800)\n"
+            "  --height H       output height in pixels (default 600)\n"
+            "  --frames N       number of frames to render (default 100)\n"
+            "  --time T         animation time of the first frame (default 0)\n"
+            "  --dt S           time step between frames (default 1/60)\n"
+            "  --texture FILE   texture to sample (default block.png)\n"
+            "  --mips N         mip levels, 0 = full chain (default 0, as the D3D12 texture)\n"
+            "  --filter NAME    mip filter: box, kaiser or lanczos (default kaiser, as the D3D12 texture)\n"
+            "  --linear-mips    average color channels as stored instead of in linear light\n"
+            "  --layout NAME    texel layout: linear or tiled (default tiled)\n"
+            "  --isa NAME       sampler kernel: scalar, avx2 or avx512 (default: widest supported)\n"
+            "  --bench          trilinear samples and texels/s for the linear and tiled layouts per ISA\n"
+            "  --verify         check LOD selection, quad derivatives and every ISA and layout against scalar\n"
+            "  --descriptors    descriptor free list, ring and copy batch checks, then ops/s\n"
+            "  --heap N         shader-visible heap size for --descriptors (default 1000000)\n"
+            "  --bindless       per-draw CPU cost of bindless draws against a descriptor table per draw\n"
+            "  --draws N        cubes per frame for --bindless (default 10000)\n"
+            "  --textures N     distinct textures for --bindless (default 1000)\n"
+            "  --loader         texture loader checks, then textures/s and MB/s through the async pipeline\n"
+            "  --dir DIR        PNG and JPEG files for --loader (default: --files generated from --texture)\n"
+            "  --files N        textures to generate for --loader without --dir (default 300)\n"
+            "  --mipgen         mip generator checks against scalar and DownsampleImage, then 4K chains per filter and ISA\n"
+            "  --compress       block compressor checks against scalar and exact inputs, then Mpix/s, RMSE and PSNR\n"
+            "  --format NAME    block format for --compress: bc1, bc3 or bc7 (default: all)\n"
+            "  --quality NAME   encoder preset for --compress: fast, normal or best (default: all)\n"
+            "  --container      DDS and KTX2 checks, then PNG decode against container loads on the --loader files\n"
+            "                   converted to rgba8 and each --format at the first --quality\n"
+            "  --pack           texture pack checks, then startup with --files textures (default 10000) as PNG\n"
+            "                   files, DDS files and one pack, in the first --format at the first --quality\n"
+            "  --footprints     GetCopyableFootprints replica against known D3D12 layouts, subresource copies\n"
+            "                   against a reference per ISA, then GB/s into staging memory\n"
+            "  --out FILE.png   write the last frame\n";
+    }
+
+    HeadlessOptions ParseOptions(int argc, char** argv) {
+        HeadlessOptions options;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            auto next = [&]() -> const char* {
+                if (i + 1 >= argc) {
+                    throw std::runtime_error("Missing value for " + arg);
+                }
+                return argv[++i];
+            };
+
+            if (arg == "--width") options.width = static_cast<uint32_t>(std::strtoul(next(), nullptr, 10));
+            else if (arg == "--height") options.height = static_cast<uint32_t>(std::strtoul(next(), nullptr, 10));
+            else if (arg == "--frames") options.frames = static_cast<uint32_t>(std::strtoul(next(), nullptr, 10));
+            else if (arg == "--time") options.startTime = std::strtof(next(), nullptr);
+            else if (arg == "--dt") options.timeStep = std::strtof(next(), nullptr);
+            else if (arg == "--texture") options.texturePath = next();
+            else if (arg == "--mips") options.mips.mipLevels = static_cast<uint32_t>(std::strtoul(next(), nullptr, 10));
+            else if (arg == "--linear-mips") options.mips.srgb = false;
+            else if (arg == "--mipgen") options.mipgen = true;
+            else if (arg == "--compress") options.compress = true;
+            else if (arg == "--container") options.container = true;
+            else if (arg == "--pack") options.pack = true;
+            else if (arg == "--footprints") options.footprints = true;
+            else if (arg == "--out") options.outputPath = next();
+            else if (arg == "--bench") options.benchmark = true;
+            else if (arg == "--verify") options.verify = true;
+            else if (arg == "--descriptors") options.descriptors = true;
+            else if (arg == "--heap") options.heapSize = static_cast<uint32_t>(std::strtoul(next(), nullptr, 10));
+            else if (arg == "--bindless") options.bindless = true;
+            else if (arg == "--draws") options.draws = static_cast<uint32_t>(std::strtoul(next(), nullptr, 10));
+            else if (arg == "--loader") options.loader = true;
+            else if (arg == "--dir") options.loaderDir = next();
+            else if (arg == "--files") options.files = static_cast<uint32_t>(std::strtoul(next(), nullptr, 10));
+            else if (arg == "--textures") options.textures = static_cast<uint32_t>(std::strtoul(next(), nullptr, 10));
+            else if (arg == "--isa") {
+                const char* name = next();
+                if (!ParseSimdIsa(name, options.isa) || !IsSimdIsaSupported(options.isa)) {
+                    throw std::runtime_error(std::string("Unsupported ISA ") + name);
+                }
+            }
+            else if (arg == "--filter") {
+                const char* name = next();
+                if (!ParseMipFilter(name, options.mips.filter)) {
+                    throw std::runtime_error(std::string("Unknown mip filter ") + name);
+                }
+            }
+            else if (arg == "--format") {
+                const char* name = next();
+                options.bcFormats.emplace_back();
+                if (!ParseBcFormat(name, options.bcFormats.back())) {
+                    throw std::runtime_error(std::string("Unknown block format ") + name);
+                }
+            }
+            else if (arg == "--quality") {
+                const char* name = next();
+                options.bcQualities.emplace_back();
+                if (!ParseBcQuality(name, options.bcQualities.back())) {
+                    throw std::runtime_error(std::string("Unknown encoder preset ") + name);
+                }
+            }
+            else if (arg == "--layout") {
+                const char* name = next();
+                if (!ParseTexelLayout(name, options.layout)) {
+                    throw std::runtime_error(std::string("Unknown texel layout ") + name);
+                }
+            }
+            else throw std::runtime_error("Unknown option " + arg);
+        }
+        if (options.bcFormats.empty()) {
+            options.bcFormats = { BcFormat::BC1, BcFormat::BC3, BcFormat::BC7 };
+        }
+        if (options.bcQualities.empty()) {
+            options.bcQualities = { BcQuality::Fast, BcQuality::Normal, BcQuality::Best };
+        }
+        if (options.width == 0 || options.height == 0 || options.width > 16384 || options.height > 16384) {
+            throw std::runtime_error("Resolution must be between 1x1 and 16384x16384");
+        }
+        // D3D12_MAX_SHADER_VISIBLE_DESCRIPTOR_HEAP_SIZE_TIER_2; the ring takes 1/16 of it
+        if (options.heapSize < 16384 || options.heapSize > 1000000) {
+            throw std::runtime_error("Heap size must be between 16384 and 1000000 descriptors");
+        }
+        // Table per draw needs two ring descriptors per draw for every frame in flight
+        if (options.draws == 0 || options.draws > 100000 || options.textures == 0 || options.textures > 100000) {
+            throw std::runtime_error("Draws and textures must be between 1 and 100000");
+        }
+        return options;
+    }
+
+    // ISAs with their own sampling kernel; SSE4.2 would run the scalar one
+    std::vector<SimdIsa> SamplerIsas() {
+        std::vector<SimdIsa> isas;
+        for (SimdIsa isa : { SimdIsa::Scalar, SimdIsa::AVX2 }) {
+            if (IsSimdIsaSupported(isa)) {
+                isas.push_back(isa);
+            }
+        }
+        return isas;
+    }
+
+    // The source image repeated until it is at least `size` texels wide and high, so the
+    // benchmark texture does not fit in the caches
+    CpuImage RepeatImage(const CpuImage& source, uint32_t size) {
+        const uint32_t width = (size + source.width - 1) / source.width * source.width;
+        const uint32_t height = (size + source.height - 1) / source.height * source.height;
+        CpuImage image(width, height);
+        for (uint32_t y = 0; y < height; y++) {
+            const uint8_t* row = source.Row(y % source.height);
+            uint8_t* out = image.Row(y);
+            for (uint32_t x = 0; x < width; x += source.width) {
+                std::memcpy(out + x * 4, row, source.RowPitch());
+            }
+        }
+        return image;
+    }
+
+    // A screen-space walk over the texture: pixel (x, y) samples
+    // uv = origin + x * axisX + y * axisY, in texels of the most detailed level
+    struct SampleWalk {
+        const char* name;
+        float angle;            // Degrees
+        float texelsPerPixel;   // 1 = LOD 0, 2 = LOD 1, ...
+    };
+
+    double Walk(const TextureSampler& sampler, const SampledTexture& texture, const SampleWalk& walk, uint32_t size,
+        float& checksum) {
+        const SampledTexture::Level& level = texture.GetLevel(0);
+        const float radians = walk.angle * 3.14159265f / 180.0f;
+        const float scale = walk.texelsPerPixel;
+        const float axisXu = std::cos(radians) * scale / level.width, axisXv = std::sin(radians) * scale / level.height;
+        const float axisYu = -std::sin(radians) * scale / level.width, axisYv = std::cos(radians) * scale / level.height;
+
+        float sum = 0.0f;
+        auto begin = std::chrono::steady_clock::now();
+        for (uint32_t y = 0; y < size; y += 2) {
+            for (uint32_t x = 0; x < size; x += 2) {
+                float u[4], v[4], rgba[4][4];
+                for (uint32_t i = 0; i < 4; i++) {
+                    float px = static_cast<float>(x + (i & 1)) + 0.5f, py = static_cast<float>(y + (i >> 1)) + 0.5f;
+                    u[i] = px * axisXu + py * axisYu;
+                    v[i] = px * axisXv + py * axisYv;
+                }
+                sampler.SampleQuad(texture, u, v, rgba);
+                sum += rgba[0][0] + rgba[1][1] + rgba[2][2] + rgba[3][3];
+            }
+        }
+        auto end = std::chrono::steady_clock::now();
+        checksum += sum;
+        return std::chrono::duration<double>(end - begin).count();
+    }
+
+    void RunBenchmark(const CpuImage& source) {
+        const uint32_t textureSize = 4096;
+        const uint32_t screenSize = 1024;
+        static const SampleWalk walks[] = {
+            { "axis-aligned 1:1", 0.0f, 1.0f },
+            { "rotated 90 1:1", 90.0f, 1.0f },
+            { "rotated 30 1:1", 30.0f, 1.0f },
+            { "rotated 30 1:2.5", 30.0f, 2.5f },
+            { "rotated 30 4:1", 30.0f, 0.25f },
+        };
+
+        const CpuImage image = RepeatImage(source, textureSize);
+        const SampledTexture linear(image, 0, TexelLayout::Linear);
+        const SampledTexture tiled(image, 0, TexelLayout::Tiled);
+        std::printf("%ux%u texture, %u mip levels, %.1f MB linear, %.1f MB tiled; %ux%u pixels per walk\n",
+            image.width, image.height, linear.MipLevels(), linear.SizeInBytes() / 1048576.0,
+            tiled.SizeInBytes() / 1048576.0, screenSize, screenSize);
+
+        // Every trilinear sample reads eight texels, two bilinear footprints
+        const double samples = static_cast<double>(screenSize) * screenSize;
+        float checksum = 0.0f;
+        for (SimdIsa isa : SamplerIsas()) {
+            TextureSampler sampler(isa);
+            for (const SampleWalk& walk : walks) {
+                double seconds[2];
+                for (int repeat = 0; repeat < 2; repeat++) {
+                    // The first pass warms up; the second is timed
+                    seconds[0] = Walk(sampler, linear, walk, screenSize, checksum);
+                    seconds[1] = Walk(sampler, tiled, walk, screenSize, checksum);
+                }
+                std::printf("  %-7s %-18s linear %7.1f Msamples/s %7.1f Mtexels/s, tiled %7.1f Msamples/s %7.1f Mtexels/s, x%.2f\n",
+                    SimdIsaName(isa), walk.name, samples / seconds[0] * 1e-6, samples * 8 / seconds[0] * 1e-6,
+                    samples / seconds[1] * 1e-6, samples * 8 / seconds[1] * 1e-6, seconds[0] / seconds[1]);
+            }
+        }
+        std::printf("checksum %.3f\n", checksum);
+    }
+
+    // Every ISA and layout against the scalar kernel on the linear layout, at random coordinates
+    // far outside [0, 1) and random LODs including magnification and past the last level
+    bool VerifyKernels(const CpuImage& source) {
+        const SampledTexture linear(source, 0, TexelLayout::Linear);
+        const SampledTexture tiled(source, 0, TexelLayout::Tiled);
+        const TextureSampler reference(SimdIsa::Scalar);
+        std::mt19937 random(7);
+        std::uniform_real_distribution<float> coordinate(-40.0f, 40.0f);
+        std::uniform_real_distribution<float> lod(-1.0f, static_cast<float>(linear.MipLevels()) + 1.0f);
+
+        bool passed = tiled.ExtractLevel(0).pixels == source.pixels;
+        std::cout << "tiled layout round trip " << (passed ? "OK" : "FAILED") << std::endl;
+        for (SimdIsa isa : SamplerIsas()) {
+            TextureSampler sampler(isa);
+            for (const SampledTexture* texture : { &linear, &tiled }) {
+                float largest = 0.0f;
+                for (uint32_t i = 0; i < 200000; i++) {
+                    float u = coordinate(random), v = coordinate(random), l = lod(random);
+                    float expected[4], actual[4];
+                    reference.SampleLevel(linear, u, v, l, expected);
+                    sampler.SampleLevel(*texture, u, v, l, actual);
+                    for (int c = 0; c < 4; c++) {
+                        largest = std::max(largest, std::fabs(expected[c] - actual[c]));
+                    }
+                }
+                // Only multiply-add contraction may tell the kernels apart
+                bool ok = largest <= 1e-5f;
+                passed &= ok;
+                std::printf("%-7s %-6s largest difference from scalar %g %s\n", SimdIsaName(isa),
+                    TexelLayoutName(texture->Layout()), largest, ok ? "OK" : "FAILED");
+            }
+        }
+        return passed;
+    }
+
+    // A quad stepping one texel of level k per pixel selects LOD k, and sampling it at texel
+    // centers of that level returns those texels unfiltered
+    bool VerifyLodSelection(const CpuImage& source, const TextureSampler& sampler) {
+        const SampledTexture texture(source, 0, TexelLayout::Tiled);
+        const SampledTexture::Level& base = texture.GetLevel(0);
+        bool passed = true;
+        for (uint32_t level = 0; level < texture.MipLevels(); level++) {
+            const SampledTexture::Level& info = texture.GetLevel(level);
+            const float stepU = 1.0f / info.width, stepV = 1.0f / info.height;
+            // Below an odd size a level is not an exact half, so the quad also blends in the next
+            // level; only exact halves must return the texels unfiltered
+            float expectedLod = std::min(std::log2(std::max(static_cast<float>(base.width) / info.width,
+                static_cast<float>(base.height) / info.height)), static_cast<float>(texture.MipLevels() - 1));
+            const bool exact = expectedLod == static_cast<float>(level);
+            uint32_t wrong = 0;
+            float lod = 0.0f;
+            for (uint32_t y = 0; y + 1 < info.height || y == 0; y += 2) {
+                for (uint32_t x = 0; x + 1 < info.width || x == 0; x += 2) {
+                    float u[4], v[4], rgba[4][4];
+                    for (uint32_t i = 0; i < 4; i++) {
+                        u[i] = (x + (i & 1) + 0.5f) * stepU;
+                        v[i] = (y + (i >> 1) + 0.5f) * stepV;
+                    }
+                    lod = TextureSampler::ComputeLod(texture, u[1] - u[0], v[1] - v[0], u[2] - u[0], v[2] - v[0]);
+                    sampler.SampleQuad(texture, u, v, rgba);
+                    for (uint32_t i = 0; i < 4; i++) {
+                        uint32_t tx = (x + (i & 1)) % info.width, ty = (y + (i >> 1)) % info.height;
+                        uint32_t texel = texture.Texel(level, tx, ty);
+                        for (int c = 0; c < 4; c++) {
+                            // A fraction within rounding of a texel center still blends a tiny bit
+                            float expected = static_cast<float>((texel >> (c * 8)) & 0xff) / 255.0f;
+                            wrong += exact && std::fabs(rgba[i][c] - expected) > 1.0f / 255.0f;
+                        }
+                    }
+                }
+            }
+            bool ok = wrong == 0 && std::fabs(lod - expectedLod) < 1e-3f;
+            passed &= ok;
+            std::printf("level %2u %4ux%-4u LOD %.3f (expected %.3f), %u channels off %s\n", level, info.width,
+                info.height, lod, expectedLod, wrong, ok ? "OK" : "FAILED");
+        }
+        return passed;
+    }
+
+    // A screen-filling quad whose UVs are a known projective map: the rasterizer's quad
+    // derivatives must match the analytic ones at the quad's top-left pixel
+    bool VerifyQuadDerivatives() {
+        const uint32_t width = 64, height = 48;
+        // The far edge has w = 3, so u and v are not affine in screen space
+        ClipVertex vertices[4] = {};
+        const float w[4] = { 1.0f, 1.0f, 3.0f, 3.0f };
+        const float x[4] = { -1.0f, 1.0f, -1.0f, 1.0f };
+        const float y[4] = { 1.0f, 1.0f, -1.0f, -1.0f };
+        for (int i = 0; i < 4; i++) {
+            vertices[i].position = { x[i] * w[i], y[i] * w[i], 0.5f * w[i], w[i] };
+            // Affine in clip space, so u / w and v / w are affine on screen
+            vertices[i].varyings[0] = (x[i] + 1.0f) * 2.0f * w[i];
+            vertices[i].varyings[1] = (1.0f - y[i]) * 3.0f * w[i];
+        }
+        const uint16_t indices[] = { 0, 1, 2, 2, 1, 3 };
+
+        // Perspective-correct u and v at pixel center (px, py)
+        auto uvAt = [&](float px, float py, float uv[2]) {
+            float s = px / width, t = py / height;
+            float invW = (1.0f - t) / w[0] + t / w[2];
+            uv[0] = s * 4.0f / invW;
+            uv[1] = t * 6.0f / invW;
+        };
+
+        uint32_t wrong = 0, shaded = 0;
+        float largest = 0.0f;
+        RasterPipeline pipeline;
+        pipeline.rasterizer.cullMode = CullMode::None;
+        pipeline.viewport.width = static_cast<float>(width);
+        pipeline.viewport.height = static_cast<float>(height);
+        pipeline.varyingCount = 2;
+        pipeline.quadDerivatives = true;
+        pipeline.pixelShader = [&](const PixelInput& input, float rgba[4]) {
+            float qx = static_cast<float>(input.x & ~1u) + 0.5f, qy = static_cast<float>(input.y & ~1u) + 0.5f;
+            float origin[2], right[2], below[2];
+            uvAt(qx, qy, origin);
+            uvAt(qx + 1.0f, qy, right);
+            uvAt(qx, qy + 1.0f, below);
+            for (int i = 0; i < 2; i++) {
+                float error = std::max(std::fabs(input.ddx[i] - (right[i] - origin[i])),
+                    std::fabs(input.ddy[i] - (below[i] - origin[i])));
+                largest = std::max(largest, error);
+                wrong += error > 1e-4f;
+            }
+            shaded++;
+            rgba[0] = rgba[1] = rgba[2] = rgba[3] = 1.0f;
+        };
+
+        CpuImage image(width, height);
+        DepthBuffer depth;
+        depth.Resize(width, height);
+        DrawIndexed(pipeline, vertices, indices, 6, image, depth);
+
+        bool ok = wrong == 0 && shaded == width * height;
+        std::printf("quad derivatives: %u pixels, largest error %g %s\n", shaded, largest, ok ? "OK" : "FAILED");
+        return ok;
+    }
+
+    bool Verify(const HeadlessOptions& options, const CpuImage& source) {
+        bool passed = VerifyKernels(source);
+        passed &= VerifyLodSelection(source, TextureSampler(options.isa));
+        passed &= VerifyQuadDerivatives();
+        std::cout << (passed ? "All checks passed" : "Some checks FAILED") << std::endl;
+        return passed;
+    }
+
+    // A heap split the way the D3D12 path splits it: the last 1/16 is the per-frame ring
+    struct HeapRegions {
+        uint32_t persistent;
+        uint32_t transient;
+    };
+
+    HeapRegions SplitHeap(uint32_t heapSize) {
+        return { heapSize - heapSize / 16, heapSize / 16 };
+    }
+
+    // Descriptors as CopyDescriptors moves them: 32 bytes, the CBV_SRV_UAV increment of
+    // most GPUs
+    struct HostDescriptor {
+        uint64_t words[4];
+    };
+
+    void ApplyCopies(const DescriptorCopyBatch& batch, const std::vector<HostDescriptor>& staging,
+        std::vector<HostDescriptor>& heap) {
+        for (const DescriptorCopy& copy : batch.Copies()) {
+            std::memcpy(&heap[copy.destination], &staging[copy.source], copy.count * sizeof(HostDescriptor));
+        }
+    }
+
+    template <typename F>
+    bool Throws(F&& f) {
+        try {
+            f();
+        }
+        catch (const std::runtime_error&) {
+            return true;
+        }
+        return false;
+    }
+
+    // Free list: random allocate/free against a mirror of what is live, then the error cases.
+    // Ring: tables of random sizes per frame against a fence the test completes `lag` frames
+    // behind; no descriptor may be handed out again before the frame that used it retired.
+    // Copy batch: tables staged in order collapse to one range and land where they belong.
+    bool VerifyDescriptorAllocators(uint32_t heapSize) {
+        const HeapRegions regions = SplitHeap(heapSize);
+        std::mt19937 random(7);
+        bool passed = true;
+
+        {
+            DescriptorFreeList freeList(0, regions.persistent);
+            std::vector<uint8_t> live(regions.persistent, 0);
+            std::vector<uint32_t> indices;
+            uint32_t duplicates = 0, mismatched = 0;
+            for (uint32_t op = 0; op < 4 * regions.persistent; op++) {
+                const bool allocate = indices.empty() || (indices.size() < regions.persistent && random() % 8 < 5);
+                if (allocate) {
+                    const uint32_t index = freeList.Allocate();
+                    duplicates += live[index];
+                    live[index] = 1;
+                    indices.push_back(index);
+                }
+                else {
+                    const size_t pick = random() % indices.size();
+                    const uint32_t index = indices[pick];
+                    indices[pick] = indices.back();
+                    indices.pop_back();
+                    freeList.Free(index);
+                    live[index] = 0;
+                }
+            }
+            for (uint32_t i = 0; i < regions.persistent; i += 97) {
+                mismatched += freeList.IsAllocated(i) != (live[i] != 0);
+            }
+            while (freeList.AllocatedCount() < regions.persistent) {
+                const uint32_t index = freeList.Allocate();
+                duplicates += live[index];
+                live[index] = 1;
+            }
+            const bool exhausted = Throws([&] { freeList.Allocate(); });
+            freeList.Free(regions.persistent / 2);
+            const bool doubleFree = Throws([&] { freeList.Free(regions.persistent / 2); });
+            const bool outside = Throws([&] { freeList.Free(regions.persistent); });
+            const bool reused = freeList.Allocate() == regions.persistent / 2;
+
+            bool ok = duplicates == 0 && mismatched == 0 && exhausted && doubleFree && outside && reused;
+            passed &= ok;
+            std::printf("Free list of %u: %u duplicates, %u mismatches, exhaustion %s, double free %s, "
+                "out of range %s, last freed reused first %s %s\n", regions.persistent, duplicates, mismatched,
+                exhausted ? "throws" : "DOES NOT THROW", doubleFree ? "throws" : "DOES NOT THROW",
+                outside ? "throws" : "DOES NOT THROW", reused ? "yes" : "NO", ok ? "OK" : "FAILED");
+        }
+
+        const uint32_t frames = 200, tablesPerFrame = regions.transient / 4 / 32;
+        for (uint32_t lag : { 1u, 2u, frames }) {
+            ManualFence fence;
+            DescriptorRing ring(fence, regions.persistent, regions.transient);
+            // Fence value of the frame that last used each ring descriptor
+            std::vector<uint64_t> owner(regions.transient, 0);
+            uint64_t reusedEarly = 0, outside = 0;
+            for (uint32_t frame = 1; frame <= frames; frame++) {
+                for (uint32_t t = 0; t < tablesPerFrame; t++) {
+                    const uint32_t count = 1 + random() % 32;
+                    const uint32_t index = ring.Allocate(count);
+                    if (index < regions.persistent || index + count > regions.persistent + regions.transient) {
+                        outside++;
+                        continue;
+                    }
+                    for (uint32_t i = index - regions.persistent; i < index - regions.persistent + count; i++) {
+                        reusedEarly += owner[i] != 0 && owner[i] != frame && fence.CompletedValue() < owner[i];
+                        owner[i] = frame;
+                    }
+                }
+                ring.EndFrame(frame);
+                if (frame > lag) {
+                    fence.Complete(frame - lag);
+                }
+            }
+            const DescriptorRing::Stats& stats = ring.GetStats();
+            // Each frame uses up to a quarter of the ring, so only a stalled GPU forces waits
+            bool ok = reusedEarly == 0 && outside == 0 && (lag < 3 ? stats.waits == 0 : stats.waits > 0);
+            passed &= ok;
+            std::printf("Ring of %u, GPU %3u frames behind: %llu tables, %llu waits, %llu descriptors skipped at the "
+                "end, %llu reused early %s\n", regions.transient, lag, static_cast<unsigned long long>(stats.allocations),
+                static_cast<unsigned long long>(stats.waits), static_cast<unsigned long long>(stats.skipped),
+                static_cast<unsigned long long>(reusedEarly), ok ? "OK" : "FAILED");
+        }
+        {
+            ManualFence fence;
+            DescriptorRing ring(fence, 0, 64);
+            ring.Allocate(40);
+            const bool tooLarge = Throws([&] { ring.Allocate(40); });
+            ring.EndFrame(1);
+            fence.Complete(1);
+            const bool wrapped = ring.Allocate(40) == 0;
+            bool ok = tooLarge && wrapped;
+            passed &= ok;
+            std::printf("Ring overflow within one frame %s, a range that would wrap starts over %s %s\n",
+                tooLarge ? "throws" : "DOES NOT THROW", wrapped ? "yes" : "NO", ok ? "OK" : "FAILED");
+        }
+
+        {
+            std::vector<HostDescriptor> staging(regions.persistent), heap(heapSize);
+            for (uint32_t i = 0; i < regions.persistent; i++) {
+                staging[i] = { { i, ~static_cast<uint64_t>(i), i * 3ull, i * 5ull } };
+            }
+            DescriptorCopyBatch batch;
+            batch.Add(100, 5000, 8);
+            for (uint32_t i = 0; i < 8; i++) {
+                batch.Add(108 + i, 5008 + i);
+            }
+            const bool merged = batch.Copies().size() == 1 && batch.DescriptorCount() == 16;
+
+            // Scattered tables: every source descriptor lands at its destination
+            std::vector<std::pair<uint32_t, uint32_t>> expected;
+            for (uint32_t t = 0; t < 2000; t++) {
+                const uint32_t count = 1 + random() % 8;
+                const uint32_t source = random() % (regions.persistent - count);
+                const uint32_t destination = regions.persistent + t * 8 % (regions.transient - 8);
+                batch.Add(source, destination, count);
+                for (uint32_t i = 0; i < count; i++) {
+                    expected.push_back({ source + i, destination + i });
+                }
+            }
+            for (uint32_t i = 0; i < 16; i++) {
+                expected.push_back({ 100 + i, 5000 + i });
+            }
+            ApplyCopies(batch, staging, heap);
+            // Later tables may overwrite earlier ones at the same destination; check the last writer
+            std::vector<uint32_t> lastSource(heapSize, UINT32_MAX);
+            for (const DescriptorCopy& copy : batch.Copies()) {
+                for (uint32_t i = 0; i < copy.count; i++) {
+                    lastSource[copy.destination + i] = copy.source + i;
+                }
+            }
+            uint32_t wrong = 0;
+            for (const auto& pair : expected) {
+                const uint32_t source = lastSource[pair.second];
+                wrong += std::memcmp(&heap[pair.second], &staging[source], sizeof(HostDescriptor)) != 0;
+            }
+            bool ok = merged && wrong == 0;
+            passed &= ok;
+            std::printf("Copy batch: 9 adjacent copies merged into %zu range, %zu descriptors copied, %u wrong %s\n",
+                merged ? size_t(1) : batch.Copies().size(), expected.size(), wrong, ok ? "OK" : "FAILED");
+        }
+        return passed;
+    }
+
+    // Millions of operations against a full-size heap: free list churn, per-frame tables
+    // from the ring with the GPU two frames behind, and staged tables copied in batches
+    void RunDescriptorBenchmark(uint32_t heapSize) {
+        using Clock = std::chrono::steady_clock;
+        const HeapRegions regions = SplitHeap(heapSize);
+        std::mt19937 random(11);
+        std::printf("Heap of %u descriptors: %u persistent, %u per-frame ring\n", heapSize, regions.persistent,
+            regions.transient);
+
+        {
+            DescriptorFreeList freeList(0, regions.persistent);
+            std::vector<uint32_t> indices(regions.persistent);
+            auto begin = Clock::now();
+            for (uint32_t i = 0; i < regions.persistent; i++) {
+                indices[i] = freeList.Allocate();
+            }
+            double fill = std::chrono::duration<double>(Clock::now() - begin).count();
+
+            std::shuffle(indices.begin(), indices.end(), random);
+            begin = Clock::now();
+            for (uint32_t index : indices) {
+                freeList.Free(index);
+            }
+            double drain = std::chrono::duration<double>(Clock::now() - begin).count();
+
+            // Steady state: a live set of half the region, freeing a random member per allocation
+            indices.resize(regions.persistent / 2);
+            for (uint32_t& index : indices) {
+                index = freeList.Allocate();
+            }
+            std::vector<uint32_t> picks(1 << 20);
+            for (uint32_t& pick : picks) {
+                pick = random() % static_cast<uint32_t>(indices.size());
+            }
+            const uint32_t churn = 8u << 20;
+            begin = Clock::now();
+            for (uint32_t op = 0; op < churn; op++) {
+                uint32_t& slot = indices[picks[op & (picks.size() - 1)]];
+                freeList.Free(slot);
+                slot = freeList.Allocate();
+            }
+            double mixed = std::chrono::duration<double>(Clock::now() - begin).count();
+            std::printf("  free list: allocate %6.1f M/s, free in random order %6.1f M/s, churn %6.1f M alloc+free/s\n",
+                regions.persistent / fill * 1e-6, regions.persistent / drain * 1e-6, churn / mixed * 1e-6);
+        }
+
+        {
+            ManualFence fence;
+            DescriptorRing ring(fence, regions.persistent, regions.transient);
+            // Up to 8 descriptors per table and a quarter of the ring per frame
+            const uint32_t tablesPerFrame = std::min(1000u, regions.transient / 32), frames = 4000;
+            std::vector<uint32_t> sizes(tablesPerFrame);
+            for (uint32_t& size : sizes) {
+                size = 1 + random() % 8;
+            }
+            auto begin = Clock::now();
+            for (uint32_t frame = 1; frame <= frames; frame++) {
+                for (uint32_t size : sizes) {
+                    ring.Allocate(size);
+                }
+                ring.EndFrame(frame);
+                if (frame > 2) {
+                    fence.Complete(frame - 2);
+                }
+            }
+            double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+            const DescriptorRing::Stats& stats = ring.GetStats();
+            std::printf("  ring: %6.1f M tables/s, %6.1f M descriptors/s, %llu waits\n", stats.allocations / seconds * 1e-6,
+                stats.descriptors / seconds * 1e-6, static_cast<unsigned long long>(stats.waits));
+        }
+
+        {
+            std::vector<HostDescriptor> staging(regions.persistent), heap(heapSize);
+            for (uint32_t i = 0; i < regions.persistent; i++) {
+                staging[i] = { { i, i, i, i } };
+            }
+            // Tables of 1-8 descriptors staged contiguously, as a frame's materials would be,
+            // against the same descriptors staged from scattered sources
+            for (bool contiguous : { true, false }) {
+                ManualFence fence;
+                DescriptorRing ring(fence, regions.persistent, regions.transient);
+                DescriptorCopyBatch batch;
+                const uint32_t tablesPerFrame = std::min(1000u, regions.transient / 32), frames = 2000;
+                uint64_t ranges = 0;
+                uint32_t source = 0;
+                auto begin = Clock::now();
+                for (uint32_t frame = 1; frame <= frames; frame++) {
+                    for (uint32_t t = 0; t < tablesPerFrame; t++) {
+                        const uint32_t count = 1 + (t * 7 + frame) % 8;
+                        const uint32_t destination = ring.Allocate(count);
+                        if (!contiguous) {
+                            source = (source * 2654435761u + 12345) % (regions.persistent - 8);
+                        }
+                        else if (source + count > regions.persistent) {
+                            source = 0;
+                        }
+                        batch.Add(source, destination, count);
+                        source += contiguous ? count : 0;
+                    }
+                    ranges += batch.Copies().size();
+                    ApplyCopies(batch, staging, heap);
+                    batch.Clear();
+                    ring.EndFrame(frame);
+                    if (frame > 2) {
+                        fence.Complete(frame - 2);
+                    }
+                }
+                double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+                std::printf("  copy batch, %s sources: %6.1f M descriptors/s, %.0f CopyDescriptors ranges per "
+                    "frame for %u tables\n", contiguous ? "contiguous" : "scattered  ",
+                    ring.GetStats().descriptors / seconds * 1e-6, static_cast<double>(ranges) / frames, tablesPerFrame);
+            }
+        }
+    }
+
+    // Both draw paths against recording command lists, with the heap, rings and upload memory
+    // the D3D12 path uses. Each path first records one frame that is replayed to check that
+    // every draw sees its own MVP and texture, then records frames with the GPU two behind.
+    bool RunBindlessBenchmark(const HeadlessOptions& options) {
+        using Clock = std::chrono::steady_clock;
+        const uint32_t framesInFlight = 3, materialCount = 64, indexCount = 36;
+        const uint32_t drawCount = options.draws, textureCount = options.textures;
+        const uint32_t frames = std::max(20u, 2000000 / drawCount);
+
+        // Persistent region: textures; ring: a { CBV, SRV } table per draw for every frame in flight
+        const uint32_t persistent = textureCount, transient = 2 * drawCount * (framesInFlight + 1);
+        RecordingCommandList commands(persistent + transient, textureCount);
+        DescriptorFreeList persistentDescriptors(0, persistent);
+        DescriptorFreeList stagingDescriptors(0, textureCount);
+        DescriptorCopyBatch copies;
+        std::vector<uint32_t> stagingSrv(textureCount), textureSrv(textureCount);
+        for (uint32_t t = 0; t < textureCount; t++) {
+            stagingSrv[t] = stagingDescriptors.Allocate();
+            commands.CreateShaderResourceView(stagingSrv[t], 1000 + t);
+            textureSrv[t] = persistentDescriptors.Allocate();
+            copies.Add(stagingSrv[t], textureSrv[t]);
+        }
+        commands.CopyDescriptors(copies);
+        copies.Clear();
+
+        std::mt19937 random(5);
+        std::vector<DrawItem> draws(drawCount);
+        for (uint32_t i = 0; i < drawCount; i++) {
+            draws[i].transform = MatrixRotationY(i * 0.01f) * MatrixRotationX(i * 0.005f);
+            draws[i].transform.m[3][0] = static_cast<float>(i);
+            draws[i].materialIndex = i % materialCount;
+            draws[i].textureIndex = textureSrv[random() % textureCount];
+        }
+        // The table path looks textures up by slot; both see the same texture per draw
+        std::vector<uint32_t> stagingByIndex(persistent);
+        for (uint32_t t = 0; t < textureCount; t++) {
+            stagingByIndex[textureSrv[t]] = stagingSrv[t];
+        }
+
+        HostUploadDevice device;
+        const uint64_t materials = 0x200000000ull;
+        std::printf("%u draws per frame, %u textures, %u frames per path\n", drawCount, textureCount, frames);
+
+        bool passed = true;
+        for (bool bindless : { false, true }) {
+            ManualFence fence;
+            UploadRing upload(device, fence, framesInFlight,
+                static_cast<uint64_t>(drawCount) * UploadRing::Alignment + 65536);
+            UploadCursor cursor(upload);
+            DescriptorRing ring(fence, persistent, transient);
+            uint64_t fenceValue = 0;
+
+            auto recordFrame = [&]() {
+                upload.BeginFrame();
+                cursor.Reset();
+                commands.Reset();
+                if (bindless) {
+                    SubmitBindless(commands, upload, materials, 0, draws.data(), drawCount, indexCount);
+                }
+                else {
+                    SubmitTablePerDraw(commands, cursor, ring, copies, stagingByIndex.data(), draws.data(), drawCount,
+                        indexCount);
+                }
+                fenceValue++;
+                upload.EndFrame(fenceValue);
+                ring.EndFrame(fenceValue);
+                if (fenceValue > 2) {
+                    fence.Complete(fenceValue - 2);
+                }
+            };
+
+            // Root views and CBVs hold GPU addresses; the ring is one buffer, so one offset maps them back
+            upload.BeginFrame();
+            UploadRing::Allocation probe = upload.Allocate(16);
+            upload.EndFrame(0);
+            recordFrame();
+            const int64_t toCpu = reinterpret_cast<int64_t>(probe.cpuAddress) - static_cast<int64_t>(probe.gpuAddress);
+            uint32_t drawn = 0, wrongTransform = 0, wrongTexture = 0, wrongMaterial = 0;
+            commands.Replay([&](const RecordingCommandList::RootState& state, const RecordingCommandList::Draw&) {
+                const DrawItem& expected = draws[drawn++];
+                uint64_t transformAddress, texture;
+                if (bindless) {
+                    const uint32_t* constants = state.constants[BindlessDrawConstants];
+                    transformAddress = state.argument[BindlessTransforms] + constants[0] * sizeof(Float4x4);
+                    texture = commands.ShaderVisibleDescriptor(static_cast<uint32_t>(state.argument[BindlessTextures]) +
+                        constants[2]).address;
+                    wrongMaterial += constants[1] != expected.materialIndex;
+                }
+                else {
+                    const uint32_t table = static_cast<uint32_t>(state.argument[0]);
+                    transformAddress = commands.ShaderVisibleDescriptor(table).address;
+                    texture = commands.ShaderVisibleDescriptor(table + 1).address;
+                }
+                const void* transform = reinterpret_cast<const void*>(static_cast<int64_t>(transformAddress) + toCpu);
+                wrongTransform += std::memcmp(transform, &expected.transform, sizeof(Float4x4)) != 0;
+                wrongTexture += texture != commands.ShaderVisibleDescriptor(expected.textureIndex).address;
+            });
+            bool ok = drawn == drawCount && wrongTransform == 0 && wrongTexture == 0 && wrongMaterial == 0;
+            passed &= ok;
+
+            const size_t bytesPerFrame = commands.CommandBytes();
+            const uint64_t callsPerFrame = commands.Calls();
+            auto begin = Clock::now();
+            for (uint32_t frame = 0; frame < frames; frame++) {
+                recordFrame();
+            }
+            const double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+            const double perDraw = seconds * 1e9 / (static_cast<double>(frames) * drawCount);
+            std::printf("  %-15s %6.1f ns/draw, %5.2f M draws/s, %4.1f calls and %3.0f command bytes per draw, "
+                "%u draws checked %s\n", bindless ? "bindless" : "table per draw", perDraw, 1e3 / perDraw,
+                static_cast<double>(callsPerFrame) / drawCount, static_cast<double>(bytesPerFrame) / drawCount, drawn,
+                ok ? "OK" : "FAILED");
+        }
+        return passed;
+    }
+
+    // A directory of test textures from the sample's texture: every fourth file a copy of it
+    // as it is, the others recolored PNGs at 200, 400 and 800 texels square
+    std::vector<std::string> WriteLoaderTextures(const HeadlessOptions& options, const CpuImage& source) {
+        const std::filesystem::path directory = std::filesystem::temp_directory_path() / "descriptor_table_textures";
+        std::filesystem::remove_all(directory);
+        std::filesystem::create_directories(directory);
+        const CpuImage sizes[3] = { DownsampleImage(source), source, RepeatImage(source, source.width * 2) };
+        static const int channelOrder[6][3] = { { 0, 1, 2 }, { 1, 2, 0 }, { 2, 0, 1 }, { 0, 2, 1 }, { 2, 1, 0 }, { 1, 0, 2 } };
+        std::vector<std::string> paths;
+        const uint32_t count = options.files > 0 ? options.files : 300;
+        for (uint32_t i = 0; i < count; i++) {
+            char name[32];
+            std::snprintf(name, sizeof(name), "texture%04u.%s", i, i % 4 == 0 ? "jpg" : "png");
+            const std::string path = (directory / name).string();
+            if (i % 4 == 0) {
+                std::filesystem::copy_file(options.texturePath, path);
+            }
+            else {
+                CpuImage image = sizes[i % 3];
+                const int* order = channelOrder[i % 6];
+                for (size_t p = 0; p < image.pixels.size(); p += 4) {
+                    const uint8_t rgb[3] = { image.pixels[p], image.pixels[p + 1], image.pixels[p + 2] };
+                    for (int c = 0; c < 3; c++) {
+                        image.pixels[p + c] = rgb[order[c]];
+                    }
+                }
+                WritePngFile(path, image);
+            }
+            paths.push_back(path);
+        }
+        return paths;
+    }
+
+    std::vector<std::string> ListLoaderTextures(const std::string& directory) {
+        std::vector<std::string> paths;
+        for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+            std::string extension = entry.path().extension().string();
+            std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) {
+                return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            });
+            if (entry.is_regular_file() && (extension == ".png" || extension == ".jpg" || extension == ".jpeg")) {
+                paths.push_back(entry.path().string());
+            }
+        }
+        std::sort(paths.begin(), paths.end());
+        return paths;
+    }
+
+    // Every level the copy queue received against LoadImageFile and the scalar mip generator
+    // on this thread
+    bool MatchesSynchronousLoad(const HostTextureCopyQueue& queue, const TextureLoader::Resident& texture,
+        const MipOptions& mips) {
+        std::vector<CpuImage> expected(1, LoadImageFile(texture.path));
+        MipGenerator(SimdIsa::Scalar).Generate(expected, mips, nullptr);
+        if (texture.mipLevels != expected.size()) {
+            return false;
+        }
+        for (uint32_t level = 0; level < texture.mipLevels; level++) {
+            const CpuImage copied = queue.Level(texture.texture, level);
+            if (copied.width != expected[level].width || copied.height != expected[level].height ||
+                copied.pixels != expected[level].pixels) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Loader checks on a few files, then every file through the loader with one decode
+    // thread and with one per core, against decoding them one after another on this thread.
+    // The caller ticks 60 frames a second meanwhile, picking up resident textures as a
+    // render loop would.
+    bool RunLoaderBenchmark(const HeadlessOptions& options, const CpuImage& source) {
+        using Clock = std::chrono::steady_clock;
+        std::vector<std::string> paths;
+        try {
+            paths = options.loaderDir.empty() ? WriteLoaderTextures(options, source) : ListLoaderTextures(options.loaderDir);
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return false;
+        }
+        if (paths.empty()) {
+            std::cerr << "No PNG or JPEG files in " << options.loaderDir << std::endl;
+            return false;
+        }
+
+        bool passed = true;
+        {
+            // Results for good, missing and undecodable files, and a staging buffer too small
+            // for the largest texture
+            const std::string corrupt = (std::filesystem::temp_directory_path() / "descriptor_table_corrupt.png").string();
+            FILE* file = std::fopen(corrupt.c_str(), "wb");
+            if (file) {
+                std::fputs("\x89PNG not really", file);
+                std::fclose(file);
+            }
+            HostUploadDevice device;
+            HostTextureCopyQueue queue;
+            TextureLoader::Options loaderOptions;
+            loaderOptions.mips = options.mips;
+            loaderOptions.decodeThreads = 2;
+            loaderOptions.stagingBytes = 1 << 20;
+            loaderOptions.batchBytes = 256 << 10;
+            const size_t checked = std::min<size_t>(paths.size(), 24);
+            std::vector<TextureLoader::Resident> results;
+            {
+                TextureLoader loader(device, queue, loaderOptions);
+                for (size_t i = 0; i < checked; i++) {
+                    loader.Load(paths[i]);
+                }
+                loader.Load("missing.png");
+                loader.Load(corrupt);
+                loader.WaitForIdle();
+                results = loader.TakeResident();
+            }
+            std::remove(corrupt.c_str());
+            std::sort(results.begin(), results.end(), [](const TextureLoader::Resident& a, const TextureLoader::Resident& b) {
+                return a.texture < b.texture;
+            });
+
+            uint32_t matched = 0, tooLarge = 0;
+            bool complete = results.size() == checked + 2;
+            for (size_t i = 0; complete && i < checked; i++) {
+                if (results[i].error.empty()) {
+                    matched += MatchesSynchronousLoad(queue, results[i], options.mips);
+                }
+                else {
+                    std::vector<TextureLevelFootprint> footprints;
+                    const CpuImage image = LoadImageFile(paths[i]);
+                    const uint32_t mipLevels = options.mips.mipLevels ? options.mips.mipLevels :
+                        MipGenerator::FullChainLevels(image.width, image.height);
+                    tooLarge += TextureLoader::LevelFootprints(TextureFormat::R8G8B8A8, image.width, image.height, mipLevels,
+                        footprints) > loaderOptions.stagingBytes;
+                }
+            }
+            const bool failures = complete && !results[checked].error.empty() && !results[checked + 1].error.empty();
+            std::printf("%zu files: %u loaded and identical to a synchronous load, %u too large for 1 MB of staging, "
+                "missing and corrupt files %s; %llu batches\n", checked, matched, tooLarge,
+                failures ? "reported" : "NOT REPORTED", static_cast<unsigned long long>(queue.Submissions()));
+            passed &= complete && failures && matched + tooLarge == checked;
+        }
+
+        // The synchronous baseline: what LoadAssets does, one file after another
+        auto begin = Clock::now();
+        uint64_t baselineBytes = 0;
+        const MipGenerator mipGenerator;
+        for (const std::string& path : paths) {
+            std::vector<CpuImage> levels(1, LoadImageFile(path));
+            mipGenerator.Generate(levels, options.mips, nullptr);
+            for (const CpuImage& level : levels) {
+                baselineBytes += level.pixels.size();
+            }
+        }
+        const double baseline = std::chrono::duration<double>(Clock::now() - begin).count();
+        std::printf("%zu files, synchronous stbi_load and mips: %.1f textures/s, %.1f MB/s of texels\n", paths.size(),
+            paths.size() / baseline, baselineBytes / baseline / 1048576.0);
+
+        const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+        const std::vector<unsigned> threadCounts = cores > 1 ? std::vector<unsigned>{ 1, cores } : std::vector<unsigned>{ 1 };
+        for (unsigned threads : threadCounts) {
+            HostUploadDevice device;
+            HostTextureCopyQueue queue;
+            TextureLoader::Options loaderOptions;
+            loaderOptions.mips = options.mips;
+            loaderOptions.decodeThreads = threads;
+            TextureLoader loader(device, queue, loaderOptions);
+
+            begin = Clock::now();
+            for (const std::string& path : paths) {
+                loader.Load(path);
+            }
+            // A frame every 16.7 ms until everything is resident
+            size_t resident = 0;
+            uint32_t frames = 0;
+            double firstResident = 0.0;
+            while (resident < paths.size()) {
+                const size_t arrived = loader.TakeResident().size();
+                if (arrived > 0 && resident == 0) {
+                    firstResident = std::chrono::duration<double>(Clock::now() - begin).count();
+                }
+                resident += arrived;
+                if (resident < paths.size()) {
+                    std::this_thread::sleep_until(begin + std::chrono::microseconds(16667 * ++frames));
+                }
+            }
+            const double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+            const TextureLoader::Stats stats = loader.GetStats();
+            std::printf("  %2u decode threads: %7.1f textures/s, %6.1f MB/s of files, %6.1f MB/s of texels; first "
+                "resident after %.1f ms, %u frames ticked, %llu batches, %llu staging waits\n", threads,
+                paths.size() / seconds, stats.fileBytes / seconds / 1048576.0, stats.texelBytes / seconds / 1048576.0,
+                firstResident * 1e3, frames, static_cast<unsigned long long>(stats.batches),
+                static_cast<unsigned long long>(stats.stagingWaits));
+            std::printf("    thread time: read %.3f s, decode %.3f s, mips %.3f s, upload %.3f s; %llu failed\n",
+                stats.readSeconds, stats.decodeSeconds, stats.mipSeconds, stats.uploadSeconds,
+                static_cast<unsigned long long>(stats.failed));
+            passed &= stats.failed == 0;
+        }
+        return passed;
+    }
+
+    bool SameImages(const std::vector<CpuImage>& a, const std::vector<CpuImage>& b) {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); i++) {
+            if (a[i].width != b[i].width || a[i].height != b[i].height || a[i].pixels != b[i].pixels) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Noise images of awkward sizes through every filter, color space and edge mode: the
+    // AVX2 kernels and the row blocks of a scheduler against one scalar pass, box filtering
+    // without sRGB against DownsampleImage, flat images staying flat and a black and white
+    // checkerboard averaging to sRGB 188 in linear light
+    bool VerifyMipGenerator() {
+        std::mt19937 random(13);
+        std::uniform_int_distribution<int> byte(0, 255);
+        const MipGenerator reference(SimdIsa::Scalar);
+        TaskScheduler scheduler(4);
+        bool passed = true;
+
+        const uint32_t sizes[][2] = { { 1, 1 }, { 2, 2 }, { 3, 5 }, { 7, 1 }, { 33, 17 }, { 256, 256 }, { 513, 300 } };
+        uint32_t chains = 0, mismatches = 0, downsampleMismatches = 0;
+        for (const auto& size : sizes) {
+            CpuImage image(size[0], size[1]);
+            for (uint8_t& value : image.pixels) {
+                value = static_cast<uint8_t>(byte(random));
+            }
+            for (MipFilter filter : { MipFilter::Box, MipFilter::Kaiser, MipFilter::Lanczos }) {
+                for (int mode = 0; mode < 4; mode++) {
+                    MipOptions mips;
+                    mips.filter = filter;
+                    mips.srgb = (mode & 1) != 0;
+                    mips.wrap = (mode & 2) != 0;
+                    std::vector<CpuImage> expected(1, image);
+                    reference.Generate(expected, mips, nullptr);
+                    for (SimdIsa isa : SamplerIsas()) {
+                        std::vector<CpuImage> levels(1, image);
+                        MipGenerator(isa).Generate(levels, mips, &scheduler);
+                        mismatches += !SameImages(levels, expected);
+                        chains++;
+                    }
+                    if (filter == MipFilter::Box && !mips.srgb) {
+                        std::vector<CpuImage> boxed(1, image);
+                        while (boxed.back().width > 1 || boxed.back().height > 1) {
+                            boxed.push_back(DownsampleImage(boxed.back()));
+                        }
+                        downsampleMismatches += !SameImages(boxed, expected);
+                    }
+                }
+            }
+        }
+        std::printf("%u chains, every ISA with 4 threads against scalar: %u mismatches %s\n", chains, mismatches,
+            mismatches == 0 ? "OK" : "FAILED");
+        std::printf("box without sRGB against DownsampleImage: %u mismatches %s\n", downsampleMismatches,
+            downsampleMismatches == 0 ? "OK" : "FAILED");
+        passed &= mismatches == 0 && downsampleMismatches == 0;
+
+        CpuImage flat(45, 29);
+        const uint8_t color[4] = { 200, 100, 30, 128 };
+        for (size_t i = 0; i < flat.pixels.size(); i++) {
+            flat.pixels[i] = color[i % 4];
+        }
+        CpuImage checkerboard(64, 64);
+        for (uint32_t y = 0; y < checkerboard.height; y++) {
+            for (uint32_t x = 0; x < checkerboard.width; x++) {
+                std::memset(checkerboard.Row(y) + x * 4, (x + y) % 2 ? 255 : 0, 3);
+                checkerboard.Row(y)[x * 4 + 3] = 255;
+            }
+        }
+        for (MipFilter filter : { MipFilter::Box, MipFilter::Kaiser, MipFilter::Lanczos }) {
+            for (bool srgb : { false, true }) {
+                MipOptions mips;
+                mips.filter = filter;
+                mips.srgb = srgb;
+                std::vector<CpuImage> levels(1, flat);
+                MipGenerator().Generate(levels, mips, nullptr);
+                bool stayedFlat = levels.size() == 6 && levels.back().width == 1 && levels.back().height == 1;
+                for (const CpuImage& level : levels) {
+                    for (size_t i = 0; i < level.pixels.size(); i++) {
+                        stayedFlat &= level.pixels[i] == color[i % 4];
+                    }
+                }
+                levels.assign(1, checkerboard);
+                mips.mipLevels = 2;
+                MipGenerator().Generate(levels, mips, nullptr);
+                const uint8_t gray = levels[1].pixels[0];
+                // Sinc filters cancel the checkerboard's frequency only up to their ripple
+                const uint8_t expected = srgb ? 188 : 128;
+                const bool averaged = filter == MipFilter::Box ? gray == expected : std::abs(gray - expected) <= 2;
+                std::printf("%-7s %-6s flat image %s, checkerboard averages to %u %s\n", MipFilterName(filter),
+                    srgb ? "sRGB" : "linear", stayedFlat ? "stays flat" : "CHANGED", gray,
+                    averaged ? "OK" : "FAILED");
+                passed &= stayedFlat && averaged;
+            }
+        }
+        return passed;
+    }
+
+    // Full chains of a 4K texture: milliseconds per filter, color space, ISA and thread count
+    void RunMipBenchmark(const CpuImage& source) {
+        using Clock = std::chrono::steady_clock;
+        const CpuImage repeated = RepeatImage(source, 4096);
+        CpuImage image(4096, 4096);
+        for (uint32_t y = 0; y < image.height; y++) {
+            std::memcpy(image.Row(y), repeated.Row(y), image.RowPitch());
+        }
+        const double megapixels = static_cast<double>(image.width) * image.height / 1e6;
+        const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+        const std::vector<unsigned> threadCounts = cores > 1 ? std::vector<unsigned>{ 1, cores } : std::vector<unsigned>{ 1 };
+        std::printf("%ux%u texture, %u levels; best of 5 runs\n", image.width, image.height,
+            MipGenerator::FullChainLevels(image.width, image.height));
+
+        auto best = [&](const std::function<void()>& run) {
+            double fastest = 1e30;
+            for (int i = 0; i < 5; i++) {
+                const auto begin = Clock::now();
+                run();
+                fastest = std::min(fastest, std::chrono::duration<double>(Clock::now() - begin).count());
+            }
+            return fastest;
+        };
+        const double baseline = best([&] {
+            CpuImage level = DownsampleImage(image);
+            while (level.width > 1 || level.height > 1) {
+                level = DownsampleImage(level);
+            }
+        });
+        std::printf("  DownsampleImage chain:        %8.2f ms, %7.1f Mpix/s\n", baseline * 1e3, megapixels / baseline);
+
+        for (MipFilter filter : { MipFilter::Box, MipFilter::Kaiser, MipFilter::Lanczos }) {
+            for (bool srgb : { false, true }) {
+                MipOptions mips;
+                mips.filter = filter;
+                mips.srgb = srgb;
+                for (SimdIsa isa : SamplerIsas()) {
+                    const MipGenerator generator(isa);
+                    for (unsigned threads : threadCounts) {
+                        TaskScheduler scheduler(threads);
+                        std::vector<CpuImage> levels(1, image);
+                        const double seconds = best([&] {
+                            levels.resize(1);
+                            generator.Generate(levels, mips, threads > 1 ? &scheduler : nullptr);
+                        });
+                        std::printf("  %-7s %-6s %-6s %2u threads: %8.2f ms, %7.1f Mpix/s\n", MipFilterName(filter),
+                            srgb ? "sRGB" : "linear", SimdIsaName(isa), threads, seconds * 1e3, megapixels / seconds);
+                    }
+                }
+            }
+        }
+    }
+
+    // Noise and texture crops of awkward sizes: every ISA with a scheduler against one scalar
+    // pass, then inputs with an exact encoding (flat blocks of representable colors), the
+    // partition table and the presets ranking by PSNR on the texture
+    bool VerifyBlockCompressor(const CpuImage& source) {
+        std::mt19937 random(29);
+        std::uniform_int_distribution<int> byte(0, 255);
+        const BlockCompressor reference(SimdIsa::Scalar);
+        TaskScheduler scheduler(4);
+        const BcFormat formats[] = { BcFormat::BC1, BcFormat::BC3, BcFormat::BC7 };
+        const BcQuality qualities[] = { BcQuality::Fast, BcQuality::Normal, BcQuality::Best };
+        bool passed = true;
+
+        const CpuImage texture = RepeatImage(source, 128);
+        const uint32_t sizes[][2] = { { 1, 1 }, { 4, 4 }, { 37, 29 }, { 128, 64 } };
+        uint32_t images = 0, mismatches = 0, undecodable = 0;
+        for (const auto& size : sizes) {
+            for (bool noise : { true, false }) {
+                CpuImage image(size[0], size[1]);
+                for (uint32_t y = 0; y < image.height; y++) {
+                    for (uint32_t x = 0; x < image.width * 4; x++) {
+                        image.Row(y)[x] = noise ? static_cast<uint8_t>(byte(random)) : texture.Row(y)[x];
+                    }
+                }
+                for (BcFormat format : formats) {
+                    for (BcQuality quality : qualities) {
+                        const CompressedImage expected = reference.Compress(image, format, quality, nullptr);
+                        for (SimdIsa isa : SamplerIsas()) {
+                            const CompressedImage blocks = BlockCompressor(isa).Compress(image, format, quality, &scheduler);
+                            mismatches += blocks.blocks != expected.blocks;
+                            images++;
+                        }
+                        undecodable += Throws([&] { DecompressImage(expected); });
+                    }
+                }
+            }
+        }
+        std::printf("%u images, every ISA with 4 threads against scalar: %u mismatches, %u undecodable %s\n", images,
+            mismatches, undecodable, mismatches == 0 && undecodable == 0 ? "OK" : "FAILED");
+        passed &= mismatches == 0 && undecodable == 0;
+
+        // BC1 and BC3 colors exact in 5:6:5, BC3 alpha any value and BC7 channels of one parity,
+        // which one 7-bit endpoint and its p-bit store
+        for (BcFormat format : formats) {
+            uint32_t blocks = 0, inexact = 0;
+            for (int i = 0; i < 64; i++) {
+                uint8_t color[4];
+                for (uint8_t& value : color) {
+                    value = static_cast<uint8_t>(byte(random));
+                }
+                if (format == BcFormat::BC7) {
+                    for (uint8_t& value : color) {
+                        value = static_cast<uint8_t>((value & ~1) | (color[0] & 1));
+                    }
+                }
+                else {
+                    color[0] = static_cast<uint8_t>(((color[0] >> 3) << 3) | (color[0] >> 5));
+                    color[1] = static_cast<uint8_t>(((color[1] >> 2) << 2) | (color[1] >> 6));
+                    color[2] = static_cast<uint8_t>(((color[2] >> 3) << 3) | (color[2] >> 5));
+                    color[3] = format == BcFormat::BC1 ? 255 : color[3];
+                }
+                CpuImage flat(8, 4);
+                for (size_t j = 0; j < flat.pixels.size(); j++) {
+                    flat.pixels[j] = color[j % 4];
+                }
+                for (BcQuality quality : qualities) {
+                    inexact += DecompressImage(reference.Compress(flat, format, quality, nullptr)).pixels != flat.pixels;
+                    blocks += 2;
+                }
+            }
+            std::printf("%s: %u flat blocks of representable colors, %u inexact %s\n", BcFormatName(format), blocks,
+                inexact, inexact == 0 ? "OK" : "FAILED");
+            passed &= inexact == 0;
+        }
+
+        // Transparent texels in BC1 come back as transparent black, the others opaque
+        CpuImage cutout(4, 4);
+        for (uint32_t t = 0; t < 16; t++) {
+            const uint8_t texel[4] = { 255, static_cast<uint8_t>(t * 16), 0, static_cast<uint8_t>(t % 3 ? 255 : 0) };
+            std::memcpy(cutout.pixels.data() + t * 4, texel, 4);
+        }
+        const CpuImage cutoutDecoded = DecompressImage(reference.Compress(cutout, BcFormat::BC1, BcQuality::Normal, nullptr));
+        uint32_t wrongAlpha = 0;
+        for (uint32_t t = 0; t < 16; t++) {
+            const uint8_t* texel = cutoutDecoded.pixels.data() + t * 4;
+            wrongAlpha += t % 3 ? texel[3] != 255 : (texel[0] | texel[1] | texel[2] | texel[3]) != 0;
+        }
+        std::printf("bc1 punch-through alpha: %u wrong texels %s\n", wrongAlpha, wrongAlpha == 0 ? "OK" : "FAILED");
+        passed &= wrongAlpha == 0;
+
+        const CpuImage crop = RepeatImage(source, 256);
+        for (BcFormat format : formats) {
+            double previous = 0.0;
+            bool ranked = true;
+            std::printf("%s PSNR on %ux%u of the texture:", BcFormatName(format), crop.width, crop.height);
+            for (BcQuality quality : qualities) {
+                const double psnr = CompareImages(DecompressImage(reference.Compress(crop, format, quality, &scheduler)),
+                    crop, 0).psnr;
+                // Presets minimize RGBA error, so RGB alone may lose a little
+                ranked &= psnr >= previous - 0.05;
+                previous = psnr;
+                std::printf(" %s %.2f dB", BcQualityName(quality), psnr);
+            }
+            std::printf(" %s\n", ranked ? "OK" : "FAILED");
+            passed &= ranked;
+        }
+        return passed;
+    }
+
+    // Encode throughput, error against the source and the memory a compressed chain saves,
+    // per format, preset, ISA and thread count on a 1024x1024 texture
+    void RunCompressBenchmark(const HeadlessOptions& options, const CpuImage& source) {
+        using Clock = std::chrono::steady_clock;
+        const CpuImage repeated = RepeatImage(source, 1024);
+        CpuImage image(1024, 1024);
+        for (uint32_t y = 0; y < image.height; y++) {
+            std::memcpy(image.Row(y), repeated.Row(y), image.RowPitch());
+        }
+        const double megapixels = static_cast<double>(image.width) * image.height / 1e6;
+        const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+        const std::vector<unsigned> threadCounts = cores > 1 ? std::vector<unsigned>{ 1, cores } : std::vector<unsigned>{ 1 };
+        std::printf("%ux%u texture; best of 3 runs\n", image.width, image.height);
+
+        for (BcFormat format : options.bcFormats) {
+            uint64_t uncompressed = 0, compressed = 0;
+            for (uint32_t w = image.width, h = image.height;; w = std::max(1u, w / 2), h = std::max(1u, h / 2)) {
+                uncompressed += BlockCompressor::UncompressedLevelBytes(w, h);
+                compressed += BlockCompressor::LevelBytes(format, w, h);
+                if (w == 1 && h == 1) {
+                    break;
+                }
+            }
+            std::printf("  %s full chain: %.2f MB as R8G8B8A8, %.2f MB compressed, %.2f MB saved (%.0f%%)\n",
+                BcFormatName(format), uncompressed / 1e6, compressed / 1e6, (uncompressed - compressed) / 1e6,
+                100.0 * (uncompressed - compressed) / uncompressed);
+            for (BcQuality quality : options.bcQualities) {
+                for (SimdIsa isa : SamplerIsas()) {
+                    const BlockCompressor compressor(isa);
+                    for (unsigned threads : threadCounts) {
+                        TaskScheduler scheduler(threads);
+                        CompressedImage blocks;
+                        double fastest = 1e30;
+                        for (int i = 0; i < 3; i++) {
+                            const auto begin = Clock::now();
+                            blocks = compressor.Compress(image, format, quality, threads > 1 ? &scheduler : nullptr);
+                            fastest = std::min(fastest, std::chrono::duration<double>(Clock::now() - begin).count());
+                        }
+                        const ImageDifference difference = CompareImages(DecompressImage(blocks), image, 0);
+                        std::printf("  %s %-6s %-6s %2u threads: %8.2f ms, %7.2f Mpix/s, RMSE %.3f, PSNR %.2f dB\n",
+                            BcFormatName(format), BcQualityName(quality), SimdIsaName(isa), threads, fastest * 1e3,
+                            megapixels / fastest, difference.rmse, difference.psnr);
+                    }
+                }
+            }
+        }
+    }
+
+    // Round trips of every format through both containers, files other writers produce and
+    // files the reader must refuse, then containers through the loader: what reaches the
+    // copy queue must be the stored levels, byte for byte
+    bool VerifyTextureContainers(const CpuImage& source) {
+        bool passed = true;
+        // Not square and not a power of two, so levels go down to 1x1 through odd sizes
+        CpuImage image(60, 36);
+        for (uint32_t y = 0; y < image.height; y++) {
+            std::memcpy(image.Row(y), source.Row(y), image.RowPitch());
+        }
+        std::vector<CpuImage> chain(1, image);
+        MipGenerator().Generate(chain, BlockTextureMips(), nullptr);
+
+        const TextureFormat formats[] = { TextureFormat::R8G8B8A8, TextureFormat::BC1, TextureFormat::BC3, TextureFormat::BC7 };
+        std::vector<TextureData> textures;
+        for (TextureFormat format : formats) {
+            textures.push_back(BuildTextureData(chain, format, BcQuality::Fast, nullptr));
+            const TextureData& texture = textures.back();
+            bool decoded = texture.MipLevels() == chain.size();
+            for (uint32_t level = 0; decoded && level < texture.MipLevels(); level++) {
+                const CpuImage stored = TextureLevelImage(texture, level);
+                decoded = stored.width == chain[level].width && stored.height == chain[level].height &&
+                    (format != TextureFormat::R8G8B8A8 || stored.pixels == chain[level].pixels);
+            }
+            for (ContainerType type : { ContainerType::Dds, ContainerType::Ktx2 }) {
+                const std::vector<uint8_t> file = WriteTextureContainer(texture, type);
+                const TextureData read = ReadTextureContainer(file, "round trip");
+                bool same = read.format == format && read.width == texture.width && read.height == texture.height &&
+                    read.MipLevels() == texture.MipLevels();
+                for (uint32_t level = 0; same && level < read.MipLevels(); level++) {
+                    same = read.levels[level].Size() == texture.levels[level].Size() &&
+                        std::memcmp(read.LevelData(level), texture.LevelData(level), texture.levels[level].Size()) == 0;
+                }
+                // Reading points into the file, so writing what was read gives the same file
+                same &= WriteTextureContainer(read, type) == file;
+                std::printf("%-5s %-4s %ux%u, %u levels, %zu bytes: round trip %s, levels %s\n", TextureFormatName(format),
+                    ContainerTypeName(type), texture.width, texture.height, texture.MipLevels(), file.size(),
+                    same ? "OK" : "FAILED", decoded ? "OK" : "FAILED");
+                passed &= same && decoded;
+            }
+        }
+
+        // A legacy DXT5 header instead of DX10 reads as BC3
+        std::vector<uint8_t> legacy = WriteTextureContainer(textures[2], ContainerType::Dds);
+        legacy.erase(legacy.begin() + 128, legacy.begin() + 148);
+        std::memcpy(legacy.data() + 84, "DXT5", 4);
+        const TextureData legacyRead = ReadTextureContainer(legacy, "legacy");
+        const bool legacyOk = legacyRead.format == TextureFormat::BC3 && legacyRead.MipLevels() == textures[2].MipLevels() &&
+            std::memcmp(legacyRead.LevelData(0), textures[2].LevelData(0), textures[2].levels[0].Size()) == 0;
+
+        // Truncated files, unknown formats, cube maps, arrays and supercompression
+        const std::vector<uint8_t> dds = WriteTextureContainer(textures[3], ContainerType::Dds);
+        const std::vector<uint8_t> ktx2 = WriteTextureContainer(textures[3], ContainerType::Ktx2);
+        auto patched = [](std::vector<uint8_t> file, size_t offset, uint32_t value) {
+            std::memcpy(file.data() + offset, &value, 4);
+            return file;
+        };
+        const std::vector<std::vector<uint8_t>> invalid = {
+            std::vector<uint8_t>(dds.begin(), dds.end() - 1),
+            std::vector<uint8_t>(dds.begin(), dds.begin() + 100),
+            patched(dds, 128, 2),               // DXGI_FORMAT_R32G32B32A32_FLOAT
+            patched(dds, 112, 0xfe00),          // Cube map faces
+            patched(dds, 140, 6),               // Array
+            patched(dds, 28, 12),               // More levels than 60x36 has
+            patched(dds, 16, 58),               // BC7 58 wide, not whole blocks
+            std::vector<uint8_t>(ktx2.begin(), ktx2.end() - 1),
+            patched(ktx2, 12, 43),              // VK_FORMAT_R8G8B8A8_SRGB
+            patched(ktx2, 36, 6),               // Cube map faces
+            patched(ktx2, 44, 1),               // BasisLZ
+            patched(ktx2, 80, 0xffffff00u),     // Level 0 past the end
+            patched(ktx2, 24, 34),              // BC7 34 high, not whole blocks
+            std::vector<uint8_t>(ktx2.begin() + 1, ktx2.end()),
+        };
+        uint32_t refused = 0;
+        for (const std::vector<uint8_t>& file : invalid) {
+            refused += Throws([&] { ReadTextureContainer(file, "invalid"); });
+        }
+        std::printf("legacy DXT5 header %s; %u of %zu invalid files refused %s\n", legacyOk ? "OK" : "FAILED", refused,
+            invalid.size(), refused == invalid.size() ? "OK" : "FAILED");
+        passed &= legacyOk && refused == invalid.size();
+
+        // Every container through the loader with a staging buffer that forces batches and waits
+        const std::filesystem::path directory = std::filesystem::temp_directory_path() / "descriptor_table_containers";
+        std::filesystem::remove_all(directory);
+        std::filesystem::create_directories(directory);
+        std::vector<const TextureData*> expected;
+        HostUploadDevice device;
+        HostTextureCopyQueue queue;
+        std::vector<TextureLoader::Resident> results;
+        {
+            TextureLoader::Options loaderOptions;
+            loaderOptions.decodeThreads = 2;
+            loaderOptions.stagingBytes = 64 << 10;
+            loaderOptions.batchBytes = 16 << 10;
+            TextureLoader loader(device, queue, loaderOptions);
+            for (const TextureData& texture : textures) {
+                for (const char* extension : { ".dds", ".KTX2" }) {
+                    const std::string path = (directory / (std::string(TextureFormatName(texture.format)) + extension)).string();
+                    SaveTextureContainer(path, texture);
+                    loader.Load(path);
+                    expected.push_back(&texture);
+                }
+            }
+            loader.WaitForIdle();
+            results = loader.TakeResident();
+        }
+
+        // A copy queue that throws partway through one texture: that texture reports the
+        // error and the ones after it still arrive intact
+        struct FailingCopyQueue : HostTextureCopyQueue {
+            void CopyLevel(uint32_t texture, uint32_t level, const UploadMemory& staging,
+                const TextureLevelFootprint& footprint) override {
+                if (texture == 1 && level == 2) {
+                    throw std::runtime_error("copy queue lost");
+                }
+                HostTextureCopyQueue::CopyLevel(texture, level, staging, footprint);
+            }
+        };
+        FailingCopyQueue failingQueue;
+        std::vector<TextureLoader::Resident> failingResults;
+        {
+            TextureLoader::Options loaderOptions;
+            loaderOptions.decodeThreads = 1;
+            loaderOptions.stagingBytes = 64 << 10;
+            TextureLoader loader(device, failingQueue, loaderOptions);
+            for (const TextureData& texture : textures) {
+                loader.Load((directory / (std::string(TextureFormatName(texture.format)) + ".dds")).string());
+            }
+            loader.WaitForIdle();
+            failingResults = loader.TakeResident();
+        }
+        std::filesystem::remove_all(directory);
+        uint32_t reported = 0, intact = 0;
+        for (const TextureLoader::Resident& resident : failingResults) {
+            const TextureData& texture = textures.at(resident.texture);
+            if (resident.texture == 1) {
+                reported += resident.error.find("copy queue lost") != std::string::npos;
+                continue;
+            }
+            bool same = resident.error.empty();
+            for (uint32_t level = 0; same && level < texture.MipLevels(); level++) {
+                same = std::memcmp(failingQueue.Texture(resident.texture).LevelData(level), texture.LevelData(level),
+                    texture.levels[level].Size()) == 0;
+            }
+            intact += same;
+        }
+        const bool failureReported = failingResults.size() == textures.size() && reported == 1 &&
+            intact == textures.size() - 1;
+        std::printf("copy queue failure: %u of 1 reported, %u of %zu other textures intact %s\n", reported, intact,
+            textures.size() - 1, failureReported ? "OK" : "FAILED");
+        passed &= failureReported;
+        uint32_t identical = 0;
+        for (const TextureLoader::Resident& resident : results) {
+            const TextureData& texture = *expected.at(resident.texture);
+            if (!resident.error.empty() || resident.format != texture.format || resident.mipLevels != texture.MipLevels()) {
+                continue;
+            }
+            const TextureData& copied = queue.Texture(resident.texture);
+            bool same = true;
+            for (uint32_t level = 0; same && level < texture.MipLevels(); level++) {
+                same = std::memcmp(copied.LevelData(level), texture.LevelData(level), texture.levels[level].Size()) == 0;
+            }
+            identical += same;
+        }
+        std::printf("%zu containers through the loader: %u identical to the stored levels, %llu batches %s\n",
+            expected.size(), identical, static_cast<unsigned long long>(queue.Submissions()),
+            identical == expected.size() ? "OK" : "FAILED");
+        passed &= identical == expected.size();
+        return passed;
+    }
+
+    // Time to put every file through `load` on this thread, best of 3 runs
+    template <typename F>
+    double BestLoadSeconds(const std::vector<std::string>& paths, F&& load) {
+        double fastest = 1e30;
+        for (int run = 0; run < 3; run++) {
+            const auto begin = std::chrono::steady_clock::now();
+            for (const std::string& path : paths) {
+                load(path);
+            }
+            fastest = std::min(fastest, std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+        }
+        return fastest;
+    }
+
+    // Seconds until every file is resident through a loader with one decode thread per core
+    double LoaderSeconds(const HeadlessOptions& options, const std::vector<std::string>& paths, uint64_t& failed) {
+        HostUploadDevice device;
+        HostTextureCopyQueue queue;
+        TextureLoader::Options loaderOptions;
+        loaderOptions.mips = options.mips;
+        TextureLoader loader(device, queue, loaderOptions);
+        const auto begin = std::chrono::steady_clock::now();
+        for (const std::string& path : paths) {
+            loader.Load(path);
+        }
+        loader.WaitForIdle();
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        failed += loader.GetStats().failed;
+        return seconds;
+    }
+
+    // The --loader files converted once to rgba8 and each --format, in DDS and KTX2 files,
+    // then loaded: stbi_load and mips against reading a container, on this thread and
+    // through the loader. Files whose size a BC format cannot take are left out of that format.
+    bool RunContainerBenchmark(const HeadlessOptions& options, const CpuImage& source) {
+        using Clock = std::chrono::steady_clock;
+        std::vector<std::string> paths;
+        try {
+            paths = options.loaderDir.empty() ? WriteLoaderTextures(options, source) : ListLoaderTextures(options.loaderDir);
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return false;
+        }
+        if (paths.empty()) {
+            std::cerr << "No PNG or JPEG files in " << options.loaderDir << std::endl;
+            return false;
+        }
+
+        // Decoded once for the conversions; every load below reads the files again
+        const MipGenerator mipGenerator;
+        std::vector<std::vector<CpuImage>> chains;
+        uint64_t fileBytes = 0;
+        for (const std::string& path : paths) {
+            chains.emplace_back(1, LoadImageFile(path));
+            mipGenerator.Generate(chains.back(), options.mips, nullptr);
+            fileBytes += std::filesystem::file_size(path);
+        }
+        const double decodeSeconds = BestLoadSeconds(paths, [&](const std::string& path) {
+            std::vector<CpuImage> levels(1, LoadImageFile(path));
+            mipGenerator.Generate(levels, options.mips, nullptr);
+        });
+        uint64_t failed = 0;
+        const double decodeLoader = LoaderSeconds(options, paths, failed);
+        std::printf("%zu files, %.1f MB: stbi_load and mips %.3f ms/texture, through the loader %.1f textures/s\n",
+            paths.size(), fileBytes / 1048576.0, decodeSeconds * 1e3 / paths.size(), paths.size() / decodeLoader);
+
+        const std::filesystem::path directory = std::filesystem::temp_directory_path() / "descriptor_table_converted";
+        std::filesystem::remove_all(directory);
+        std::filesystem::create_directories(directory);
+        std::vector<TextureFormat> formats(1, TextureFormat::R8G8B8A8);
+        for (BcFormat format : options.bcFormats) {
+            formats.push_back(TextureFormatOf(format));
+        }
+        const BcQuality quality = options.bcQualities.front();
+        TaskScheduler scheduler;
+        bool passed = true;
+        for (TextureFormat format : formats) {
+            std::vector<std::string> converted[2];
+            uint64_t containerBytes = 0;
+            const auto begin = Clock::now();
+            for (size_t i = 0; i < paths.size(); i++) {
+                if (IsBlockCompressed(format) && (chains[i][0].width % 4 != 0 || chains[i][0].height % 4 != 0)) {
+                    continue;
+                }
+                const TextureData texture = BuildTextureData(chains[i], format, quality, &scheduler);
+                const std::string stem = (directory / std::filesystem::path(paths[i]).stem()).string() + "." +
+                    TextureFormatName(format);
+                converted[0].push_back(stem + ".dds");
+                converted[1].push_back(stem + ".ktx2");
+                SaveTextureContainer(converted[0].back(), texture);
+                SaveTextureContainer(converted[1].back(), texture);
+                containerBytes += texture.bytes.size();
+            }
+            const double convertSeconds = std::chrono::duration<double>(Clock::now() - begin).count();
+            if (converted[0].empty()) {
+                continue;
+            }
+            std::printf("  %-5s %zu files converted in %.2f s (%s), %.1f MB with mips\n", TextureFormatName(format),
+                converted[0].size(), convertSeconds, IsBlockCompressed(format) ? BcQualityName(quality) : "copied",
+                containerBytes / 1048576.0);
+            for (int type = 0; type < 2; type++) {
+                const double loadSeconds = BestLoadSeconds(converted[type], [](const std::string& path) {
+                    LoadTextureContainer(path);
+                });
+                const double loaderSeconds = LoaderSeconds(options, converted[type], failed);
+                const double perTexture = loadSeconds / converted[type].size();
+                std::printf("    %-4s %.3f ms/texture, %5.1fx faster than decoding; through the loader %.1f textures/s\n",
+                    type == 0 ? "dds" : "ktx2", perTexture * 1e3, decodeSeconds / paths.size() / perTexture,
+                    converted[type].size() / loaderSeconds);
+            }
+        }
+        std::filesystem::remove_all(directory);
+        std::printf("%llu loads failed %s\n", static_cast<unsigned long long>(failed), failed == 0 ? "OK" : "FAILED");
+        passed &= failed == 0;
+        return passed;
+    }
+
+    // A packed texture's levels against the ones it was built from, level records included
+    bool SameLevels(const TextureData& texture, const PackedTexture& packed, const std::vector<TextureLevel>& levels) {
+        if (levels.size() != texture.levels.size()) {
+            return false;
+        }
+        for (uint32_t level = 0; level < texture.MipLevels(); level++) {
+            const TextureLevel& stored = texture.levels[level];
+            if (levels[level].width != stored.width || levels[level].height != stored.height ||
+                levels[level].rowBytes != stored.rowBytes || levels[level].rows != stored.rows ||
+                levels[level].offset + stored.Size() > packed.size ||
+                std::memcmp(packed.data + levels[level].offset, texture.LevelData(level), stored.Size()) != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // A pack of mixed formats and sizes read back through lookups and the loader, packs the
+    // reader must refuse and names the writer must refuse
+    bool VerifyTexturePack(const CpuImage& source) {
+        bool passed = true;
+        const std::filesystem::path directory = std::filesystem::temp_directory_path() / "descriptor_table_pack";
+        std::filesystem::remove_all(directory);
+        std::filesystem::create_directories(directory);
+        const std::string path = (directory / "textures.pack").string();
+
+        struct Input {
+            std::string name;
+            TextureData texture;
+        };
+        std::vector<Input> inputs;
+        auto crop = [&](uint32_t width, uint32_t height, uint32_t offset) {
+            CpuImage image(width, height);
+            for (uint32_t y = 0; y < height; y++) {
+                std::memcpy(image.Row(y), source.Row((y + offset) % source.height) + offset % (source.width - width) * 4,
+                    image.RowPitch());
+            }
+            return image;
+        };
+        const MipGenerator mipGenerator;
+        auto add = [&](const std::string& name, const CpuImage& image, TextureFormat format, uint32_t mipLevels) {
+            std::vector<CpuImage> chain(1, image);
+            MipOptions mips = BlockTextureMips();
+            mips.mipLevels = mipLevels;
+            mipGenerator.Generate(chain, mips, nullptr);
+            inputs.push_back({ name, BuildTextureData(chain, format, BcQuality::Fast, nullptr) });
+        };
+        add("block", source, TextureFormat::BC7, 0);
+        add("odd/rgba8", crop(60, 36, 7), TextureFormat::R8G8B8A8, 0);
+        add("bc1 single level", crop(16, 8, 3), TextureFormat::BC1, 1);
+        add("bc3", crop(128, 64, 11), TextureFormat::BC3, 3);
+        for (uint32_t i = 0; i < 100; i++) {
+            add("small" + std::to_string(i), crop(8, 8, i * 13), TextureFormat::R8G8B8A8, 0);
+        }
+
+        uint64_t bytes = 0;
+        bool refusedDuplicate = false, removedUnfinished = false;
+        {
+            TexturePackWriter writer(path);
+            for (const Input& input : inputs) {
+                writer.Add(input.name, input.texture);
+            }
+            refusedDuplicate = Throws([&] { writer.Add("bc3", inputs[0].texture); });
+            bytes = writer.Finish();
+        }
+        {
+            const std::string unfinished = (directory / "unfinished.pack").string();
+            TexturePackWriter writer(unfinished);
+            writer.Add("block", inputs[0].texture);
+            removedUnfinished = true;
+        }
+        removedUnfinished &= !std::filesystem::exists(directory / "unfinished.pack");
+
+        const TexturePack pack(path);
+        uint32_t found = 0, laidOut = 0, aligned = 0;
+        std::vector<TextureLevelFootprint> footprints, expected;
+        std::vector<TextureLevel> levels;
+        uint64_t payloadBytes = 0;
+        for (const Input& input : inputs) {
+            const uint32_t index = pack.Find(input.name);
+            if (index == TexturePack::NotFound || pack.Name(index) != input.name) {
+                continue;
+            }
+            found++;
+            const PackedTexture packed = pack.Texture(index);
+            pack.Footprints(index, footprints);
+            pack.Levels(index, levels);
+            const uint64_t size = TextureLoader::LevelFootprints(input.texture.format, input.texture.width,
+                input.texture.height, input.texture.MipLevels(), expected);
+            bool same = packed.format == input.texture.format && packed.width == input.texture.width &&
+                packed.height == input.texture.height && packed.mipLevels == input.texture.MipLevels() &&
+                packed.stagingBytes == size && footprints.size() == expected.size();
+            for (size_t level = 0; same && level < footprints.size(); level++) {
+                same = footprints[level].offset == expected[level].offset && footprints[level].rowPitch == expected[level].rowPitch &&
+                    footprints[level].width == expected[level].width && footprints[level].height == expected[level].height;
+            }
+            laidOut += same && SameLevels(input.texture, packed, levels);
+            payloadBytes += packed.size;
+            aligned += reinterpret_cast<uintptr_t>(packed.data) % TexturePack::PayloadAlignment == 0;
+        }
+        const bool missing = pack.Find("missing") == TexturePack::NotFound && pack.Find("") == TexturePack::NotFound;
+        std::printf("%zu textures, %.2f MB (%.2f MB of levels): %u found, %u with their levels and the loader's "
+            "footprints, %u page aligned, missing names %s %s\n", inputs.size(), bytes / 1048576.0,
+            payloadBytes / 1048576.0, found, laidOut, aligned,
+            missing ? "not found" : "FOUND", found == inputs.size() && laidOut == found && aligned == found && missing ? "OK" : "FAILED");
+        passed &= found == inputs.size() && laidOut == found && aligned == found && missing;
+        std::printf("duplicate names %s, unfinished packs %s\n", refusedDuplicate ? "refused" : "NOT REFUSED",
+            removedUnfinished ? "removed" : "NOT REMOVED");
+        passed &= refusedDuplicate && removedUnfinished;
+
+        // Damaged copies: the header, the TOC and its first entry, the footprint table
+        std::vector<uint8_t> file(static_cast<size_t>(bytes));
+        {
+            FILE* in = std::fopen(path.c_str(), "rb");
+            const bool read = in && std::fread(file.data(), 1, file.size(), in) == file.size();
+            if (in) {
+                std::fclose(in);
+            }
+            passed &= read;
+        }
+        uint64_t tocOffset, levelsOffset;
+        std::memcpy(&tocOffset, file.data() + 16, 8);
+        std::memcpy(&levelsOffset, file.data() + 24, 8);
+        auto patched = [&](size_t offset, uint32_t value) {
+            std::vector<uint8_t> copy = file;
+            std::memcpy(copy.data() + offset, &value, 4);
+            return copy;
+        };
+        std::vector<uint8_t> unsorted = file;
+        std::swap_ranges(unsorted.begin() + tocOffset, unsorted.begin() + tocOffset + 64, unsorted.begin() + tocOffset + 64);
+        const std::vector<std::vector<uint8_t>> invalid = {
+            std::vector<uint8_t>(file.begin(), file.end() - 1),
+            std::vector<uint8_t>(file.begin(), file.begin() + 32),
+            patched(0, 0x4b415055),                 // Magic
+            patched(4, 2),                          // Version
+            patched(8, 1000),                       // TOC past the end
+            unsorted,
+            patched(tocOffset + 8, 4096 + 512),     // Payload not page aligned
+            patched(tocOffset + 16, 64),            // Payload shorter than its levels
+            patched(tocOffset + 36, 0),             // Name no longer matches the hash
+            patched(tocOffset + 40, 2),             // DXGI_FORMAT_R32G32B32A32_FLOAT
+            patched(tocOffset + 52, 40),            // More levels than the size has
+            patched(levelsOffset + 16, 4),          // Row shorter than the width needs
+            patched(levelsOffset + 40, 128),        // Row pitch below the loader's
+        };
+        uint32_t refused = 0;
+        const std::string damaged = (directory / "damaged.pack").string();
+        for (const std::vector<uint8_t>& bytesOnDisk : invalid) {
+            FILE* out = std::fopen(damaged.c_str(), "wb");
+            if (out) {
+                std::fwrite(bytesOnDisk.data(), 1, bytesOnDisk.size(), out);
+                std::fclose(out);
+            }
+            refused += Throws([&] { TexturePack damagedPack(damaged); });
+        }
+        std::printf("%u of %zu damaged packs refused %s\n", refused, invalid.size(), refused == invalid.size() ? "OK" : "FAILED");
+        passed &= refused == invalid.size();
+
+        // Every texture through the loader, straight from the mapped file
+        HostUploadDevice device;
+        HostTextureCopyQueue queue;
+        std::vector<TextureLoader::Resident> results;
+        {
+            TextureLoader::Options loaderOptions;
+            loaderOptions.decodeThreads = 2;
+            loaderOptions.stagingBytes = 1 << 20;
+            loaderOptions.batchBytes = 64 << 10;
+            TextureLoader loader(device, queue, loaderOptions);
+            for (const Input& input : inputs) {
+                loader.Load(pack, pack.Find(input.name));
+            }
+            loader.WaitForIdle();
+            results = loader.TakeResident();
+        }
+        uint32_t identical = 0;
+        for (const TextureLoader::Resident& resident : results) {
+            const TextureData& texture = inputs.at(resident.texture).texture;
+            if (!resident.error.empty() || resident.path != inputs[resident.texture].name ||
+                resident.format != texture.format || resident.mipLevels != texture.MipLevels()) {
+                continue;
+            }
+            const TextureData& copied = queue.Texture(resident.texture);
+            bool same = true;
+            for (uint32_t level = 0; same && level < texture.MipLevels(); level++) {
+                same = std::memcmp(copied.LevelData(level), texture.LevelData(level), texture.levels[level].Size()) == 0;
+            }
+            identical += same;
+        }
+        std::printf("%zu packed textures through the loader: %u identical to the stored levels, %llu batches %s\n",
+            inputs.size(), identical, static_cast<unsigned long long>(queue.Submissions()),
+            identical == inputs.size() ? "OK" : "FAILED");
+        passed &= identical == inputs.size();
+        std::filesystem::remove_all(directory);
+        return passed;
+    }
+
+    // Startup with many small textures: the files one by one as PNGs and as DDS files against
+    // one pack, each until every texture is resident through a loader with a decode thread
+    // per core. The files were just written, so this is the page cache's speed, not the disk's.
+    bool RunPackBenchmark(const HeadlessOptions& options, const CpuImage& source) {
+        using Clock = std::chrono::steady_clock;
+        const uint32_t count = options.files > 0 ? options.files : 10000;
+        const uint32_t size = 64;
+        const TextureFormat format = TextureFormatOf(options.bcFormats.front());
+        const BcQuality quality = options.bcQualities.front();
+        const std::filesystem::path directory = std::filesystem::temp_directory_path() / "descriptor_table_startup";
+        std::filesystem::remove_all(directory);
+        std::filesystem::create_directories(directory / "png");
+        std::filesystem::create_directories(directory / "dds");
+        const std::string packPath = (directory / "textures.pack").string();
+
+        // Recolored crops of the texture, each written three ways
+        auto begin = Clock::now();
+        std::vector<std::string> names, pngPaths, ddsPaths;
+        uint64_t pngBytes = 0, ddsBytes = 0, packBytes = 0;
+        {
+            static const int channelOrder[6][3] = { { 0, 1, 2 }, { 1, 2, 0 }, { 2, 0, 1 }, { 0, 2, 1 }, { 2, 1, 0 }, { 1, 0, 2 } };
+            const MipGenerator mipGenerator;
+            TexturePackWriter writer(packPath);
+            for (uint32_t i = 0; i < count; i++) {
+                CpuImage image(size, size);
+                const uint32_t x = i * 37 % (source.width - size), y = i * 53 % (source.height - size);
+                const int* order = channelOrder[i % 6];
+                for (uint32_t row = 0; row < size; row++) {
+                    const uint8_t* in = source.Row(y + row) + x * 4;
+                    uint8_t* out = image.Row(row);
+                    for (uint32_t column = 0; column < size; column++) {
+                        for (int c = 0; c < 3; c++) {
+                            out[column * 4 + c] = in[column * 4 + order[c]];
+                        }
+                        out[column * 4 + 3] = 255;
+                    }
+                }
+                char name[32];
+                std::snprintf(name, sizeof(name), "texture%05u", i);
+                names.push_back(name);
+                pngPaths.push_back((directory / "png" / (names.back() + ".png")).string());
+                ddsPaths.push_back((directory / "dds" / (names.back() + ".dds")).string());
+                WritePngFile(pngPaths.back(), image);
+                std::vector<CpuImage> chain(1, image);
+                mipGenerator.Generate(chain, options.mips, nullptr);
+                const TextureData texture = BuildTextureData(chain, format, quality, nullptr);
+                SaveTextureContainer(ddsPaths.back(), texture);
+                writer.Add(names.back(), texture);
+                pngBytes += std::filesystem::file_size(pngPaths.back());
+                ddsBytes += std::filesystem::file_size(ddsPaths.back());
+            }
+            packBytes = writer.Finish();
+        }
+        std::printf("%u textures of %ux%u, %s %s: written in %.1f s; %.1f MB of PNGs, %.1f MB of DDS files, "
+            "%.1f MB pack\n", count, size, size, TextureFormatName(format), BcQualityName(quality),
+            std::chrono::duration<double>(Clock::now() - begin).count(), pngBytes / 1048576.0, ddsBytes / 1048576.0,
+            packBytes / 1048576.0);
+
+        bool passed = true;
+        auto startup = [&](const char* label, const std::function<void(TextureLoader&)>& queueAll) {
+            HostUploadDevice device;
+            HostTextureCopyQueue queue;
+            TextureLoader::Options loaderOptions;
+            loaderOptions.mips = options.mips;
+            TextureLoader loader(device, queue, loaderOptions);
+            const auto start = Clock::now();
+            queueAll(loader);
+            loader.WaitForIdle();
+            const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            const TextureLoader::Stats stats = loader.GetStats();
+            std::printf("  %-10s %8.1f ms until all resident, %8.0f textures/s; thread time read %.3f s, decode %.3f s, "
+                "mips %.3f s, upload %.3f s; %llu failed\n", label, seconds * 1e3, count / seconds, stats.readSeconds,
+                stats.decodeSeconds, stats.mipSeconds, stats.uploadSeconds, static_cast<unsigned long long>(stats.failed));
+            passed &= stats.failed == 0 && stats.resident == count;
+        };
+        startup("png files", [&](TextureLoader& loader) {
+            for (const std::string& path : pngPaths) {
+                loader.Load(path);
+            }
+        });
+        startup("dds files", [&](TextureLoader& loader) {
+            for (const std::string& path : ddsPaths) {
+                loader.Load(path);
+            }
+        });
+        // Opened inside so mapping and checking the tables count towards startup
+        std::unique_ptr<TexturePack> pack;
+        double openSeconds = 0.0, findSeconds = 0.0;
+        startup("pack", [&](TextureLoader& loader) {
+            auto start = Clock::now();
+            pack = std::make_unique<TexturePack>(packPath);
+            openSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+            start = Clock::now();
+            std::vector<uint32_t> indices;
+            indices.reserve(names.size());
+            for (const std::string& name : names) {
+                indices.push_back(pack->Find(name));
+            }
+            findSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+            for (uint32_t index : indices) {
+                loader.Load(*pack, index);
+            }
+        });
+        std::printf("  pack opened and its TOC checked in %.2f ms, %.0f ns per name lookup\n", openSeconds * 1e3,
+            findSeconds * 1e9 / count);
+        pack.reset();
+        std::filesystem::remove_all(directory);
+        return passed;
+    }
+
+    // Footprints D3D12 gives these textures, worked out by hand from its rules: rows padded
+    // to 256 bytes, subresources placed on 512-byte boundaries, BC sizes rounded up to whole
+    // blocks and TotalBytes ending at the last row's texels
+    struct KnownLayout {
+        const char* name;
+        SubresourceLayoutDesc desc;
+        uint32_t firstSubresource;
+        uint32_t subresourceCount;
+        uint64_t baseOffset;
+        uint64_t totalBytes;
+        std::vector<SubresourceFootprint> footprints;
+    };
+
+    std::vector<KnownLayout> KnownLayouts() {
+        const TextureFormat rgba8 = TextureFormat::R8G8B8A8, bc1 = TextureFormat::BC1, bc7 = TextureFormat::BC7;
+        std::vector<KnownLayout> layouts;
+        layouts.push_back({ "rgba8 256x256, full chain", { rgba8, 256, 256, 1, 0 }, 0, 9, 0, 359940, {
+            { 0, rgba8, 256, 256, 1024, 256, 1024 },
+            { 262144, rgba8, 128, 128, 512, 128, 512 },
+            { 327680, rgba8, 64, 64, 256, 64, 256 },
+            { 344064, rgba8, 32, 32, 256, 32, 128 },
+            { 352256, rgba8, 16, 16, 256, 16, 64 },
+            { 356352, rgba8, 8, 8, 256, 8, 32 },
+            { 358400, rgba8, 4, 4, 256, 4, 16 },
+            { 359424, rgba8, 2, 2, 256, 2, 8 },
+            { 359936, rgba8, 1, 1, 256, 1, 4 } } });
+        layouts.push_back({ "bc7 60x36 array of 2, full chains, base offset 1024", { bc7, 60, 36, 2, 0 }, 0, 12, 1024, 12816, {
+            { 1024, bc7, 60, 36, 256, 9, 240 },
+            { 3584, bc7, 32, 20, 256, 5, 128 },
+            { 5120, bc7, 16, 12, 256, 3, 64 },
+            { 6144, bc7, 8, 4, 256, 1, 32 },
+            { 6656, bc7, 4, 4, 256, 1, 16 },
+            { 7168, bc7, 4, 4, 256, 1, 16 },
+            { 7680, bc7, 60, 36, 256, 9, 240 },
+            { 10240, bc7, 32, 20, 256, 5, 128 },
+            { 11776, bc7, 16, 12, 256, 3, 64 },
+            { 12800, bc7, 8, 4, 256, 1, 32 },
+            { 13312, bc7, 4, 4, 256, 1, 16 },
+            { 13824, bc7, 4, 4, 256, 1, 16 } } });
+        layouts.push_back({ "bc1 8x8, subresources 2 and 3", { bc1, 8, 8, 1, 4 }, 2, 2, 0, 520, {
+            { 0, bc1, 4, 4, 256, 1, 8 },
+            { 512, bc1, 4, 4, 256, 1, 8 } } });
+        layouts.push_back({ "rgba8 65x3", { rgba8, 65, 3, 1, 1 }, 0, 1, 0, 1284, {
+            { 0, rgba8, 65, 3, 512, 3, 260 } } });
+        return layouts;
+    }
+
+    bool SameFootprint(const SubresourceFootprint& a, const SubresourceFootprint& b) {
+        return a.offset == b.offset && a.format == b.format && a.width == b.width && a.height == b.height &&
+            a.rowPitch == b.rowPitch && a.rows == b.rows && a.rowBytes == b.rowBytes;
+    }
+
+    // Random subresources of a layout with sources `sourcePadding` bytes wider than their rows
+    struct CopyInput {
+        std::vector<SubresourceFootprint> footprints;
+        uint64_t totalBytes;
+        std::vector<std::vector<uint8_t>> bytes;
+        std::vector<SubresourceData> sources;
+    };
+
+    CopyInput MakeCopyInput(const SubresourceLayoutDesc& desc, uint32_t sourcePadding, std::mt19937& random) {
+        CopyInput input;
+        input.totalBytes = GetCopyableFootprints(desc, 0, SubresourceCount(desc), 0, input.footprints);
+        for (const SubresourceFootprint& footprint : input.footprints) {
+            const uint64_t pitch = footprint.rowBytes + sourcePadding;
+            input.bytes.emplace_back(static_cast<size_t>(pitch * footprint.rows));
+            for (uint8_t& value : input.bytes.back()) {
+                value = static_cast<uint8_t>(random());
+            }
+        }
+        for (size_t i = 0; i < input.footprints.size(); i++) {
+            input.sources.push_back({ input.bytes[i].data(), input.footprints[i].rowBytes + sourcePadding });
+        }
+        return input;
+    }
+
+    // The rows where the footprints say and every other byte still `fill`
+    bool CopiedAsFootprints(const CopyInput& input, const uint8_t* staging, uint8_t fill) {
+        std::vector<uint8_t> expected(static_cast<size_t>(input.totalBytes), fill);
+        for (size_t i = 0; i < input.footprints.size(); i++) {
+            const SubresourceFootprint& footprint = input.footprints[i];
+            for (uint32_t row = 0; row < footprint.rows; row++) {
+                std::memcpy(expected.data() + footprint.offset + static_cast<uint64_t>(row) * footprint.rowPitch,
+                    input.bytes[i].data() + row * input.sources[i].rowPitch, footprint.rowBytes);
+            }
+        }
+        return std::memcmp(expected.data(), staging, expected.size()) == 0;
+    }
+
+    // Footprints against the known layouts and their error cases, then every ISA's copies
+    // against a row by row reference at staging alignments a mapped buffer never has
+    bool VerifySubresourceUpload() {
+        bool passed = true;
+        std::vector<SubresourceFootprint> footprints;
+        for (const KnownLayout& known : KnownLayouts()) {
+            const uint64_t total = GetCopyableFootprints(known.desc, known.firstSubresource, known.subresourceCount,
+                known.baseOffset, footprints);
+            bool same = total == known.totalBytes && footprints.size() == known.footprints.size();
+            for (size_t i = 0; same && i < footprints.size(); i++) {
+                same = SameFootprint(footprints[i], known.footprints[i]);
+            }
+            std::printf("%-52s %zu subresources, %llu bytes %s\n", known.name, footprints.size(),
+                static_cast<unsigned long long>(total), same ? "OK" : "FAILED");
+            passed &= same;
+        }
+
+        // TextureLoader lays its staging memory out the same way
+        std::vector<TextureLevelFootprint> levels;
+        const KnownLayout chain = KnownLayouts()[0];
+        const uint64_t loaderBytes = TextureLoader::LevelFootprints(chain.desc.format, chain.desc.width,
+            chain.desc.height, 9, levels);
+        bool sameAsLoader = loaderBytes == (chain.totalBytes + 511) / 512 * 512 && levels.size() == chain.footprints.size();
+        for (size_t i = 0; sameAsLoader && i < levels.size(); i++) {
+            sameAsLoader = levels[i].offset == chain.footprints[i].offset && levels[i].rowPitch == chain.footprints[i].rowPitch &&
+                levels[i].width == chain.footprints[i].width && levels[i].height == chain.footprints[i].height;
+        }
+        std::printf("TextureLoader::LevelFootprints %s\n", sameAsLoader ? "OK" : "FAILED");
+        passed &= sameAsLoader;
+
+        SubresourceLayoutDesc empty;
+        empty.width = 0;
+        SubresourceLayoutDesc tooManyMips;
+        tooManyMips.width = tooManyMips.height = 256;
+        tooManyMips.mipLevels = 10;
+        SubresourceLayoutDesc array;
+        array.arraySize = 3;
+        uint32_t refused = 0;
+        refused += Throws([&] { GetCopyableFootprints(empty, 0, 1, 0, footprints); });
+        refused += Throws([&] { GetCopyableFootprints(tooManyMips, 0, 1, 0, footprints); });
+        refused += Throws([&] { GetCopyableFootprints(array, 2, 2, 0, footprints); });
+        refused += Throws([&] { GetCopyableFootprints(array, 4, 0, 0, footprints); });
+        std::printf("%u of 4 invalid footprint requests refused %s\n", refused, refused == 4 ? "OK" : "FAILED");
+        passed &= refused == 4;
+
+        std::mt19937 random(25);
+        TaskScheduler scheduler(4);
+        const SubresourceLayoutDesc descs[] = {
+            { TextureFormat::R8G8B8A8, 256, 256, 1, 0 },
+            { TextureFormat::BC7, 60, 36, 2, 0 },
+            { TextureFormat::R8G8B8A8, 1000, 20, 3, 2 },
+            { TextureFormat::BC1, 1024, 512, 1, 0 },
+        };
+        uint32_t copies = 0, mismatches = 0;
+        for (const SubresourceLayoutDesc& desc : descs) {
+            for (uint32_t sourcePadding : { 0u, 7u }) {
+                const CopyInput input = MakeCopyInput(desc, sourcePadding, random);
+                std::vector<uint8_t> buffer(static_cast<size_t>(input.totalBytes) + 64);
+                for (SimdIsa isa : SamplerIsas()) {
+                    const SubresourceCopier copier(isa);
+                    for (size_t shift : { 0, 16, 1 }) {
+                        for (TaskScheduler* threads : { static_cast<TaskScheduler*>(nullptr), &scheduler }) {
+                            uint8_t* staging = buffer.data() + (64 - reinterpret_cast<uintptr_t>(buffer.data()) % 64) % 64 + shift;
+                            std::fill(buffer.begin(), buffer.end(), 0xcd);
+                            copier.Copy(staging, input.totalBytes, input.footprints, input.sources.data(), threads);
+                            mismatches += !CopiedAsFootprints(input, staging, 0xcd);
+                            copies++;
+                        }
+                    }
+                }
+            }
+        }
+        std::printf("%u copies, every ISA, 1 and 4 threads, staging shifted by 0, 16 and 1 bytes: %u mismatches %s\n",
+            copies, mismatches, mismatches == 0 ? "OK" : "FAILED");
+        passed &= mismatches == 0;
+
+        // A buffer one byte short is refused before anything is written
+        const CopyInput input = MakeCopyInput(descs[1], 0, random);
+        std::vector<uint8_t> shortBuffer(static_cast<size_t>(input.totalBytes), 0xcd);
+        const bool refusedShort = Throws([&] {
+            SubresourceCopier().Copy(shortBuffer.data(), input.totalBytes - 1, input.footprints, input.sources.data(), &scheduler);
+        });
+        const bool untouched = std::all_of(shortBuffer.begin(), shortBuffer.end(), [](uint8_t value) { return value == 0xcd; });
+        std::printf("staging buffer too small %s, %s\n", refusedShort ? "refused" : "NOT REFUSED",
+            untouched ? "nothing written OK" : "WRITTEN FAILED");
+        passed &= refusedShort && untouched;
+        return passed;
+    }
+
+    // GB/s of staging writes for a 4K R8G8B8A8 chain and a 2K BC7 array of 6 with full chains:
+    // the row by row memcpy UpdateSubresources does against the copier per ISA and thread count
+    void RunSubresourceUploadBenchmark() {
+        using Clock = std::chrono::steady_clock;
+        const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+        const std::vector<unsigned> threadCounts = cores > 1 ? std::vector<unsigned>{ 1, cores } : std::vector<unsigned>{ 1 };
+        std::mt19937 random(4);
+        const std::pair<const char*, SubresourceLayoutDesc> cases[] = {
+            { "rgba8 4096x4096, full chain", { TextureFormat::R8G8B8A8, 4096, 4096, 1, 0 } },
+            { "bc7 2048x2048 array of 6, full chains", { TextureFormat::BC7, 2048, 2048, 6, 0 } },
+        };
+        std::printf("best of 5 runs\n");
+        for (const auto& entry : cases) {
+            const CopyInput input = MakeCopyInput(entry.second, 0, random);
+            std::vector<uint8_t> staging(static_cast<size_t>(input.totalBytes));
+            uint64_t texelBytes = 0;
+            for (const SubresourceFootprint& footprint : input.footprints) {
+                texelBytes += static_cast<uint64_t>(footprint.rowBytes) * footprint.rows;
+            }
+            const double gigabytes = texelBytes / 1e9;
+            std::printf("%s: %zu subresources, %.1f MB of texels, %.1f MB of staging\n", entry.first,
+                input.footprints.size(), texelBytes / 1048576.0, input.totalBytes / 1048576.0);
+
+            auto best = [&](const std::function<void()>& run) {
+                double fastest = 1e30;
+                for (int i = 0; i < 5; i++) {
+                    const auto begin = Clock::now();
+                    run();
+                    fastest = std::min(fastest, std::chrono::duration<double>(Clock::now() - begin).count());
+                }
+                return fastest;
+            };
+            const double baseline = best([&] {
+                for (size_t i = 0; i < input.footprints.size(); i++) {
+                    const SubresourceFootprint& footprint = input.footprints[i];
+                    for (uint32_t row = 0; row < footprint.rows; row++) {
+                        std::memcpy(staging.data() + footprint.offset + static_cast<uint64_t>(row) * footprint.rowPitch,
+                            input.bytes[i].data() + row * input.sources[i].rowPitch, footprint.rowBytes);
+                    }
+                }
+            });
+            std::printf("  memcpy per row:        %8.2f ms, %6.2f GB/s\n", baseline * 1e3, gigabytes / baseline);
+            for (SimdIsa isa : SamplerIsas()) {
+                const SubresourceCopier copier(isa);
+                for (unsigned threads : threadCounts) {
+                    TaskScheduler scheduler(threads);
+                    const double seconds = best([&] {
+                        copier.Copy(staging.data(), staging.size(), input.footprints, input.sources.data(), &scheduler);
+                    });
+                    std::printf("  %-6s %2u thread%s     %8.2f ms, %6.2f GB/s, %.2fx\n", SimdIsaName(isa), threads,
+                        threads == 1 ? ": " : "s:", seconds * 1e3, gigabytes / seconds, baseline / seconds);
+                }
+            }
+        }
+    }
+}
+
+int RunHeadless(int argc, char** argv) {
+    HeadlessOptions options;
+    CpuImage source;
+    try {
+        options = ParseOptions(argc, argv);
+        if (!options.descriptors && !options.bindless && !options.footprints &&
+            !(options.loader && !options.loaderDir.empty())) {
+            source = LoadImageFile(options.texturePath);
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        PrintUsage();
+        return 1;
+    }
+
+    if (options.descriptors) {
+        bool passed = VerifyDescriptorAllocators(options.heapSize);
+        RunDescriptorBenchmark(options.heapSize);
+        return passed ? 0 : 1;
+    }
+    if (options.bindless) {
+        return RunBindlessBenchmark(options) ? 0 : 1;
+    }
+    if (options.loader) {
+        return RunLoaderBenchmark(options, source) ? 0 : 1;
+    }
+    if (options.mipgen) {
+        const bool passed = VerifyMipGenerator();
+        RunMipBenchmark(source);
+        return passed ? 0 : 1;
+    }
+    if (options.compress) {
+        const bool passed = VerifyBlockCompressor(source);
+        RunCompressBenchmark(options, source);
+        return passed ? 0 : 1;
+    }
+    if (options.container) {
+        bool passed = VerifyTextureContainers(source);
+        passed &= RunContainerBenchmark(options, source);
+        return passed ? 0 : 1;
+    }
+    if (options.footprints) {
+        const bool passed = VerifySubresourceUpload();
+        RunSubresourceUploadBenchmark();
+        return passed ? 0 : 1;
+    }
+    if (options.pack) {
+        bool passed = VerifyTexturePack(source);
+        passed &= RunPackBenchmark(options, source);
+        return passed ? 0 : 1;
+    }
+    if (options.benchmark) {
+        RunBenchmark(source);
+        return 0;
+    }
+    if (options.verify) {
+        return Verify(options, source) ? 0 : 1;
+    }
+
+    SampledTexture texture;
+    try {
+        std::vector<CpuImage> chain(1, source);
+        MipGenerator(options.isa).Generate(chain, options.mips, nullptr);
+        texture = SampledTexture(chain, options.layout);
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    const TextureSampler sampler(options.isa);
+    CpuImage image(options.width, options.height);
+    DepthBuffer depth;
+    depth.Resize(options.width, options.height);
+
+    std::cout << "CPU renderer: " << options.width << "x" << options.height << ", " << texture.MipLevels()
+        << " mip levels (" << MipFilterName(options.mips.filter) << (options.mips.srgb ? ", sRGB" : "") << "), " << TexelLayoutName(texture.Layout()) << " texels, " << SimdIsaName(sampler.Isa()) << std::endl;
+
+    auto begin = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < options.frames; frame++) {
+        RenderTexturedCube(texture, sampler, options.startTime + options.timeStep * frame, image, depth);
+    }
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - begin).count();
+    std::cout << options.frames << " frames in " << seconds << " s (" << options.frames / seconds << " frames/s)" << std::endl;
+
+    if (!options.outputPath.empty()) {
+        try {
+            WritePngFile(options.outputPath, image);
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        std::cout << "Wrote " << options.outputPath << std::endl;
+    }
+    return 0;
+}
+
+#ifndef _WIN32
+int main(int argc, char** argv) {
+    return RunHeadless(argc, argv);
+}
+#endif
@@ -7,11 +7,24 @@
 #include <d3dcompiler.h>
 #include <DirectXMath.h>
 #include <chrono>
+#include <filesystem>
+#include <mutex>
 #include <vector>
 #include <stdexcept>
-
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
+#include <string>
+#include "CubeMesh.h"
+#include "CpuRenderer.h"
+#include "../Common/BlockCompressor.h"
+#include "../Common/DescriptorAllocator.h"
+#include "../Common/DrawSubmission.h"
+#include "../Common/FramePacer.h"
+#include "../Common/SubresourceUpload.h"
+#include "../Common/TaskScheduler.h"
+#include "../Common/TextureLoader.h"
+#include "../Common/TexturePack.h"
+#include "../Common/UploadRing.h"
+
+#include "../Common/stb_image.h"
 
 
 using namespace Microsoft::WRL;
@@ -31,85 +44,16 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
 void InitWindow(HINSTANCE hInstance);
 void Initialize();
 void LoadAssets();
+void LoadBindlessAssets();
 void LoadShaderPipeline();
+int RunHeadless(int argc, char** argv); // headless.cpp
 void ThrowIfFailed(HRESULT hr); // Centralized error handling
 
 // Constants
 const UINT Width = 800;
 const UINT Height = 600;
 const UINT FrameCount = 2;
-
-// Vertex structure
-struct Vertex {
-    XMFLOAT3 position;
-    XMFLOAT2 texCoord;
-};
-
-// Cube data
-Vertex cubeVertices[] = {
-    // +X
-    {{+1, -1, -1}, {0, 1}}, // 0
-    {{+1, +1, -1}, {0, 0}}, // 1
-    {{+1, +1, +1}, {1, 0}}, // 2
-    {{+1, -1, +1}, {1, 1}}, // 3
-
-    // -X
-    {{-1, -1, +1}, {0, 1}}, // 4
-    {{-1, +1, +1}, {0, 0}}, // 5
-    {{-1, +1, -1}, {1, 0}}, // 6
-    {{-1, -1, -1}, {1, 1}}, // 7
-
-    // +Y
-    {{-1, +1, -1}, {0, 1}}, // 8
-    {{-1, +1, +1}, {0, 0}}, // 9
-    {{+1, +1, +1}, {1, 0}}, //10
-    {{+1, +1, -1}, {1, 1}}, //11
-
-    // -Y
-    {{-1, -1, +1}, {0, 1}}, //12
-    {{-1, -1, -1}, {0, 0}}, //13
-    {{+1, -1, -1}, {1, 0}}, //14
-    {{+1, -1, +1}, {1, 1}}, //15
-
-    // +Z
-    {{+1, -1, +1}, {0, 1}}, //16
-    {{+1, +1, +1}, {0, 0}}, //17
-    {{-1, +1, +1}, {1, 0}}, //18
-    {{-1, -1, +1}, {1, 1}}, //19
-
-    // -Z
-    {{-1, -1, -1}, {0, 1}}, //20
-    {{-1, +1, -1}, {0, 0}}, //21
-    {{+1, +1, -1}, {1, 0}}, //22
-    {{+1, -1, -1}, {1, 1}}, //23
-};
-
-uint16_t cubeIndices[] = {
-    // +X
-    0, 1, 2,
-    0, 2, 3,
-
-    // -X
-    4, 5, 6,
-    4, 6, 7,
-
-    // +Y
-    8, 9,10,
-    8,10,11,
-
-    // -Y
-   12,13,14,
-   12,14,15,
-
-   // +Z
-  16,17,18,
-  16,18,19,
-
-  // -Z
- 20,21,22,
- 20,22,23,
-};
-
+const UINT FramesInFlight = 3; // Frames the CPU may record ahead of the GPU, independent of the back buffers
 
 // Globals (Consider minimizing these)
 HWND hwnd = nullptr;
@@ -123,11 +67,10 @@ ComPtr<ID3D12DescriptorHeap> dsvHeap;
 UINT dsvDescriptorSize;
 ComPtr<ID3D12Resource> depthStencilBuffer;
 D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc;
-ComPtr<ID3D12CommandAllocator> commandAllocator;
+ComPtr<ID3D12CommandAllocator> commandAllocator[FramesInFlight]; // One per frame context
 ComPtr<ID3D12GraphicsCommandList> commandList;
 ComPtr<ID3D12Fence> fence;
 HANDLE fenceEvent;
-UINT64 fenceValue = 1;
 UINT frameIndex;
 
 ComPtr<ID3D12RootSignature> rootSignature;
@@ -139,13 +82,265 @@ D3D12_INDEX_BUFFER_VIEW indexBufferView;
 
 // Descriptor heap is needed for constant buffer view (Root descriptor or Descriptor table)
 ComPtr<ID3D12DescriptorHeap> shaderVisibleHeap;
-ComPtr<ID3D12Resource> constantBuffer;
-D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
+UINT cbvSrvDescriptorSize;
 ComPtr<ID3D12Resource> texture;
 D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
 
+// Per-frame constants come from one persistently mapped upload ring instead of a
+// Map/memcpy/Unmap on a single buffer the GPU may still be reading
+class D3D12UploadDevice : public UploadDevice {
+public:
+    UploadMemory CreateMappedBuffer(uint64_t size) override {
+        ComPtr<ID3D12Resource> buffer;
+        auto heapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+        auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(size, D3D12_RESOURCE_FLAG_NONE);
+        ThrowIfFailed(device->CreateCommittedResource(
+            &heapProps, D3D12_HEAP_FLAG_NONE,
+            &bufferDesc,
+            D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&buffer)));
+
+        // Upload heaps may stay mapped for the lifetime of the resource
+        UploadMemory memory;
+        CD3DX12_RANGE readRange(0, 0);
+        ThrowIfFailed(buffer->Map(0, &readRange, reinterpret_cast<void**>(&memory.cpuAddress)));
+        memory.gpuAddress = buffer->GetGPUVirtualAddress();
+        memory.size = size;
+        memory.handle = buffer.Get();
+        buffers.push_back(buffer);
+        return memory;
+    }
+
+    void ReleaseMappedBuffer(const UploadMemory& memory) override {
+        for (auto it = buffers.begin(); it != buffers.end(); ++it) {
+            if (it->Get() == memory.handle) {
+                (*it)->Unmap(0, nullptr);
+                buffers.erase(it);
+                return;
+            }
+        }
+    }
+
+private:
+    std::vector<ComPtr<ID3D12Resource>> buffers;
+};
+
+class D3D12TimelineFence : public TimelineFence {
+public:
+    uint64_t CompletedValue() override { return fence->GetCompletedValue(); }
+
+    void WaitForValue(uint64_t value) override {
+        if (fence->GetCompletedValue() < value) {
+            ThrowIfFailed(fence->SetEventOnCompletion(value, fenceEvent));
+            WaitForSingleObject(fenceEvent, INFINITE);
+        }
+    }
+};
+
+const UINT64 UploadBytesPerFrame = 256 * 1024; // The bindless grid packs its MVPs into one array
+D3D12UploadDevice uploadDevice;
+D3D12TimelineFence frameFence;
+FramePacer framePacer(frameFence, FramesInFlight);
+std::unique_ptr<UploadRing> uploadRing;
+
+// Shader-visible descriptors: stable indices at the start of the heap, per-frame tables in a
+// ring after them. Views are created in a CPU-only staging heap and copied over in batches.
+const UINT PersistentDescriptors = 4096;
+const UINT TransientDescriptors = 1024;
+const UINT StagingDescriptors = 4096;
+ComPtr<ID3D12DescriptorHeap> stagingHeap;
+DescriptorFreeList persistentDescriptors(0, PersistentDescriptors);
+DescriptorRing transientDescriptors(frameFence, PersistentDescriptors, TransientDescriptors);
+DescriptorFreeList stagingDescriptors(0, StagingDescriptors);
+DescriptorCopyBatch descriptorCopies;
+UINT textureSrvStaging;
+UINT textureSrv; // Stable index in shaderVisibleHeap
+
+// The texture loader's copy queue: a COPY command queue with its own fence, and an allocator
+// per submission that is reset once the fence has passed it. Textures are created in COMMON;
+// the copy queue promotes them to COPY_DEST and the direct queue to PIXEL_SHADER_RESOURCE.
+class D3D12TextureCopyQueue : public TextureCopyQueue {
+public:
+    void Create() {
+        D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+        queueDesc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+        ThrowIfFailed(device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&queue)));
+        ThrowIfFailed(device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&copyFence.fence)));
+        copyFence.event = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+        for (ComPtr<ID3D12CommandAllocator>& allocator : allocators) {
+            ThrowIfFailed(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY, IID_PPV_ARGS(&allocator)));
+        }
+        ThrowIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COPY, allocators[0].Get(), nullptr, IID_PPV_ARGS(&list)));
+    }
+
+    void CreateTexture(uint32_t texture, TextureFormat format, uint32_t width, uint32_t height,
+        uint32_t mipLevels) override {
+        D3D12_RESOURCE_DESC textureDesc = {};
+        textureDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+        textureDesc.Width = width;
+        textureDesc.Height = height;
+        textureDesc.DepthOrArraySize = 1;
+        textureDesc.MipLevels = static_cast<UINT16>(mipLevels);
+        textureDesc.Format = static_cast<DXGI_FORMAT>(DxgiFormatValue(format));
+        textureDesc.SampleDesc.Count = 1;
+        auto heapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+        ComPtr<ID3D12Resource> resource;
+        ThrowIfFailed(device->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE, &textureDesc,
+            D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS(&resource)));
+        std::lock_guard<std::mutex> lock(mutex);
+        if (texture >= textures.size()) {
+            textures.resize(texture + 1);
+        }
+        textures[texture] = resource;
+    }
+
+    void CopyLevel(uint32_t texture, uint32_t level, const UploadMemory& staging,
+        const TextureLevelFootprint& footprint) override {
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT placed = {};
+        placed.Offset = footprint.offset;
+        placed.Footprint = { static_cast<DXGI_FORMAT>(DxgiFormatValue(footprint.format)), footprint.width, footprint.height, 1, footprint.rowPitch };
+        CD3DX12_TEXTURE_COPY_LOCATION source(static_cast<ID3D12Resource*>(staging.handle), placed);
+        CD3DX12_TEXTURE_COPY_LOCATION destination(Texture(texture).Get(), level);
+        list->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
+    }
+
+    void Submit(uint64_t fenceValue) override {
+        ThrowIfFailed(list->Close());
+        ID3D12CommandList* lists[] = { list.Get() };
+        queue->ExecuteCommandLists(1, lists);
+        ThrowIfFailed(queue->Signal(copyFence.fence.Get(), fenceValue));
+        allocatorFence[current] = fenceValue;
+
+        current = (current + 1) % AllocatorCount;
+        copyFence.WaitForValue(allocatorFence[current]);
+        ThrowIfFailed(allocators[current]->Reset());
+        ThrowIfFailed(list->Reset(allocators[current].Get(), nullptr));
+    }
+
+    TimelineFence& Fence() override { return copyFence; }
+
+    ComPtr<ID3D12Resource> Texture(uint32_t texture) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return textures[texture];
+    }
+
+private:
+    struct CopyFence : TimelineFence {
+        ComPtr<ID3D12Fence> fence;
+        HANDLE event = nullptr;
+
+        ~CopyFence() {
+            if (event) {
+                CloseHandle(event);
+            }
+        }
+
+        uint64_t CompletedValue() override { return fence->GetCompletedValue(); }
+
+        void WaitForValue(uint64_t value) override {
+            if (fence->GetCompletedValue() < value) {
+                ThrowIfFailed(fence->SetEventOnCompletion(value, event));
+                WaitForSingleObject(event, INFINITE);
+            }
+        }
+    };
+
+    static const UINT AllocatorCount = 4;
+    ComPtr<ID3D12CommandQueue> queue;
+    ComPtr<ID3D12CommandAllocator> allocators[AllocatorCount];
+    uint64_t allocatorFence[AllocatorCount] = {};
+    UINT current = 0;
+    ComPtr<ID3D12GraphicsCommandList> list;
+    CopyFence copyFence;
+    std::mutex mutex;   // textures is written on the loader's upload thread and read on the main thread
+    std::vector<ComPtr<ID3D12Resource>> textures;
+};
+
+// block.png, or block.dds or textures.pack when TextureConverter has made one, streams in
+// through the loader while the cube renders with a null view. The pack stays mapped for as
+// long as the loader may read from it.
+D3D12TextureCopyQueue textureCopyQueue;
+std::unique_ptr<TexturePack> texturePack;
+std::unique_ptr<TextureLoader> textureLoader;
+uint32_t blockTexture;
+
+CD3DX12_CPU_DESCRIPTOR_HANDLE CpuDescriptor(ID3D12DescriptorHeap* heap, UINT index) {
+    return CD3DX12_CPU_DESCRIPTOR_HANDLE(heap->GetCPUDescriptorHandleForHeapStart(), index, cbvSrvDescriptorSize);
+}
+
+// One CopyDescriptors call for everything staged since the last flush
+void FlushDescriptorCopies() {
+    if (descriptorCopies.Empty()) {
+        return;
+    }
+    std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> destinations, sources;
+    std::vector<UINT> sizes;
+    for (const DescriptorCopy& copy : descriptorCopies.Copies()) {
+        destinations.push_back(CpuDescriptor(shaderVisibleHeap.Get(), copy.destination));
+        sources.push_back(CpuDescriptor(stagingHeap.Get(), copy.source));
+        sizes.push_back(copy.count);
+    }
+    const UINT ranges = static_cast<UINT>(sizes.size());
+    device->CopyDescriptors(ranges, destinations.data(), sizes.data(), ranges, sources.data(), sizes.data(),
+        D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    descriptorCopies.Clear();
+}
+
+// --bindless-grid: a grid of cubes, each picking its texture and tint by index from arrays
+// bound once per frame (shader_bindless.hlsl). The unbounded texture range needs resource
+// binding tier 2.
+bool bindlessMode = false;
+const UINT BindlessGridSize = 32;
+const UINT BindlessTextureCount = 64;
+const UINT BindlessMaterialCount = 64;
+ComPtr<ID3D12RootSignature> bindlessRootSignature;
+ComPtr<ID3D12PipelineState> bindlessPipelineState;
+ComPtr<ID3D12Resource> materialBuffer; // float4 tint per material
+std::vector<ComPtr<ID3D12Resource>> bindlessTextures;
+std::vector<UINT> bindlessTextureSrv; // Stable indices in shaderVisibleHeap
+std::vector<DrawItem> bindlessDraws;
+
+// The RecordingCommandList calls on commandList and device, so the submission code in
+// DrawSubmission.h records straight into the frame's command list. Tables are heap indices.
+class D3D12DrawCommands {
+public:
+    void SetGraphicsRootDescriptorTable(uint32_t parameter, uint32_t descriptorIndex) {
+        CD3DX12_GPU_DESCRIPTOR_HANDLE handle(shaderVisibleHeap->GetGPUDescriptorHandleForHeapStart(), descriptorIndex, cbvSrvDescriptorSize);
+        commandList->SetGraphicsRootDescriptorTable(parameter, handle);
+    }
+
+    void SetGraphicsRoot32BitConstants(uint32_t parameter, uint32_t count, const void* data, uint32_t offset) {
+        commandList->SetGraphicsRoot32BitConstants(parameter, count, data, offset);
+    }
+
+    void SetGraphicsRootConstantBufferView(uint32_t parameter, uint64_t gpuAddress) {
+        commandList->SetGraphicsRootConstantBufferView(parameter, gpuAddress);
+    }
+
+    void SetGraphicsRootShaderResourceView(uint32_t parameter, uint64_t gpuAddress) {
+        commandList->SetGraphicsRootShaderResourceView(parameter, gpuAddress);
+    }
+
+    void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex,
+        uint32_t startInstance) {
+        commandList->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+    }
+
+    void CreateConstantBufferView(uint32_t descriptorIndex, uint64_t gpuAddress, uint32_t size) {
+        D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
+        cbvDesc.BufferLocation = gpuAddress;
+        cbvDesc.SizeInBytes = size;
+        device->CreateConstantBufferView(&cbvDesc, CpuDescriptor(shaderVisibleHeap.Get(), descriptorIndex));
+    }
+
+    // The submission code stages into the global batch
+    void CopyDescriptors(const DescriptorCopyBatch&) {
+        FlushDescriptorCopies();
+    }
+};
+
 // Timer
 std::chrono::steady_clock::time_point startTime;
+float fixedTime = -1.0f; // --time T pins the animation, e.g. to compare against the golden images
 
 // Helper Functions
 void ThrowIfFailed(HRESULT hr) {
@@ -229,102 +424,210 @@ void LoadAssets() {
     }
 
     {
-		// Create a descriptor heap for the constant buffer view
+		// Create the shader-visible heap for the persistent and per-frame regions, and the
+		// staging heap views are created in
 		D3D12_DESCRIPTOR_HEAP_DESC cbvHeapDesc = {};
-		cbvHeapDesc.NumDescriptors = 100;
+		cbvHeapDesc.NumDescriptors = PersistentDescriptors + TransientDescriptors;
 		cbvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
 		cbvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
 		ThrowIfFailed(device->CreateDescriptorHeap(&cbvHeapDesc, IID_PPV_ARGS(&shaderVisibleHeap)));
-
-		// Create the constant buffer resource
-		const UINT bufferSize = (sizeof(XMMATRIX) + 255) & ~255;
-		auto heapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-		auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize, D3D12_RESOURCE_FLAG_NONE);
-		ThrowIfFailed(device->CreateCommittedResource(
-			&heapProps, D3D12_HEAP_FLAG_NONE,
-			&bufferDesc,
-			D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&constantBuffer)));
-
-		// Create the constant buffer view
-		cbvDesc.BufferLocation = constantBuffer->GetGPUVirtualAddress();
-		cbvDesc.SizeInBytes = bufferSize;
-		device->CreateConstantBufferView(&cbvDesc, shaderVisibleHeap->GetCPUDescriptorHandleForHeapStart());
-
-        // Load texture
-		int width, height, channels;
-		unsigned char* imageData = stbi_load("block.png", &width, &height, &channels, 4);
-		if (!imageData) {
-			throw std::runtime_error("Failed to load texture image");
-		}
-
-		// Create texture resource
-		D3D12_RESOURCE_DESC textureDesc = {};
-		textureDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-		textureDesc.Width = width;
-		textureDesc.Height = height;
-		textureDesc.DepthOrArraySize = 1;
-		textureDesc.MipLevels = 1;
-		textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-		textureDesc.SampleDesc.Count = 1;
-		textureDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
-
-		auto heapPropsTexture = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-		ThrowIfFailed(device->CreateCommittedResource(
-			&heapPropsTexture, D3D12_HEAP_FLAG_NONE,
-			&textureDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&texture)));
-
-        const UINT64 uploadBufferSize = GetRequiredIntermediateSize(texture.Get(), 0, 1);
-
-		ComPtr<ID3D12Resource> textureUploadHeap;
-
-        // Create the GPU upload buffer.
-        auto textureUploadHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-        auto textureUploadResourceDescription = CD3DX12_RESOURCE_DESC::Buffer(uploadBufferSize);
-        ThrowIfFailed(device->CreateCommittedResource(
-            &textureUploadHeapProperties,
-            D3D12_HEAP_FLAG_NONE,
-            &textureUploadResourceDescription,
-            D3D12_RESOURCE_STATE_GENERIC_READ,
-            nullptr,
-            IID_PPV_ARGS(&textureUploadHeap)));
-
-		// Copy image data to the texture
-		D3D12_SUBRESOURCE_DATA subresourceData = {};
-		subresourceData.pData = imageData;
-		subresourceData.RowPitch = width * 4; // 4 bytes per pixel
-		subresourceData.SlicePitch = subresourceData.RowPitch * height;
-
-		// Create a command list for copying the data
-		ComPtr<ID3D12GraphicsCommandList> copyCommandList;
-		ThrowIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, commandAllocator.Get(), nullptr, IID_PPV_ARGS(&copyCommandList)));
-		UpdateSubresources(copyCommandList.Get(), texture.Get(), textureUploadHeap.Get(), 0, 0, 1, &subresourceData);
-        auto textureResourceBarrier = CD3DX12_RESOURCE_BARRIER::Transition(texture.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
-        copyCommandList->ResourceBarrier(1, &textureResourceBarrier);
-		ThrowIfFailed(copyCommandList->Close());
-		ID3D12CommandList* ppCommandLists[] = { copyCommandList.Get() };
-		commandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
-		// wait for the command queue to finish
-		ComPtr<ID3D12Fence> fence;
-		HANDLE fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
-		uint32_t copyFenceValue = 0;
-		ThrowIfFailed(device->CreateFence(copyFenceValue, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fence)));
-		commandQueue->Signal(fence.Get(), copyFenceValue);
-        if (fence->GetCompletedValue() < copyFenceValue) {
-            ThrowIfFailed(fence->SetEventOnCompletion(copyFenceValue, fenceEvent));
-            WaitForSingleObject(fenceEvent, INFINITE);
+		cbvSrvDescriptorSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+		D3D12_DESCRIPTOR_HEAP_DESC stagingHeapDesc = {};
+		stagingHeapDesc.NumDescriptors = StagingDescriptors;
+		stagingHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+		stagingHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+		ThrowIfFailed(device->CreateDescriptorHeap(&stagingHeapDesc, IID_PPV_ARGS(&stagingHeap)));
+
+		// The fence is created after LoadAssets; the ring only reads it from BeginFrame on
+		uploadRing = std::make_unique<UploadRing>(uploadDevice, frameFence, FramesInFlight, UploadBytesPerFrame);
+
+        // Load the texture on the loader's threads; the window renders meanwhile. The decode
+        // threads build the full mip chain as the CPU reference does and every level is
+        // copied to its own subresource. A block.dds next to it is uploaded as stored, mips
+        // and format included, with nothing to decode; from a textures.pack holding "block"
+        // it is copied straight out of the mapped file without reading anything first.
+        textureCopyQueue.Create();
+        TextureLoader::Options loaderOptions;
+        loaderOptions.mips = BlockTextureMips();
+        textureLoader = std::make_unique<TextureLoader>(uploadDevice, textureCopyQueue, loaderOptions);
+        if (std::filesystem::exists("textures.pack")) {
+            texturePack = std::make_unique<TexturePack>("textures.pack");
+        }
+        const uint32_t packedBlock = texturePack ? texturePack->Find("block") : TexturePack::NotFound;
+        if (packedBlock != TexturePack::NotFound) {
+            blockTexture = textureLoader->Load(*texturePack, packedBlock);
+        }
+        else {
+            blockTexture = textureLoader->Load(std::filesystem::exists("block.dds") ? "block.dds" : "block.png");
         }
-		CloseHandle(fenceEvent);
-		stbi_image_free(imageData); // Free the image data after copying
 
-		// Create the shader resource view for the texture
+		// Until then the texture's SRV is a null view, which samples as zero
 		srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
 		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
 		srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
 		srvDesc.Texture2D.MostDetailedMip = 0;
 		srvDesc.Texture2D.MipLevels = 1;
 		srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
-		auto srvHandle = CD3DX12_CPU_DESCRIPTOR_HANDLE(shaderVisibleHeap->GetCPUDescriptorHandleForHeapStart(), 1, device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV));
-		device->CreateShaderResourceView(texture.Get(), &srvDesc, srvHandle);
+		textureSrvStaging = stagingDescriptors.Allocate();
+		device->CreateShaderResourceView(nullptr, &srvDesc, CpuDescriptor(stagingHeap.Get(), textureSrvStaging));
+
+		// The texture also keeps a stable index in the persistent region
+		textureSrv = persistentDescriptors.Allocate();
+		descriptorCopies.Add(textureSrvStaging, textureSrv);
+		FlushDescriptorCopies();
+
+		if (bindlessMode) {
+			LoadBindlessAssets();
+		}
+    }
+}
+
+// Recolored copies of block.png, all uploaded by one command list out of one upload buffer,
+// and the material tints. Every texture gets a stable SRV in the persistent region, which
+// the unbounded texture range of the bindless root signature covers from index 0. The
+// textures are BC7, a quarter of the memory R8G8B8A8 takes, encoded here at load time.
+void LoadBindlessAssets() {
+    int width, height, channels;
+    unsigned char* imageData = stbi_load("block.png", &width, &height, &channels, 4);
+    if (!imageData) {
+        throw std::runtime_error("Failed to load texture image");
+    }
+    if (width % 4 != 0 || height % 4 != 0) {
+        stbi_image_free(imageData);
+        throw std::runtime_error("BC7 textures need a width and height that are multiples of 4");
+    }
+    const size_t imageBytes = static_cast<size_t>(width) * height * 4;
+
+    D3D12_RESOURCE_DESC textureDesc = {};
+    textureDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+    textureDesc.Width = width;
+    textureDesc.Height = height;
+    textureDesc.DepthOrArraySize = 1;
+    textureDesc.MipLevels = 1;
+    textureDesc.Format = DXGI_FORMAT_BC7_UNORM;
+    textureDesc.SampleDesc.Count = 1;
+    textureDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+    auto defaultHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+    bindlessTextures.resize(BindlessTextureCount);
+    for (UINT i = 0; i < BindlessTextureCount; i++) {
+        ThrowIfFailed(device->CreateCommittedResource(
+            &defaultHeapProps, D3D12_HEAP_FLAG_NONE,
+            &textureDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&bindlessTextures[i])));
+    }
+
+    // Every texture has the same footprint, computed without asking the device; each starts
+    // on a D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT boundary
+    SubresourceLayoutDesc layoutDesc;
+    layoutDesc.format = TextureFormat::BC7;
+    layoutDesc.width = width;
+    layoutDesc.height = height;
+    std::vector<SubresourceFootprint> textureFootprint;
+    const UINT64 textureUploadSize = (GetCopyableFootprints(layoutDesc, 0, 1, 0, textureFootprint) +
+        D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1) & ~UINT64(D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1);
+    ComPtr<ID3D12Resource> uploadBuffer;
+    auto uploadHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+    auto uploadBufferDesc = CD3DX12_RESOURCE_DESC::Buffer(textureUploadSize * BindlessTextureCount);
+    ThrowIfFailed(device->CreateCommittedResource(
+        &uploadHeapProps, D3D12_HEAP_FLAG_NONE,
+        &uploadBufferDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&uploadBuffer)));
+
+    ComPtr<ID3D12GraphicsCommandList> copyCommandList;
+    ThrowIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, commandAllocator[0].Get(), nullptr, IID_PPV_ARGS(&copyCommandList)));
+
+    // Texture i swaps the color channels one of six ways and darkens them in four steps, so
+    // only 24 of them differ; each of those is encoded once, its block rows spread over the cores
+    static const int channelOrder[6][3] = { { 0, 1, 2 }, { 1, 2, 0 }, { 2, 0, 1 }, { 0, 2, 1 }, { 2, 1, 0 }, { 1, 0, 2 } };
+    TaskScheduler scheduler;
+    const BlockCompressor compressor;
+    CpuImage variant(width, height);
+    std::vector<CompressedImage> encoded(24);
+    std::vector<SubresourceFootprint> footprints;
+    std::vector<SubresourceData> sources;
+    for (UINT i = 0; i < BindlessTextureCount; i++) {
+        CompressedImage& blocks = encoded[i % 24];
+        if (blocks.blocks.empty()) {
+            const int* order = channelOrder[i % 6];
+            const UINT scale = 256 - ((i / 6) % 4) * 48;
+            for (size_t p = 0; p < imageBytes; p += 4) {
+                for (int c = 0; c < 3; c++) {
+                    variant.pixels[p + c] = static_cast<unsigned char>((imageData[p + order[c]] * scale) >> 8);
+                }
+                variant.pixels[p + 3] = imageData[p + 3];
+            }
+            blocks = compressor.Compress(variant, BcFormat::BC7, BcQuality::Normal, &scheduler);
+        }
+
+        // A row of 4x4 blocks is the unit of RowPitch for block-compressed formats
+        SubresourceFootprint footprint = textureFootprint[0];
+        footprint.offset = textureUploadSize * i;
+        footprints.push_back(footprint);
+        sources.push_back({ blocks.blocks.data(), blocks.RowPitch() });
+    }
+    stbi_image_free(imageData);
+
+    // What UpdateSubresources does per texture: every texture's rows at once, spread over the
+    // cores, then a copy per texture from its footprint
+    uint8_t* uploadData;
+    CD3DX12_RANGE readRange(0, 0);
+    ThrowIfFailed(uploadBuffer->Map(0, &readRange, reinterpret_cast<void**>(&uploadData)));
+    const SubresourceCopier copier;
+    copier.Copy(uploadData, textureUploadSize * BindlessTextureCount, footprints, sources.data(), &scheduler);
+    uploadBuffer->Unmap(0, nullptr);
+    std::vector<CD3DX12_RESOURCE_BARRIER> barriers;
+    for (UINT i = 0; i < BindlessTextureCount; i++) {
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT placed = {};
+        placed.Offset = footprints[i].offset;
+        placed.Footprint = { textureDesc.Format, footprints[i].width, footprints[i].height, 1, footprints[i].rowPitch };
+        CD3DX12_TEXTURE_COPY_LOCATION source(uploadBuffer.Get(), placed);
+        CD3DX12_TEXTURE_COPY_LOCATION destination(bindlessTextures[i].Get(), 0);
+        copyCommandList->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
+        barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(bindlessTextures[i].Get(),
+            D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+    }
+    copyCommandList->ResourceBarrier(static_cast<UINT>(barriers.size()), barriers.data());
+    ThrowIfFailed(copyCommandList->Close());
+    ID3D12CommandList* ppCommandLists[] = { copyCommandList.Get() };
+    commandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+
+    // Views go to the staging heap and reach the shader-visible heap in one CopyDescriptors
+    D3D12_SHADER_RESOURCE_VIEW_DESC bindlessSrvDesc = srvDesc;
+    bindlessSrvDesc.Format = textureDesc.Format;
+    bindlessTextureSrv.resize(BindlessTextureCount);
+    for (UINT i = 0; i < BindlessTextureCount; i++) {
+        const UINT staging = stagingDescriptors.Allocate();
+        device->CreateShaderResourceView(bindlessTextures[i].Get(), &bindlessSrvDesc, CpuDescriptor(stagingHeap.Get(), staging));
+        bindlessTextureSrv[i] = persistentDescriptors.Allocate();
+        descriptorCopies.Add(staging, bindlessTextureSrv[i]);
+    }
+    FlushDescriptorCopies();
+
+    // Tints stay in an upload heap: 1 KB the GPU reads every frame and nobody writes again
+    std::vector<XMFLOAT4> tints(BindlessMaterialCount);
+    for (UINT i = 0; i < BindlessMaterialCount; i++) {
+        const float hue = XM_2PI * i / BindlessMaterialCount;
+        tints[i] = XMFLOAT4(0.6f + 0.4f * cosf(hue), 0.6f + 0.4f * cosf(hue - XM_2PI / 3), 0.6f + 0.4f * cosf(hue + XM_2PI / 3), 1.0f);
+    }
+    const UINT materialBytes = static_cast<UINT>(tints.size() * sizeof(XMFLOAT4));
+    auto materialBufferDesc = CD3DX12_RESOURCE_DESC::Buffer(materialBytes);
+    ThrowIfFailed(device->CreateCommittedResource(
+        &uploadHeapProps, D3D12_HEAP_FLAG_NONE,
+        &materialBufferDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&materialBuffer)));
+    void* materialData;
+    ThrowIfFailed(materialBuffer->Map(0, &readRange, &materialData));
+    memcpy(materialData, tints.data(), materialBytes);
+    materialBuffer->Unmap(0, nullptr);
+
+    // The upload buffer is released on return, so wait for the copies
+    ComPtr<ID3D12Fence> copyFence;
+    ThrowIfFailed(device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&copyFence)));
+    ThrowIfFailed(commandQueue->Signal(copyFence.Get(), 1));
+    if (copyFence->GetCompletedValue() < 1) {
+        HANDLE copyEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+        ThrowIfFailed(copyFence->SetEventOnCompletion(1, copyEvent));
+        WaitForSingleObject(copyEvent, INFINITE);
+        CloseHandle(copyEvent);
     }
 }
 
@@ -429,7 +732,9 @@ void Initialize() {
     device->CreateDepthStencilView(depthStencilBuffer.Get(), &dsvDesc, dsvHandle);
 
     // Command Allocator
-    ThrowIfFailed(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&commandAllocator)));
+    for (UINT i = 0; i < FramesInFlight; i++) {
+        ThrowIfFailed(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&commandAllocator[i])));
+    }
 }
 
 void LoadShaderPipeline() {
@@ -509,17 +814,98 @@ void LoadShaderPipeline() {
     psoDesc.SampleDesc.Count = 1;
 
     ThrowIfFailed(device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&pipelineState)));
-    ThrowIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, commandAllocator.Get(), pipelineState.Get(), IID_PPV_ARGS(&commandList)));
+
+    if (bindlessMode) {
+        // Unbounded descriptor ranges and root-indexed texture arrays need resource binding tier 2
+        D3D12_FEATURE_DATA_D3D12_OPTIONS options = {};
+        ThrowIfFailed(device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(options)));
+        if (options.ResourceBindingTier < D3D12_RESOURCE_BINDING_TIER_2) {
+            throw std::runtime_error("--bindless-grid needs resource binding tier 2");
+        }
+
+        ComPtr<ID3DBlob> bindlessVs, bindlessPs;
+        ThrowIfFailed(D3DCompileFromFile(L"shader_bindless.hlsl", nullptr, nullptr, "VSMain", "vs_5_1", 0, 0, &bindlessVs, nullptr));
+        ThrowIfFailed(D3DCompileFromFile(L"shader_bindless.hlsl", nullptr, nullptr, "PSMain", "ps_5_1", 0, 0, &bindlessPs, nullptr));
+
+        D3D12_ROOT_PARAMETER bindlessParams[BindlessRootParameterCount] = {};
+        bindlessParams[BindlessDrawConstants].ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+        bindlessParams[BindlessDrawConstants].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+        bindlessParams[BindlessDrawConstants].Constants.ShaderRegister = 0;
+        bindlessParams[BindlessDrawConstants].Constants.RegisterSpace = 1;
+        bindlessParams[BindlessDrawConstants].Constants.Num32BitValues = sizeof(DrawConstants) / 4;
+
+        bindlessParams[BindlessTransforms].ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+        bindlessParams[BindlessTransforms].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
+        bindlessParams[BindlessTransforms].Descriptor.ShaderRegister = 0;
+        bindlessParams[BindlessTransforms].Descriptor.RegisterSpace = 1;
+
+        bindlessParams[BindlessMaterials].ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+        bindlessParams[BindlessMaterials].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+        bindlessParams[BindlessMaterials].Descriptor.ShaderRegister = 1;
+        bindlessParams[BindlessMaterials].Descriptor.RegisterSpace = 1;
+
+        // Every texture in the heap from index 0 on
+        D3D12_DESCRIPTOR_RANGE textureRange = {};
+        textureRange.RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
+        textureRange.NumDescriptors = UINT_MAX;
+        textureRange.BaseShaderRegister = 0;
+        textureRange.RegisterSpace = 2;
+        textureRange.OffsetInDescriptorsFromTableStart = 0;
+        bindlessParams[BindlessTextures].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+        bindlessParams[BindlessTextures].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+        bindlessParams[BindlessTextures].DescriptorTable.NumDescriptorRanges = 1;
+        bindlessParams[BindlessTextures].DescriptorTable.pDescriptorRanges = &textureRange;
+
+        rootSigDesc.NumParameters = BindlessRootParameterCount;
+        rootSigDesc.pParameters = bindlessParams;
+        ComPtr<ID3DBlob> bindlessSigBlob;
+        ThrowIfFailed(D3D12SerializeRootSignature(&rootSigDesc, D3D_ROOT_SIGNATURE_VERSION_1, &bindlessSigBlob, nullptr));
+        ThrowIfFailed(device->CreateRootSignature(0, bindlessSigBlob->GetBufferPointer(), bindlessSigBlob->GetBufferSize(), IID_PPV_ARGS(&bindlessRootSignature)));
+
+        psoDesc.pRootSignature = bindlessRootSignature.Get();
+        psoDesc.VS = { bindlessVs->GetBufferPointer(), bindlessVs->GetBufferSize() };
+        psoDesc.PS = { bindlessPs->GetBufferPointer(), bindlessPs->GetBufferSize() };
+        ThrowIfFailed(device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&bindlessPipelineState)));
+    }
+    ThrowIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, commandAllocator[0].Get(), pipelineState.Get(), IID_PPV_ARGS(&commandList)));
 	commandList->Close(); // Close the command list after creating it
 }
 
+// Views for the textures that became resident since the last frame. Frames in flight may
+// still read the null view, so the texture gets a new persistent index instead of overwriting it.
+void PollTextureLoads() {
+    for (const TextureLoader::Resident& resident : textureLoader->TakeResident()) {
+        if (!resident.error.empty()) {
+            std::cerr << resident.error << std::endl;
+            continue;
+        }
+        if (resident.texture == blockTexture) {
+            texture = textureCopyQueue.Texture(resident.texture);
+            D3D12_SHADER_RESOURCE_VIEW_DESC mipsDesc = srvDesc;
+            mipsDesc.Format = static_cast<DXGI_FORMAT>(DxgiFormatValue(resident.format));
+            mipsDesc.Texture2D.MipLevels = resident.mipLevels;
+            device->CreateShaderResourceView(texture.Get(), &mipsDesc, CpuDescriptor(stagingHeap.Get(), textureSrvStaging));
+            textureSrv = persistentDescriptors.Allocate();
+            descriptorCopies.Add(textureSrvStaging, textureSrv);
+            FlushDescriptorCopies();
+        }
+    }
+}
+
 // Main render loop
 void UpdateAndRender() {
-    // Reset the command allocator.  This is done at the beginning of each frame.
-    ThrowIfFailed(commandAllocator->Reset());
+    // Waits only if the GPU has not finished the frame that last used this frame context,
+    // which also retires the context's part of the upload ring
+    framePacer.BeginFrame();
+    uploadRing->BeginFrame();
+    PollTextureLoads();
+
+    // Reset the frame context's command allocator; the GPU is done with its commands
+    ID3D12CommandAllocator* allocator = commandAllocator[framePacer.FrameIndex()].Get();
+    ThrowIfFailed(allocator->Reset());
 
     // Reset the command list.
-    ThrowIfFailed(commandList->Reset(commandAllocator.Get(), pipelineState.Get()));
+    ThrowIfFailed(commandList->Reset(allocator, bindlessMode ? bindlessPipelineState.Get() : pipelineState.Get()));
 
     // Resource barriers for render target and depth stencil
     CD3DX12_RESOURCE_BARRIER rtBarrierBegin = CD3DX12_RESOURCE_BARRIER::Transition(
@@ -553,38 +939,65 @@ void UpdateAndRender() {
     commandList->ClearDepthStencilView(dsvHandle, D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
 
     // Set pipeline state and resources
-    commandList->SetGraphicsRootSignature(rootSignature.Get());
+    commandList->SetGraphicsRootSignature(bindlessMode ? bindlessRootSignature.Get() : rootSignature.Get());
     commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
     commandList->IASetVertexBuffers(0, 1, &vertexBufferView);
     commandList->IASetIndexBuffer(&indexBufferView);
 
     // MVP Calculation
     auto now = std::chrono::steady_clock::now();
-    float time = std::chrono::duration<float>(now - startTime).count();
+    float time = fixedTime >= 0.0f ? fixedTime : std::chrono::duration<float>(now - startTime).count();
 
     XMMATRIX model = XMMatrixRotationY(time) * XMMatrixRotationX(time * 0.5f);
     XMMATRIX view = XMMatrixLookAtLH({ 0.0f, 0.0f, -5.0f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f });
     XMMATRIX proj = XMMatrixPerspectiveFovLH(XMConvertToRadians(90.0f), (float)Width / (float)Height, 0.1f, 100.0f);
     XMMATRIX mvp = model * view * proj;
 
-    // [The first MVP]
-    //commandList->SetGraphicsRoot32BitConstants(0, sizeof(DirectX::XMMATRIX) / 4, &mvp, 0);
-
-	// [The second MVP]
-	 UINT8* pData;
-	 ThrowIfFailed(constantBuffer->Map(0, nullptr, reinterpret_cast<void**>(&pData)));
-	 memcpy(pData, &mvp, sizeof(XMMATRIX));
-	 constantBuffer->Unmap(0, nullptr);
-	// commandList->SetGraphicsRootConstantBufferView(1, constantBuffer->GetGPUVirtualAddress());
-
-	// [The third MVP]
-	ID3D12DescriptorHeap* heaps[] = { shaderVisibleHeap.Get() };
-	commandList->SetDescriptorHeaps(1, heaps);
-	D3D12_GPU_DESCRIPTOR_HANDLE gpuHandle = shaderVisibleHeap->GetGPUDescriptorHandleForHeapStart();
-	commandList->SetGraphicsRootDescriptorTable(0, gpuHandle);
+    if (bindlessMode) {
+        // Same spin for every cube, laid out in a grid the camera sees from further back
+        static_assert(sizeof(Float4x4) == sizeof(XMFLOAT4X4), "DrawItem transforms are XMFLOAT4X4s");
+        XMMATRIX gridViewProj = XMMatrixLookAtLH({ 0.0f, 0.0f, -60.0f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }) * proj;
+        bindlessDraws.resize(BindlessGridSize * BindlessGridSize);
+        for (UINT i = 0; i < bindlessDraws.size(); i++) {
+            const float x = (static_cast<float>(i % BindlessGridSize) - (BindlessGridSize - 1) * 0.5f) * 3.0f;
+            const float y = (static_cast<float>(i / BindlessGridSize) - (BindlessGridSize - 1) * 0.5f) * 3.0f;
+            XMStoreFloat4x4(reinterpret_cast<XMFLOAT4X4*>(&bindlessDraws[i].transform), model * XMMatrixTranslation(x, y, 0.0f) * gridViewProj);
+            bindlessDraws[i].materialIndex = i % BindlessMaterialCount;
+            bindlessDraws[i].textureIndex = bindlessTextureSrv[(i / BindlessMaterialCount + i) % BindlessTextureCount];
+        }
 
-    // Draw
-    commandList->DrawIndexedInstanced(_countof(cubeIndices), 1, 0, 0, 0);
+        ID3D12DescriptorHeap* heaps[] = { shaderVisibleHeap.Get() };
+        commandList->SetDescriptorHeaps(1, heaps);
+        D3D12DrawCommands commands;
+        SubmitBindless(commands, *uploadRing, materialBuffer->GetGPUVirtualAddress(), 0,
+            bindlessDraws.data(), static_cast<uint32_t>(bindlessDraws.size()), _countof(cubeIndices));
+    }
+    else {
+        // [The first MVP]
+        //commandList->SetGraphicsRoot32BitConstants(0, sizeof(DirectX::XMMATRIX) / 4, &mvp, 0);
+
+		// [The second MVP]
+		UploadRing::Allocation constants = uploadRing->AllocateConstants(mvp);
+		// commandList->SetGraphicsRootConstantBufferView(1, constants.gpuAddress);
+
+		// [The third MVP]
+		// A { CBV, SRV } table from the per-frame ring: the CBV is written in place, the SRV
+		// copied from the staging heap
+		UINT tableStart = transientDescriptors.Allocate(2);
+		D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
+		cbvDesc.BufferLocation = constants.gpuAddress;
+		cbvDesc.SizeInBytes = static_cast<UINT>(constants.size);
+		device->CreateConstantBufferView(&cbvDesc, CpuDescriptor(shaderVisibleHeap.Get(), tableStart));
+		descriptorCopies.Add(textureSrvStaging, tableStart + 1);
+		FlushDescriptorCopies();
+		ID3D12DescriptorHeap* heaps[] = { shaderVisibleHeap.Get() };
+		commandList->SetDescriptorHeaps(1, heaps);
+		CD3DX12_GPU_DESCRIPTOR_HANDLE gpuHandle(shaderVisibleHeap->GetGPUDescriptorHandleForHeapStart(), tableStart, cbvSrvDescriptorSize);
+		commandList->SetGraphicsRootDescriptorTable(0, gpuHandle);
+
+        // Draw
+        commandList->DrawIndexedInstanced(_countof(cubeIndices), 1, 0, 0, 0);
+    }
 
     // Resource barrier for present
     CD3DX12_RESOURCE_BARRIER rtBarrierEnd = CD3DX12_RESOURCE_BARRIER::Transition(
@@ -599,13 +1012,11 @@ void UpdateAndRender() {
     commandQueue->ExecuteCommandLists(1, cmdLists);
     ThrowIfFailed(swapChain->Present(1, 0));
 
-    // Fence and update frame index
-    fenceValue++;
+    // Tag the frame context with its fence value and move on without waiting for the GPU
+    const UINT64 fenceValue = framePacer.EndFrame();
     ThrowIfFailed(commandQueue->Signal(fence.Get(), fenceValue));
-    if (fence->GetCompletedValue() < fenceValue) {
-        ThrowIfFailed(fence->SetEventOnCompletion(fenceValue, fenceEvent));
-        WaitForSingleObject(fenceEvent, INFINITE);
-    }
+    uploadRing->EndFrame(fenceValue);
+    transientDescriptors.EndFrame(fenceValue);
     frameIndex = swapChain->GetCurrentBackBufferIndex();
 }
 
@@ -654,7 +1065,21 @@ static void GetHardwareAdapter(
     }
 }
 
-int main() {
+int main(int argc, char** argv) {
+    // Other switches select the CPU renderer instead of the window; --time pins the animation
+    // and --bindless-grid draws the bindless cube grid
+    if (argc > 1 && std::string(argv[1]) != "--time" && std::string(argv[1]) != "--bindless-grid") {
+        return RunHeadless(argc, argv);
+    }
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--time" && i + 1 < argc) {
+            fixedTime = std::stof(argv[++i]);
+        }
+        else if (std::string(argv[i]) == "--bindless-grid") {
+            bindlessMode = true;
+        }
+    }
+
     std::cout << "Starting Direct3D 12 Cube Demo" << std::endl;
     HINSTANCE hInstance = GetModuleHandle(nullptr);
     InitWindow(hInstance);
@@ -680,6 +1105,11 @@ int main() {
         //UpdateAndRender();
     }
 
+    // The GPU may still run the last frames in flight
+    framePacer.WaitForIdle();
+    textureLoader.reset();
+    texturePack.reset();
+    uploadRing.reset();
     CloseHandle(fenceEvent);
     std::cout << "Exiting Direct3D 12 Cube Demo" << std::endl;
     return 0;
@@ -0,0 +1,42 @@
+
+// Bindless variant of shader.hlsl: a draw binds nothing but three root constants, which
+// pick its MVP, its material and its texture out of arrays bound once per frame
+struct DrawConstants
+{
+	uint transformIndex;
+	uint materialIndex;
+	uint textureIndex;
+};
+
+struct Material
+{
+	float4 tint;
+};
+
+ConstantBuffer<DrawConstants> draw : register(b0, space1);
+StructuredBuffer<float4x4> transforms : register(t0, space1);
+StructuredBuffer<Material> materials : register(t1, space1);
+Texture2D textures[] : register(t0, space2);
+SamplerState samplerState : register(s0);
+
+struct VSInput {
+    float3 pos : POSITION;
+	float2 uv : TEXCOORD;
+};
+
+struct PSInput {
+    float4 pos : SV_POSITION;
+	float2 uv : TEXCOORD;
+};
+
+PSInput VSMain(VSInput input) {
+    PSInput output;
+    output.pos = mul(transforms[draw.transformIndex], float4(input.pos, 1.0));
+    output.uv = input.uv;
+    return output;
+}
+
+// The indices are the same for the whole draw, so no NonUniformResourceIndex
+float4 PSMain(PSInput input) : SV_TARGET {
+	return textures[draw.textureIndex].Sample(samplerState, input.uv) * materials[draw.materialIndex].tint;
+}
@@ -0,0 +1,240 @@
+// Golden-image regression harness for the three samples. Every case renders one sample
+// headlessly on the CPU at a fixed animation time and compares the frame against a PNG
+// checked in under golden/. Cases run in parallel; a failing case writes the rendered frame
+// and a diff image to the output directory.
+//
+// Run it from this directory so the default paths resolve. On Linux build it with:
+//   g++ -std=c++17 -O2 -pthread main.cpp ../Common/*.cpp ../MVPmatrix/CpuRenderer.cpp ../DescritorTable/CpuRenderer.cpp ../UAVComputerShader/CpuCompute.cpp ../UAVComputerShader/CSMainSimd.cpp -o golden_image
+#include "../Common/CpuImage.h"
+#include "../Common/ImageCompare.h"
+#include "../Common/ImageFile.h"
+#include "../Common/SoftwareRasterizer.h"
+#include "../Common/TaskScheduler.h"
+#include "../DescritorTable/CpuRenderer.h"
+#include "../MVPmatrix/CpuRenderer.h"
+#include "../UAVComputerShader/CpuCompute.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    enum class Sample {
+        MVPmatrix,
+        DescritorTable,
+        UAVComputerShader,
+    };
+
+    struct TestCase {
+        Sample sample;
+        float time;                 // Replaces the steady_clock time since startTime
+        uint32_t tolerance;         // Largest per-channel difference that still counts as equal
+        double minPsnr;             // Over RGB, in dB
+        uint32_t maxPixelsOverTolerance;
+    };
+
+    // All samples render at the window size used by the D3D12 path
+    const uint32_t Width = 800;
+    const uint32_t Height = 600;
+
+    // A few pixels of slack on the cubes absorb edge pixels where another rasterizer's
+    // interpolation lands on the other side of a rounding boundary
+    const TestCase testCases[] = {
+        { Sample::MVPmatrix, 0.0f, 2, 40.0, 64 },
+        { Sample::MVPmatrix, 1.5f, 2, 40.0, 64 },
+        { Sample::MVPmatrix, 4.0f, 2, 40.0, 64 },
+        { Sample::DescritorTable, 0.0f, 2, 40.0, 64 },
+        { Sample::DescritorTable, 1.5f, 2, 40.0, 64 },
+        { Sample::DescritorTable, 4.0f, 2, 40.0, 64 },
+        { Sample::UAVComputerShader, 0.0f, 1, 45.0, 0 },
+        { Sample::UAVComputerShader, 1.5f, 1, 45.0, 0 },
+        { Sample::UAVComputerShader, 4.0f, 1, 45.0, 0 },
+    };
+
+    struct HarnessOptions {
+        std::string goldenDir = "golden";
+        std::string outputDir = "golden_out";
+        std::string texturePath = "../DescritorTable/block.png";
+        std::string filter;
+        unsigned threads = 0;
+        bool update = false;
+    };
+
+    struct CaseResult {
+        bool ran = false;
+        bool passed = false;
+        std::string message;
+        double milliseconds = 0.0;
+    };
+
+    const char* SampleName(Sample sample) {
+        switch (sample) {
+        case Sample::MVPmatrix: return "MVPmatrix";
+        case Sample::DescritorTable: return "DescritorTable";
+        default: return "UAVComputerShader";
+        }
+    }
+
+    std::string CaseName(const TestCase& testCase) {
+        char time[32];
+        std::snprintf(time, sizeof(time), "%.2f", testCase.time);
+        return std::string(SampleName(testCase.sample)) + "_t" + time;
+    }
+
+    void PrintUsage() {
+        std::cout <<
+            "Usage: GoldenImage [options]\n"
+            "  --golden DIR     golden PNGs (default golden)\n"
+            "  --out DIR        rendered and diff images of failing cases (default golden_out)\n"
+            "  --texture FILE   DescritorTable texture (default ../DescritorTable/block.png)\n"
+            "  --filter TEXT    only run cases whose name contains TEXT\n"
+            "  --threads N      worker threads, 0 = all cores (default 0)\n"
+            "  --update         overwrite the golden PNGs with the current output\n";
+    }
+
+    HarnessOptions ParseOptions(int argc, char** argv) {
+        HarnessOptions options;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            auto next = [&]() -> const char* {
+                if (i + 1 >= argc) {
+                    throw std::runtime_error("Missing value for " + arg);
+                }
+                return argv[++i];
+            };
+
+            if (arg == "--golden") options.goldenDir = next();
+            else if (arg == "--out") options.outputDir = next();
+            else if (arg == "--texture") options.texturePath = next();
+            else if (arg == "--filter") options.filter = next();
+            else if (arg == "--threads") options.threads = static_cast<unsigned>(std::strtoul(next(), nullptr, 10));
+            else if (arg == "--update") options.update = true;
+            else throw std::runtime_error("Unknown option " + arg);
+        }
+        return options;
+    }
+
+    CpuImage RenderCase(const TestCase& testCase, const CpuImage& texture) {
+        CpuImage image(Width, Height);
+        if (testCase.sample == Sample::UAVComputerShader) {
+            // Cases already run in parallel, so the compute backend gets the calling thread only
+            TaskScheduler serial(1);
+            CpuComputeEngine engine(serial);
+            engine.Dispatch(MakeComputeParams(Width, Height, testCase.time), image);
+            return image;
+        }
+
+        DepthBuffer depth;
+        depth.Resize(Width, Height);
+        if (testCase.sample == Sample::MVPmatrix) {
+            RenderColoredCube(testCase.time, image, depth);
+        }
+        else {
+            RenderTexturedCube(texture, testCase.time, image, depth);
+        }
+        return image;
+    }
+
+    CaseResult RunCase(const TestCase& testCase, const CpuImage& texture, const HarnessOptions& options) {
+        CaseResult result;
+        result.ran = true;
+        const std::string name = CaseName(testCase);
+        const std::string goldenPath = options.goldenDir + "/" + name + ".png";
+
+        auto begin = std::chrono::steady_clock::now();
+        try {
+            CpuImage actual = RenderCase(testCase, texture);
+
+            if (options.update) {
+                WritePngFile(goldenPath, actual);
+                result.passed = true;
+                result.message = "updated " + goldenPath;
+            }
+            else {
+                CpuImage golden = LoadImageFile(goldenPath);
+                CpuImage diff;
+                ImageDifference difference = CompareImages(actual, golden, testCase.tolerance, &diff);
+
+                result.passed = difference.sizeMatches && difference.psnr >= testCase.minPsnr &&
+                    difference.pixelsOverTolerance <= testCase.maxPixelsOverTolerance;
+
+                char message[160];
+                if (!difference.sizeMatches) {
+                    std::snprintf(message, sizeof(message), "size %ux%u, golden is %ux%u",
+                        actual.width, actual.height, golden.width, golden.height);
+                }
+                else {
+                    std::snprintf(message, sizeof(message), "max diff %u, %llu pixels over %u, PSNR %.1f dB",
+                        difference.maxChannelDifference, static_cast<unsigned long long>(difference.pixelsOverTolerance),
+                        testCase.tolerance, difference.psnr);
+                }
+                result.message = message;
+
+                if (!result.passed) {
+                    std::string prefix = options.outputDir + "/" + name;
+                    WritePngFile(prefix + "_actual.png", actual);
+                    if (difference.sizeMatches) {
+                        WritePngFile(prefix + "_diff.png", diff);
+                    }
+                    result.message += ", wrote " + prefix + "_*.png";
+                }
+            }
+        }
+        catch (const std::exception& e) {
+            result.passed = false;
+            result.message = e.what();
+        }
+        auto end = std::chrono::steady_clock::now();
+        result.milliseconds = std::chrono::duration<double, std::milli>(end - begin).count();
+        return result;
+    }
+}
+
+int main(int argc, char** argv) {
+    HarnessOptions options;
+    CpuImage texture;
+    try {
+        options = ParseOptions(argc, argv);
+        texture = LoadImageFile(options.texturePath);
+        std::filesystem::create_directories(options.update ? options.goldenDir : options.outputDir);
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        PrintUsage();
+        return 1;
+    }
+
+    const uint32_t caseCount = sizeof(testCases) / sizeof(testCases[0]);
+    std::vector<CaseResult> results(caseCount);
+    TaskScheduler scheduler(options.threads);
+
+    auto begin = std::chrono::steady_clock::now();
+    scheduler.ParallelFor(caseCount, [&](uint32_t first, uint32_t last) {
+        for (uint32_t i = first; i < last; i++) {
+            if (CaseName(testCases[i]).find(options.filter) != std::string::npos) {
+                results[i] = RunCase(testCases[i], texture, options);
+            }
+        }
+    });
+    auto end = std::chrono::steady_clock::now();
+
+    uint32_t ran = 0, failed = 0;
+    for (uint32_t i = 0; i < caseCount; i++) {
+        const CaseResult& result = results[i];
+        if (!result.ran) {
+            continue;
+        }
+        ran++;
+        failed += !result.passed;
+        std::printf("%s %-26s %s (%.1f ms)\n", result.passed ? "PASS" : "FAIL", CaseName(testCases[i]).c_str(),
+            result.message.c_str(), result.milliseconds);
+    }
+
+    double seconds = std::chrono::duration<double>(end - begin).count();
+    std::printf("%u of %u cases passed in %.2f s on %u threads\n", ran - failed, ran, seconds, scheduler.ThreadCount());
+    return failed == 0 ? 0 : 1;
+}
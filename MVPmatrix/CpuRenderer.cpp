@@ -0,0 +1,107 @@
+#include "CpuRenderer.h"
+#include "CubeMesh.h"
+#include "../Common/TaskScheduler.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    const uint32_t cubeVertexCount = sizeof(cubeVertices) / sizeof(cubeVertices[0]);
+    const uint32_t cubeIndexCount = sizeof(cubeIndices) / sizeof(cubeIndices[0]);
+
+    Float4x4 CameraView() {
+        return MatrixLookAtLH({ 0.0f, 0.0f, -5.0f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f });
+    }
+
+    Float4x4 CameraProjection(float aspect) {
+        return MatrixPerspectiveFovLH(ConvertToRadians(90.0f), aspect, 0.1f, 100.0f);
+    }
+
+    // VSMain: output.pos = mul(mvp3.m, float4(input.pos, 1.0)), output.col = input.col
+    void ShadeCube(const Float4x4& mvp, ClipVertex* out) {
+        for (uint32_t i = 0; i < cubeVertexCount; i++) {
+            const Vertex& v = cubeVertices[i];
+            out[i].position = TransformPoint({ v.position[0], v.position[1], v.position[2] }, mvp);
+            for (int c = 0; c < 3; c++) {
+                out[i].varyings[c] = v.color[c];
+            }
+        }
+    }
+}
+
+RasterPipeline MakeColoredCubePipeline(uint32_t width, uint32_t height) {
+    RasterPipeline pipeline;
+    pipeline.viewport.width = static_cast<float>(width);
+    pipeline.viewport.height = static_cast<float>(height);
+    pipeline.varyingCount = 3;
+    pipeline.pixelShader = [](const PixelInput& input, float rgba[4]) {
+        rgba[0] = input.varyings[0];
+        rgba[1] = input.varyings[1];
+        rgba[2] = input.varyings[2];
+        rgba[3] = 1.0f;
+    };
+    return pipeline;
+}
+
+void RenderColoredCube(float time, CpuImage& target, DepthBuffer& depth) {
+    const float clearColor[] = { 0.1f, 0.1f, 0.1f, 1.0f };
+    ClearImage(target, clearColor);
+    depth.Clear(1.0f);
+
+    const float aspect = static_cast<float>(target.width) / static_cast<float>(target.height);
+    Float4x4 model = MatrixRotationY(time) * MatrixRotationX(time * 0.5f);
+    Float4x4 mvp = model * CameraView() * CameraProjection(aspect);
+
+    ClipVertex clipVertices[cubeVertexCount];
+    ShadeCube(mvp, clipVertices);
+
+    RasterPipeline pipeline = MakeColoredCubePipeline(target.width, target.height);
+    DrawIndexed(pipeline, clipVertices, cubeIndices, cubeIndexCount, target, depth);
+}
+
+void BuildCubeGrid(uint32_t cubeCount, float time, float aspect, TaskScheduler& scheduler, CubeGrid& grid) {
+    static_assert(CubeGridVertexCount == cubeVertexCount && CubeGridIndexCount == cubeIndexCount, "Cube mesh changed");
+    grid.vertices.resize(static_cast<size_t>(cubeCount) * cubeVertexCount);
+    grid.indices.resize(static_cast<size_t>(cubeCount) * cubeIndexCount);
+    grid.centers.resize(cubeCount);
+
+    // side^3 >= cubeCount cells spanning [-extent, extent] on each axis, half a cell per cube
+    uint32_t side = std::max(1u, static_cast<uint32_t>(std::ceil(std::cbrt(static_cast<double>(cubeCount)))));
+    while (static_cast<uint64_t>(side) * side * side < cubeCount) {
+        side++;
+    }
+    const float extent = 2.0f;
+    const float cell = 2.0f * extent / side;
+    const float scale = cell * 0.25f;
+    const Float4x4 viewProjection = CameraView() * CameraProjection(aspect);
+    grid.side = side;
+    grid.radius = scale * std::sqrt(3.0f);
+    grid.viewProjection = viewProjection;
+
+    scheduler.ParallelFor(cubeCount, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t cube = begin; cube < end; cube++) {
+            uint32_t x = cube % side;
+            uint32_t y = (cube / side) % side;
+            uint32_t z = cube / (side * side);
+
+            // Each cube gets its own phase so neighbours do not line up
+            float phase = time + static_cast<float>(cube % 97) * 0.37f;
+            Float4x4 model = MatrixRotationY(phase) * MatrixRotationX(phase * 0.5f);
+            for (int r = 0; r < 3; r++) {
+                for (int c = 0; c < 3; c++) {
+                    model.m[r][c] *= scale;
+                }
+            }
+            model.m[3][0] = -extent + (x + 0.5f) * cell;
+            model.m[3][1] = -extent + (y + 0.5f) * cell;
+            model.m[3][2] = -extent + (z + 0.5f) * cell;
+            grid.centers[cube] = { model.m[3][0], model.m[3][1], model.m[3][2] };
+
+            ShadeCube(model * viewProjection, &grid.vertices[static_cast<size_t>(cube) * cubeVertexCount]);
+
+            uint32_t* indices = &grid.indices[static_cast<size_t>(cube) * cubeIndexCount];
+            for (uint32_t i = 0; i < cubeIndexCount; i++) {
+                indices[i] = cube * cubeVertexCount + cubeIndices[i];
+            }
+        }
+    }, 64);
+}
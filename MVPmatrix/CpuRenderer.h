@@ -0,0 +1,35 @@
+#pragma once
+#include <vector>
+#include "../Common/CpuImage.h"
+#include "../Common/SoftwareRasterizer.h"
+
+class TaskScheduler;
+
+// One frame of UpdateAndRender on the CPU at a given animation time: clear to the same
+// color and depth, run VSMain over the cube with model * view * proj, then draw it with PSMain.
+// `target` and `depth` must already have the output size.
+void RenderColoredCube(float time, CpuImage& target, DepthBuffer& depth);
+
+// The sample's pipeline state: default rasterizer (cull back, clockwise front), a full-target
+// viewport and PSMain returning the interpolated COLOR
+RasterPipeline MakeColoredCubePipeline(uint32_t width, uint32_t height);
+
+// Many copies of the cube on a grid, each spinning about its own center, shaded and ready to
+// draw as one 32-bit indexed triangle list. Used to load the rasterizer with hundreds of
+// thousands of triangles.
+// Cubes are stored layer by layer from the camera outwards, side * side cubes per layer.
+struct CubeGrid {
+    std::vector<ClipVertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<Float3> centers;        // World space, for bounds and culling
+    float radius = 0.0f;                // Every cube fits in a sphere of this radius around its center
+    uint32_t side = 0;
+    Float4x4 viewProjection = {};
+};
+
+// Indices and vertices of one cube within a CubeGrid
+const uint32_t CubeGridVertexCount = 8;
+const uint32_t CubeGridIndexCount = 36;
+
+// Runs VSMain for every cube in parallel. The camera is the sample's; the grid fills the view.
+void BuildCubeGrid(uint32_t cubeCount, float time, float aspect, TaskScheduler& scheduler, CubeGrid& grid);
@@ -0,0 +1,20 @@
+#pragma once
+#include <cstdint>
+
+// Cube geometry shared by the D3D12 path and the CPU renderer.
+// Matches the input layout: POSITION and COLOR, both DXGI_FORMAT_R32G32B32_FLOAT.
+struct Vertex {
+    float position[3];
+    float color[3];
+};
+
+const Vertex cubeVertices[] = {
+    {{-1,-1,-1}, {1,0,0}}, {{-1, 1,-1}, {0,1,0}}, {{1, 1,-1}, {0,0,1}}, {{1,-1,-1}, {1,1,0}},
+    {{-1,-1, 1}, {1,0,1}}, {{-1, 1, 1}, {0,1,1}}, {{1, 1, 1}, {1,1,1}}, {{1,-1, 1}, {0,0,0}},
+};
+
+const uint16_t cubeIndices[] = {
+    0,1,2, 0,2,3,  4,6,5, 4,7,6,
+    4,5,1, 4,1,0,  3,2,6, 3,6,7,
+    1,5,6, 1,6,2,  4,0,3, 4,3,7,
+};
@@ -0,0 +1,1657 @@
+// Headless mode: draws the cube, or a grid of many cubes, with the CPU rasterizer instead of
+// a D3D12 device. On Windows it is reached through `MVPmatrix.exe <options>`; on Linux build it standalone:
+//   g++ -std=c++17 -O2 -pthread headless.cpp CpuRenderer.cpp ../Common/Bvh.cpp ../Common/CpuImage.cpp ../Common/DescriptorAllocator.cpp ../Common/FrustumCuller.cpp ../Common/HiZBuffer.cpp ../Common/ImageFile.cpp ../Common/InstanceBuilder.cpp ../Common/RecordingCommandList.cpp ../Common/SimdIsa.cpp ../Common/SoftwareRasterizer.cpp ../Common/StbImage.cpp ../Common/FramePacer.cpp ../Common/TaskScheduler.cpp ../Common/TimelineFence.cpp ../Common/TransformEngine.cpp ../Common/UploadRing.cpp -o mvp_headless
+#include "CpuRenderer.h"
+#include "../Common/Bvh.h"
+#include "../Common/CpuImage.h"
+#include "../Common/DescriptorAllocator.h"
+#include "../Common/DrawSubmission.h"
+#include "../Common/FramePacer.h"
+#include "../Common/FrustumCuller.h"
+#include "../Common/HiZBuffer.h"
+#include "../Common/ImageFile.h"
+#include "../Common/InstanceBuilder.h"
+#include "../Common/RecordingCommandList.h"
+#include "../Common/SimdIsa.h"
+#include "../Common/SoftwareRasterizer.h"
+#include "../Common/TaskScheduler.h"
+#include "../Common/TransformEngine.h"
+#include "../Common/TimelineFence.h"
+#include "../Common/UploadRing.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <DirectXMath.h>
+#endif
+
+namespace {
+    struct HeadlessOptions {
+        uint32_t width = 800;
+        uint32_t height = 600;
+        uint32_t frames = 100;
+        uint32_t threads = 0;
+        uint32_t cubes = 1;
+        float startTime = 0.0f;
+        float timeStep = 1.0f / 60.0f;
+        SimdIsa isa = DetectSimdIsa();
+        bool benchmark = false;
+        bool verify = false;
+        bool occlusion = false;
+        bool upload = false;
+        bool pacing = false;
+        bool bindings = false;
+        bool instances = false;
+        bool transforms = false;
+        bool culling = false;
+        bool bvh = false;
+        bool cubesSet = false;
+        std::string outputPath;
+    };
+
+    void PrintUsage() {
+        std::cout <<
+            "Usage: MVPmatrix [options]\n"
+            "  --width W       output width in pixels (default 800)\n"
+            "  --height H      output height in pixels (default 600)\n"
+            "  --frames N      number of frames to render (default 100)\n"
+            "  --time T        animation time of the first frame (default 0)\n"
+            "  --dt S          time step between frames (default 1/60)\n"
+            "  --threads N     worker threads, 0 = all cores (default 0)\n"
+            "  --cubes N       draw N cubes on a grid, 12 triangles each (default 1)\n"
+            "  --isa NAME      coverage kernel: scalar, avx2 or avx512 (default: widest supported)\n"
+            "  --bench         serial reference vs tiled rasterizer per ISA: triangles/s, fill rate, identical output\n"
+            "  --verify        check fill rules on a shared-edge mesh and every ISA against the reference\n"
+            "  --occlusion     Hi-Z rejection rates and timings of triangle and per-cube culling\n"
+            "  --upload        upload ring checks against a manual fence, then allocations/s for --cubes objects (default 10000)\n"
+            "  --pacing        frame pacer checks, then frame times with 1-4 frames in flight on a simulated GPU\n"
+            "  --instances     instance stream checks per ISA, then instances/s into an upload ring for --cubes (default 1000000)\n"
+            "  --transforms    transform engine checks, then MVP matrices/s per kernel into an upload ring for --cubes (default 262144)\n"
+            "  --culling       frustum extraction and culler checks per ISA, then sphere culling of --cubes objects (default 1000000)\n"
+            "  --bvh           BVH checks, then build, refit, frustum and pick ray timings for --cubes boxes (default 100K, 1M and 10M)\n"
+            "  --bindings      CPU cost of root constants, root CBV and descriptor table MVPs for --cubes draws (default 10000)\n"
+            "  --out FILE.png  write the last frame\n";
+    }
+
+    HeadlessOptions ParseOptions(int argc, char** argv) {
+        HeadlessOptions options;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            auto next = [&]() -> const char* {
+                if (i + 1 >= argc) {
+                    throw std::runtime_error("Missing value for " + arg);
+                }
+                return argv[++i];
+            };
+
+            if (arg == "--width") options.width = static_cast<uint32_t>(std::strtoul(next(), nullptr, 10));
+            else if (arg == "--height") options.height = static_cast<uint32_t>(std::strtoul(next(), nullptr, 10));
+            else if (arg == "--frames") options.frames = static_cast<uint32_t>(std::strtoul(next(), nullptr, 10));
+            else if (arg == "--time") options.startTime = std::strtof(next(), nullptr);
+            else if (arg == "--dt") options.timeStep = std::strtof(next(), nullptr);
+            else if (arg == "--threads") options.threads = static_cast<uint32_t>(std::strtoul(next(), nullptr, 10));
+            else if (arg == "--out") options.outputPath = next();
+            else if (arg == "--bench") options.benchmark = true;
+            else if (arg == "--verify") options.verify = true;
+            else if (arg == "--occlusion") options.occlusion = true;
+            else if (arg == "--upload") options.upload = true;
+            else if (arg == "--pacing") options.pacing = true;
+            else if (arg == "--bindings") options.bindings = true;
+            else if (arg == "--instances") options.instances = true;
+            else if (arg == "--transforms") options.transforms = true;
+            else if (arg == "--culling") options.culling = true;
+            else if (arg == "--bvh") options.bvh = true;
+            else if (arg == "--isa") {
+                const char* name = next();
+                if (!ParseSimdIsa(name, options.isa) || !IsSimdIsaSupported(options.isa)) {
+                    throw std::runtime_error(std::string("Unsupported ISA ") + name);
+                }
+            }
+            else if (arg == "--cubes") {
+                options.cubes = static_cast<uint32_t>(std::strtoul(next(), nullptr, 10));
+                options.cubesSet = true;
+            }
+            else throw std::runtime_error("Unknown option " + arg);
+        }
+        if (options.width == 0 || options.height == 0 || options.width > 16384 || options.height > 16384) {
+            throw std::runtime_error("Resolution must be between 1x1 and 16384x16384");
+        }
+        // 36 indices per cube must fit the 32-bit index count
+        if (options.cubes == 0 || options.cubes > (1u << 24)) {
+            throw std::runtime_error("Cube count must be between 1 and 16777216");
+        }
+        // Every draw may need a descriptor per frame in flight in the recording heap
+        if (options.bindings && options.cubes > 1000000) {
+            throw std::runtime_error("--bindings records at most 1000000 draws per frame");
+        }
+        return options;
+    }
+
+    struct FrameTiming {
+        double drawSeconds = 0.0;       // Rasterization only, vertex shading excluded
+        uint64_t triangles = 0;
+        uint64_t pixels = 0;            // Covered pixels, only counted by the tiled rasterizer
+    };
+
+    // `tiled` is null for the serial reference
+    template <typename Index>
+    void Draw(TiledRasterizer* tiled, const RasterPipeline& pipeline, const ClipVertex* vertices, const Index* indices,
+        uint32_t indexCount, CpuImage& image, DepthBuffer& depth) {
+        if (tiled) {
+            tiled->DrawIndexed(pipeline, vertices, indices, indexCount, image, depth);
+        }
+        else {
+            DrawIndexed(pipeline, vertices, indices, indexCount, image, depth);
+        }
+    }
+
+    FrameTiming RenderFrames(TaskScheduler& scheduler, TiledRasterizer* tiled, const HeadlessOptions& options,
+        uint32_t cubes, CpuImage& image, DepthBuffer& depth) {
+        const float clearColor[] = { 0.1f, 0.1f, 0.1f, 1.0f };
+        const float aspect = static_cast<float>(options.width) / static_cast<float>(options.height);
+        const RasterPipeline pipeline = MakeColoredCubePipeline(options.width, options.height);
+        CubeGrid grid;
+        FrameTiming timing;
+
+        for (uint32_t frame = 0; frame < options.frames; frame++) {
+            float time = options.startTime + options.timeStep * frame;
+            BuildCubeGrid(cubes, time, aspect, scheduler, grid);
+            ClearImage(image, clearColor);
+            depth.Clear(1.0f);
+
+            const uint32_t indexCount = static_cast<uint32_t>(grid.indices.size());
+            auto begin = std::chrono::steady_clock::now();
+            Draw(tiled, pipeline, grid.vertices.data(), grid.indices.data(), indexCount, image, depth);
+            auto end = std::chrono::steady_clock::now();
+            timing.drawSeconds += std::chrono::duration<double>(end - begin).count();
+            timing.triangles += indexCount / 3;
+            timing.pixels += tiled ? tiled->Stats().pixelsCovered : 0;
+        }
+        return timing;
+    }
+
+    // ISAs with their own coverage kernel; SSE4.2 would run the scalar one
+    std::vector<SimdIsa> CoverageIsas() {
+        std::vector<SimdIsa> isas;
+        for (SimdIsa isa : { SimdIsa::Scalar, SimdIsa::AVX2, SimdIsa::AVX512 }) {
+            if (IsSimdIsaSupported(isa)) {
+                isas.push_back(isa);
+            }
+        }
+        return isas;
+    }
+
+    void RunBenchmark(TaskScheduler& scheduler, const HeadlessOptions& options) {
+        static const uint32_t cubeCounts[] = { 1, 1000, 10000, 50000 };
+        std::vector<uint32_t> counts(std::begin(cubeCounts), std::end(cubeCounts));
+        if (options.cubesSet) {
+            counts.assign(1, options.cubes);
+        }
+
+        CpuImage referenceImage(options.width, options.height), tiledImage(options.width, options.height);
+        DepthBuffer referenceDepth, tiledDepth;
+        referenceDepth.Resize(options.width, options.height);
+        tiledDepth.Resize(options.width, options.height);
+
+        std::cout << options.width << "x" << options.height << ", " << scheduler.ThreadCount() << " threads, "
+            << TiledRasterizer::TileSize << "x" << TiledRasterizer::TileSize << " tiles" << std::endl;
+        for (uint32_t cubes : counts) {
+            // Roughly the same number of triangles per count, but at least a few frames
+            HeadlessOptions sized = options;
+            sized.frames = std::max(3u, std::min(options.frames, static_cast<uint32_t>(2000000 / (cubes * 12))));
+            std::printf("%u cubes, %u triangles, %u frames\n", cubes, cubes * 12, sized.frames);
+
+            FrameTiming reference = RenderFrames(scheduler, nullptr, sized, cubes, referenceImage, referenceDepth);
+            double scalarSeconds = 0.0;
+            for (SimdIsa isa : CoverageIsas()) {
+                TiledRasterizer tiled(scheduler, isa);
+                FrameTiming timing = RenderFrames(scheduler, &tiled, sized, cubes, tiledImage, tiledDepth);
+                bool identical = referenceImage.pixels == tiledImage.pixels && referenceDepth.depth == tiledDepth.depth;
+                if (isa == SimdIsa::Scalar) {
+                    // The reference covers the same pixels; report its fill rate against them
+                    reference.pixels = timing.pixels;
+                    std::printf("  %-16s %8.2f ms/frame %8.2f Mtri/s %8.1f Mpix/s\n", "reference",
+                        reference.drawSeconds * 1e3 / sized.frames, reference.triangles / reference.drawSeconds * 1e-6,
+                        reference.pixels / reference.drawSeconds * 1e-6);
+                    scalarSeconds = timing.drawSeconds;
+                }
+
+                const RasterStats& stats = tiled.Stats();
+                std::printf("  tiled %-10s %8.2f ms/frame %8.2f Mtri/s %8.1f Mpix/s, x%.2f vs reference, x%.2f vs scalar, "
+                    "%.2f tiles/triangle, %s\n", SimdIsaName(isa),
+                    timing.drawSeconds * 1e3 / sized.frames, timing.triangles / timing.drawSeconds * 1e-6,
+                    timing.pixels / timing.drawSeconds * 1e-6, reference.drawSeconds / timing.drawSeconds,
+                    scalarSeconds / timing.drawSeconds,
+                    stats.trianglesRasterized ? static_cast<double>(stats.binEntries) / stats.trianglesRasterized : 0.0,
+                    identical ? "identical" : "DIFFERENT");
+            }
+        }
+    }
+
+    ClipVertex ScreenPoint(float x, float y, float z, uint32_t width, uint32_t height) {
+        ClipVertex v = {};
+        v.position = { x / width * 2.0f - 1.0f, 1.0f - y / height * 2.0f, z, 1.0f };
+        return v;
+    }
+
+    // A grid of quads whose inner vertices are jittered in 1/8 pixel steps, with every other
+    // row of vertices exactly on pixel centers so horizontal and vertical edges hit samples.
+    // Each triangle has its own vertices and is nearer than the previous one, so the depth
+    // test never hides a second hit: with correct fill rules every pixel inside is shaded once.
+    bool VerifyFillRules(TaskScheduler& scheduler, TiledRasterizer* tiled, const char* name) {
+        const uint32_t width = 203, height = 157;
+        const uint32_t columns = 23, rows = 17;
+        const float left = 10.3f, top = 7.7f, cell = 8.0f;
+        std::mt19937 random(1234);
+        std::uniform_int_distribution<int> jitter(-24, 24);
+
+        std::vector<float> gridX((columns + 1) * (rows + 1)), gridY((columns + 1) * (rows + 1));
+        for (uint32_t y = 0; y <= rows; y++) {
+            for (uint32_t x = 0; x <= columns; x++) {
+                float px = left + x * cell, py = top + y * cell;
+                if (x > 0 && x < columns && y > 0 && y < rows) {
+                    px = (y % 2) ? std::floor(px) + 0.5f : px + jitter(random) / 8.0f;
+                    py = (y % 2) ? std::floor(py) + 0.5f : py + jitter(random) / 8.0f;
+                }
+                gridX[y * (columns + 1) + x] = px;
+                gridY[y * (columns + 1) + x] = py;
+            }
+        }
+
+        std::vector<ClipVertex> vertices;
+        const float triangleCount = static_cast<float>(columns * rows * 2);
+        auto addTriangle = [&](uint32_t a, uint32_t b, uint32_t c) {
+            float z = 1.0f - (vertices.size() / 3 + 1) / (triangleCount + 2.0f);
+            for (uint32_t index : { a, b, c }) {
+                vertices.push_back(ScreenPoint(gridX[index], gridY[index], z, width, height));
+            }
+        };
+        for (uint32_t y = 0; y < rows; y++) {
+            for (uint32_t x = 0; x < columns; x++) {
+                uint32_t i00 = y * (columns + 1) + x, i10 = i00 + 1;
+                uint32_t i01 = i00 + columns + 1, i11 = i01 + 1;
+                // Alternate the diagonal; both windings, since culling is off
+                if ((x + y) % 2) {
+                    addTriangle(i00, i10, i11);
+                    addTriangle(i00, i01, i11);
+                }
+                else {
+                    addTriangle(i00, i10, i01);
+                    addTriangle(i10, i11, i01);
+                }
+            }
+        }
+        std::vector<uint32_t> indices(vertices.size());
+        for (uint32_t i = 0; i < indices.size(); i++) {
+            indices[i] = i;
+        }
+
+        std::vector<uint32_t> hits(width * height, 0);
+        RasterPipeline pipeline;
+        pipeline.rasterizer.cullMode = CullMode::None;
+        pipeline.viewport.width = static_cast<float>(width);
+        pipeline.viewport.height = static_cast<float>(height);
+        // Tiles own their pixels, so the counters need no atomics
+        pipeline.pixelShader = [&](const PixelInput& input, float rgba[4]) {
+            hits[input.y * width + input.x]++;
+            rgba[0] = rgba[1] = rgba[2] = rgba[3] = 1.0f;
+        };
+
+        CpuImage image(width, height);
+        DepthBuffer depth;
+        depth.Resize(width, height);
+        Draw(tiled, pipeline, vertices.data(), indices.data(), static_cast<uint32_t>(indices.size()), image, depth);
+        (void)scheduler;
+
+        uint32_t missed = 0, overdrawn = 0;
+        const float right = left + columns * cell, bottom = top + rows * cell;
+        for (uint32_t y = 0; y < height; y++) {
+            for (uint32_t x = 0; x < width; x++) {
+                float cx = x + 0.5f, cy = y + 0.5f;
+                bool inside = cx > left && cx < right && cy > top && cy < bottom;
+                uint32_t count = hits[y * width + x];
+                missed += inside && count != 1;
+                overdrawn += count > 1 || (!inside && count != 0);
+            }
+        }
+        bool ok = missed == 0 && overdrawn == 0;
+        std::cout << name << ": fill rules " << missed << " pixels missed, " << overdrawn << " drawn twice or outside"
+            << (ok ? " OK" : " FAILED") << std::endl;
+        return ok;
+    }
+
+    // Random triangles of every size and both windings, some crossing the near plane and some
+    // far past the guard band, drawn by each ISA and compared bit for bit with the reference
+    bool VerifyAgainstReference(TaskScheduler& scheduler, const HeadlessOptions& options) {
+        const uint32_t triangleCount = 20000;
+        std::mt19937 random(42);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        std::vector<ClipVertex> vertices(triangleCount * 3);
+        for (uint32_t t = 0; t < triangleCount; t++) {
+            // Mostly small triangles around a random center, a few large and a few huge
+            float scale = t % 100 == 0 ? 40.0f : t % 10 == 0 ? 1.0f : 0.05f;
+            float cx = unit(random) * 2.4f - 1.2f, cy = unit(random) * 2.4f - 1.2f;
+            for (uint32_t v = 0; v < 3; v++) {
+                ClipVertex& vertex = vertices[t * 3 + v];
+                float w = 0.5f + unit(random) * 1.5f;
+                float x = cx + (unit(random) - 0.5f) * scale;
+                float y = cy + (unit(random) - 0.5f) * scale;
+                vertex.position = { x * w, y * w, (unit(random) * 1.2f - 0.1f) * w, w };
+                for (uint32_t c = 0; c < 3; c++) {
+                    vertex.varyings[c] = unit(random);
+                }
+            }
+        }
+        std::vector<uint32_t> indices(vertices.size());
+        for (uint32_t i = 0; i < indices.size(); i++) {
+            indices[i] = i;
+        }
+
+        RasterPipeline pipeline = MakeColoredCubePipeline(options.width, options.height);
+        pipeline.rasterizer.cullMode = CullMode::None;
+        const float clearColor[] = { 0.0f, 0.0f, 0.0f, 1.0f };
+        CpuImage referenceImage(options.width, options.height), image(options.width, options.height);
+        DepthBuffer referenceDepth, depth;
+        referenceDepth.Resize(options.width, options.height);
+        depth.Resize(options.width, options.height);
+        ClearImage(referenceImage, clearColor);
+        DrawIndexed(pipeline, vertices.data(), indices.data(), static_cast<uint32_t>(indices.size()), referenceImage, referenceDepth);
+
+        bool passed = true;
+        for (SimdIsa isa : CoverageIsas()) {
+            TiledRasterizer tiled(scheduler, isa);
+            ClearImage(image, clearColor);
+            depth.Clear(1.0f);
+            tiled.DrawIndexed(pipeline, vertices.data(), indices.data(), static_cast<uint32_t>(indices.size()), image, depth);
+            bool identical = image.pixels == referenceImage.pixels && depth.depth == referenceDepth.depth;
+            std::cout << SimdIsaName(isa) << ": " << triangleCount << " random triangles, "
+                << tiled.Stats().pixelsCovered << " pixels covered, " << (identical ? "identical to the reference OK" : "DIFFERENT")
+                << std::endl;
+            passed = passed && identical;
+            passed = VerifyFillRules(scheduler, &tiled, SimdIsaName(isa)) && passed;
+        }
+        return VerifyFillRules(scheduler, nullptr, "reference") && passed;
+    }
+
+    struct OcclusionTiming {
+        double seconds = 0.0;           // Culling and rasterization, vertex shading excluded
+        uint64_t cubesTested = 0;
+        uint64_t cubesCulled = 0;
+        uint64_t triangleTiles = 0;     // Triangle-tile pairs binned
+        uint64_t triangleTilesOccluded = 0;
+        uint64_t blocksOccluded = 0;
+        uint64_t pixelsCovered = 0;
+    };
+
+    // Draws the grid one depth layer at a time, near to far. With `cullCubes` every cube of a
+    // layer is first tested against the Hi-Z buffer as left by the layers in front of it.
+    OcclusionTiming DrawOccluded(TaskScheduler& scheduler, TiledRasterizer& tiled, HiZBuffer* hiZ, bool cullCubes,
+        const CubeGrid& grid, const RasterPipeline& pipeline, CpuImage& image, DepthBuffer& depth) {
+        const uint32_t cubeCount = static_cast<uint32_t>(grid.centers.size());
+        const uint32_t layerSize = grid.side * grid.side;
+        std::vector<uint8_t> visible(layerSize);
+        std::vector<uint32_t> indices;
+        indices.reserve(static_cast<size_t>(layerSize) * CubeGridIndexCount);
+        tiled.SetHiZ(hiZ);
+
+        OcclusionTiming timing;
+        auto begin = std::chrono::steady_clock::now();
+        for (uint32_t first = 0; first < cubeCount; first += layerSize) {
+            const uint32_t count = std::min(layerSize, cubeCount - first);
+            if (cullCubes) {
+                scheduler.ParallelFor(count, [&](uint32_t begin, uint32_t end) {
+                    for (uint32_t i = begin; i < end; i++) {
+                        const Float3& c = grid.centers[first + i];
+                        const float r = grid.radius;
+                        ScreenBounds bounds = ProjectBox({ c.x - r, c.y - r, c.z - r }, { c.x + r, c.y + r, c.z + r },
+                            grid.viewProjection, pipeline.viewport, image.width, image.height);
+                        visible[i] = !bounds.valid ||
+                            (!bounds.offscreen && !hiZ->IsOccluded(bounds.minX, bounds.minY, bounds.maxX, bounds.maxY, bounds.minDepth));
+                    }
+                }, 64);
+            }
+
+            indices.clear();
+            for (uint32_t i = 0; i < count; i++) {
+                if (cullCubes && !visible[i]) {
+                    timing.cubesCulled++;
+                    continue;
+                }
+                const uint32_t* cube = &grid.indices[static_cast<size_t>(first + i) * CubeGridIndexCount];
+                indices.insert(indices.end(), cube, cube + CubeGridIndexCount);
+            }
+            timing.cubesTested += cullCubes ? count : 0;
+
+            tiled.DrawIndexed(pipeline, grid.vertices.data(), indices.data(), static_cast<uint32_t>(indices.size()), image, depth);
+            const RasterStats& stats = tiled.Stats();
+            timing.triangleTiles += stats.binEntries;
+            timing.triangleTilesOccluded += stats.trianglesOccluded;
+            timing.blocksOccluded += stats.blocksOccluded;
+            timing.pixelsCovered += stats.pixelsCovered;
+        }
+        auto end = std::chrono::steady_clock::now();
+        timing.seconds = std::chrono::duration<double>(end - begin).count();
+        tiled.SetHiZ(nullptr);
+        return timing;
+    }
+
+    // Dense grids drawn three ways: without Hi-Z, with Hi-Z rejecting triangles and blocks in
+    // the rasterizer, and with per-cube culling against Hi-Z as well. All three must match.
+    bool RunOcclusionReport(TaskScheduler& scheduler, const HeadlessOptions& options) {
+        static const uint32_t cubeCounts[] = { 10000, 50000, 200000 };
+        std::vector<uint32_t> counts(std::begin(cubeCounts), std::end(cubeCounts));
+        if (options.cubesSet) {
+            counts.assign(1, options.cubes);
+        }
+
+        const float clearColor[] = { 0.1f, 0.1f, 0.1f, 1.0f };
+        const float aspect = static_cast<float>(options.width) / static_cast<float>(options.height);
+        const RasterPipeline pipeline = MakeColoredCubePipeline(options.width, options.height);
+        TiledRasterizer tiled(scheduler, options.isa);
+        CpuImage referenceImage(options.width, options.height), image(options.width, options.height);
+        DepthBuffer depth;
+        depth.Resize(options.width, options.height);
+        HiZBuffer hiZ;
+        hiZ.Resize(options.width, options.height);
+        CubeGrid grid;
+        bool passed = true;
+
+        std::cout << options.width << "x" << options.height << ", " << scheduler.ThreadCount() << " threads, "
+            << SimdIsaName(tiled.Isa()) << std::endl;
+        for (uint32_t cubes : counts) {
+            const uint32_t frames = std::max(3u, std::min(options.frames, static_cast<uint32_t>(2000000 / (cubes * 12))));
+            OcclusionTiming modes[3];
+            bool identical = true;
+            for (uint32_t frame = 0; frame < frames; frame++) {
+                BuildCubeGrid(cubes, options.startTime + options.timeStep * frame, aspect, scheduler, grid);
+                for (int mode = 0; mode < 3; mode++) {
+                    CpuImage& target = mode == 0 ? referenceImage : image;
+                    ClearImage(target, clearColor);
+                    depth.Clear(1.0f);
+                    hiZ.Clear(1.0f);
+                    OcclusionTiming timing = DrawOccluded(scheduler, tiled, mode == 0 ? nullptr : &hiZ, mode == 2,
+                        grid, pipeline, target, depth);
+                    modes[mode].seconds += timing.seconds;
+                    modes[mode].cubesTested += timing.cubesTested;
+                    modes[mode].cubesCulled += timing.cubesCulled;
+                    modes[mode].triangleTiles += timing.triangleTiles;
+                    modes[mode].triangleTilesOccluded += timing.triangleTilesOccluded;
+                    modes[mode].blocksOccluded += timing.blocksOccluded;
+                    modes[mode].pixelsCovered += timing.pixelsCovered;
+                    if (mode > 0) {
+                        identical = identical && image.pixels == referenceImage.pixels;
+                    }
+                }
+            }
+            passed = passed && identical;
+
+            auto percent = [](uint64_t part, uint64_t whole) { return whole ? 100.0 * part / whole : 0.0; };
+            std::printf("%u cubes, %u triangles, %u layers, %u frames\n", cubes, cubes * 12,
+                (cubes + grid.side * grid.side - 1) / (grid.side * grid.side), frames);
+            std::printf("  no Hi-Z        %8.2f ms/frame, %llu pixels covered/frame\n", modes[0].seconds * 1e3 / frames,
+                static_cast<unsigned long long>(modes[0].pixelsCovered / frames));
+            std::printf("  Hi-Z raster    %8.2f ms/frame, %.1f%% of triangle-tiles and %llu blocks/frame rejected, "
+                "%.1f%% fewer pixels covered\n", modes[1].seconds * 1e3 / frames,
+                percent(modes[1].triangleTilesOccluded, modes[1].triangleTiles),
+                static_cast<unsigned long long>(modes[1].blocksOccluded / frames),
+                100.0 - percent(modes[1].pixelsCovered, modes[0].pixelsCovered));
+            std::printf("  Hi-Z + cubes   %8.2f ms/frame, %.1f%% of cubes culled, %.1f%% of remaining triangle-tiles rejected, "
+                "x%.2f vs no Hi-Z, %s\n", modes[2].seconds * 1e3 / frames, percent(modes[2].cubesCulled, modes[2].cubesTested),
+                percent(modes[2].triangleTilesOccluded, modes[2].triangleTiles), modes[0].seconds / modes[2].seconds,
+                identical ? "identical" : "DIFFERENT");
+        }
+        return passed;
+    }
+
+    // Three partitions driven by a fence the test completes by hand. With the GPU two frames
+    // behind nothing waits and every in-flight frame's constants survive until the GPU is
+    // done with them; with the GPU stalled every BeginFrame past the third has to wait.
+    bool VerifyUploadRing(TaskScheduler& scheduler) {
+        const uint32_t frameCount = 3, frames = 12, constantsPerFrame = 200;
+        HostUploadDevice device;
+        bool passed = true;
+
+        for (uint32_t lag : { 2u, frames }) {
+            ManualFence fence;
+            UploadRing ring(device, fence, frameCount, constantsPerFrame * UploadRing::Alignment);
+            std::vector<std::vector<UploadRing::Allocation>> inFlight(frames);
+            uint32_t misaligned = 0, overwritten = 0, reusedEarly = 0;
+
+            for (uint32_t frame = 0; frame < frames; frame++) {
+                ring.BeginFrame();
+                // The partition's previous frame must have completed before it is reused
+                if (frame >= frameCount && fence.CompletedValue() < frame - frameCount + 1) {
+                    reusedEarly++;
+                }
+                for (uint32_t i = 0; i < constantsPerFrame; i++) {
+                    Float4x4 constants;
+                    std::fill(&constants.m[0][0], &constants.m[0][0] + 16, static_cast<float>(frame * 1000 + i));
+                    UploadRing::Allocation allocation = ring.AllocateConstants(constants);
+                    misaligned += allocation.gpuAddress % UploadRing::Alignment != 0 || allocation.size != UploadRing::Alignment;
+                    inFlight[frame].push_back(allocation);
+                }
+                ring.EndFrame(frame + 1);
+
+                // The GPU finishes the frame `lag` frames back; its constants must be intact
+                if (frame >= lag) {
+                    const uint32_t done = frame - lag;
+                    for (uint32_t i = 0; i < constantsPerFrame; i++) {
+                        float value;
+                        std::memcpy(&value, inFlight[done][i].cpuAddress + 60, sizeof(value));
+                        overwritten += value != static_cast<float>(done * 1000 + i);
+                    }
+                    fence.Complete(done + 1);
+                }
+            }
+
+            const uint64_t expectedWaits = lag < frameCount ? 0 : frames - frameCount;
+            bool ok = misaligned == 0 && overwritten == 0 && reusedEarly == 0 && ring.GetStats().waits == expectedWaits &&
+                fence.Waits() == expectedWaits;
+            passed &= ok;
+            std::printf("GPU %u frames behind: %llu waits (expected %llu), %u misaligned, %u overwritten in flight, "
+                "%u reused early %s\n", lag, static_cast<unsigned long long>(ring.GetStats().waits),
+                static_cast<unsigned long long>(expectedWaits), misaligned, overwritten, reusedEarly, ok ? "OK" : "FAILED");
+        }
+
+        // Larger alignments, exhaustion and allocations from every thread at once
+        ManualFence fence;
+        UploadRing ring(device, fence, 2, 65536);
+        ring.BeginFrame();
+        ring.Allocate(100);
+        UploadRing::Allocation placed = ring.Allocate(1000, 512);
+        UploadRing::Allocation page = ring.Allocate(16, 4096);
+        bool aligned = placed.gpuAddress % 512 == 0 && page.gpuAddress % 4096 == 0 && placed.size == 1024;
+        bool threw = false;
+        try {
+            ring.Allocate(65536);
+        }
+        catch (const std::runtime_error&) {
+            threw = true;
+        }
+        ring.EndFrame(1);
+
+        const uint32_t count = 250;
+        std::vector<uint64_t> offsets(count);
+        ring.BeginFrame();
+        scheduler.ParallelFor(count, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) {
+                offsets[i] = ring.Allocate(64).gpuAddress;
+            }
+        });
+        ring.EndFrame(2);
+        std::sort(offsets.begin(), offsets.end());
+        uint32_t overlapping = 0;
+        for (uint32_t i = 1; i < count; i++) {
+            overlapping += offsets[i] - offsets[i - 1] != UploadRing::Alignment;
+        }
+        bool ok = aligned && threw && overlapping == 0;
+        passed &= ok;
+        std::printf("512 B and 4 KB alignment %s, exhaustion %s, %u allocations from %u threads with %u overlaps %s\n",
+            aligned ? "kept" : "BROKEN", threw ? "throws" : "DOES NOT THROW", count, scheduler.ThreadCount(), overlapping,
+            ok ? "OK" : "FAILED");
+        return passed;
+    }
+
+    // Per-object constants the way a frame would write them: one matrix per cube into a ring
+    // sized for the frame, with the GPU one frame behind
+    void RunUploadBenchmark(TaskScheduler& scheduler, const HeadlessOptions& options) {
+        const uint32_t objects = options.cubesSet ? options.cubes : 10000;
+        const uint32_t frames = std::max(3u, std::min(options.frames * 10, 20000000 / objects));
+        const uint32_t frameCount = 3;
+        HostUploadDevice device;
+        ManualFence fence;
+        // Cursors leave up to a block unused per thread
+        UploadRing ring(device, fence, frameCount,
+            static_cast<uint64_t>(objects) * UploadRing::Alignment + scheduler.ThreadCount() * 16384ull);
+        Float4x4 constants = MatrixRotationY(0.5f) * MatrixLookAtLH({ 0.0f, 0.0f, -5.0f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f });
+
+        std::printf("%u objects/frame, %u frames, %u frames in flight, %.2f MB per partition\n", objects, frames,
+            frameCount, ring.BytesPerFrame() / 1048576.0);
+
+        // Committed upload heaps are resident; fault the host pages in before timing
+        uint64_t fenceValue = 0;
+        for (uint32_t frame = 0; frame < frameCount; frame++) {
+            ring.BeginFrame();
+            UploadRing::Allocation all = ring.Allocate(ring.BytesPerFrame());
+            std::memset(all.cpuAddress, 0, static_cast<size_t>(all.size));
+            ring.EndFrame(++fenceValue);
+            fence.Complete(fenceValue);
+        }
+
+        enum Mode { Allocate, Constants, Array, Cursor, Parallel };
+        const char* names[] = { "Allocate", "AllocateConstants", "AllocateArray", "UploadCursor", "parallel cursors" };
+        UploadCursor cursor(ring);
+        for (int mode = Allocate; mode <= Parallel; mode++) {
+            auto begin = std::chrono::steady_clock::now();
+            for (uint32_t frame = 0; frame < frames; frame++) {
+                ring.BeginFrame();
+                if (mode == Allocate) {
+                    for (uint32_t i = 0; i < objects; i++) {
+                        ring.Allocate(sizeof(Float4x4));
+                    }
+                }
+                else if (mode == Constants) {
+                    for (uint32_t i = 0; i < objects; i++) {
+                        ring.AllocateConstants(constants);
+                    }
+                }
+                else if (mode == Array) {
+                    UploadRing::Allocation array = ring.AllocateArray(objects, sizeof(Float4x4));
+                    for (uint32_t i = 0; i < objects; i++) {
+                        std::memcpy(array.cpuAddress + i * UploadRing::ElementStride(sizeof(Float4x4)), &constants,
+                            sizeof(constants));
+                    }
+                }
+                else if (mode == Cursor) {
+                    cursor.Reset();
+                    for (uint32_t i = 0; i < objects; i++) {
+                        cursor.AllocateConstants(constants);
+                    }
+                }
+                else {
+                    scheduler.ParallelFor(objects, [&](uint32_t first, uint32_t last) {
+                        UploadCursor local(ring);
+                        for (uint32_t i = first; i < last; i++) {
+                            local.AllocateConstants(constants);
+                        }
+                    }, 256);
+                }
+                ring.EndFrame(++fenceValue);
+                fence.Complete(fenceValue - 1);
+            }
+            auto end = std::chrono::steady_clock::now();
+            double seconds = std::chrono::duration<double>(end - begin).count();
+            std::printf("  %-20s %8.1f M allocations/s, %7.2f us/frame, %6.2f GB/s of constants, %llu waits\n",
+                names[mode], static_cast<double>(objects) * frames / seconds * 1e-6, seconds * 1e6 / frames,
+                static_cast<double>(objects) * frames * sizeof(Float4x4) / seconds * 1e-9,
+                static_cast<unsigned long long>(ring.GetStats().waits));
+        }
+    }
+
+    // Frame contexts reused against a fence the test completes by hand, `lag` frames behind
+    // the CPU: nothing may wait while lag < frames in flight, every frame past the first N
+    // has to wait once the GPU stalls, and no context may be reused before its frame retired
+    bool VerifyFramePacer() {
+        const uint32_t frames = 12;
+        bool passed = true;
+        for (uint32_t framesInFlight : { 1u, 2u, 3u }) {
+            for (uint32_t lag : { framesInFlight - 1, framesInFlight, frames }) {
+                ManualFence fence;
+                FramePacer pacer(fence, framesInFlight);
+                uint32_t reusedEarly = 0, wrongContext = 0;
+                for (uint32_t frame = 0; frame < frames; frame++) {
+                    pacer.BeginFrame();
+                    wrongContext += pacer.FrameIndex() != frame % framesInFlight;
+                    if (frame >= framesInFlight && fence.CompletedValue() < frame - framesInFlight + 1) {
+                        reusedEarly++;
+                    }
+                    const uint64_t value = pacer.EndFrame();
+                    if (value > lag) {
+                        fence.Complete(value - lag);
+                    }
+                }
+                pacer.WaitForIdle();
+
+                const uint64_t expectedWaits = lag < framesInFlight ? 0 : frames - framesInFlight;
+                bool ok = reusedEarly == 0 && wrongContext == 0 && pacer.GetStats().waits == expectedWaits &&
+                    fence.CompletedValue() == frames;
+                passed &= ok;
+                std::printf("%u in flight, GPU %2u frames behind: %2llu waits (expected %2llu), %u reused early, "
+                    "idle after WaitForIdle %s\n", framesInFlight, lag, static_cast<unsigned long long>(pacer.GetStats().waits),
+                    static_cast<unsigned long long>(expectedWaits), reusedEarly, ok ? "OK" : "FAILED");
+            }
+        }
+
+        // The simulated queue completes values in submission order, no earlier than their work
+        SimulatedGpuFence gpu;
+        const auto work = std::chrono::milliseconds(2);
+        const auto begin = SimulatedGpuFence::Clock::now();
+        gpu.Submit(1, work);
+        gpu.Submit(2, work);
+        bool early = gpu.CompletedValue() != 0;
+        gpu.WaitForValue(1);
+        const auto first = SimulatedGpuFence::Clock::now() - begin;
+        bool inOrder = gpu.CompletedValue() == 1 || gpu.CompletedValue() == 2;
+        gpu.WaitForValue(2);
+        const auto second = SimulatedGpuFence::Clock::now() - begin;
+        bool ok = !early && inOrder && first >= work && second >= 2 * work && gpu.CompletedValue() == 2;
+        passed &= ok;
+        std::printf("Simulated GPU: values completed after %.2f and %.2f ms of 2 ms work each %s\n",
+            std::chrono::duration<double, std::milli>(first).count(), std::chrono::duration<double, std::milli>(second).count(),
+            ok ? "OK" : "FAILED");
+        return passed;
+    }
+
+    // Frame loop against a simulated GPU: the CPU spins for its part of each frame, submits
+    // the GPU part and moves on. One frame in flight is the old Signal-and-wait loop; with
+    // more, CPU and GPU overlap and the frame time drops to the slower of the two.
+    void RunPacingBenchmark(const HeadlessOptions& options) {
+        using Clock = SimulatedGpuFence::Clock;
+        struct Workload {
+            const char* name;
+            double cpuMs;
+            double gpuMs;
+            double gpuJitterMs;     // Odd frames take this much longer on the GPU, even ones this much less
+        };
+        const Workload workloads[] = {
+            { "CPU 1 ms, GPU 2 ms", 1.0, 2.0, 0.0 },
+            { "CPU 2 ms, GPU 1 ms", 2.0, 1.0, 0.0 },
+            { "CPU 2 ms, GPU 2 ms", 2.0, 2.0, 0.0 },
+            { "CPU 2 ms, GPU 1-3 ms", 2.0, 2.0, 1.0 },
+        };
+        const uint32_t frames = std::max(10u, options.frames);
+        auto milliseconds = [](double ms) {
+            return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(ms));
+        };
+
+        std::printf("%u frames per run\n", frames);
+        for (const Workload& workload : workloads) {
+            std::printf("%s\n", workload.name);
+            double serialized = 0.0;
+            for (uint32_t framesInFlight = 1; framesInFlight <= 4; framesInFlight++) {
+                SimulatedGpuFence gpu;
+                FramePacer pacer(gpu, framesInFlight);
+                const Clock::time_point begin = Clock::now();
+                for (uint32_t frame = 0; frame < frames; frame++) {
+                    pacer.BeginFrame();
+                    const Clock::time_point recorded = Clock::now() + milliseconds(workload.cpuMs);
+                    while (Clock::now() < recorded) {
+                    }
+                    const double jitter = frame % 2 ? workload.gpuJitterMs : -workload.gpuJitterMs;
+                    gpu.Submit(pacer.EndFrame(), milliseconds(workload.gpuMs + jitter));
+                }
+                pacer.WaitForIdle();
+                const double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+
+                const double frameMs = seconds * 1e3 / frames;
+                if (framesInFlight == 1) {
+                    serialized = frameMs;
+                }
+                const SimulatedGpuFence::Stats& stats = gpu.GetStats();
+                const double busy = std::chrono::duration<double>(stats.busyTime).count();
+                std::printf("  %u in flight: %6.3f ms/frame, %7.1f frames/s, %5.1f%% GPU busy, %6.3f ms CPU wait/frame, "
+                    "%3llu waits, %.2fx\n", framesInFlight, frameMs, 1e3 / frameMs, 100.0 * busy / seconds,
+                    std::chrono::duration<double, std::milli>(stats.waitTime).count() / frames,
+                    static_cast<unsigned long long>(pacer.GetStats().waits), serialized / frameMs);
+            }
+        }
+    }
+
+    // Every ISA's instance kernel against the scalar one, bit for bit, over ranges that start
+    // and end off the vector width, and the scalar kernel against the grid's world matrices
+    bool VerifyInstanceBuilder(TaskScheduler& scheduler) {
+        const InstanceGrid grid = MakeInstanceGrid(4099);
+        const float time = 12.75f;
+        const InstanceBuilder scalar(SimdIsa::Scalar);
+        std::vector<InstanceTransform> expected(grid.count);
+        scalar.BuildRange(grid, time, 0, grid.count, expected.data());
+
+        float worst = 0.0f;
+        for (uint32_t i = 0; i < grid.count; i++) {
+            const Float4x4 world = InstanceWorldMatrix(grid, time, i);
+            for (int c = 0; c < 3; c++) {
+                const float* column = &expected[i].column[c].x;
+                for (int r = 0; r < 4; r++) {
+                    worst = std::max(worst, std::fabs(column[r] - world.m[r][c]));
+                }
+            }
+        }
+        bool passed = worst < 1e-6f;
+        std::printf("scalar instances against InstanceWorldMatrix: max error %g %s\n", worst, passed ? "OK" : "FAILED");
+
+        for (SimdIsa isa : CoverageIsas()) {
+            const InstanceBuilder builder(isa);
+            std::vector<InstanceTransform> actual(grid.count);
+            // Odd range boundaries, then the whole grid in parallel
+            const uint32_t cuts[] = { 0, 3, 20, 37, 1000, 1001, 4099 };
+            for (size_t k = 0; k + 1 < std::size(cuts); k++) {
+                builder.BuildRange(grid, time, cuts[k], cuts[k + 1], actual.data());
+            }
+            bool ranges = std::memcmp(actual.data(), expected.data(), actual.size() * sizeof(InstanceTransform)) == 0;
+            std::fill(actual.begin(), actual.end(), InstanceTransform{});
+            builder.Build(grid, time, scheduler, actual.data());
+            bool parallel = std::memcmp(actual.data(), expected.data(), actual.size() * sizeof(InstanceTransform)) == 0;
+            std::printf("%-7s instances: ranges %s, parallel %s\n", SimdIsaName(isa), ranges ? "identical" : "DIFFERENT",
+                parallel ? "identical" : "DIFFERENT");
+            passed &= ranges && parallel;
+        }
+        return passed;
+    }
+
+    // The instance stream of a --cubes grid rebuilt every frame into a fresh upload ring
+    // partition, as the window's --instances mode does before one DrawIndexedInstanced
+    void RunInstanceBenchmark(TaskScheduler& scheduler, const HeadlessOptions& options) {
+        const uint32_t instances = options.cubesSet ? options.cubes : 1000000;
+        const uint32_t frames = std::max(3u, std::min(options.frames, 200000000 / instances));
+        const uint32_t framesInFlight = 3;
+        const InstanceGrid grid = MakeInstanceGrid(instances);
+        const uint64_t streamBytes = static_cast<uint64_t>(instances) * sizeof(InstanceTransform);
+        HostUploadDevice device;
+        ManualFence fence;
+        UploadRing ring(device, fence, framesInFlight, streamBytes);
+
+        // Committed upload heaps are resident; fault the host pages in before timing
+        uint64_t fenceValue = 0;
+        for (uint32_t frame = 0; frame < framesInFlight; frame++) {
+            ring.BeginFrame();
+            UploadRing::Allocation all = ring.Allocate(ring.BytesPerFrame());
+            std::memset(all.cpuAddress, 0, static_cast<size_t>(all.size));
+            ring.EndFrame(++fenceValue);
+            fence.Complete(fenceValue);
+        }
+
+        std::printf("%u instances, %u^3 grid, %.1f MB stream per frame, %u frames, %u threads\n", instances, grid.side,
+            streamBytes / 1048576.0, frames, scheduler.ThreadCount());
+        double scalarSeconds = 0.0;
+        for (SimdIsa isa : CoverageIsas()) {
+            const InstanceBuilder builder(isa);
+            for (bool parallel : { false, true }) {
+                auto begin = std::chrono::steady_clock::now();
+                for (uint32_t frame = 0; frame < frames; frame++) {
+                    ring.BeginFrame();
+                    UploadRing::Allocation stream = ring.Allocate(streamBytes);
+                    InstanceTransform* out = reinterpret_cast<InstanceTransform*>(stream.cpuAddress);
+                    const float time = options.startTime + options.timeStep * frame;
+                    if (parallel) {
+                        builder.Build(grid, time, scheduler, out);
+                    }
+                    else {
+                        builder.BuildRange(grid, time, 0, instances, out);
+                    }
+                    ring.EndFrame(++fenceValue);
+                    fence.Complete(fenceValue - 1);
+                }
+                const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+                if (isa == SimdIsa::Scalar && !parallel) {
+                    scalarSeconds = seconds;
+                }
+                std::printf("  %-7s %-8s %8.2f ms/frame, %7.1f M instances/s, %6.2f GB/s, x%.2f vs scalar\n",
+                    SimdIsaName(isa), parallel ? "parallel" : "1 thread", seconds * 1e3 / frames,
+                    static_cast<double>(instances) * frames / seconds * 1e-6,
+                    static_cast<double>(streamBytes) * frames / seconds * 1e-9, scalarSeconds / seconds);
+            }
+        }
+    }
+
+    // Objects scattered in front of the camera with every transform component different
+    void FillTransforms(uint32_t count, TransformArrays& objects) {
+        objects.Resize(count);
+        std::mt19937 random(17);
+        std::uniform_real_distribution<float> position(-50.0f, 50.0f), angle(-8.0f, 8.0f), scale(0.25f, 2.0f);
+        for (uint32_t i = 0; i < count; i++) {
+            objects.x[i] = position(random);
+            objects.y[i] = position(random);
+            objects.z[i] = position(random) + 60.0f;
+            objects.yaw[i] = angle(random);
+            objects.pitch[i] = angle(random);
+            objects.scale[i] = scale(random);
+        }
+    }
+
+    Float4x4 TransformViewProjection(const HeadlessOptions& options) {
+        return MatrixLookAtLH({ 0.0f, 0.0f, -5.0f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f })
+            * MatrixPerspectiveFovLH(ConvertToRadians(90.0f), static_cast<float>(options.width) / options.height, 0.1f, 200.0f);
+    }
+
+    std::vector<SimdIsa> TransformIsas() {
+        std::vector<SimdIsa> isas = { SimdIsa::Scalar };
+        if (IsSimdIsaSupported(SimdIsa::AVX2)) {
+            isas.push_back(SimdIsa::AVX2);
+        }
+        return isas;
+    }
+
+    // Largest difference between two matrices relative to the larger of 1 and reference's largest element
+    float RelativeError(const Float4x4& actual, const Float4x4& reference) {
+        float magnitude = 1.0f;
+        for (int r = 0; r < 4; r++) {
+            for (int c = 0; c < 4; c++) {
+                magnitude = std::max(magnitude, std::fabs(reference.m[r][c]));
+            }
+        }
+        float error = 0.0f;
+        for (int r = 0; r < 4; r++) {
+            for (int c = 0; c < 4; c++) {
+                error = std::max(error, std::fabs(actual.m[r][c] - reference.m[r][c]) / magnitude);
+            }
+        }
+        return error;
+    }
+
+#ifdef _WIN32
+    // SceneMath stands in for DirectXMath only because the latter is not vendored in this
+    // repo; where the Windows SDK provides it, the camera and the per-object products of both,
+    // and the engine's MVPs, must agree
+    bool VerifyAgainstDirectXMath(const HeadlessOptions& options, const TransformArrays& objects,
+        const std::vector<Float4x4>& composed) {
+        using namespace DirectX;
+        const XMMATRIX viewProjection = XMMatrixLookAtLH(XMVectorSet(0.0f, 0.0f, -5.0f, 1.0f),
+            XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)) *
+            XMMatrixPerspectiveFovLH(XMConvertToRadians(90.0f), static_cast<float>(options.width) / options.height,
+            0.1f, 200.0f);
+        auto toFloat4x4 = [](FXMMATRIX matrix) {
+            XMFLOAT4X4 stored;
+            XMStoreFloat4x4(&stored, matrix);
+            Float4x4 result;
+            std::memcpy(result.m, stored.m, sizeof(result.m));
+            return result;
+        };
+        float cameraError = RelativeError(TransformViewProjection(options), toFloat4x4(viewProjection));
+        float sceneMathError = 0.0f, engineError = 0.0f;
+        for (uint32_t i = 0; i < objects.Count(); i++) {
+            const float scale = objects.scale[i];
+            const Float4x4 reference = toFloat4x4(XMMatrixScaling(scale, scale, scale) * XMMatrixRotationY(objects.yaw[i]) *
+                XMMatrixRotationX(objects.pitch[i]) * XMMatrixTranslation(objects.x[i], objects.y[i], objects.z[i]) *
+                viewProjection);
+            sceneMathError = std::max(sceneMathError,
+                RelativeError(ObjectWorldMatrix(objects, i) * TransformViewProjection(options), reference));
+            engineError = std::max(engineError, RelativeError(composed[i], reference));
+        }
+        const bool passed = cameraError < 1e-5f && sceneMathError < 1e-5f && engineError < 1e-5f;
+        std::printf("against DirectXMath: camera %g, SceneMath products %g, scalar MVPs %g max relative error %s\n",
+            cameraError, sceneMathError, engineError, passed ? "OK" : "FAILED");
+        return passed;
+    }
+#endif
+
+    bool VerifyTransformEngine(TaskScheduler& scheduler) {
+        HeadlessOptions options;
+        const Float4x4 viewProjection = TransformViewProjection(options);
+        const uint32_t count = 1037;
+        TransformArrays objects;
+        FillTransforms(count, objects);
+        const TransformEngine scalar(SimdIsa::Scalar);
+        std::vector<Float4x4> expected(count);
+        scalar.ComposeRange(objects, viewProjection, 0, count, expected.data(), sizeof(Float4x4));
+
+        // The folded products round differently from full 4x4 products; compare relative to the matrix
+        float worst = 0.0f;
+        for (uint32_t i = 0; i < count; i++) {
+            worst = std::max(worst, RelativeError(expected[i], ObjectWorldMatrix(objects, i) * viewProjection));
+        }
+        bool passed = worst < 1e-5f;
+        std::printf("scalar MVPs against SceneMath products: max relative error %g %s\n", worst, passed ? "OK" : "FAILED");
+#ifdef _WIN32
+        passed &= VerifyAgainstDirectXMath(options, objects, expected);
+#endif
+
+        HostUploadDevice device;
+        ManualFence fence;
+        UploadRing ring(device, fence, 1, count * UploadRing::Alignment);
+        for (SimdIsa isa : TransformIsas()) {
+            const TransformEngine engine(isa);
+            std::vector<Float4x4> actual(count);
+            // Odd range boundaries packed, then every object in parallel, one constant buffer each
+            const uint32_t cuts[] = { 0, 5, 13, 21, 500, 501, count };
+            for (size_t k = 0; k + 1 < std::size(cuts); k++) {
+                engine.ComposeRange(objects, viewProjection, cuts[k], cuts[k + 1], actual.data(), sizeof(Float4x4));
+            }
+            bool ranges = std::memcmp(actual.data(), expected.data(), count * sizeof(Float4x4)) == 0;
+            ring.BeginFrame();
+            UploadRing::Allocation constants = engine.ComposeToUploadRing(objects, viewProjection, scheduler, ring,
+                UploadRing::Alignment);
+            bool parallel = constants.size == count * UploadRing::Alignment;
+            for (uint32_t i = 0; i < count && parallel; i++) {
+                parallel = std::memcmp(constants.cpuAddress + i * UploadRing::Alignment, &expected[i], sizeof(Float4x4)) == 0;
+            }
+            ring.EndFrame(fence.CompletedValue() + 1);
+            fence.Complete(fence.CompletedValue() + 1);
+            std::printf("%-7s MVPs: ranges %s, parallel constant buffers %s\n", SimdIsaName(engine.Isa()),
+                ranges ? "identical" : "DIFFERENT", parallel ? "identical" : "DIFFERENT");
+            passed &= ranges && parallel;
+        }
+        return passed;
+    }
+
+    // Per-object MVPs for --cubes objects recomposed every frame into a fresh upload ring
+    // partition, packed and one constant buffer per object, against SceneMath products one
+    // object at a time
+    void RunTransformBenchmark(TaskScheduler& scheduler, const HeadlessOptions& options) {
+        using Clock = std::chrono::steady_clock;
+        const uint32_t objects = options.cubesSet ? options.cubes : 262144;
+        const uint32_t frames = std::max(3u, std::min(options.frames, 50000000 / objects));
+        const uint32_t framesInFlight = 3;
+        const Float4x4 viewProjection = TransformViewProjection(options);
+        TransformArrays transforms;
+        FillTransforms(objects, transforms);
+        HostUploadDevice device;
+        ManualFence fence;
+        UploadRing ring(device, fence, framesInFlight, static_cast<uint64_t>(objects) * UploadRing::Alignment);
+
+        uint64_t fenceValue = 0;
+        for (uint32_t frame = 0; frame < framesInFlight; frame++) {
+            ring.BeginFrame();
+            UploadRing::Allocation all = ring.Allocate(ring.BytesPerFrame());
+            std::memset(all.cpuAddress, 0, static_cast<size_t>(all.size));
+            ring.EndFrame(++fenceValue);
+            fence.Complete(fenceValue);
+        }
+        auto nextFrame = [&]() {
+            ring.EndFrame(++fenceValue);
+            fence.Complete(fenceValue - 1);
+            ring.BeginFrame();
+        };
+
+        std::printf("%u objects, %u frames, %u threads\n", objects, frames, scheduler.ThreadCount());
+        for (uint64_t stride : { static_cast<uint64_t>(sizeof(Float4x4)), UploadRing::Alignment }) {
+            std::printf("%llu-byte stride (%s), %.1f MB per frame\n", static_cast<unsigned long long>(stride),
+                stride == UploadRing::Alignment ? "a constant buffer per object" : "packed",
+                static_cast<double>(objects) * stride / 1048576.0);
+            auto report = [&](const char* name, const char* threads, double seconds, double baseline) {
+                std::printf("  %-9s %-8s %8.2f ms/frame, %7.1f M matrices/s, %6.2f GB/s, x%.2f vs SceneMath\n", name, threads,
+                    seconds * 1e3 / frames, static_cast<double>(objects) * frames / seconds * 1e-6,
+                    static_cast<double>(objects) * stride * frames / seconds * 1e-9, baseline / seconds);
+            };
+
+            ring.BeginFrame();
+            auto begin = Clock::now();
+            for (uint32_t frame = 0; frame < frames; frame++) {
+                UploadRing::Allocation out = ring.Allocate(objects * stride);
+                for (uint32_t i = 0; i < objects; i++) {
+                    const Float4x4 mvp = ObjectWorldMatrix(transforms, i) * viewProjection;
+                    std::memcpy(out.cpuAddress + i * stride, &mvp, sizeof(mvp));
+                }
+                nextFrame();
+            }
+            const double baseline = std::chrono::duration<double>(Clock::now() - begin).count();
+            report("SceneMath", "1 thread", baseline, baseline);
+
+            for (SimdIsa isa : TransformIsas()) {
+                const TransformEngine engine(isa);
+                for (bool parallel : { false, true }) {
+                    begin = Clock::now();
+                    for (uint32_t frame = 0; frame < frames; frame++) {
+                        if (parallel) {
+                            engine.ComposeToUploadRing(transforms, viewProjection, scheduler, ring, stride);
+                        }
+                        else {
+                            UploadRing::Allocation out = ring.Allocate(objects * stride);
+                            engine.ComposeRange(transforms, viewProjection, 0, objects, out.cpuAddress, stride);
+                        }
+                        nextFrame();
+                    }
+                    report(SimdIsaName(engine.Isa()), parallel ? "parallel" : "1 thread",
+                        std::chrono::duration<double>(Clock::now() - begin).count(), baseline);
+                }
+            }
+            ring.EndFrame(++fenceValue);
+            fence.Complete(fenceValue);
+        }
+    }
+
+    // Spheres scattered through a box around the camera and past the far plane
+    void FillSpheres(uint32_t count, SphereArrays& spheres) {
+        spheres.Resize(count);
+        std::mt19937 random(29);
+        std::uniform_real_distribution<float> position(-100.0f, 100.0f), radius(0.1f, 4.0f);
+        for (uint32_t i = 0; i < count; i++) {
+            spheres.x[i] = position(random);
+            spheres.y[i] = position(random);
+            spheres.z[i] = position(random) * 1.5f + 100.0f;
+            spheres.radius[i] = radius(random);
+        }
+    }
+
+    bool VerifyFrustumCuller(TaskScheduler& scheduler, const HeadlessOptions& options) {
+        const Float4x4 viewProjection = TransformViewProjection(options);
+        const Frustum frustum = ExtractFrustum(viewProjection);
+
+        // Points inside every plane are the points inside the clip volume, away from its boundary.
+        // The far plane is nearly parallel to the near one, so clip coordinates need doubles.
+        std::mt19937 random(31);
+        std::uniform_real_distribution<float> position(-250.0f, 250.0f);
+        uint32_t disagreements = 0, inside = 0;
+        const uint32_t points = 200000;
+        for (uint32_t i = 0; i < points; i++) {
+            const Float3 p = { position(random), position(random), position(random) };
+            double clip[4];
+            for (int c = 0; c < 4; c++) {
+                clip[c] = static_cast<double>(p.x) * viewProjection.m[0][c] + static_cast<double>(p.y) * viewProjection.m[1][c]
+                    + static_cast<double>(p.z) * viewProjection.m[2][c] + viewProjection.m[3][c];
+            }
+            float nearest = std::numeric_limits<float>::max();
+            bool insidePlanes = true;
+            for (const Float4& plane : frustum.planes) {
+                const float d = plane.x * p.x + plane.y * p.y + plane.z * p.z + plane.w;
+                nearest = std::min(nearest, std::fabs(d));
+                insidePlanes &= d >= 0.0f;
+            }
+            const bool insideClip = -clip[3] <= clip[0] && clip[0] <= clip[3] && -clip[3] <= clip[1] && clip[1] <= clip[3]
+                && 0.0 <= clip[2] && clip[2] <= clip[3];
+            inside += insideClip;
+            disagreements += nearest > 1e-3f && insidePlanes != insideClip;
+        }
+        bool passed = disagreements == 0 && inside > 0;
+        std::printf("frustum planes against clip coordinates: %u points, %u inside, %u disagreements %s\n", points, inside,
+            disagreements, passed ? "OK" : "FAILED");
+
+        // The scalar kernel against spheres tested in double precision, skipping spheres within
+        // rounding of touching a plane
+        const uint32_t count = 20011;
+        SphereArrays spheres;
+        FillSpheres(count, spheres);
+        std::vector<uint32_t> expected(count);
+        CullStats expectedStats;
+        const FrustumCuller scalar(SimdIsa::Scalar);
+        expected.resize(scalar.CullRange(frustum, spheres, 0, count, expected.data(), expectedStats));
+        std::vector<bool> kept(count, false);
+        for (uint32_t index : expected) {
+            kept[index] = true;
+        }
+        uint32_t wrong = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            bool visible = true, borderline = false;
+            for (const Float4& plane : frustum.planes) {
+                const double d = static_cast<double>(plane.x) * spheres.x[i] + static_cast<double>(plane.y) * spheres.y[i]
+                    + static_cast<double>(plane.z) * spheres.z[i] + plane.w;
+                visible &= d >= -spheres.radius[i];
+                borderline |= std::fabs(d + spheres.radius[i]) < 1e-3;
+            }
+            wrong += !borderline && visible != kept[i];
+        }
+        std::printf("scalar culling against double precision: %zu of %u visible, %u wrong %s\n", expected.size(), count,
+            wrong, wrong == 0 ? "OK" : "FAILED");
+        passed &= wrong == 0;
+
+        for (SimdIsa isa : CoverageIsas()) {
+            const FrustumCuller culler(isa);
+            // Odd range boundaries, then everything in parallel chunks
+            std::vector<uint32_t> actual(count);
+            CullStats stats;
+            uint32_t visible = 0;
+            const uint32_t cuts[] = { 0, 3, 21, 40, 5000, 5001, count };
+            for (size_t k = 0; k + 1 < std::size(cuts); k++) {
+                visible += culler.CullRange(frustum, spheres, cuts[k], cuts[k + 1], actual.data() + visible, stats);
+            }
+            bool ranges = visible == expected.size() && std::equal(expected.begin(), expected.end(), actual.begin())
+                && stats.visible == expectedStats.visible && stats.intersecting == expectedStats.intersecting
+                && std::equal(std::begin(stats.outside), std::end(stats.outside), std::begin(expectedStats.outside));
+            std::fill(actual.begin(), actual.end(), 0u);
+            stats = CullStats();
+            visible = culler.Cull(frustum, spheres, scheduler, actual.data(), &stats);
+            bool parallel = visible == expected.size() && std::equal(expected.begin(), expected.end(), actual.begin())
+                && stats.tested == count && stats.visible == expectedStats.visible
+                && stats.intersecting == expectedStats.intersecting
+                && std::equal(std::begin(stats.outside), std::end(stats.outside), std::begin(expectedStats.outside));
+            std::printf("%-7s culling: ranges %s, parallel %s\n", SimdIsaName(isa), ranges ? "identical" : "DIFFERENT",
+                parallel ? "identical" : "DIFFERENT");
+            passed &= ranges && parallel;
+        }
+        return passed;
+    }
+
+    // One culling pass over --cubes spheres a frame, on one thread and in parallel chunks
+    void RunCullingBenchmark(TaskScheduler& scheduler, const HeadlessOptions& options) {
+        using Clock = std::chrono::steady_clock;
+        const uint32_t objects = options.cubesSet ? options.cubes : 1000000;
+        const uint32_t frames = std::max(3u, std::min(options.frames, 200000000 / objects));
+        const Frustum frustum = ExtractFrustum(TransformViewProjection(options));
+        SphereArrays spheres;
+        FillSpheres(objects, spheres);
+        std::vector<uint32_t> visibleList(objects);
+
+        CullStats stats;
+        const uint32_t visible = FrustumCuller(SimdIsa::Scalar).CullRange(frustum, spheres, 0, objects, visibleList.data(), stats);
+        static const char* planeNames[6] = { "left", "right", "bottom", "top", "near", "far" };
+        std::printf("%u spheres, %u frames, %u threads: %u visible (%.1f%%), %llu of them crossing a plane; outside",
+            objects, frames, scheduler.ThreadCount(), visible, 100.0 * visible / objects,
+            static_cast<unsigned long long>(stats.intersecting));
+        for (int p = 0; p < 6; p++) {
+            std::printf(" %s %llu%s", planeNames[p], static_cast<unsigned long long>(stats.outside[p]), p < 5 ? "," : "\n");
+        }
+
+        double scalarSeconds = 0.0;
+        for (SimdIsa isa : CoverageIsas()) {
+            const FrustumCuller culler(isa);
+            for (bool parallel : { false, true }) {
+                auto begin = Clock::now();
+                for (uint32_t frame = 0; frame < frames; frame++) {
+                    CullStats frameStats;
+                    if (parallel) {
+                        culler.Cull(frustum, spheres, scheduler, visibleList.data(), &frameStats);
+                    }
+                    else {
+                        culler.CullRange(frustum, spheres, 0, objects, visibleList.data(), frameStats);
+                    }
+                }
+                const double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+                if (isa == SimdIsa::Scalar && !parallel) {
+                    scalarSeconds = seconds;
+                }
+                std::printf("  %-7s %-8s %7.3f ms/pass, %8.1f M spheres/s, x%.2f vs scalar\n", SimdIsaName(isa),
+                    parallel ? "parallel" : "1 thread", seconds * 1e3 / frames,
+                    static_cast<double>(objects) * frames / seconds * 1e-6, scalarSeconds / seconds);
+            }
+        }
+    }
+
+    // The boxes of cubes placed like FillSpheres, each spinning about its center with a phase
+    // of its own as the sample's cube does
+    void SpinningCubeBoxes(const SphereArrays& cubes, float time, TaskScheduler& scheduler, std::vector<Aabb>& boxes) {
+        boxes.resize(cubes.Count());
+        scheduler.ParallelFor(cubes.Count(), [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) {
+                const float phase = time + static_cast<float>(i % 97) * 0.37f;
+                const Float4x4 rotation = MatrixRotationY(phase) * MatrixRotationX(phase * 0.5f);
+                // Half-size radius / sqrt(3) cubes; each world axis extent sums the rotated axes
+                const float half = cubes.radius[i] * 0.57735027f;
+                float extent[3];
+                for (int c = 0; c < 3; c++) {
+                    extent[c] = half * (std::fabs(rotation.m[0][c]) + std::fabs(rotation.m[1][c]) + std::fabs(rotation.m[2][c]));
+                }
+                boxes[i] = { { cubes.x[i] - extent[0], cubes.y[i] - extent[1], cubes.z[i] - extent[2] },
+                    { cubes.x[i] + extent[0], cubes.y[i] + extent[1], cubes.z[i] + extent[2] } };
+            }
+        }, 4096);
+    }
+
+    std::vector<Ray> PickRays(uint32_t count, const HeadlessOptions& options) {
+        std::mt19937 random(37);
+        std::uniform_real_distribution<float> ndc(-1.0f, 1.0f);
+        std::vector<Ray> rays(count);
+        for (Ray& ray : rays) {
+            const float x = ndc(random), y = ndc(random);
+            ray = MakePickRay({ 0.0f, 0.0f, -5.0f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, ConvertToRadians(90.0f),
+                static_cast<float>(options.width) / options.height, x, y);
+        }
+        return rays;
+    }
+
+    uint32_t CullBoxesBruteForce(const Frustum& frustum, const std::vector<Aabb>& boxes, uint32_t* out) {
+        uint32_t visible = 0;
+        for (uint32_t i = 0; i < boxes.size(); i++) {
+            if (TestBox(frustum, boxes[i]) != FrustumTest::Outside) {
+                out[visible++] = i;
+            }
+        }
+        return visible;
+    }
+
+    float NearestHitBruteForce(const Ray& ray, const std::vector<Aabb>& boxes) {
+        const Float3 inverse = { 1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z };
+        float nearest = ray.tMax;
+        for (const Aabb& box : boxes) {
+            float t;
+            if (IntersectBox(ray, inverse, box, nearest, t)) {
+                nearest = t;
+            }
+        }
+        return nearest;
+    }
+
+    // Every primitive in exactly one leaf, every box inside its parent's, children after parents
+    bool ValidateBvh(const Bvh& bvh, const std::vector<Aabb>& boxes) {
+        const std::vector<BvhNode>& nodes = bvh.Nodes();
+        std::vector<uint32_t> seen(boxes.size(), 0);
+        auto contains = [](const BvhNode& outer, const Aabb& inner) {
+            return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z
+                && outer.max.x >= inner.max.x && outer.max.y >= inner.max.y && outer.max.z >= inner.max.z;
+        };
+        for (uint32_t i = 0; i < nodes.size(); i++) {
+            const BvhNode& node = nodes[i];
+            if (node.count > 0) {
+                for (uint32_t k = 0; k < node.count; k++) {
+                    const uint32_t primitive = bvh.Primitives()[node.first + k];
+                    seen[primitive]++;
+                    if (!contains(node, boxes[primitive])) {
+                        return false;
+                    }
+                }
+            }
+            else if (node.first <= i || node.first + 1 >= nodes.size()
+                || !contains(node, { nodes[node.first].min, nodes[node.first].max })
+                || !contains(node, { nodes[node.first + 1].min, nodes[node.first + 1].max })) {
+                return false;
+            }
+        }
+        return std::all_of(seen.begin(), seen.end(), [](uint32_t count) { return count == 1; });
+    }
+
+    bool VerifyBvh(TaskScheduler& scheduler, const HeadlessOptions& options) {
+        const uint32_t count = 30011;
+        SphereArrays cubes;
+        FillSpheres(count, cubes);
+        std::vector<Aabb> boxes;
+        SpinningCubeBoxes(cubes, 0.0f, scheduler, boxes);
+        const Frustum frustum = ExtractFrustum(TransformViewProjection(options));
+        const std::vector<Ray> rays = PickRays(2000, options);
+
+        std::vector<uint32_t> expected(count), actual(count);
+        std::vector<float> expectedHits(rays.size());
+        auto reference = [&]() {
+            expected.resize(count);
+            expected.resize(CullBoxesBruteForce(frustum, boxes, expected.data()));
+            for (size_t r = 0; r < rays.size(); r++) {
+                expectedHits[r] = NearestHitBruteForce(rays[r], boxes);
+            }
+        };
+        // Same primitive set in any order, and the nearest hit at the same distance
+        auto check = [&](auto& tree) {
+            actual.resize(count);
+            actual.resize(tree.CullFrustum(frustum, boxes, actual.data()));
+            std::sort(actual.begin(), actual.end());
+            bool culled = actual == expected;
+            uint32_t wrongHits = 0;
+            for (size_t r = 0; r < rays.size(); r++) {
+                RayHit hit;
+                const bool found = tree.IntersectRay(rays[r], boxes, hit);
+                wrongHits += found != (expectedHits[r] < rays[r].tMax) || (found && hit.t != expectedHits[r]);
+            }
+            return culled && wrongHits == 0;
+        };
+
+        bool passed = true;
+        reference();
+        std::printf("%u boxes, %zu in the frustum, %zu pick rays\n", count, expected.size(), rays.size());
+        for (bool parallel : { false, true }) {
+            Bvh bvh;
+            bvh.Build(boxes, parallel ? &scheduler : nullptr);
+            bool valid = ValidateBvh(bvh, boxes);
+            bool queries = check(bvh);
+            std::printf("%-8s build: %zu nodes, SAH cost %.1f, valid %s, queries %s\n", parallel ? "parallel" : "serial",
+                bvh.Nodes().size(), bvh.SahCost(), valid ? "OK" : "FAILED", queries ? "OK" : "FAILED");
+            passed &= valid && queries;
+        }
+
+        Bvh bvh;
+        bvh.Build(boxes, &scheduler);
+        SpinningCubeBoxes(cubes, 2.5f, scheduler, boxes);
+        bvh.Refit(boxes, &scheduler);
+        reference();
+        bool refit = ValidateBvh(bvh, boxes) && check(bvh);
+        std::printf("refit after the cubes turned: valid and queries %s\n", refit ? "OK" : "FAILED");
+        passed &= refit;
+
+        for (SimdIsa isa : { SimdIsa::Scalar, options.isa }) {
+            Bvh4 bvh4(isa);
+            Bvh8 bvh8(isa);
+            bvh4.Collapse(bvh);
+            bvh8.Collapse(bvh);
+            bool ok4 = check(bvh4), ok8 = check(bvh8);
+            std::printf("%-7s BVH4 %zu nodes, queries %s; BVH8 %zu nodes, queries %s\n", SimdIsaName(isa),
+                bvh4.Nodes().size(), ok4 ? "OK" : "FAILED", bvh8.Nodes().size(), ok8 ? "OK" : "FAILED");
+            passed &= ok4 && ok8;
+        }
+        return passed;
+    }
+
+    // Build, refit, frustum and ray query timings for --cubes spinning cubes, or for 100K and 1M.
+    // Rays are traced one per thread item; frustum queries run one at a time.
+    void RunBvhBenchmark(TaskScheduler& scheduler, const HeadlessOptions& options) {
+        using Clock = std::chrono::steady_clock;
+        auto since = [](Clock::time_point begin) { return std::chrono::duration<double>(Clock::now() - begin).count(); };
+        std::vector<uint32_t> counts = { 100000, 1000000, 10000000 };
+        if (options.cubesSet) {
+            counts = { options.cubes };
+        }
+        const Frustum frustum = ExtractFrustum(TransformViewProjection(options));
+        const std::vector<Ray> rays = PickRays(100000, options);
+
+        for (uint32_t count : counts) {
+            SphereArrays cubes;
+            FillSpheres(count, cubes);
+            std::vector<Aabb> boxes;
+            SpinningCubeBoxes(cubes, options.startTime, scheduler, boxes);
+            std::printf("%u boxes, %u threads, %s\n", count, scheduler.ThreadCount(), SimdIsaName(options.isa));
+
+            Bvh bvh;
+            auto begin = Clock::now();
+            bvh.Build(boxes, nullptr);
+            const double serialBuild = since(begin);
+            begin = Clock::now();
+            bvh.Build(boxes, &scheduler);
+            const double parallelBuild = since(begin);
+            const float builtCost = bvh.SahCost();
+            Bvh4 bvh4(options.isa);
+            Bvh8 bvh8(options.isa);
+            begin = Clock::now();
+            bvh4.Collapse(bvh);
+            bvh8.Collapse(bvh);
+            const double collapse = since(begin);
+            std::printf("  build    %8.1f ms serial, %8.1f ms parallel (%.1f M boxes/s), collapse to BVH4 and BVH8 %.1f ms\n",
+                serialBuild * 1e3, parallelBuild * 1e3, count / parallelBuild * 1e-6, collapse * 1e3);
+            std::printf("  memory   binary %zu nodes %.1f MB, BVH4 %zu nodes %.1f MB, BVH8 %zu nodes %.1f MB; SAH cost %.1f\n",
+                bvh.Nodes().size(), bvh.MemoryBytes() / 1048576.0, bvh4.Nodes().size(), bvh4.MemoryBytes() / 1048576.0,
+                bvh8.Nodes().size(), bvh8.MemoryBytes() / 1048576.0, builtCost);
+
+            // A second of animation later: refit against rebuilding
+            SpinningCubeBoxes(cubes, options.startTime + 1.0f, scheduler, boxes);
+            begin = Clock::now();
+            bvh.Refit(boxes, &scheduler);
+            const double refit = since(begin);
+            const float refitCost = bvh.SahCost();
+            Bvh rebuilt;
+            rebuilt.Build(boxes, &scheduler);
+            std::printf("  refit    %8.2f ms, SAH cost %.1f against %.1f rebuilt\n", refit * 1e3, refitCost, rebuilt.SahCost());
+            bvh4.Collapse(bvh);
+            bvh8.Collapse(bvh);
+
+            std::vector<uint32_t> visibleList(count);
+            const uint32_t queries = std::max(3u, 20000000 / count);
+            auto cullTime = [&](auto&& cull) {
+                uint32_t visible = 0;
+                auto start = Clock::now();
+                for (uint32_t q = 0; q < queries; q++) {
+                    visible = cull();
+                }
+                return std::make_pair(since(start) / queries, visible);
+            };
+            const auto flat = cullTime([&]() { return CullBoxesBruteForce(frustum, boxes, visibleList.data()); });
+            const auto binary = cullTime([&]() { return bvh.CullFrustum(frustum, boxes, visibleList.data()); });
+            const auto wide4 = cullTime([&]() { return bvh4.CullFrustum(frustum, boxes, visibleList.data()); });
+            const auto wide8 = cullTime([&]() { return bvh8.CullFrustum(frustum, boxes, visibleList.data()); });
+            std::printf("  frustum  %u visible: every box %.3f ms, binary %.3f ms, BVH4 %.3f ms, BVH8 %.3f ms\n", flat.second,
+                flat.first * 1e3, binary.first * 1e3, wide4.first * 1e3, wide8.first * 1e3);
+
+            auto traceTime = [&](auto& tree) {
+                std::vector<uint32_t> hits(scheduler.ThreadCount() * 16, 0);
+                auto start = Clock::now();
+                scheduler.ParallelFor(static_cast<uint32_t>(rays.size()), [&](uint32_t first, uint32_t last) {
+                    uint32_t found = 0;
+                    for (uint32_t r = first; r < last; r++) {
+                        RayHit hit;
+                        found += tree.IntersectRay(rays[r], boxes, hit);
+                    }
+                    hits[(first / 1024) % hits.size()] += found;
+                }, 1024);
+                return rays.size() / since(start) * 1e-6;
+            };
+            std::printf("  rays     binary %.2f, BVH4 %.2f, BVH8 %.2f M rays/s\n", traceTime(bvh), traceTime(bvh4),
+                traceTime(bvh8));
+        }
+    }
+
+    // The three MVP bindings of the sample recorded for `--cubes` draws a frame, as the window
+    // records them with --binding. A replay of one frame reads every draw's matrix back the
+    // way VSMain would; the timing covers upload, descriptor writes and command recording.
+    bool RunBindingBenchmark(TaskScheduler& scheduler, const HeadlessOptions& options) {
+        using Clock = std::chrono::steady_clock;
+        const uint32_t objects = options.cubesSet ? options.cubes : 10000;
+        const uint32_t frames = std::max(3u, std::min(options.frames * 10, 20000000 / objects));
+        const uint32_t framesInFlight = 3;
+        const uint32_t indexCount = CubeGridIndexCount;
+
+        CubeGrid grid;
+        BuildCubeGrid(objects, options.startTime, static_cast<float>(options.width) / options.height, scheduler, grid);
+        std::vector<Float4x4> mvps(objects);
+        for (uint32_t i = 0; i < objects; i++) {
+            Float4x4 model = MatrixRotationY(i * 0.37f);
+            model.m[3][0] = grid.centers[i].x;
+            model.m[3][1] = grid.centers[i].y;
+            model.m[3][2] = grid.centers[i].z;
+            mvps[i] = model * grid.viewProjection;
+        }
+
+        // A table per draw, frames in flight deep, plus room for the ring to skip to its start
+        const uint32_t descriptors = objects * (framesInFlight + 1);
+        RecordingCommandList commands(descriptors, 1);
+        HostUploadDevice device;
+        std::printf("%u draws per frame, %u frames per binding, %u frames in flight\n", objects, frames, framesInFlight);
+
+        bool passed = true;
+        for (uint32_t b = 0; b < MvpBindingCount; b++) {
+            const MvpBinding binding = static_cast<MvpBinding>(b);
+            ManualFence fence;
+            UploadRing upload(device, fence, framesInFlight, static_cast<uint64_t>(objects) * UploadRing::Alignment + 65536);
+            UploadCursor cursor(upload);
+            DescriptorRing ring(fence, 0, descriptors);
+            uint64_t fenceValue = 0;
+            uint64_t uploadBytes = 0;
+
+            auto recordFrame = [&]() {
+                upload.BeginFrame();
+                cursor.Reset();
+                commands.Reset();
+                SubmitMvpDraws(commands, binding, cursor, ring, mvps.data(), objects, indexCount);
+                uploadBytes = upload.BytesUsed();
+                fenceValue++;
+                upload.EndFrame(fenceValue);
+                ring.EndFrame(fenceValue);
+                if (fenceValue > framesInFlight - 1) {
+                    fence.Complete(fenceValue - (framesInFlight - 1));
+                }
+            };
+
+            // Root CBVs and CBVs hold GPU addresses; the ring is one buffer, so one offset maps them back
+            upload.BeginFrame();
+            UploadRing::Allocation probe = upload.Allocate(16);
+            upload.EndFrame(0);
+            recordFrame();
+            const int64_t toCpu = reinterpret_cast<int64_t>(probe.cpuAddress) - static_cast<int64_t>(probe.gpuAddress);
+            uint32_t drawn = 0, wrong = 0;
+            commands.Replay([&](const RecordingCommandList::RootState& state, const RecordingCommandList::Draw&) {
+                const void* mvp;
+                if (binding == MvpBinding::RootConstants) {
+                    mvp = state.constants[0];
+                }
+                else {
+                    const uint64_t address = binding == MvpBinding::RootCbv ? state.argument[1] :
+                        commands.ShaderVisibleDescriptor(static_cast<uint32_t>(state.argument[2])).address;
+                    mvp = reinterpret_cast<const void*>(static_cast<int64_t>(address) + toCpu);
+                }
+                wrong += std::memcmp(mvp, &mvps[drawn++], sizeof(Float4x4)) != 0;
+            });
+            const bool ok = drawn == objects && wrong == 0;
+            passed &= ok;
+
+            const size_t commandBytes = commands.CommandBytes();
+            const uint64_t calls = commands.Calls();
+            const uint64_t descriptorsBefore = ring.GetStats().descriptors;
+            auto begin = Clock::now();
+            for (uint32_t frame = 0; frame < frames; frame++) {
+                recordFrame();
+            }
+            const double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+            const double perDraw = seconds * 1e9 / (static_cast<double>(frames) * objects);
+            std::printf("  %-9s %6.1f ns/draw, %6.2f M draws/s, %8.1f KB uploaded, %8.1f KB of commands, "
+                "%6llu descriptors/frame, %.1f calls/draw, %u draws checked %s\n", MvpBindingName(binding),
+                perDraw, 1e3 / perDraw, uploadBytes / 1024.0, commandBytes / 1024.0,
+                static_cast<unsigned long long>((ring.GetStats().descriptors - descriptorsBefore) / frames),
+                static_cast<double>(calls) / objects, drawn, ok ? "OK" : "FAILED");
+        }
+        return passed;
+    }
+}
+
+int RunHeadless(int argc, char** argv) {
+    HeadlessOptions options;
+    try {
+        options = ParseOptions(argc, argv);
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        PrintUsage();
+        return 1;
+    }
+
+    TaskScheduler scheduler(options.threads);
+    if (options.benchmark) {
+        RunBenchmark(scheduler, options);
+        return 0;
+    }
+    if (options.verify) {
+        return VerifyAgainstReference(scheduler, options) ? 0 : 1;
+    }
+    if (options.occlusion) {
+        return RunOcclusionReport(scheduler, options) ? 0 : 1;
+    }
+    if (options.upload) {
+        bool passed = VerifyUploadRing(scheduler);
+        RunUploadBenchmark(scheduler, options);
+        return passed ? 0 : 1;
+    }
+    if (options.instances) {
+        bool passed = VerifyInstanceBuilder(scheduler);
+        RunInstanceBenchmark(scheduler, options);
+        return passed ? 0 : 1;
+    }
+    if (options.transforms) {
+        bool passed = VerifyTransformEngine(scheduler);
+        RunTransformBenchmark(scheduler, options);
+        return passed ? 0 : 1;
+    }
+    if (options.culling) {
+        bool passed = VerifyFrustumCuller(scheduler, options);
+        RunCullingBenchmark(scheduler, options);
+        return passed ? 0 : 1;
+    }
+    if (options.bvh) {
+        bool passed = VerifyBvh(scheduler, options);
+        RunBvhBenchmark(scheduler, options);
+        return passed ? 0 : 1;
+    }
+    if (options.bindings) {
+        return RunBindingBenchmark(scheduler, options) ? 0 : 1;
+    }
+    if (options.pacing) {
+        bool passed = VerifyFramePacer();
+        RunPacingBenchmark(options);
+        return passed ? 0 : 1;
+    }
+
+    TiledRasterizer tiled(scheduler, options.isa);
+    CpuImage image(options.width, options.height);
+    DepthBuffer depth;
+    depth.Resize(options.width, options.height);
+
+    std::cout << "CPU rasterizer: " << options.width << "x" << options.height << ", " << options.cubes
+        << " cubes, " << scheduler.ThreadCount() << " threads, " << SimdIsaName(tiled.Isa()) << std::endl;
+
+    auto begin = std::chrono::steady_clock::now();
+    FrameTiming timing = RenderFrames(scheduler, &tiled, options, options.cubes, image, depth);
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - begin).count();
+
+    const RasterStats& stats = tiled.Stats();
+    std::cout << options.frames << " frames in " << seconds << " s (" << options.frames / seconds << " frames/s, "
+        << timing.triangles / timing.drawSeconds * 1e-6 << " Mtriangles/s rasterized), last frame "
+        << stats.trianglesRasterized << " of " << stats.trianglesSubmitted << " triangles visible" << std::endl;
+
+    if (!options.outputPath.empty()) {
+        try {
+            WritePngFile(options.outputPath, image);
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        std::cout << "Wrote " << options.outputPath << std::endl;
+    }
+    return 0;
+}
+
+#ifndef _WIN32
+int main(int argc, char** argv) {
+    return RunHeadless(argc, argv);
+}
+#endif
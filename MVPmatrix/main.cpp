@@ -6,9 +6,22 @@
 #include <dxgi1_6.h>
 #include <d3dcompiler.h>
 #include <DirectXMath.h>
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <vector>
 #include <stdexcept>
+#include <string>
+#include "CubeMesh.h"
+#include "../Common/Bvh.h"
+#include "../Common/DescriptorAllocator.h"
+#include "../Common/DrawSubmission.h"
+#include "../Common/FramePacer.h"
+#include "../Common/FrustumCuller.h"
+#include "../Common/InstanceBuilder.h"
+#include "../Common/TaskScheduler.h"
+#include "../Common/TransformEngine.h"
+#include "../Common/UploadRing.h"
 
 using namespace Microsoft::WRL;
 using namespace DirectX;
@@ -26,30 +39,14 @@ void InitWindow(HINSTANCE hInstance);
 void Initialize();
 void LoadAssets();
 void LoadShaderPipeline();
+int RunHeadless(int argc, char** argv); // headless.cpp
 void ThrowIfFailed(HRESULT hr); // Centralized error handling
 
 // Constants
 const UINT Width = 800;
 const UINT Height = 600;
 const UINT FrameCount = 2;
-
-// Vertex structure
-struct Vertex {
-    XMFLOAT3 position;
-    XMFLOAT3 color;
-};
-
-// Cube data
-Vertex cubeVertices[] = {
-    {{-1,-1,-1}, {1,0,0}}, {{-1, 1,-1}, {0,1,0}}, {{1, 1,-1}, {0,0,1}}, {{1,-1,-1}, {1,1,0}},
-    {{-1,-1, 1}, {1,0,1}}, {{-1, 1, 1}, {0,1,1}}, {{1, 1, 1}, {1,1,1}}, {{1,-1, 1}, {0,0,0}},
-};
-
-uint16_t cubeIndices[] = {
-    0,1,2, 0,2,3,  4,6,5, 4,7,6,
-    4,5,1, 4,1,0,  3,2,6, 3,6,7,
-    1,5,6, 1,6,2,  4,0,3, 4,3,7,
-};
+const UINT FramesInFlight = 3; // Frames the CPU may record ahead of the GPU, independent of the back buffers
 
 // Globals (Consider minimizing these)
 HWND hwnd = nullptr;
@@ -63,11 +60,10 @@ ComPtr<ID3D12DescriptorHeap> dsvHeap;
 UINT dsvDescriptorSize;
 ComPtr<ID3D12Resource> depthStencilBuffer;
 D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc;
-ComPtr<ID3D12CommandAllocator> commandAllocator;
+ComPtr<ID3D12CommandAllocator> commandAllocator[FramesInFlight]; // One per frame context
 ComPtr<ID3D12GraphicsCommandList> commandList;
 ComPtr<ID3D12Fence> fence;
 HANDLE fenceEvent;
-UINT64 fenceValue = 1;
 UINT frameIndex;
 
 ComPtr<ID3D12RootSignature> rootSignature;
@@ -79,11 +75,202 @@ D3D12_INDEX_BUFFER_VIEW indexBufferView;
 
 // Descriptor heap is needed for constant buffer view (Root descriptor or Descriptor table)
 ComPtr<ID3D12DescriptorHeap> shaderVisibleHeap;
-ComPtr<ID3D12Resource> constantBuffer;
-D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
+UINT cbvDescriptorSize;
+
+// Per-frame constants come from one persistently mapped upload ring instead of a
+// Map/memcpy/Unmap on a single buffer the GPU may still be reading
+class D3D12UploadDevice : public UploadDevice {
+public:
+    UploadMemory CreateMappedBuffer(uint64_t size) override {
+        ComPtr<ID3D12Resource> buffer;
+        auto heapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+        auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(size, D3D12_RESOURCE_FLAG_NONE);
+        ThrowIfFailed(device->CreateCommittedResource(
+            &heapProps, D3D12_HEAP_FLAG_NONE,
+            &bufferDesc,
+            D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&buffer)));
+
+        // Upload heaps may stay mapped for the lifetime of the resource
+        UploadMemory memory;
+        CD3DX12_RANGE readRange(0, 0);
+        ThrowIfFailed(buffer->Map(0, &readRange, reinterpret_cast<void**>(&memory.cpuAddress)));
+        memory.gpuAddress = buffer->GetGPUVirtualAddress();
+        memory.size = size;
+        memory.handle = buffer.Get();
+        buffers.push_back(buffer);
+        return memory;
+    }
+
+    void ReleaseMappedBuffer(const UploadMemory& memory) override {
+        for (auto it = buffers.begin(); it != buffers.end(); ++it) {
+            if (it->Get() == memory.handle) {
+                (*it)->Unmap(0, nullptr);
+                buffers.erase(it);
+                return;
+            }
+        }
+    }
+
+private:
+    std::vector<ComPtr<ID3D12Resource>> buffers;
+};
+
+class D3D12TimelineFence : public TimelineFence {
+public:
+    uint64_t CompletedValue() override { return fence->GetCompletedValue(); }
+
+    void WaitForValue(uint64_t value) override {
+        if (fence->GetCompletedValue() < value) {
+            ThrowIfFailed(fence->SetEventOnCompletion(value, fenceEvent));
+            WaitForSingleObject(fenceEvent, INFINITE);
+        }
+    }
+};
+
+const UINT64 UploadBytesPerFrame = 64 * 1024; // Plus a constant buffer per object
+D3D12UploadDevice uploadDevice;
+D3D12TimelineFence frameFence;
+FramePacer framePacer(frameFence, FramesInFlight);
+std::unique_ptr<UploadRing> uploadRing;
+
+// --binding picks the root parameter that carries the MVP, and VSMain is compiled to read
+// that one; --objects draws that many cubes, each with its own MVP bound on its own
+MvpBinding mvpBinding = MvpBinding::DescriptorTable;
+UINT objectCount = 1;
+const UINT MaxObjects = 65536;
+DescriptorRing frameDescriptors(frameFence, 0, MaxObjects * FramesInFlight); // A CBV per table-bound draw
+TransformArrays objectTransforms; // Placed on the first frame, spun every frame
+SphereArrays objectBounds;
+FrustumCuller frustumCuller;
+std::vector<uint32_t> visibleObjects;
+std::vector<Aabb> objectBoxes; // Refit into objectBvh every frame for picking with the mouse
+Bvh objectBvh;
+TransformEngine transformEngine;
+std::vector<Float4x4> objectMvps;
+double submitSeconds = 0.0; // CPU time of SubmitMvpDraws since the last report
+UINT submitFrames = 0;
+
+// --instances N draws an N-cube grid with one DrawIndexedInstanced instead: the world
+// matrices go in a per-instance vertex stream rebuilt in the upload ring every frame
+UINT instanceCount = 0;
+const UINT MaxInstances = 1 << 22; // 192 MB of instance data per frame in flight
+ComPtr<ID3D12PipelineState> instancedPipelineState;
+InstanceBuilder instanceBuilder;
+
+// Runs the transform engine and the instance builder across all cores
+std::unique_ptr<TaskScheduler> workerScheduler;
+
+// The calls SubmitMvpDraws makes, on commandList and device. Tables are heap indices.
+class D3D12MvpCommands {
+public:
+    void SetGraphicsRoot32BitConstants(uint32_t parameter, uint32_t count, const void* data, uint32_t offset) {
+        commandList->SetGraphicsRoot32BitConstants(parameter, count, data, offset);
+    }
+
+    void SetGraphicsRootConstantBufferView(uint32_t parameter, uint64_t gpuAddress) {
+        commandList->SetGraphicsRootConstantBufferView(parameter, gpuAddress);
+    }
+
+    void SetGraphicsRootDescriptorTable(uint32_t parameter, uint32_t descriptorIndex) {
+        CD3DX12_GPU_DESCRIPTOR_HANDLE handle(shaderVisibleHeap->GetGPUDescriptorHandleForHeapStart(), descriptorIndex, cbvDescriptorSize);
+        commandList->SetGraphicsRootDescriptorTable(parameter, handle);
+    }
+
+    void CreateConstantBufferView(uint32_t descriptorIndex, uint64_t gpuAddress, uint32_t size) {
+        D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
+        cbvDesc.BufferLocation = gpuAddress;
+        cbvDesc.SizeInBytes = size;
+        CD3DX12_CPU_DESCRIPTOR_HANDLE handle(shaderVisibleHeap->GetCPUDescriptorHandleForHeapStart(), descriptorIndex, cbvDescriptorSize);
+        device->CreateConstantBufferView(&cbvDesc, handle);
+    }
+
+    void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex,
+        uint32_t startInstance) {
+        commandList->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+    }
+};
+
+// One object is the sample's cube; more are smaller copies on a square grid facing the camera.
+// Every object spins like the sample's cube, and the transform engine composes all MVPs in
+// parallel. Objects outside the view frustum are culled: the MVPs of the visible ones are
+// moved to the front of objectMvps, in order, and their number returned.
+UINT BuildObjectMvps(float time, const XMMATRIX& viewProj) {
+    if (objectTransforms.Count() != objectCount) {
+        objectTransforms.Resize(objectCount);
+        objectBounds.Resize(objectCount);
+        objectMvps.resize(objectCount);
+        visibleObjects.resize(objectCount);
+        if (objectCount > 1) {
+            UINT side = 1;
+            while (side * side < objectCount) {
+                side++;
+            }
+            const float cell = 8.0f / side;
+            for (UINT i = 0; i < objectCount; i++) {
+                objectTransforms.x[i] = -4.0f + (i % side + 0.5f) * cell;
+                objectTransforms.y[i] = -4.0f + (i / side + 0.5f) * cell;
+                objectTransforms.scale[i] = cell * 0.3f;
+            }
+        }
+        // The cube's corners are at distance sqrt(3) from its center
+        for (UINT i = 0; i < objectCount; i++) {
+            objectBounds.x[i] = objectTransforms.x[i];
+            objectBounds.y[i] = objectTransforms.y[i];
+            objectBounds.z[i] = objectTransforms.z[i];
+            objectBounds.radius[i] = objectTransforms.scale[i] * 1.7320508f;
+        }
+    }
+    std::fill(objectTransforms.yaw.begin(), objectTransforms.yaw.end(), time);
+    std::fill(objectTransforms.pitch.begin(), objectTransforms.pitch.end(), time * 0.5f);
+
+    static_assert(sizeof(Float4x4) == sizeof(XMFLOAT4X4), "Object MVPs are XMFLOAT4X4s");
+    Float4x4 viewProjection;
+    XMStoreFloat4x4(reinterpret_cast<XMFLOAT4X4*>(&viewProjection), viewProj);
+    transformEngine.Compose(objectTransforms, viewProjection, *workerScheduler, objectMvps.data(), sizeof(Float4x4));
+
+    const UINT visible = frustumCuller.Cull(ExtractFrustum(viewProjection), objectBounds, *workerScheduler, visibleObjects.data());
+    for (UINT i = 0; i < visible; i++) {
+        objectMvps[i] = objectMvps[visibleObjects[i]];
+    }
+
+    // The cubes' boxes as they turn: each world axis extent sums the scaled, rotated axes
+    const bool rebuild = objectBoxes.size() != objectCount;
+    objectBoxes.resize(objectCount);
+    for (UINT i = 0; i < objectCount; i++) {
+        const Float4x4 world = ObjectWorldMatrix(objectTransforms, i);
+        float extent[3];
+        for (int c = 0; c < 3; c++) {
+            extent[c] = std::fabs(world.m[0][c]) + std::fabs(world.m[1][c]) + std::fabs(world.m[2][c]);
+        }
+        objectBoxes[i] = { { world.m[3][0] - extent[0], world.m[3][1] - extent[1], world.m[3][2] - extent[2] },
+            { world.m[3][0] + extent[0], world.m[3][1] + extent[1], world.m[3][2] + extent[2] } };
+    }
+    if (rebuild) {
+        objectBvh.Build(objectBoxes, workerScheduler.get());
+    }
+    else {
+        objectBvh.Refit(objectBoxes, workerScheduler.get());
+    }
+    return visible;
+}
+
+// The object under a click, through the camera UpdateAndRender draws with
+void PickObject(int x, int y) {
+    const float ndcX = 2.0f * (x + 0.5f) / Width - 1.0f, ndcY = 1.0f - 2.0f * (y + 0.5f) / Height;
+    const Ray ray = MakePickRay({ 0.0f, 0.0f, -5.0f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f },
+        XMConvertToRadians(90.0f), (float)Width / (float)Height, ndcX, ndcY);
+    RayHit hit;
+    if (instanceCount == 0 && objectBvh.IntersectRay(ray, objectBoxes, hit)) {
+        std::cout << "Picked object " << hit.primitive << " at distance " << hit.t << std::endl;
+    }
+    else {
+        std::cout << "Nothing picked" << std::endl;
+    }
+}
 
 // Timer
 std::chrono::steady_clock::time_point startTime;
+float fixedTime = -1.0f; // --time T pins the animation, e.g. to compare against the golden images
 
 // Helper Functions
 void ThrowIfFailed(HRESULT hr) {
@@ -102,6 +289,9 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam) {
     case WM_PAINT:
         UpdateAndRender();
         break;
+    case WM_LBUTTONDOWN:
+        PickObject(static_cast<short>(LOWORD(lParam)), static_cast<short>(HIWORD(lParam)));
+        break;
     default:
         return DefWindowProc(hWnd, msg, wParam, lParam); // Correct default handling
     }
@@ -167,26 +357,18 @@ void LoadAssets() {
     }
 
     {
-		// Create a descriptor heap for the constant buffer view
+		// Constant buffer views for table-bound draws, handed out per frame by frameDescriptors;
+		// each points at that draw's upload ring allocation
 		D3D12_DESCRIPTOR_HEAP_DESC cbvHeapDesc = {};
-		cbvHeapDesc.NumDescriptors = 1;
+		cbvHeapDesc.NumDescriptors = MaxObjects * FramesInFlight;
 		cbvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
 		cbvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
 		ThrowIfFailed(device->CreateDescriptorHeap(&cbvHeapDesc, IID_PPV_ARGS(&shaderVisibleHeap)));
+		cbvDescriptorSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 
-		// Create the constant buffer resource
-		const UINT bufferSize = (sizeof(XMMATRIX) + 255) & ~255;
-		auto heapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-		auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize, D3D12_RESOURCE_FLAG_NONE);
-		ThrowIfFailed(device->CreateCommittedResource(
-			&heapProps, D3D12_HEAP_FLAG_NONE,
-			&bufferDesc,
-			D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&constantBuffer)));
-
-		// Create the constant buffer view
-		cbvDesc.BufferLocation = constantBuffer->GetGPUVirtualAddress();
-		cbvDesc.SizeInBytes = bufferSize;
-		device->CreateConstantBufferView(&cbvDesc, shaderVisibleHeap->GetCPUDescriptorHandleForHeapStart());
+		// The fence is created after LoadAssets; the ring only reads it from BeginFrame on
+		uploadRing = std::make_unique<UploadRing>(uploadDevice, frameFence, FramesInFlight,
+			UploadBytesPerFrame + objectCount * UploadRing::Alignment + static_cast<UINT64>(instanceCount) * sizeof(InstanceTransform));
     }
 }
 
@@ -291,13 +473,18 @@ void Initialize() {
     device->CreateDepthStencilView(depthStencilBuffer.Get(), &dsvDesc, dsvHandle);
 
     // Command Allocator
-    ThrowIfFailed(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&commandAllocator)));
+    for (UINT i = 0; i < FramesInFlight; i++) {
+        ThrowIfFailed(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&commandAllocator[i])));
+    }
 }
 
 void LoadShaderPipeline() {
     ComPtr<ID3DBlob> vs, ps;
-    ThrowIfFailed(D3DCompileFromFile(L"shader.hlsl", nullptr, nullptr, "VSMain", "vs_5_1", 0, 0, &vs, nullptr));
-    ThrowIfFailed(D3DCompileFromFile(L"shader.hlsl", nullptr, nullptr, "PSMain", "ps_5_1", 0, 0, &ps, nullptr));
+    // VSMain reads the MVP from the constant buffer --binding feeds: mvp1, mvp2 or mvp3
+    const char* mvpSources[MvpBindingCount] = { "mvp1", "mvp2", "mvp3" };
+    D3D_SHADER_MACRO defines[] = { { "MVP_SOURCE", mvpSources[static_cast<UINT>(mvpBinding)] }, { nullptr, nullptr } };
+    ThrowIfFailed(D3DCompileFromFile(L"shader.hlsl", defines, nullptr, "VSMain", "vs_5_1", 0, 0, &vs, nullptr));
+    ThrowIfFailed(D3DCompileFromFile(L"shader.hlsl", defines, nullptr, "PSMain", "ps_5_1", 0, 0, &ps, nullptr));
 
     // Root signature: root constant for MVP
     D3D12_ROOT_PARAMETER rootParams[3] = {};
@@ -361,17 +548,43 @@ void LoadShaderPipeline() {
     psoDesc.SampleDesc.Count = 1;
 
     ThrowIfFailed(device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&pipelineState)));
-    ThrowIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, commandAllocator.Get(), pipelineState.Get(), IID_PPV_ARGS(&commandList)));
+
+    if (instanceCount > 0) {
+        // Same root signature; view * projection goes in the root constants
+        ComPtr<ID3DBlob> instancedVs, instancedPs;
+        ThrowIfFailed(D3DCompileFromFile(L"shader_instanced.hlsl", nullptr, nullptr, "VSMain", "vs_5_1", 0, 0, &instancedVs, nullptr));
+        ThrowIfFailed(D3DCompileFromFile(L"shader_instanced.hlsl", nullptr, nullptr, "PSMain", "ps_5_1", 0, 0, &instancedPs, nullptr));
+
+        // Slot 1 advances once per instance: one InstanceTransform per cube
+        D3D12_INPUT_ELEMENT_DESC instancedLayout[] = {
+            { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+            { "COLOR",    0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+            { "WORLD",    0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
+            { "WORLD",    1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 16, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
+            { "WORLD",    2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 32, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 }
+        };
+        psoDesc.InputLayout = { instancedLayout, _countof(instancedLayout) };
+        psoDesc.VS = { instancedVs->GetBufferPointer(), instancedVs->GetBufferSize() };
+        psoDesc.PS = { instancedPs->GetBufferPointer(), instancedPs->GetBufferSize() };
+        ThrowIfFailed(device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&instancedPipelineState)));
+    }
+    ThrowIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, commandAllocator[0].Get(), pipelineState.Get(), IID_PPV_ARGS(&commandList)));
 	commandList->Close(); // Close the command list after creating it
 }
 
 // Main render loop
 void UpdateAndRender() {
-    // Reset the command allocator.  This is done at the beginning of each frame.
-    ThrowIfFailed(commandAllocator->Reset());
+    // Waits only if the GPU has not finished the frame that last used this frame context,
+    // which also retires the context's part of the upload ring
+    framePacer.BeginFrame();
+    uploadRing->BeginFrame();
+
+    // Reset the frame context's command allocator; the GPU is done with its commands
+    ID3D12CommandAllocator* allocator = commandAllocator[framePacer.FrameIndex()].Get();
+    ThrowIfFailed(allocator->Reset());
 
     // Reset the command list.
-    ThrowIfFailed(commandList->Reset(commandAllocator.Get(), pipelineState.Get()));
+    ThrowIfFailed(commandList->Reset(allocator, instanceCount > 0 ? instancedPipelineState.Get() : pipelineState.Get()));
 
     // Resource barriers for render target and depth stencil
     CD3DX12_RESOURCE_BARRIER rtBarrierBegin = CD3DX12_RESOURCE_BARRIER::Transition(
@@ -412,31 +625,54 @@ void UpdateAndRender() {
 
     // MVP Calculation
     auto now = std::chrono::steady_clock::now();
-    float time = std::chrono::duration<float>(now - startTime).count();
+    float time = fixedTime >= 0.0f ? fixedTime : std::chrono::duration<float>(now - startTime).count();
 
-    XMMATRIX model = XMMatrixRotationY(time) * XMMatrixRotationX(time * 0.5f);
     XMMATRIX view = XMMatrixLookAtLH({ 0.0f, 0.0f, -5.0f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f });
     XMMATRIX proj = XMMatrixPerspectiveFovLH(XMConvertToRadians(90.0f), (float)Width / (float)Height, 0.1f, 100.0f);
-    XMMATRIX mvp = model * view * proj;
-
-    // [The first MVP]
-    commandList->SetGraphicsRoot32BitConstants(0, sizeof(DirectX::XMMATRIX) / 4, &mvp, 0);
 
-	// [The second MVP]
-	UINT8* pData;
-	ThrowIfFailed(constantBuffer->Map(0, nullptr, reinterpret_cast<void**>(&pData)));
-	memcpy(pData, &mvp, sizeof(XMMATRIX));
-	constantBuffer->Unmap(0, nullptr);
-	commandList->SetGraphicsRootConstantBufferView(1, constantBuffer->GetGPUVirtualAddress());
-
-	// [The third MVP]
-	ID3D12DescriptorHeap* heaps[] = { shaderVisibleHeap.Get() };
-	commandList->SetDescriptorHeaps(1, heaps);
-	D3D12_GPU_DESCRIPTOR_HANDLE gpuHandle = shaderVisibleHeap->GetGPUDescriptorHandleForHeapStart();
-	commandList->SetGraphicsRootDescriptorTable(2, gpuHandle);
+    if (instanceCount > 0) {
+        // The instance stream, built across all cores straight into the upload ring
+        auto buildBegin = std::chrono::steady_clock::now();
+        const InstanceGrid grid = MakeInstanceGrid(instanceCount);
+        const UINT streamBytes = instanceCount * sizeof(InstanceTransform);
+        UploadRing::Allocation stream = uploadRing->Allocate(streamBytes);
+        instanceBuilder.Build(grid, time, *workerScheduler, reinterpret_cast<InstanceTransform*>(stream.cpuAddress));
+        submitSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - buildBegin).count();
+        if (++submitFrames == 600) {
+            std::cout << instanceCount << " instances: " << submitSeconds * 1e3 / submitFrames << " ms CPU per frame to build "
+                << streamBytes << " bytes of instance data" << std::endl;
+            submitSeconds = 0.0;
+            submitFrames = 0;
+        }
 
-    // Draw
-    commandList->DrawIndexedInstanced(_countof(cubeIndices), 1, 0, 0, 0);
+        D3D12_VERTEX_BUFFER_VIEW instanceView = {};
+        instanceView.BufferLocation = stream.gpuAddress;
+        instanceView.SizeInBytes = streamBytes;
+        instanceView.StrideInBytes = sizeof(InstanceTransform);
+        commandList->IASetVertexBuffers(1, 1, &instanceView);
+        XMMATRIX viewProj = view * proj;
+        commandList->SetGraphicsRoot32BitConstants(0, sizeof(DirectX::XMMATRIX) / 4, &viewProj, 0);
+        commandList->DrawIndexedInstanced(_countof(cubeIndices), instanceCount, 0, 0, 0);
+    }
+    else {
+        // [The first MVP] root constants, [The second MVP] a root CBV, [The third MVP] a descriptor
+        // table: every draw binds its matrix the one way --binding selected
+        const UINT drawCount = BuildObjectMvps(time, view * proj);
+        ID3D12DescriptorHeap* heaps[] = { shaderVisibleHeap.Get() };
+        commandList->SetDescriptorHeaps(1, heaps);
+        auto submitBegin = std::chrono::steady_clock::now();
+        UploadCursor cursor(*uploadRing);
+        D3D12MvpCommands commands;
+        SubmitMvpDraws(commands, mvpBinding, cursor, frameDescriptors, objectMvps.data(), drawCount, _countof(cubeIndices));
+        submitSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - submitBegin).count();
+        if (++submitFrames == 600) {
+            std::cout << MvpBindingName(mvpBinding) << ": " << submitSeconds * 1e9 / (static_cast<double>(submitFrames) * (drawCount > 0 ? drawCount : 1))
+                << " ns CPU per draw, " << drawCount << " of " << objectCount << " objects drawn, " << uploadRing->BytesUsed()
+                << " upload bytes per frame" << std::endl;
+            submitSeconds = 0.0;
+            submitFrames = 0;
+        }
+    }
 
     // Resource barrier for present
     CD3DX12_RESOURCE_BARRIER rtBarrierEnd = CD3DX12_RESOURCE_BARRIER::Transition(
@@ -451,13 +687,11 @@ void UpdateAndRender() {
     commandQueue->ExecuteCommandLists(1, cmdLists);
     ThrowIfFailed(swapChain->Present(1, 0));
 
-    // Fence and update frame index
-    fenceValue++;
+    // Tag the frame context with its fence value and move on without waiting for the GPU
+    const UINT64 fenceValue = framePacer.EndFrame();
     ThrowIfFailed(commandQueue->Signal(fence.Get(), fenceValue));
-    if (fence->GetCompletedValue() < fenceValue) {
-        ThrowIfFailed(fence->SetEventOnCompletion(fenceValue, fenceEvent));
-        WaitForSingleObject(fenceEvent, INFINITE);
-    }
+    uploadRing->EndFrame(fenceValue);
+    frameDescriptors.EndFrame(fenceValue);
     frameIndex = swapChain->GetCurrentBackBufferIndex();
 }
 
@@ -506,7 +740,38 @@ static void GetHardwareAdapter(
     }
 }
 
-int main() {
+int main(int argc, char** argv) {
+    // Other switches select the CPU rasterizer instead of the window; --time pins the animation,
+    // --binding constants|cbv|table and --objects K set up the binding benchmark, --instances N
+    // draws N cubes with one instanced draw
+    auto isWindowSwitch = [](const std::string& arg) {
+        return arg == "--time" || arg == "--binding" || arg == "--objects" || arg == "--instances";
+    };
+    if (argc > 1 && !isWindowSwitch(argv[1])) {
+        return RunHeadless(argc, argv);
+    }
+    for (int i = 1; i + 1 < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--time") {
+            fixedTime = std::stof(argv[++i]);
+        }
+        else if (arg == "--binding" && !ParseMvpBinding(argv[++i], mvpBinding)) {
+            std::cerr << "Unknown binding " << argv[i] << ", expected constants, cbv or table" << std::endl;
+            return 1;
+        }
+        else if (arg == "--objects") {
+            // windows.h defines min and max as macros
+            const unsigned long objects = std::stoul(argv[++i]);
+            objectCount = objects < 1 ? 1 : objects > MaxObjects ? MaxObjects : static_cast<UINT>(objects);
+        }
+        else if (arg == "--instances") {
+            const unsigned long instances = std::stoul(argv[++i]);
+            instanceCount = instances < 1 ? 1 : instances > MaxInstances ? MaxInstances : static_cast<UINT>(instances);
+        }
+    }
+
+    workerScheduler = std::make_unique<TaskScheduler>();
+
     std::cout << "Starting Direct3D 12 Cube Demo" << std::endl;
     HINSTANCE hInstance = GetModuleHandle(nullptr);
     InitWindow(hInstance);
@@ -532,6 +797,9 @@ int main() {
         //UpdateAndRender();
     }
 
+    // The GPU may still run the last frames in flight
+    framePacer.WaitForIdle();
+    uploadRing.reset();
     CloseHandle(fenceEvent);
     std::cout << "Exiting Direct3D 12 Cube Demo" << std::endl;
     return 0;
@@ -8,6 +8,11 @@ ConstantBuffer<MVPMatrix> mvp1 : register(b0);
 ConstantBuffer<MVPMatrix> mvp2 : register(b1);
 ConstantBuffer<MVPMatrix> mvp3 : register(b2);
 
+// The one VSMain reads; the application defines it to match the root parameter it binds
+#ifndef MVP_SOURCE
+#define MVP_SOURCE mvp3
+#endif
+
 struct VSInput {
     float3 pos : POSITION;
     float3 col : COLOR;
@@ -20,7 +25,7 @@ struct PSInput {
 
 PSInput VSMain(VSInput input) {
     PSInput output;
-    output.pos = mul(mvp3.m, float4(input.pos, 1.0));
+    output.pos = mul(MVP_SOURCE.m, float4(input.pos, 1.0));
     output.col = input.col;
     return output;
 }
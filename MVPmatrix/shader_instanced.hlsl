@@ -0,0 +1,35 @@
+// Instanced variant of shader.hlsl: one draw covers every cube. The second vertex stream
+// holds each cube's world matrix as three columns (InstanceTransform), and the root
+// constants at b0 hold view * projection.
+struct MVPMatrix
+{
+	matrix m;
+};
+
+ConstantBuffer<MVPMatrix> viewProjection : register(b0);
+
+struct VSInput {
+    float3 pos : POSITION;
+    float3 col : COLOR;
+    float4 world0 : WORLD0;
+    float4 world1 : WORLD1;
+    float4 world2 : WORLD2;
+};
+
+struct PSInput {
+    float4 pos : SV_POSITION;
+    float3 col : COLOR;
+};
+
+PSInput VSMain(VSInput input) {
+    PSInput output;
+    float4 local = float4(input.pos, 1.0);
+    float3 world = float3(dot(input.world0, local), dot(input.world1, local), dot(input.world2, local));
+    output.pos = mul(viewProjection.m, float4(world, 1.0));
+    output.col = input.col;
+    return output;
+}
+
+float4 PSMain(PSInput input) : SV_TARGET {
+    return float4(input.col, 1.0);
+}
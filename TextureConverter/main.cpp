@@ -0,0 +1,240 @@
+// Converts PNG, JPEG and whatever else stb_image reads into DDS or KTX2 files holding the
+// full mip chain, optionally block-compressed, so TextureLoader uploads them without
+// decoding anything. The defaults build the chain DescritorTable builds for block.png:
+// Kaiser filter in linear light, encoded as BC7. With a .pack output every input goes into
+// one TexturePack under its file name without the extension; DDS and KTX2 inputs are packed
+// as they are. A directory input stands for the image and container files in it.
+//
+//   TextureConverter [options] INPUT OUTPUT.dds|OUTPUT.ktx2
+//   TextureConverter [options] INPUT... DIR
+//   TextureConverter [options] INPUT... OUTPUT.pack
+//
+// On Linux build it with:
+//   g++ -std=c++17 -O2 -pthread main.cpp ../Common/BlockCompressor.cpp ../Common/CpuImage.cpp ../Common/ImageCompare.cpp ../Common/ImageFile.cpp ../Common/MipGenerator.cpp ../Common/SimdIsa.cpp ../Common/StbImage.cpp ../Common/SubresourceUpload.cpp ../Common/TaskScheduler.cpp ../Common/TextureContainer.cpp ../Common/TextureLoader.cpp ../Common/TexturePack.cpp ../Common/TimelineFence.cpp ../Common/UploadRing.cpp -o texture_converter
+#include "../Common/BlockCompressor.h"
+#include "../Common/CpuImage.h"
+#include "../Common/ImageCompare.h"
+#include "../Common/ImageFile.h"
+#include "../Common/MipGenerator.h"
+#include "../Common/TaskScheduler.h"
+#include "../Common/TextureContainer.h"
+#include "../Common/TexturePack.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    struct ConverterOptions {
+        TextureFormat format = TextureFormat::BC7;
+        BcQuality quality = BcQuality::Normal;
+        MipOptions mips;
+        ContainerType container = ContainerType::Dds;
+        unsigned threads = 0;
+        std::vector<std::string> inputs;
+        std::string output;
+    };
+
+    void PrintUsage() {
+        std::cout <<
+            "Usage: TextureConverter [options] INPUT OUTPUT.dds|OUTPUT.ktx2\n"
+            "       TextureConverter [options] INPUT... DIR\n"
+            "       TextureConverter [options] INPUT... OUTPUT.pack\n"
+            "  --format NAME    rgba8, bc1, bc3 or bc7 (default bc7)\n"
+            "  --quality NAME   encoder preset: fast, normal or best (default normal)\n"
+            "  --mips N         mip levels, 0 = full chain (default 0)\n"
+            "  --filter NAME    mip filter: box, kaiser or lanczos (default kaiser)\n"
+            "  --linear-mips    average color channels as stored instead of in linear light\n"
+            "  --container NAME dds or ktx2 for files written into DIR (default dds)\n"
+            "  --threads N      encoder threads, 0 = all cores (default 0)\n";
+    }
+
+    ConverterOptions ParseOptions(int argc, char** argv) {
+        ConverterOptions options;
+        options.mips.filter = MipFilter::Kaiser;
+        options.mips.srgb = true;
+        std::vector<std::string> paths;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            auto next = [&]() -> const char* {
+                if (i + 1 >= argc) {
+                    throw std::runtime_error("Missing value for " + arg);
+                }
+                return argv[++i];
+            };
+
+            if (arg == "--mips") options.mips.mipLevels = static_cast<uint32_t>(std::strtoul(next(), nullptr, 10));
+            else if (arg == "--linear-mips") options.mips.srgb = false;
+            else if (arg == "--threads") options.threads = static_cast<unsigned>(std::strtoul(next(), nullptr, 10));
+            else if (arg == "--format") {
+                const char* name = next();
+                if (!ParseTextureFormat(name, options.format)) {
+                    throw std::runtime_error(std::string("Unknown texture format ") + name);
+                }
+            }
+            else if (arg == "--quality") {
+                const char* name = next();
+                if (!ParseBcQuality(name, options.quality)) {
+                    throw std::runtime_error(std::string("Unknown encoder preset ") + name);
+                }
+            }
+            else if (arg == "--filter") {
+                const char* name = next();
+                if (!ParseMipFilter(name, options.mips.filter)) {
+                    throw std::runtime_error(std::string("Unknown mip filter ") + name);
+                }
+            }
+            else if (arg == "--container") {
+                const std::string name = next();
+                if (name == ContainerTypeName(ContainerType::Dds)) options.container = ContainerType::Dds;
+                else if (name == ContainerTypeName(ContainerType::Ktx2)) options.container = ContainerType::Ktx2;
+                else throw std::runtime_error("Unknown container " + name);
+            }
+            else if (arg.size() > 1 && arg[0] == '-') throw std::runtime_error("Unknown option " + arg);
+            else paths.push_back(arg);
+        }
+        if (paths.size() < 2) {
+            throw std::runtime_error("Need an input and an output");
+        }
+        options.output = paths.back();
+        paths.pop_back();
+        for (const std::string& path : paths) {
+            if (!std::filesystem::is_directory(path)) {
+                options.inputs.push_back(path);
+                continue;
+            }
+            std::vector<std::string> files;
+            for (const auto& entry : std::filesystem::directory_iterator(path)) {
+                std::string extension = entry.path().extension().string();
+                std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) {
+                    return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+                });
+                if (entry.is_regular_file() && (extension == ".png" || extension == ".jpg" || extension == ".jpeg" ||
+                    extension == ".dds" || extension == ".ktx2")) {
+                    files.push_back(entry.path().string());
+                }
+            }
+            std::sort(files.begin(), files.end());
+            options.inputs.insert(options.inputs.end(), files.begin(), files.end());
+        }
+        if (options.inputs.empty()) {
+            throw std::runtime_error("No input files");
+        }
+        return options;
+    }
+
+    bool IsPackPath(const std::string& path) {
+        std::string extension = std::filesystem::path(path).extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) {
+            return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        });
+        return extension == ".pack";
+    }
+
+    // Containers as they are, images through the mip generator and the encoder
+    TextureData ConvertTexture(const ConverterOptions& options, const std::string& input, const MipGenerator& mipGenerator,
+        TaskScheduler& scheduler) {
+        ContainerType type;
+        if (ContainerTypeOfPath(input, type)) {
+            return LoadTextureContainer(input);
+        }
+        std::vector<CpuImage> chain(1, LoadImageFile(input));
+        mipGenerator.Generate(chain, options.mips, &scheduler);
+        return BuildTextureData(chain, options.format, options.quality, &scheduler);
+    }
+
+    int WritePack(const ConverterOptions& options) {
+        TaskScheduler scheduler(options.threads);
+        const MipGenerator mipGenerator;
+        const auto begin = std::chrono::steady_clock::now();
+        try {
+            TexturePackWriter writer(options.output);
+            for (const std::string& input : options.inputs) {
+                writer.Add(std::filesystem::path(input).stem().string(), ConvertTexture(options, input, mipGenerator, scheduler));
+            }
+            const uint64_t bytes = writer.Finish();
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+            std::printf("%zu textures -> %s: %.1f MB in %.2f s\n", options.inputs.size(), options.output.c_str(),
+                bytes / 1048576.0, seconds);
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+}
+
+int main(int argc, char** argv) {
+    ConverterOptions options;
+    std::vector<std::string> outputs;
+    try {
+        options = ParseOptions(argc, argv);
+        ContainerType type;
+        if (IsPackPath(options.output)) {
+            // One file for everything; outputs stays empty
+        }
+        else if (options.inputs.size() == 1 && ContainerTypeOfPath(options.output, type)) {
+            outputs.push_back(options.output);
+        }
+        else {
+            std::filesystem::create_directories(options.output);
+            for (const std::string& input : options.inputs) {
+                std::filesystem::path path = std::filesystem::path(options.output) / std::filesystem::path(input).stem();
+                path += std::string(".") + ContainerTypeName(options.container);
+                outputs.push_back(path.string());
+            }
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        PrintUsage();
+        return 1;
+    }
+
+    if (IsPackPath(options.output)) {
+        return WritePack(options);
+    }
+
+    TaskScheduler scheduler(options.threads);
+    const MipGenerator mipGenerator;
+    uint32_t failed = 0;
+    for (size_t i = 0; i < options.inputs.size(); i++) {
+        try {
+            auto begin = std::chrono::steady_clock::now();
+            std::vector<CpuImage> chain(1, LoadImageFile(options.inputs[i]));
+            mipGenerator.Generate(chain, options.mips, &scheduler);
+            const double mipSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+            begin = std::chrono::steady_clock::now();
+            const TextureData texture = BuildTextureData(chain, options.format, options.quality, &scheduler);
+            const double encodeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+            SaveTextureContainer(outputs[i], texture);
+
+            uint64_t texels = 0;
+            for (const CpuImage& level : chain) {
+                texels += static_cast<uint64_t>(level.width) * level.height;
+            }
+            const ImageDifference difference = CompareImages(TextureLevelImage(texture, 0), chain[0], 0);
+            std::printf("%s -> %s: %ux%u, %u levels, %s, decode and mips %.1f ms, encode %.1f ms (%.2f Mpix/s), "
+                "PSNR %.2f dB, %llu bytes\n", options.inputs[i].c_str(), outputs[i].c_str(), texture.width,
+                texture.height, texture.MipLevels(), TextureFormatName(texture.format), mipSeconds * 1e3,
+                encodeSeconds * 1e3, texels / 1e6 / encodeSeconds, difference.psnr,
+                static_cast<unsigned long long>(std::filesystem::file_size(outputs[i])));
+        }
+        catch (const std::exception& e) {
+            std::cerr << options.inputs[i] << ": " << e.what() << std::endl;
+            failed++;
+        }
+    }
+    if (options.inputs.size() > 1) {
+        std::printf("%zu of %zu converted\n", options.inputs.size() - failed, options.inputs.size());
+    }
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,276 @@
+#include "CSMainSimd.h"
+#include "CpuCompute.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#if SIMD_X86
+#include <immintrin.h>
+#endif
+
+// Argument math has to stay unfused so it rounds exactly like the scalar reference
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+// GCC 12 reports its own _mm512_undefined_* placeholders as uninitialized
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+namespace {
+    // Scalar kernels, used as the baseline and on non-x86 hosts
+    namespace scalar {
+        void CoordTable(uint32_t origin, uint32_t count, float scale, float* coord) {
+            for (uint32_t i = 0; i < count; i++) {
+                coord[i] = static_cast<float>(origin + i) * scale;
+            }
+        }
+
+        void RedTable(float time, const float* u, uint32_t count, float* r) {
+            for (uint32_t i = 0; i < count; i++) {
+                r[i] = std::fabs(std::sin(u[i] * 20.0f + time));
+            }
+        }
+
+        void GreenTable(float time, const float* v, uint32_t count, float* g) {
+            for (uint32_t i = 0; i < count; i++) {
+                g[i] = std::fabs(std::cos(v[i] * 20.0f - time));
+            }
+        }
+
+        void BlueRow(float time, const float* u, float v, uint32_t count, float* b) {
+            for (uint32_t i = 0; i < count; i++) {
+                b[i] = std::sin(u[i] * v * 50.0f + time * 2.0f);
+            }
+        }
+
+        void PackTable(const float* values, uint32_t count, uint32_t shift, uint32_t bits, uint32_t* out) {
+            for (uint32_t i = 0; i < count; i++) {
+                out[i] = static_cast<uint32_t>(FloatToUnorm8(values[i])) << shift | bits;
+            }
+        }
+
+        void ShadeRow(float time, const float* u, float v, const uint32_t* redAlpha, uint32_t greenBits, uint32_t count, uint32_t* out) {
+            for (uint32_t i = 0; i < count; i++) {
+                float b = std::sin(u[i] * v * 50.0f + time * 2.0f);
+                out[i] = redAlpha[i] | greenBits | static_cast<uint32_t>(FloatToUnorm8(b)) << 16;
+            }
+        }
+    }
+
+#if SIMD_X86
+    namespace sse42 {
+#define SIMD_FN static inline SIMD_TARGET("sse4.2")
+#define SIMD_KERNEL static SIMD_TARGET("sse4.2")
+        using VecF = __m128;
+        using VecI = __m128i;
+        const uint32_t Lanes = 4;
+
+        SIMD_FN VecF Set1(float v) { return _mm_set1_ps(v); }
+        SIMD_FN VecF Iota() { return _mm_setr_ps(0, 1, 2, 3); }
+        SIMD_FN VecF Load(const float* p) { return _mm_loadu_ps(p); }
+        SIMD_FN void Store(float* p, VecF v) { _mm_storeu_ps(p, v); }
+        SIMD_FN VecF Add(VecF a, VecF b) { return _mm_add_ps(a, b); }
+        SIMD_FN VecF Sub(VecF a, VecF b) { return _mm_sub_ps(a, b); }
+        SIMD_FN VecF Mul(VecF a, VecF b) { return _mm_mul_ps(a, b); }
+        SIMD_FN VecF Div(VecF a, VecF b) { return _mm_div_ps(a, b); }
+        SIMD_FN VecF FMA(VecF a, VecF b, VecF c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+        SIMD_FN VecF Abs(VecF a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+        SIMD_FN VecF Round(VecF a) { return _mm_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+        SIMD_FN VecI ToInt(VecF a) { return _mm_cvtps_epi32(a); }
+        SIMD_FN VecI AddInt(VecI a, int b) { return _mm_add_epi32(a, _mm_set1_epi32(b)); }
+        SIMD_FN VecF SelectIfBit0(VecI q, VecF ifSet, VecF ifClear) {
+            VecI one = _mm_set1_epi32(1);
+            return _mm_blendv_ps(ifClear, ifSet, _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(q, one), one)));
+        }
+        SIMD_FN VecF NegateIfBit1(VecF v, VecI q) {
+            VecI sign = _mm_slli_epi32(_mm_and_si128(q, _mm_set1_epi32(2)), 30);
+            return _mm_xor_ps(v, _mm_castsi128_ps(sign));
+        }
+
+        SIMD_FN VecF Min(VecF a, VecF b) { return _mm_min_ps(a, b); }
+        SIMD_FN VecF Max(VecF a, VecF b) { return _mm_max_ps(a, b); }
+        SIMD_FN VecI TruncToInt(VecF a) { return _mm_cvttps_epi32(a); }
+        SIMD_FN VecI SetInt(uint32_t v) { return _mm_set1_epi32(static_cast<int>(v)); }
+        SIMD_FN VecI LoadInt(const uint32_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+        SIMD_FN void StoreInt(uint32_t* p, VecI v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+        SIMD_FN VecI OrInt(VecI a, VecI b) { return _mm_or_si128(a, b); }
+        SIMD_FN VecI ShiftLeft(VecI a, uint32_t bits) { return _mm_sll_epi32(a, _mm_cvtsi32_si128(static_cast<int>(bits))); }
+
+#include "CSMainSimdKernel.inl"
+#undef SIMD_FN
+#undef SIMD_KERNEL
+    }
+
+    namespace avx2 {
+#define SIMD_FN static inline SIMD_TARGET("avx2,fma")
+#define SIMD_KERNEL static SIMD_TARGET("avx2,fma")
+        using VecF = __m256;
+        using VecI = __m256i;
+        const uint32_t Lanes = 8;
+
+        SIMD_FN VecF Set1(float v) { return _mm256_set1_ps(v); }
+        SIMD_FN VecF Iota() { return _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7); }
+        SIMD_FN VecF Load(const float* p) { return _mm256_loadu_ps(p); }
+        SIMD_FN void Store(float* p, VecF v) { _mm256_storeu_ps(p, v); }
+        SIMD_FN VecF Add(VecF a, VecF b) { return _mm256_add_ps(a, b); }
+        SIMD_FN VecF Sub(VecF a, VecF b) { return _mm256_sub_ps(a, b); }
+        SIMD_FN VecF Mul(VecF a, VecF b) { return _mm256_mul_ps(a, b); }
+        SIMD_FN VecF Div(VecF a, VecF b) { return _mm256_div_ps(a, b); }
+        SIMD_FN VecF FMA(VecF a, VecF b, VecF c) { return _mm256_fmadd_ps(a, b, c); }
+        SIMD_FN VecF Abs(VecF a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+        SIMD_FN VecF Round(VecF a) { return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+        SIMD_FN VecI ToInt(VecF a) { return _mm256_cvtps_epi32(a); }
+        SIMD_FN VecI AddInt(VecI a, int b) { return _mm256_add_epi32(a, _mm256_set1_epi32(b)); }
+        SIMD_FN VecF SelectIfBit0(VecI q, VecF ifSet, VecF ifClear) {
+            VecI one = _mm256_set1_epi32(1);
+            return _mm256_blendv_ps(ifClear, ifSet, _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(q, one), one)));
+        }
+        SIMD_FN VecF NegateIfBit1(VecF v, VecI q) {
+            VecI sign = _mm256_slli_epi32(_mm256_and_si256(q, _mm256_set1_epi32(2)), 30);
+            return _mm256_xor_ps(v, _mm256_castsi256_ps(sign));
+        }
+
+        SIMD_FN VecF Min(VecF a, VecF b) { return _mm256_min_ps(a, b); }
+        SIMD_FN VecF Max(VecF a, VecF b) { return _mm256_max_ps(a, b); }
+        SIMD_FN VecI TruncToInt(VecF a) { return _mm256_cvttps_epi32(a); }
+        SIMD_FN VecI SetInt(uint32_t v) { return _mm256_set1_epi32(static_cast<int>(v)); }
+        SIMD_FN VecI LoadInt(const uint32_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+        SIMD_FN void StoreInt(uint32_t* p, VecI v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+        SIMD_FN VecI OrInt(VecI a, VecI b) { return _mm256_or_si256(a, b); }
+        SIMD_FN VecI ShiftLeft(VecI a, uint32_t bits) { return _mm256_sll_epi32(a, _mm_cvtsi32_si128(static_cast<int>(bits))); }
+
+#include "CSMainSimdKernel.inl"
+#undef SIMD_FN
+#undef SIMD_KERNEL
+    }
+
+    namespace avx512 {
+#define SIMD_FN static inline SIMD_TARGET("avx512f")
+#define SIMD_KERNEL static SIMD_TARGET("avx512f")
+        using VecF = __m512;
+        using VecI = __m512i;
+        const uint32_t Lanes = 16;
+
+        SIMD_FN VecF Set1(float v) { return _mm512_set1_ps(v); }
+        SIMD_FN VecF Iota() { return _mm512_setr_ps(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15); }
+        SIMD_FN VecF Load(const float* p) { return _mm512_loadu_ps(p); }
+        SIMD_FN void Store(float* p, VecF v) { _mm512_storeu_ps(p, v); }
+        SIMD_FN VecF Add(VecF a, VecF b) { return _mm512_add_ps(a, b); }
+        SIMD_FN VecF Sub(VecF a, VecF b) { return _mm512_sub_ps(a, b); }
+        SIMD_FN VecF Mul(VecF a, VecF b) { return _mm512_mul_ps(a, b); }
+        SIMD_FN VecF Div(VecF a, VecF b) { return _mm512_div_ps(a, b); }
+        SIMD_FN VecF FMA(VecF a, VecF b, VecF c) { return _mm512_fmadd_ps(a, b, c); }
+        SIMD_FN VecF Abs(VecF a) {
+            return _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(a), _mm512_set1_epi32(0x7fffffff)));
+        }
+        SIMD_FN VecF Round(VecF a) { return _mm512_roundscale_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+        SIMD_FN VecI ToInt(VecF a) { return _mm512_cvtps_epi32(a); }
+        SIMD_FN VecI AddInt(VecI a, int b) { return _mm512_add_epi32(a, _mm512_set1_epi32(b)); }
+        SIMD_FN VecF SelectIfBit0(VecI q, VecF ifSet, VecF ifClear) {
+            return _mm512_mask_blend_ps(_mm512_test_epi32_mask(q, _mm512_set1_epi32(1)), ifClear, ifSet);
+        }
+        SIMD_FN VecF NegateIfBit1(VecF v, VecI q) {
+            VecI sign = _mm512_slli_epi32(_mm512_and_si512(q, _mm512_set1_epi32(2)), 30);
+            return _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(v), sign));
+        }
+
+        SIMD_FN VecF Min(VecF a, VecF b) { return _mm512_min_ps(a, b); }
+        SIMD_FN VecF Max(VecF a, VecF b) { return _mm512_max_ps(a, b); }
+        SIMD_FN VecI TruncToInt(VecF a) { return _mm512_cvttps_epi32(a); }
+        SIMD_FN VecI SetInt(uint32_t v) { return _mm512_set1_epi32(static_cast<int>(v)); }
+        SIMD_FN VecI LoadInt(const uint32_t* p) { return _mm512_loadu_si512(p); }
+        SIMD_FN void StoreInt(uint32_t* p, VecI v) { _mm512_storeu_si512(p, v); }
+        SIMD_FN VecI OrInt(VecI a, VecI b) { return _mm512_or_si512(a, b); }
+        SIMD_FN VecI ShiftLeft(VecI a, uint32_t bits) { return _mm512_sll_epi32(a, _mm_cvtsi32_si128(static_cast<int>(bits))); }
+
+#include "CSMainSimdKernel.inl"
+#undef SIMD_FN
+#undef SIMD_KERNEL
+    }
+#endif
+
+    const CSMainKernels scalarKernels = { scalar::CoordTable, scalar::RedTable, scalar::GreenTable, scalar::BlueRow,
+        scalar::PackTable, scalar::ShadeRow };
+#if SIMD_X86
+    const CSMainKernels sse42Kernels = { sse42::CoordTable, sse42::RedTable, sse42::GreenTable, sse42::BlueRow,
+        sse42::PackTable, sse42::ShadeRow };
+    const CSMainKernels avx2Kernels = { avx2::CoordTable, avx2::RedTable, avx2::GreenTable, avx2::BlueRow,
+        avx2::PackTable, avx2::ShadeRow };
+    const CSMainKernels avx512Kernels = { avx512::CoordTable, avx512::RedTable, avx512::GreenTable, avx512::BlueRow,
+        avx512::PackTable, avx512::ShadeRow };
+#endif
+
+    // Distance between two floats in representable values
+    uint32_t UlpDistance(float a, float b) {
+        int32_t ia, ib;
+        std::memcpy(&ia, &a, sizeof(ia));
+        std::memcpy(&ib, &b, sizeof(ib));
+        if (ia < 0) ia = INT32_MIN - ia;
+        if (ib < 0) ib = INT32_MIN - ib;
+        return static_cast<uint32_t>(std::abs(static_cast<int64_t>(ia) - ib));
+    }
+}
+
+const CSMainKernels& GetCSMainKernels(SimdIsa isa) {
+#if SIMD_X86
+    switch (isa) {
+    case SimdIsa::SSE42: return sse42Kernels;
+    case SimdIsa::AVX2: return avx2Kernels;
+    case SimdIsa::AVX512: return avx512Kernels;
+    default: break;
+    }
+#endif
+    return scalarKernels;
+}
+
+CSMainAccuracy MeasureCSMainAccuracy(SimdIsa isa, const ComputeParams& params) {
+    const CSMainKernels& kernels = GetCSMainKernels(isa);
+    const uint32_t width = params.resolution[0];
+    const uint32_t height = params.resolution[1];
+    std::vector<float> u(SimdPaddedCount(width));
+    std::vector<float> v(SimdPaddedCount(height));
+    std::vector<float> red(SimdPaddedCount(width));
+    std::vector<float> green(SimdPaddedCount(height));
+    std::vector<float> blue(SimdPaddedCount(width));
+
+    kernels.coordTable(0, width, params.invWidth, u.data());
+    kernels.coordTable(0, height, params.invWidth, v.data());
+    kernels.redTable(params.time, u.data(), width, red.data());
+    kernels.greenTable(params.time, v.data(), height, green.data());
+
+    CSMainAccuracy accuracy;
+    for (uint32_t y = 0; y < height; y++) {
+        kernels.blueRow(params.time, u.data(), v[y], width, blue.data());
+        for (uint32_t x = 0; x < width; x++) {
+            float reference[4];
+            CSMainReference(x, y, params, reference);
+            accuracy.maxUlpR = std::max(accuracy.maxUlpR, UlpDistance(red[x], reference[0]));
+            accuracy.maxUlpG = std::max(accuracy.maxUlpG, UlpDistance(green[y], reference[1]));
+            accuracy.maxUlpB = std::max(accuracy.maxUlpB, UlpDistance(blue[x], reference[2]));
+        }
+    }
+    return accuracy;
+}
+
+uint64_t CountUnormPackingMismatches(SimdIsa isa) {
+    const CSMainKernels& kernels = GetCSMainKernels(isa);
+    const uint32_t chunk = 1u << 16;
+    std::vector<float> values(chunk);
+    std::vector<uint32_t> packed(chunk);
+
+    uint64_t mismatches = 0;
+    for (uint64_t base = 0; base < (1ull << 32); base += chunk) {
+        for (uint32_t i = 0; i < chunk; i++) {
+            uint32_t bits = static_cast<uint32_t>(base + i);
+            std::memcpy(&values[i], &bits, sizeof(bits));
+        }
+        kernels.packTable(values.data(), chunk, 0, 0, packed.data());
+        for (uint32_t i = 0; i < chunk; i++) {
+            mismatches += packed[i] != FloatToUnorm8(values[i]);
+        }
+    }
+    return mismatches;
+}
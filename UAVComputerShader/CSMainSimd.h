@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include "../Common/SimdIsa.h"
+
+struct ComputeParams;
+
+// Widest vector any kernel uses; row buffers must be padded to a multiple of this.
+const uint32_t SimdMaxLanes = 16;
+
+inline uint32_t SimdPaddedCount(uint32_t count) {
+    return (count + SimdMaxLanes - 1) & ~(SimdMaxLanes - 1);
+}
+
+// CSMain split into its separable parts: r only depends on x and g only on y,
+// so they are evaluated once per column/row; only b needs a sine per pixel.
+// All outputs are written in whole vectors, i.e. up to SimdPaddedCount(count).
+struct CSMainKernels {
+    // coord[i] = (origin + i) * scale, the uv value of column or row origin + i
+    void (*coordTable)(uint32_t origin, uint32_t count, float scale, float* coord);
+    // r[i] = abs(sin(u[i] * 20.0f + Time))
+    void (*redTable)(float time, const float* u, uint32_t count, float* r);
+    // g[i] = abs(cos(v[i] * 20.0f - Time))
+    void (*greenTable)(float time, const float* v, uint32_t count, float* g);
+    // b[i] = sin(u[i] * v * 50.0f + Time * 2.0f)
+    void (*blueRow)(float time, const float* u, float v, uint32_t count, float* b);
+    // out[i] = FloatToUnorm8(values[i]) << shift | bits
+    void (*packTable)(const float* values, uint32_t count, uint32_t shift, uint32_t bits, uint32_t* out);
+    // Final R8G8B8A8 pixels straight from registers: out[i] = redAlpha[i] | greenBits | UNORM8(b[i]) << 16.
+    // Unlike the other kernels this writes exactly `count` pixels, so it can target image rows.
+    void (*shadeRow)(float time, const float* u, float v, const uint32_t* redAlpha, uint32_t greenBits, uint32_t count, uint32_t* out);
+};
+
+const CSMainKernels& GetCSMainKernels(SimdIsa isa);
+
+// Max error in ULPs of each channel against the libm scalar reference (CSMainReference).
+struct CSMainAccuracy {
+    uint32_t maxUlpR = 0;
+    uint32_t maxUlpG = 0;
+    uint32_t maxUlpB = 0;
+};
+
+CSMainAccuracy MeasureCSMainAccuracy(SimdIsa isa, const ComputeParams& params);
+
+// Runs every float bit pattern through the ISA's packTable and returns how many
+// results differ from the scalar FloatToUnorm8.
+uint64_t CountUnormPackingMismatches(SimdIsa isa);
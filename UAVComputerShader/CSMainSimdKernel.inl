@@ -0,0 +1,112 @@
+// CSMain kernels written once against a small vector vocabulary.
+// CSMainSimd.cpp includes this file inside one namespace per instruction set after
+// defining VecF, VecI, Lanes, SIMD_FN and the primitives used below.
+
+// Cody-Waite reduction by pi/2: returns a - q * pi/2 in [-pi/4, pi/4] and the quadrant q.
+SIMD_FN VecF ReduceHalfPi(VecF a, VecI& quadrant) {
+    VecF q = Round(Mul(a, Set1(0.636619772367581343f)));
+    quadrant = ToInt(q);
+    VecF r = FMA(q, Set1(-1.5703125f), a);
+    r = FMA(q, Set1(-4.837512969970703125e-4f), r);
+    r = FMA(q, Set1(-7.54978995489188216e-8f), r);
+    return r;
+}
+
+// sin(r + quadrant * pi/2) for a reduced r, using the cephes minimax polynomials.
+SIMD_FN VecF SinQuadrant(VecF r, VecI quadrant) {
+    VecF r2 = Mul(r, r);
+
+    VecF s = FMA(Set1(-1.9515295891e-4f), r2, Set1(8.3321608736e-3f));
+    s = FMA(s, r2, Set1(-1.6666654611e-1f));
+    s = FMA(Mul(s, r2), r, r);
+
+    VecF c = FMA(Set1(2.443315711809948e-5f), r2, Set1(-1.388731625493765e-3f));
+    c = FMA(c, r2, Set1(4.166664568298827e-2f));
+    c = FMA(Mul(c, r2), r2, FMA(Set1(-0.5f), r2, Set1(1.0f)));
+
+    // Odd quadrants use cos, quadrants 2 and 3 are negated
+    return NegateIfBit1(SelectIfBit0(quadrant, c, s), quadrant);
+}
+
+SIMD_FN VecF Sin(VecF a) {
+    VecI quadrant;
+    VecF r = ReduceHalfPi(a, quadrant);
+    return SinQuadrant(r, quadrant);
+}
+
+SIMD_FN VecF Cos(VecF a) {
+    VecI quadrant;
+    VecF r = ReduceHalfPi(a, quadrant);
+    return SinQuadrant(r, AddInt(quadrant, 1));
+}
+
+// Arguments are formed with separate multiply and add so they round exactly like
+// the scalar reference; FMA is only used inside the polynomial.
+SIMD_KERNEL void CoordTable(uint32_t origin, uint32_t count, float scale, float* coord) {
+    for (uint32_t i = 0; i < count; i += Lanes) {
+        VecF index = Add(Set1(static_cast<float>(origin + i)), Iota());
+        Store(coord + i, Mul(index, Set1(scale)));
+    }
+}
+
+SIMD_KERNEL void RedTable(float time, const float* u, uint32_t count, float* r) {
+    VecF t = Set1(time);
+    for (uint32_t i = 0; i < count; i += Lanes) {
+        VecF arg = Add(Mul(Load(u + i), Set1(20.0f)), t);
+        Store(r + i, Abs(Sin(arg)));
+    }
+}
+
+SIMD_KERNEL void GreenTable(float time, const float* v, uint32_t count, float* g) {
+    VecF t = Set1(time);
+    for (uint32_t i = 0; i < count; i += Lanes) {
+        VecF arg = Sub(Mul(Load(v + i), Set1(20.0f)), t);
+        Store(g + i, Abs(Cos(arg)));
+    }
+}
+
+SIMD_KERNEL void BlueRow(float time, const float* u, float v, uint32_t count, float* b) {
+    VecF vv = Set1(v);
+    VecF t2 = Set1(time * 2.0f);
+    for (uint32_t i = 0; i < count; i += Lanes) {
+        VecF arg = Add(Mul(Mul(Load(u + i), vv), Set1(50.0f)), t2);
+        Store(b + i, Sin(arg));
+    }
+}
+
+// D3D FLOAT -> UNORM: Max(v, 0) returns its second operand for NaN, so NaN and negative
+// values both become 0; then saturate, scale, add 0.5 and truncate.
+SIMD_FN VecI ToUnorm8(VecF v) {
+    v = Min(Max(v, Set1(0.0f)), Set1(1.0f));
+    return TruncToInt(Add(Mul(v, Set1(255.0f)), Set1(0.5f)));
+}
+
+SIMD_KERNEL void PackTable(const float* values, uint32_t count, uint32_t shift, uint32_t bits, uint32_t* out) {
+    VecI orBits = SetInt(bits);
+    for (uint32_t i = 0; i < count; i += Lanes) {
+        StoreInt(out + i, OrInt(ShiftLeft(ToUnorm8(Load(values + i)), shift), orBits));
+    }
+}
+
+SIMD_FN VecI ShadePixels(VecF u, VecF v, VecF time2, VecI redAlpha, VecI green) {
+    VecF b = Sin(Add(Mul(Mul(u, v), Set1(50.0f)), time2));
+    return OrInt(OrInt(redAlpha, green), ShiftLeft(ToUnorm8(b), 16));
+}
+
+SIMD_KERNEL void ShadeRow(float time, const float* u, float v, const uint32_t* redAlpha, uint32_t greenBits, uint32_t count, uint32_t* out) {
+    VecF vv = Set1(v);
+    VecF t2 = Set1(time * 2.0f);
+    VecI green = SetInt(greenBits);
+
+    uint32_t i = 0;
+    for (; i + Lanes <= count; i += Lanes) {
+        StoreInt(out + i, ShadePixels(Load(u + i), vv, t2, LoadInt(redAlpha + i), green));
+    }
+
+    // The inputs are padded but the image row is not
+    if (i < count) {
+        uint32_t tail[Lanes];
+        StoreInt(tail, ShadePixels(Load(u + i), vv, t2, LoadInt(redAlpha + i), green));
+        std::memcpy(out + i, tail, (count - i) * sizeof(uint32_t));
+    }
+}
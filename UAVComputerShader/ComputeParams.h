@@ -0,0 +1,22 @@
+#pragma once
+#include <cstdint>
+
+// Root constants for CSMain, laid out like the ComputeParams cbuffer in shader.hlsl.
+struct ComputeParams {
+    uint32_t resolution[2];     // Full output size in pixels
+    float invWidth;             // 1 / width; uv = pixel * InvWidth on both axes, so the pattern keeps its aspect
+    float time;
+    uint32_t tileOrigin[2];     // Pixel that SV_DispatchThreadID (0, 0) maps to
+};
+
+const uint32_t ComputeParamsNum32BitValues = sizeof(ComputeParams) / 4;
+static_assert(sizeof(ComputeParams) == 24, "ComputeParams must match the HLSL cbuffer packing");
+
+inline ComputeParams MakeComputeParams(uint32_t width, uint32_t height, float time) {
+    ComputeParams params = {};
+    params.resolution[0] = width;
+    params.resolution[1] = height;
+    params.invWidth = 1.0f / static_cast<float>(width);
+    params.time = time;
+    return params;
+}
@@ -0,0 +1,72 @@
+#include "CpuCompute.h"
+#include "../Common/TaskScheduler.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+void CSMainReference(uint32_t x, uint32_t y, const ComputeParams& params, float rgba[4]) {
+    const float time = params.time;
+    float u = static_cast<float>(params.tileOrigin[0] + x) * params.invWidth;
+    float v = static_cast<float>(params.tileOrigin[1] + y) * params.invWidth;
+    rgba[0] = std::fabs(std::sin(u * 20.0f + time));
+    rgba[1] = std::fabs(std::cos(v * 20.0f - time));
+    rgba[2] = std::sin(u * v * 50.0f + time * 2.0f);
+    rgba[3] = 1.0f;
+}
+
+CpuComputeEngine::CpuComputeEngine(TaskScheduler& scheduler, SimdIsa isa)
+    : scheduler(scheduler), isa(isa), kernels(GetCSMainKernels(isa)) {
+}
+
+void CpuComputeEngine::PrepareTables(const ComputeParams& params, uint32_t width, uint32_t height) {
+    uTable.resize(SimdPaddedCount(width));
+    vTable.resize(SimdPaddedCount(height));
+    redTable.resize(SimdPaddedCount(width));
+    greenTable.resize(SimdPaddedCount(height));
+    redAlphaBits.resize(SimdPaddedCount(width));
+    greenBits.resize(SimdPaddedCount(height));
+
+    kernels.coordTable(params.tileOrigin[0], width, params.invWidth, uTable.data());
+    kernels.coordTable(params.tileOrigin[1], height, params.invWidth, vTable.data());
+    kernels.redTable(params.time, uTable.data(), width, redTable.data());
+    kernels.greenTable(params.time, vTable.data(), height, greenTable.data());
+
+    // Alpha is always 1.0, so it rides along with the red byte
+    kernels.packTable(redTable.data(), width, 0, 0xff000000u, redAlphaBits.data());
+    kernels.packTable(greenTable.data(), height, 8, 0, greenBits.data());
+}
+
+void CpuComputeEngine::Dispatch(const ComputeParams& params, CpuImage& output) {
+    if (params.resolution[0] > MaxDimension || params.resolution[1] > MaxDimension) {
+        throw std::runtime_error("CSMain resolution exceeds 16384x16384");
+    }
+
+    // Clip the output rectangle against the frame, as the shader's bounds check does
+    const uint32_t originX = params.tileOrigin[0];
+    const uint32_t originY = params.tileOrigin[1];
+    const uint32_t width = std::min(output.width, params.resolution[0] > originX ? params.resolution[0] - originX : 0);
+    const uint32_t height = std::min(output.height, params.resolution[1] > originY ? params.resolution[1] - originY : 0);
+    if (width == 0 || height == 0) {
+        return;
+    }
+
+    PrepareTables(params, width, height);
+
+    const uint32_t tilesX = (width + TileWidth - 1) / TileWidth;
+    const uint32_t tilesY = (height + TileHeight - 1) / TileHeight;
+    const float time = params.time;
+
+    scheduler.ParallelFor(tilesX * tilesY, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t tile = begin; tile < end; tile++) {
+            uint32_t x0 = (tile % tilesX) * TileWidth;
+            uint32_t y0 = (tile / tilesX) * TileHeight;
+            uint32_t x1 = std::min(x0 + TileWidth, width);
+            uint32_t y1 = std::min(y0 + TileHeight, height);
+
+            for (uint32_t y = y0; y < y1; y++) {
+                uint32_t* row = reinterpret_cast<uint32_t*>(output.Row(y));
+                kernels.shadeRow(time, &uTable[x0], vTable[y], &redAlphaBits[x0], greenBits[y], x1 - x0, row + x0);
+            }
+        }
+    });
+}
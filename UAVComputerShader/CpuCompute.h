@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "ComputeParams.h"
+#include "CSMainSimd.h"
+#include "../Common/CpuImage.h"
+
+class TaskScheduler;
+
+// Scalar port of CSMain for a single SV_DispatchThreadID; writes float4(r, g, b, 1).
+// Threads outside params.resolution are not bounds-checked here.
+void CSMainReference(uint32_t x, uint32_t y, const ComputeParams& params, float rgba[4]);
+
+// Executes CSMain on the CPU. Work is split into tiles small enough that a tile's
+// output and its row tables stay in cache, rather than into 8x8 thread groups.
+class CpuComputeEngine {
+public:
+    static const uint32_t GroupSize = 8;
+    static const uint32_t TileWidth = 256;
+    static const uint32_t TileHeight = 32;
+    // D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION
+    static const uint32_t MaxDimension = 16384;
+
+    CpuComputeEngine(TaskScheduler& scheduler, SimdIsa isa = DetectSimdIsa());
+
+    SimdIsa Isa() const { return isa; }
+
+    // Equivalent of SetComputeRoot32BitConstants(0, ComputeParamsNum32BitValues, &params, 0)
+    // followed by a dispatch covering `output`, whose pixel (0, 0) is params.tileOrigin.
+    // Pixels at or beyond params.resolution are left untouched, like the shader's bounds check.
+    void Dispatch(const ComputeParams& params, CpuImage& output);
+
+private:
+    void PrepareTables(const ComputeParams& params, uint32_t width, uint32_t height);
+
+    TaskScheduler& scheduler;
+    SimdIsa isa;
+    const CSMainKernels& kernels;
+
+    // Per-dispatch tables: uv coordinates, then r per column and g per row both as
+    // floats and already packed into their bytes of the output pixel
+    std::vector<float> uTable;
+    std::vector<float> vTable;
+    std::vector<float> redTable;
+    std::vector<float> greenTable;
+    std::vector<uint32_t> redAlphaBits;
+    std::vector<uint32_t> greenBits;
+};
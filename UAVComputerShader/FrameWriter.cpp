@@ -0,0 +1,158 @@
+#include "FrameWriter.h"
+#include <stdexcept>
+
+FrameWriter::FrameWriter(const std::string& path, FrameFileFormat format, uint32_t width, uint32_t height, uint32_t framesPerSecond)
+    : format(format) {
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        throw std::runtime_error("Failed to open " + path);
+    }
+    // Frames are written whole, a large stdio buffer only adds a copy
+    std::setvbuf(file, nullptr, _IONBF, 0);
+
+    for (auto& frame : frames) {
+        frame.Resize(width, height);
+    }
+
+    if (format == FrameFileFormat::Y4M) {
+        planes.resize(static_cast<size_t>(width) * height * 3);
+        int length = std::fprintf(file, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C444 XCOLORRANGE=LIMITED\n",
+            width, height, framesPerSecond);
+        if (length < 0) {
+            std::fclose(file);
+            throw std::runtime_error("Failed to write Y4M header to " + path);
+        }
+        bytesWritten += static_cast<uint64_t>(length);
+    }
+
+    writerThread = std::thread(&FrameWriter::WriterLoop, this);
+}
+
+FrameWriter::~FrameWriter() {
+    try {
+        Close();
+    }
+    catch (...) {
+    }
+}
+
+FrameFileFormat FrameWriter::FormatFromPath(const std::string& path) {
+    const std::string extension = ".y4m";
+    if (path.size() >= extension.size() &&
+        path.compare(path.size() - extension.size(), extension.size(), extension) == 0) {
+        return FrameFileFormat::Y4M;
+    }
+    return FrameFileFormat::Raw;
+}
+
+CpuImage& FrameWriter::AcquireFrame() {
+    std::unique_lock<std::mutex> lock(mutex);
+    frameWritten.wait(lock, [this] { return !queued[acquireIndex] || !error.empty(); });
+    if (!error.empty()) {
+        throw std::runtime_error(error);
+    }
+    acquired = true;
+    return frames[acquireIndex];
+}
+
+void FrameWriter::SubmitFrame() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!acquired) {
+            throw std::runtime_error("SubmitFrame called without AcquireFrame");
+        }
+        queued[acquireIndex] = true;
+        acquireIndex = (acquireIndex + 1) % BufferCount;
+        acquired = false;
+    }
+    frameQueued.notify_one();
+}
+
+void FrameWriter::Close() {
+    if (!writerThread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closing = true;
+    }
+    frameQueued.notify_one();
+    writerThread.join();
+
+    if (std::fclose(file) != 0 && error.empty()) {
+        error = "Failed to close frame file";
+    }
+    file = nullptr;
+    ThrowIfWriteFailed();
+}
+
+void FrameWriter::ThrowIfWriteFailed() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!error.empty()) {
+        throw std::runtime_error(error);
+    }
+}
+
+void FrameWriter::WriterLoop() {
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            frameQueued.wait(lock, [this] { return queued[writeIndex] || closing; });
+            if (!queued[writeIndex]) {
+                return;
+            }
+        }
+
+        // The buffer stays owned by the writer until it is marked free again;
+        // after a failed write the remaining frames are only drained
+        if (error.empty()) {
+            WriteFrame(frames[writeIndex]);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queued[writeIndex] = false;
+            writeIndex = (writeIndex + 1) % BufferCount;
+        }
+        frameWritten.notify_one();
+    }
+}
+
+void FrameWriter::WriteFrame(const CpuImage& frame) {
+    const uint8_t* data = frame.pixels.data();
+    size_t size = frame.pixels.size();
+
+    if (format == FrameFileFormat::Y4M) {
+        static const char frameHeader[] = "FRAME\n";
+        const size_t planeSize = static_cast<size_t>(frame.width) * frame.height;
+        uint8_t* y = planes.data();
+        uint8_t* u = y + planeSize;
+        uint8_t* v = u + planeSize;
+
+        // BT.601 limited range in 8-bit fixed point
+        for (size_t i = 0; i < planeSize; i++) {
+            int r = frame.pixels[i * 4 + 0];
+            int g = frame.pixels[i * 4 + 1];
+            int b = frame.pixels[i * 4 + 2];
+            y[i] = static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+            u[i] = static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+            v[i] = static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+
+        if (std::fwrite(frameHeader, 1, sizeof(frameHeader) - 1, file) != sizeof(frameHeader) - 1) {
+            std::lock_guard<std::mutex> lock(mutex);
+            error = "Failed to write frame";
+            return;
+        }
+        bytesWritten += sizeof(frameHeader) - 1;
+        data = planes.data();
+        size = planes.size();
+    }
+
+    if (std::fwrite(data, 1, size, file) != size) {
+        std::lock_guard<std::mutex> lock(mutex);
+        error = "Failed to write frame";
+        return;
+    }
+    bytesWritten += size;
+}
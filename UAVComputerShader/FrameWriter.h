@@ -0,0 +1,65 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "CpuCompute.h"
+
+enum class FrameFileFormat {
+    Raw,    // Consecutive R8G8B8A8 frames, no header
+    Y4M,    // YUV4MPEG2, 4:4:4 BT.601 limited range
+};
+
+// Streams a sequence of frames into one file from a dedicated writer thread.
+// Two frame buffers are allocated up front and recycled: the caller renders into one
+// while the other is being converted and written, so nothing is allocated per frame.
+class FrameWriter {
+public:
+    FrameWriter(const std::string& path, FrameFileFormat format, uint32_t width, uint32_t height, uint32_t framesPerSecond);
+    ~FrameWriter();
+
+    FrameWriter(const FrameWriter&) = delete;
+    FrameWriter& operator=(const FrameWriter&) = delete;
+
+    // Picks the format from the file extension (.y4m, anything else is raw).
+    static FrameFileFormat FormatFromPath(const std::string& path);
+
+    // Returns a free buffer to render into, waiting while both buffers are queued.
+    CpuImage& AcquireFrame();
+    // Queues the buffer returned by the last AcquireFrame for writing.
+    void SubmitFrame();
+    // Writes any queued frames and closes the file. Throws if a write failed.
+    void Close();
+
+    // Only meaningful after Close
+    uint64_t BytesWritten() const { return bytesWritten; }
+
+private:
+    static const int BufferCount = 2;
+
+    void WriterLoop();
+    void WriteFrame(const CpuImage& frame);
+    void ThrowIfWriteFailed();
+
+    FILE* file = nullptr;
+    FrameFileFormat format;
+    CpuImage frames[BufferCount];
+    bool queued[BufferCount] = {};
+    int acquireIndex = 0;
+    int writeIndex = 0;
+    bool acquired = false;
+
+    // Writer thread scratch for the Y4M planes
+    std::vector<uint8_t> planes;
+
+    std::mutex mutex;
+    std::condition_variable frameQueued;
+    std::condition_variable frameWritten;
+    std::thread writerThread;
+    bool closing = false;
+    std::string error;
+    uint64_t bytesWritten = 0;
+};
@@ -0,0 +1,360 @@
+// Headless mode: runs CSMain on the CPU backend without a window or a D3D12 device.
+// On Windows it is reached through `UAVComputerShader.exe <options>`; on Linux build it standalone:
+//   g++ -std=c++17 -O2 -pthread headless.cpp CpuCompute.cpp CSMainSimd.cpp FrameWriter.cpp ../Common/CpuImage.cpp ../Common/SimdIsa.cpp ../Common/TaskScheduler.cpp -o uav_headless
+#include "CpuCompute.h"
+#include "CSMainSimd.h"
+#include "FrameWriter.h"
+#include "../Common/TaskScheduler.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    struct HeadlessOptions {
+        uint32_t width = 800;
+        uint32_t height = 600;
+        uint32_t frames = 1000;
+        uint32_t threads = 0;
+        float startTime = 0.0f;
+        float timeStep = 1.0f / 60.0f;
+        SimdIsa isa = DetectSimdIsa();
+        bool benchmark = false;
+        bool sweep = false;
+        bool verify = false;
+        uint32_t sweepMax = 7680;
+        std::string outputPath;
+        std::string recordPath;
+    };
+
+    void PrintUsage() {
+        std::cout <<
+            "Usage: UAVComputerShader [options]\n"
+            "  --width W       output width in pixels (default 800)\n"
+            "  --height H      output height in pixels (default 600)\n"
+            "  --frames N      number of frames to render (default 1000)\n"
+            "  --time T        Time root constant of the first frame (default 0)\n"
+            "  --dt S          Time step between frames (default 1/60)\n"
+            "  --threads N     worker threads, 0 = all cores (default 0)\n"
+            "  --isa NAME      scalar, sse4.2, avx2 or avx512 (default: widest supported)\n"
+            "  --bench         report Mpixels/s and max ULP error for every supported ISA\n"
+            "  --sweep [MAX]   throughput across resolutions up to MAX wide (default 7680, at most 16384)\n"
+            "  --verify        check the fused UNORM packing of every supported ISA bit for bit\n"
+            "  --out FILE.ppm  write the last frame as a binary PPM\n"
+            "  --record FILE   stream every frame to FILE (.y4m for YUV4MPEG2, otherwise raw RGBA8)\n";
+    }
+
+    HeadlessOptions ParseOptions(int argc, char** argv) {
+        HeadlessOptions options;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            auto next = [&]() -> const char* {
+                if (i + 1 >= argc) {
+                    throw std::runtime_error("Missing value for " + arg);
+                }
+                return argv[++i];
+            };
+
+            if (arg == "--width") options.width = static_cast<uint32_t>(std::strtoul(next(), nullptr, 10));
+            else if (arg == "--height") options.height = static_cast<uint32_t>(std::strtoul(next(), nullptr, 10));
+            else if (arg == "--frames") options.frames = static_cast<uint32_t>(std::strtoul(next(), nullptr, 10));
+            else if (arg == "--time") options.startTime = std::strtof(next(), nullptr);
+            else if (arg == "--dt") options.timeStep = std::strtof(next(), nullptr);
+            else if (arg == "--threads") options.threads = static_cast<uint32_t>(std::strtoul(next(), nullptr, 10));
+            else if (arg == "--out") options.outputPath = next();
+            else if (arg == "--record") options.recordPath = next();
+            else if (arg == "--bench") options.benchmark = true;
+            else if (arg == "--verify") options.verify = true;
+            else if (arg == "--sweep") {
+                options.sweep = true;
+                if (i + 1 < argc && argv[i + 1][0] != '-') {
+                    options.sweepMax = static_cast<uint32_t>(std::strtoul(next(), nullptr, 10));
+                }
+            }
+            else if (arg == "--isa") {
+                const char* name = next();
+                if (!ParseSimdIsa(name, options.isa) || !IsSimdIsaSupported(options.isa)) {
+                    throw std::runtime_error(std::string("Unsupported ISA ") + name);
+                }
+            }
+            else throw std::runtime_error("Unknown option " + arg);
+        }
+        if (options.width == 0 || options.height == 0 ||
+            options.width > CpuComputeEngine::MaxDimension || options.height > CpuComputeEngine::MaxDimension) {
+            throw std::runtime_error("Resolution must be between 1x1 and 16384x16384");
+        }
+        return options;
+    }
+
+    void WritePPM(const std::string& path, const CpuImage& image) {
+        FILE* file = std::fopen(path.c_str(), "wb");
+        if (!file) {
+            throw std::runtime_error("Failed to open " + path);
+        }
+        std::fprintf(file, "P6\n%u %u\n255\n", image.width, image.height);
+        std::vector<uint8_t> rgb(static_cast<size_t>(image.width) * 3);
+        for (uint32_t y = 0; y < image.height; y++) {
+            const uint8_t* row = image.Row(y);
+            for (uint32_t x = 0; x < image.width; x++) {
+                std::memcpy(&rgb[x * 3], row + x * 4, 3);
+            }
+            std::fwrite(rgb.data(), 1, rgb.size(), file);
+        }
+        std::fclose(file);
+    }
+
+    double RenderFrames(CpuComputeEngine& engine, CpuImage& image, const HeadlessOptions& options) {
+        auto begin = std::chrono::steady_clock::now();
+        for (uint32_t frame = 0; frame < options.frames; frame++) {
+            float time = options.startTime + options.timeStep * frame;
+            engine.Dispatch(MakeComputeParams(image.width, image.height, time), image);
+        }
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double>(end - begin).count();
+    }
+
+    // Per-pixel work only (b channel and packing), single thread, into one cache-resident row
+    double MeasureKernelSeconds(SimdIsa isa, const HeadlessOptions& options) {
+        const CSMainKernels& kernels = GetCSMainKernels(isa);
+        std::vector<float> u(SimdPaddedCount(options.width));
+        std::vector<float> v(SimdPaddedCount(options.height));
+        std::vector<uint32_t> redAlpha(SimdPaddedCount(options.width), 0xff000000u);
+        std::vector<uint32_t> row(options.width);
+        kernels.coordTable(0, options.width, 1.0f / options.width, u.data());
+        kernels.coordTable(0, options.height, 1.0f / options.width, v.data());
+
+        auto begin = std::chrono::steady_clock::now();
+        for (uint32_t frame = 0; frame < options.frames; frame++) {
+            float time = options.startTime + options.timeStep * frame;
+            for (uint32_t y = 0; y < options.height; y++) {
+                kernels.shadeRow(time, u.data(), v[y], redAlpha.data(), 0, options.width, row.data());
+            }
+        }
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double>(end - begin).count();
+    }
+
+    void RunBenchmark(TaskScheduler& scheduler, const HeadlessOptions& options) {
+        CpuImage image(options.width, options.height);
+        const double pixels = static_cast<double>(options.width) * options.height * options.frames;
+
+        for (SimdIsa isa : { SimdIsa::Scalar, SimdIsa::SSE42, SimdIsa::AVX2, SimdIsa::AVX512 }) {
+            if (!IsSimdIsaSupported(isa)) {
+                std::cout << SimdIsaName(isa) << ": not supported" << std::endl;
+                continue;
+            }
+            CpuComputeEngine engine(scheduler, isa);
+            double seconds = RenderFrames(engine, image, options);
+            double kernelSeconds = MeasureKernelSeconds(isa, options);
+            ComputeParams params = MakeComputeParams(options.width, options.height, options.startTime + 12.345f);
+            CSMainAccuracy accuracy = MeasureCSMainAccuracy(isa, params);
+            std::cout << SimdIsaName(isa) << ": kernel " << pixels / kernelSeconds * 1e-6 << " Mpixels/s/thread, frame "
+                << pixels / seconds * 1e-6 << " Mpixels/s (" << options.frames / seconds << " frames/s), max ULP r/g/b "
+                << accuracy.maxUlpR << "/" << accuracy.maxUlpG << "/" << accuracy.maxUlpB << std::endl;
+        }
+    }
+
+    // The fused path must produce exactly the bytes of the float path followed by PackUnorm8.
+    // Against the libm reference a channel may still differ by one step where the kernel's
+    // sin lands on the other side of a rounding boundary.
+    bool VerifyPacking(TaskScheduler& scheduler, const HeadlessOptions& options) {
+        const uint32_t width = options.width;
+        const uint32_t height = options.height;
+        const ComputeParams params = MakeComputeParams(width, height, options.startTime + 12.345f);
+        bool passed = true;
+
+        for (SimdIsa isa : { SimdIsa::Scalar, SimdIsa::SSE42, SimdIsa::AVX2, SimdIsa::AVX512 }) {
+            if (!IsSimdIsaSupported(isa)) {
+                continue;
+            }
+            const CSMainKernels& kernels = GetCSMainKernels(isa);
+            uint64_t packMismatches = CountUnormPackingMismatches(isa);
+
+            CpuComputeEngine engine(scheduler, isa);
+            CpuImage image(width, height);
+            engine.Dispatch(params, image);
+
+            std::vector<float> u(SimdPaddedCount(width)), v(SimdPaddedCount(height));
+            std::vector<float> r(SimdPaddedCount(width)), g(SimdPaddedCount(height)), b(SimdPaddedCount(width));
+            kernels.coordTable(0, width, params.invWidth, u.data());
+            kernels.coordTable(0, height, params.invWidth, v.data());
+            kernels.redTable(params.time, u.data(), width, r.data());
+            kernels.greenTable(params.time, v.data(), height, g.data());
+
+            uint64_t floatPathMismatches = 0;
+            int maxReferenceDiff = 0;
+            for (uint32_t y = 0; y < height; y++) {
+                kernels.blueRow(params.time, u.data(), v[y], width, b.data());
+                const uint8_t* row = image.Row(y);
+                for (uint32_t x = 0; x < width; x++) {
+                    float rgba[4] = { r[x], g[y], b[x], 1.0f };
+                    uint32_t expected = PackUnorm8(rgba);
+                    uint32_t actual;
+                    std::memcpy(&actual, row + x * 4, sizeof(actual));
+                    floatPathMismatches += expected != actual;
+
+                    float reference[4];
+                    CSMainReference(x, y, params, reference);
+                    for (int c = 0; c < 4; c++) {
+                        int diff = std::abs(static_cast<int>(FloatToUnorm8(reference[c])) - row[x * 4 + c]);
+                        maxReferenceDiff = std::max(maxReferenceDiff, diff);
+                    }
+                }
+            }
+
+            bool ok = packMismatches == 0 && floatPathMismatches == 0 && maxReferenceDiff <= 1;
+            passed = passed && ok;
+            std::cout << SimdIsaName(isa) << ": " << packMismatches << " of 2^32 floats pack differently, "
+                << floatPathMismatches << " pixels differ from the float path, max diff vs reference "
+                << maxReferenceDiff << (ok ? " OK" : " FAILED") << std::endl;
+        }
+        return passed;
+    }
+
+    // An exception from fn on the calling thread, on a worker and on every item reaches the
+    // caller of ParallelFor, and the scheduler runs the next ParallelFor in full
+    bool VerifySchedulerExceptions() {
+        TaskScheduler scheduler(4);
+        const uint32_t count = 1000;
+        uint32_t rethrown = 0, complete = 0;
+        for (uint32_t failing : { 0u, count - 1, count }) {
+            try {
+                scheduler.ParallelFor(count, [&](uint32_t begin, uint32_t end) {
+                    if (failing == count || (failing >= begin && failing < end)) {
+                        throw std::runtime_error("item failed");
+                    }
+                });
+            }
+            catch (const std::runtime_error&) {
+                rethrown++;
+            }
+            std::vector<std::atomic<uint32_t>> runs(count);
+            scheduler.ParallelFor(count, [&](uint32_t begin, uint32_t end) {
+                for (uint32_t i = begin; i < end; i++) {
+                    runs[i]++;
+                }
+            });
+            complete += std::all_of(runs.begin(), runs.end(), [](const std::atomic<uint32_t>& n) { return n == 1; });
+        }
+        const bool ok = rethrown == 3 && complete == 3;
+        std::cout << "scheduler: " << rethrown << " of 3 exceptions rethrown, " << complete
+            << " of 3 following ParallelFor calls complete" << (ok ? " OK" : " FAILED") << std::endl;
+        return ok;
+    }
+
+    // Batch mode: the kernel renders frame N + 1 while the writer thread stores frame N
+    void RecordFrames(TaskScheduler& scheduler, const HeadlessOptions& options) {
+        CpuComputeEngine engine(scheduler, options.isa);
+        FrameFileFormat format = FrameWriter::FormatFromPath(options.recordPath);
+        uint32_t framesPerSecond = options.timeStep > 0.0f ? static_cast<uint32_t>(1.0f / options.timeStep + 0.5f) : 60;
+        FrameWriter writer(options.recordPath, format, options.width, options.height, std::max(1u, framesPerSecond));
+
+        auto begin = std::chrono::steady_clock::now();
+        for (uint32_t frame = 0; frame < options.frames; frame++) {
+            float time = options.startTime + options.timeStep * frame;
+            CpuImage& image = writer.AcquireFrame();
+            engine.Dispatch(MakeComputeParams(options.width, options.height, time), image);
+            writer.SubmitFrame();
+        }
+        writer.Close();
+        auto end = std::chrono::steady_clock::now();
+
+        double seconds = std::chrono::duration<double>(end - begin).count();
+        std::cout << "Recorded " << options.frames << " frames to " << options.recordPath << " in " << seconds << " s ("
+            << options.frames / seconds << " frames/s, " << writer.BytesWritten() / seconds * 1e-6 << " MB/s)" << std::endl;
+    }
+
+    // Throughput should scale with pixel count, so ns/pixel ought to stay flat across sizes
+    void RunSweep(TaskScheduler& scheduler, const HeadlessOptions& options) {
+        static const uint32_t sizes[][2] = {
+            { 256, 256 }, { 640, 480 }, { 800, 600 }, { 1001, 777 }, { 1280, 720 }, { 1920, 1080 },
+            { 2560, 1440 }, { 3840, 2160 }, { 7680, 4320 }, { 8192, 8192 }, { 16384, 16384 },
+        };
+        const uint32_t maxWidth = std::min<uint32_t>(options.sweepMax, CpuComputeEngine::MaxDimension);
+        CpuComputeEngine engine(scheduler, options.isa);
+        CpuImage image;
+
+        for (const auto& size : sizes) {
+            if (size[0] > maxWidth) {
+                break;
+            }
+            image.Resize(size[0], size[1]);
+            const double pixelsPerFrame = static_cast<double>(size[0]) * size[1];
+
+            // About 200 Mpixels per size, but at least a few frames
+            HeadlessOptions sized = options;
+            sized.frames = static_cast<uint32_t>(std::max(3.0, 200e6 / pixelsPerFrame));
+            engine.Dispatch(MakeComputeParams(size[0], size[1], 0.0f), image);
+            double seconds = RenderFrames(engine, image, sized);
+
+            double pixels = pixelsPerFrame * sized.frames;
+            std::cout << size[0] << "x" << size[1] << ": " << pixels / seconds * 1e-6 << " Mpixels/s, "
+                << seconds / pixels * 1e9 << " ns/pixel, " << sized.frames / seconds << " frames/s" << std::endl;
+        }
+    }
+}
+
+int RunHeadless(int argc, char** argv) {
+    HeadlessOptions options;
+    try {
+        options = ParseOptions(argc, argv);
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        PrintUsage();
+        return 1;
+    }
+
+    TaskScheduler scheduler(options.threads);
+    if (options.benchmark) {
+        RunBenchmark(scheduler, options);
+        return 0;
+    }
+    if (options.verify) {
+        bool passed = VerifyPacking(scheduler, options);
+        passed &= VerifySchedulerExceptions();
+        return passed ? 0 : 1;
+    }
+    if (options.sweep) {
+        RunSweep(scheduler, options);
+        return 0;
+    }
+    if (!options.recordPath.empty()) {
+        try {
+            RecordFrames(scheduler, options);
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    CpuComputeEngine engine(scheduler, options.isa);
+    CpuImage image(options.width, options.height);
+
+    std::cout << "CPU compute backend: " << options.width << "x" << options.height
+        << ", " << scheduler.ThreadCount() << " threads, " << SimdIsaName(engine.Isa()) << std::endl;
+
+    double seconds = RenderFrames(engine, image, options);
+    std::cout << options.frames << " frames in " << seconds << " s ("
+        << options.frames / seconds << " frames/s)" << std::endl;
+
+    if (!options.outputPath.empty()) {
+        WritePPM(options.outputPath, image);
+        std::cout << "Wrote " << options.outputPath << std::endl;
+    }
+    return 0;
+}
+
+#ifndef _WIN32
+int main(int argc, char** argv) {
+    return RunHeadless(argc, argv);
+}
+#endif
@@ -9,6 +9,8 @@
 #include <chrono>
 #include <vector>
 #include <stdexcept>
+#include "ComputeParams.h"
+#include "../Common/FramePacer.h"
 
 using namespace Microsoft::WRL;
 using namespace DirectX;
@@ -27,11 +29,13 @@ void Initialize();
 void LoadAssets();
 void LoadShaderPipeline();
 void ThrowIfFailed(HRESULT hr);
+int RunHeadless(int argc, char** argv); // headless.cpp
 
 // Constants
 const UINT Width = 800;
 const UINT Height = 600;
 const UINT FrameCount = 2;
+const UINT FramesInFlight = 3; // Frames the CPU may record ahead of the GPU, independent of the back buffers
 
 // Globals
 HWND hwnd = nullptr;
@@ -41,11 +45,10 @@ ComPtr<ID3D12CommandQueue> commandQueue;
 ComPtr<ID3D12DescriptorHeap> rtvHeap;
 UINT rtvDescriptorSize;
 ComPtr<ID3D12Resource> renderTarget[FrameCount];
-ComPtr<ID3D12CommandAllocator> commandAllocator;
+ComPtr<ID3D12CommandAllocator> commandAllocator[FramesInFlight]; // One per frame context
 ComPtr<ID3D12GraphicsCommandList> commandList;
 ComPtr<ID3D12Fence> fence;
 HANDLE fenceEvent;
-UINT64 fenceValue = 1;
 UINT frameIndex;
 
 ComPtr<ID3D12RootSignature> rootSignature;
@@ -56,6 +59,22 @@ ComPtr<ID3D12Resource> uavTexture;
 ComPtr<ID3D12DescriptorHeap> shaderVisibleHeap;
 UINT shaderVisibleDescriptorSize;
 
+// Frames in flight: the CPU only waits for the GPU when it is about to reuse a frame context
+class D3D12TimelineFence : public TimelineFence {
+public:
+    uint64_t CompletedValue() override { return fence->GetCompletedValue(); }
+
+    void WaitForValue(uint64_t value) override {
+        if (fence->GetCompletedValue() < value) {
+            ThrowIfFailed(fence->SetEventOnCompletion(value, fenceEvent));
+            WaitForSingleObject(fenceEvent, INFINITE);
+        }
+    }
+};
+
+D3D12TimelineFence frameFence;
+FramePacer framePacer(frameFence, FramesInFlight);
+
 // Timer
 std::chrono::steady_clock::time_point startTime;
 
@@ -180,7 +199,9 @@ void Initialize() {
     }
 
     // Command Allocator
-    ThrowIfFailed(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&commandAllocator)));
+    for (UINT i = 0; i < FramesInFlight; i++) {
+        ThrowIfFailed(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&commandAllocator[i])));
+    }
 }
 
 void LoadShaderPipeline() {
@@ -193,7 +214,7 @@ void LoadShaderPipeline() {
     range.Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 0);
 
     CD3DX12_ROOT_PARAMETER rootParams[2] = {};
-    rootParams[0].InitAsConstants(1, 0); // Time constant
+    rootParams[0].InitAsConstants(ComputeParamsNum32BitValues, 0); // ComputeParams
     rootParams[1].InitAsDescriptorTable(1, &range); // UAV descriptor table
 
     CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc = {};
@@ -210,15 +231,18 @@ void LoadShaderPipeline() {
     ThrowIfFailed(device->CreateComputePipelineState(&psoDesc, IID_PPV_ARGS(&pipelineState)));
 
     // Create the command list
-    ThrowIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, commandAllocator.Get(), pipelineState.Get(), IID_PPV_ARGS(&commandList)));
+    ThrowIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, commandAllocator[0].Get(), pipelineState.Get(), IID_PPV_ARGS(&commandList)));
     ThrowIfFailed(commandList->Close());
 }
 
 // Main render loop
 void UpdateAndRender() {
-    // Reset command allocator and command list for the new frame
-    ThrowIfFailed(commandAllocator->Reset());
-    ThrowIfFailed(commandList->Reset(commandAllocator.Get(), pipelineState.Get()));
+    // Reset the frame context's command allocator and the command list for the new frame.
+    // BeginFrame waits only if the GPU has not finished the frame that last used the context.
+    framePacer.BeginFrame();
+    ID3D12CommandAllocator* allocator = commandAllocator[framePacer.FrameIndex()].Get();
+    ThrowIfFailed(allocator->Reset());
+    ThrowIfFailed(commandList->Reset(allocator, pipelineState.Get()));
 
     // Set the root signature and descriptor heaps
     commandList->SetComputeRootSignature(rootSignature.Get());
@@ -227,15 +251,16 @@ void UpdateAndRender() {
     CD3DX12_GPU_DESCRIPTOR_HANDLE gpuHandle(shaderVisibleHeap->GetGPUDescriptorHandleForHeapStart());
     commandList->SetComputeRootDescriptorTable(1, gpuHandle);
 
-    // Pass time to the shader as a root constant
+    // Pass resolution and time to the shader as root constants
     auto now = std::chrono::steady_clock::now();
     float time = std::chrono::duration<float>(now - startTime).count();
-    commandList->SetComputeRoot32BitConstants(0, 1, &time, 0);
+    ComputeParams params = MakeComputeParams(Width, Height, time);
+    commandList->SetComputeRoot32BitConstants(0, ComputeParamsNum32BitValues, &params, 0);
 
     // Dispatch the compute shader.
-    // The shader has a thread group size of 8x8. We need to dispatch enough groups
-    // to cover the entire texture (800x600).
-    commandList->Dispatch(Width / 8, Height / 8, 1);
+    // The shader has a thread group size of 8x8. Round up so sizes that are not a
+    // multiple of 8 still cover the edge pixels; the shader skips the overhang.
+    commandList->Dispatch((Width + 7) / 8, (Height + 7) / 8, 1);
 
     // Transition the UAV texture from UAV state to COPY_SOURCE state
     CD3DX12_RESOURCE_BARRIER uavToCopy = CD3DX12_RESOURCE_BARRIER::Transition(
@@ -255,6 +280,11 @@ void UpdateAndRender() {
         renderTarget[frameIndex].Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PRESENT);
     commandList->ResourceBarrier(1, &rtToPresent);
 
+    // Hand the UAV texture back to the next frame's dispatch
+    CD3DX12_RESOURCE_BARRIER copyToUav = CD3DX12_RESOURCE_BARRIER::Transition(
+        uavTexture.Get(), D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    commandList->ResourceBarrier(1, &copyToUav);
+
     // Close the command list and execute it
     ThrowIfFailed(commandList->Close());
     ID3D12CommandList* cmdLists[] = { commandList.Get() };
@@ -263,13 +293,8 @@ void UpdateAndRender() {
     // Present the frame
     ThrowIfFailed(swapChain->Present(1, 0));
 
-    // Wait for the GPU to finish the current frame
-    fenceValue++;
-    ThrowIfFailed(commandQueue->Signal(fence.Get(), fenceValue));
-    if (fence->GetCompletedValue() < fenceValue) {
-        ThrowIfFailed(fence->SetEventOnCompletion(fenceValue, fenceEvent));
-        WaitForSingleObject(fenceEvent, INFINITE);
-    }
+    // Tag the frame context with its fence value and move on without waiting for the GPU
+    ThrowIfFailed(commandQueue->Signal(fence.Get(), framePacer.EndFrame()));
     frameIndex = swapChain->GetCurrentBackBufferIndex();
 }
 
@@ -318,7 +343,12 @@ static void GetHardwareAdapter(
     }
 }
 
-int main() {
+int main(int argc, char** argv) {
+    // Any command line switches select the CPU backend instead of the window
+    if (argc > 1) {
+        return RunHeadless(argc, argv);
+    }
+
     std::cout << "Starting Direct3D 12 Compute Shader Demo" << std::endl;
     HINSTANCE hInstance = GetModuleHandle(nullptr);
     InitWindow(hInstance);
@@ -344,6 +374,8 @@ int main() {
         UpdateAndRender();
     }
 
+    // The GPU may still run the last frames in flight
+    framePacer.WaitForIdle();
     CloseHandle(fenceEvent);
     std::cout << "Exiting Direct3D 12 Compute Shader Demo" << std::endl;
     return 0;
@@ -1,16 +1,26 @@
 RWTexture2D<float4> OutputTexture : register(u0);
-cbuffer TimeConstants : register(b0)
+cbuffer ComputeParams : register(b0)
 {
+    uint2 Resolution;
+    float InvWidth;
     float Time;
+    uint2 TileOrigin;
 };
 
 [numthreads(8, 8, 1)]
 void CSMain(uint3 id : SV_DispatchThreadID)
 {
-    float2 uv = (float2)id.xy / (float2)800.0f;
+    uint2 pixel = TileOrigin + id.xy;
+
+    // The dispatch is rounded up to whole groups, so edge groups can overhang the texture
+    if (any(pixel >= Resolution))
+        return;
+
+    // Both axes scale by the width, as the original fixed 800x600 pattern did
+    float2 uv = (float2)pixel * InvWidth;
     float r = abs(sin(uv.x * 20.0f + Time));
     float g = abs(cos(uv.y * 20.0f - Time));
     float b = sin(uv.x * uv.y * 50.0f + Time * 2.0f);
 
-    OutputTexture[id.xy] = float4(r, g, b, 1.0f);
-}
\ No newline at end of file
+    OutputTexture[pixel] = float4(r, g, b, 1.0f);
+}